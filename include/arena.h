@@ -0,0 +1,110 @@
+/**
+ * @file arena.h
+ * @brief A linear allocator for the buffers of the real-time path.
+ *
+ * Allocating memory while audio is being acquired makes the time of each
+ * analysis round depend on the state of the allocator.
+ * To avoid it, all the buffers that the detection needs are taken from a
+ * single arena, whose size is computed when the detection is configured, and
+ * that is created once, before the recording starts.
+ *
+ * Modules that take memory from an arena should provide a function to compute
+ * the size they need, so that the owner of the arena can sum them.
+ * Use ARENA_ALIGN on each allocation size to take into account the padding.
+ */
+
+#ifndef __ARENA_H
+#define __ARENA_H
+
+// size_t
+#include <stddef.h>
+
+/**
+ * @brief The alignment of all the blocks returned by arenaAlloc.
+ *
+ * It is the size of a cache line on most of the common CPUs, and it is enough
+ * for any SIMD load, too.
+ */
+#define ARENA_ALIGNMENT 64
+
+/**
+ * @brief The space that a block of a certain size takes in the arena.
+ */
+#define ARENA_ALIGN(size) \
+	(((size_t)(size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+/**
+ * @brief The arena, whose content is private.
+ */
+typedef struct _Arena Arena;
+
+/**
+ * @brief Create an arena.
+ *
+ * The memory is allocated and cleared immediately, so that the pages are
+ * already mapped when the real-time path uses them.
+ *
+ * @param size The number of bytes that can be allocated from the arena
+ * @return The new arena, or 0 in case of error
+ */
+extern Arena *arenaCreate(size_t size);
+
+/**
+ * @brief Destroy an arena and all the blocks that have been allocated from it.
+ * @note If arena is null, the function will safely return without doing
+ *  anything.
+ *
+ * @param arena The arena to destroy or null
+ */
+extern void arenaFree(Arena *arena);
+
+/**
+ * @brief Take a block from the arena.
+ *
+ * Blocks are aligned to ARENA_ALIGNMENT and their content is zero, unless the
+ * arena has been reset.
+ * They cannot be freed individually.
+ *
+ * @param arena The arena
+ * @param size The size of the block, in bytes
+ * @return The address of the block, or 0 if the arena has not enough space
+ */
+extern void *arenaAlloc(Arena *arena, size_t size);
+
+/**
+ * @brief Release all the blocks of the arena, to use it again.
+ *
+ * @param arena The arena
+ */
+extern void arenaReset(Arena *arena);
+
+/**
+ * @brief Get the number of bytes that have been allocated from the arena.
+ *
+ * @param arena The arena
+ * @return The used bytes, including the alignment padding
+ */
+extern size_t arenaUsed(const Arena *arena);
+
+#ifdef ALLOC_TRACKING
+/**
+ * @brief Start counting the heap allocations of the calling thread.
+ *
+ * This is available only in debug builds on platforms whose linker can wrap
+ * malloc, calloc and realloc (see the ALLOC_TRACKING option in CMake).
+ * It is meant to verify that the real-time path never reaches the heap.
+ */
+extern void allocTrackingBegin(void);
+
+/**
+ * @brief Stop counting the heap allocations of the calling thread.
+ *
+ * @return The number of allocations since allocTrackingBegin
+ */
+extern unsigned long allocTrackingEnd(void);
+#else
+#	define allocTrackingBegin()
+#	define allocTrackingEnd() 0UL
+#endif
+
+#endif /* __ARENA_H */
@@ -158,4 +158,20 @@ extern int audioSetDevice(AudioContext *context, const char *name);
  */
 extern int audioRecord(AudioContext *context, const char *keepRunning);
 
+/**
+ * @brief Find the tightest stable capture and analysis settings for the
+ *  current device, and save them to the profile.
+ *
+ * The capture and the analysis run for a few seconds at increasingly
+ * aggressive latencies and hops, measuring the jitter of the callbacks, the
+ * distribution of the analysis time and the overflows, until a step is not
+ * stable anymore.
+ * audioRecord loads the profile each time it starts.
+ *
+ * @param context The AudioContext instance
+ * @return The status (boolean): 0 if no stable settings have been found or
+ *  the profile could not be saved
+ */
+extern int audioCalibrate(AudioContext *context);
+
 #endif /* __AUDIO_H */
@@ -0,0 +1,173 @@
+/**
+ * @file band_estimator.h
+ * @brief Estimate the period of a signal separately on two registers.
+ *
+ * The signal is split by a crossover: the low register is low-passed and
+ * decimated heavily, so its long periods need only a few lags, and the high
+ * register is analyzed at full rate, but only with the short lags and on the
+ * last part of the window.
+ * The two bands have separate buffers and estimators, so they can run on two
+ * cores at the same time, and then their candidates are combined with an
+ * octave arbitration on the whole signal.
+ */
+
+#ifndef __BAND_ESTIMATOR_H
+#define __BAND_ESTIMATOR_H
+
+// size_t
+#include <stddef.h>
+
+// Arena
+#include "arena.h"
+
+/**
+ * @brief An instance of the band-split estimator with its own buffers.
+ */
+typedef struct _BandEstimator BandEstimator;
+
+/**
+ * @brief The parameters of a BandEstimator.
+ *
+ * Always initialize instances with bandConfigInit, so that the options that
+ * are not set explicitly have their default value.
+ */
+typedef struct {
+	/**
+	 * @brief The sample rate of the signal.
+	 */
+	unsigned int rate;
+
+	/**
+	 * @brief Minimum period of interest, at full rate.
+	 */
+	int minP;
+
+	/**
+	 * @brief Maximum period of interest, at full rate.
+	 */
+	int maxP;
+
+	/**
+	 * @brief The number of samples of the windows, at least 2 * maxP.
+	 */
+	int window;
+
+	/**
+	 * @brief The frequency between the two registers, in Hz.
+	 *
+	 * The low band also covers the octave above it, so that the notes near
+	 * the crossover are seen by both the bands.
+	 */
+	double crossover;
+
+	/**
+	 * @brief The decimation factor of the low band.
+	 *
+	 * If 0, bandCreate chooses the highest one that keeps two octaves above
+	 * the crossover.
+	 */
+	unsigned int factor;
+
+	/**
+	 * @brief The spacing of the lag grid of the estimators, in semitones.
+	 * @sa EstimatorConfig.gridStep
+	 */
+	double gridStep;
+
+	/**
+	 * @brief Accumulate the products of the estimators in float.
+	 * @sa EstimatorConfig.floatSums
+	 */
+	int floatSums;
+} BandConfig;
+
+/**
+ * @brief Initialize a BandConfig with the default options.
+ *
+ * The crossover is two octaves above the lowest note.
+ *
+ * @param config The configuration to initialize
+ * @param rate The sample rate of the signal
+ * @param minP Minimum period of interest
+ * @param maxP Maximum period of interest
+ */
+extern void bandConfigInit(BandConfig *config, unsigned int rate, int minP,
+		int maxP);
+
+/**
+ * @brief Get the memory that bandCreate will take from the arena.
+ *
+ * @param config The configuration of the estimator
+ * @return The size in bytes, including the alignment padding
+ */
+extern size_t bandMemorySize(const BandConfig *config);
+
+/**
+ * @brief Create a band-split estimator.
+ *
+ * @param arena The arena to take the memory from. It must have at least
+ *  bandMemorySize bytes available
+ * @param config The configuration of the estimator, which will be copied
+ * @return The estimator, or 0 in case of error
+ */
+extern BandEstimator *bandCreate(Arena *arena, const BandConfig *config);
+
+/**
+ * @brief Estimate the period in the low band.
+ *
+ * The period found on the decimated signal is refined on the lags around it
+ * at full rate.
+ * It uses only the buffers of the low band, so it can run while another
+ * thread runs bandRunHigh on the same estimator.
+ *
+ * @param estimator The estimator
+ * @param x The signal, with config.window samples
+ * @param q Output parameter for the quality of the periodicity
+ * @return The period at full rate, or 0 if none has been found
+ */
+extern double bandRunLow(BandEstimator *estimator, const float *x, double *q);
+
+/**
+ * @brief Estimate the period in the high band.
+ * @sa bandRunLow
+ *
+ * @param estimator The estimator
+ * @param x The signal, with config.window samples
+ * @param q Output parameter for the quality of the periodicity
+ * @return The period, or 0 if none has been found
+ */
+extern double bandRunHigh(BandEstimator *estimator, const float *x, double *q);
+
+/**
+ * @brief Choose between the candidates of the two bands.
+ *
+ * The high band sees the harmonics of the low notes, and the low band can see
+ * a multiple of the period of the notes near the crossover.
+ * So, when a candidate is a multiple of the other, the shorter one is chosen
+ * only if the whole signal is nearly as periodic with all its multiples below
+ * the longer one, like fixOctaves of the period estimator does.
+ * Otherwise, the candidate with the best quality is chosen.
+ *
+ * @param x The signal
+ * @param n The number of samples
+ * @param low The period of the low band, or 0
+ * @param lowQ The quality of the low band
+ * @param high The period of the high band, or 0
+ * @param highQ The quality of the high band
+ * @param q Output parameter for the quality of the chosen period
+ * @return The chosen period, or 0 if no band has found one
+ */
+extern double bandCombine(const float *x, int n, double low, double lowQ,
+		double high, double highQ, double *q);
+
+/**
+ * @brief Estimate the period in both the bands, and combine them.
+ *
+ * @param estimator The estimator
+ * @param x The signal, with config.window samples
+ * @param q Output parameter for the quality of the periodicity
+ * @return The period, or 0 if none has been found
+ */
+extern double bandRun(BandEstimator *estimator, const float *x, double *q);
+
+#endif /* __BAND_ESTIMATOR_H */
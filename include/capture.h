@@ -0,0 +1,189 @@
+/**
+ * @file capture.h
+ * @brief Record the audio that the detection sees, and its events, to disk.
+ *
+ * The capture is a tap on the input: the audio callback copies its blocks
+ * into a lock-free ring, the recording loop copies the events of the
+ * detection into a lock-free queue, and a low-priority thread drains both to
+ * a WAV file and to a text log.
+ * The producers never wait for the disk: when the writer falls behind, the
+ * blocks that don't fit in the ring are dropped and counted, and the writer
+ * replaces them with silence, so that the positions of the events still
+ * match the samples of the file.
+ */
+
+#ifndef __CAPTURE_H
+#define __CAPTURE_H
+
+// size_t
+#include <stddef.h>
+
+// FILE
+#include <stdio.h>
+
+// DetectEvent
+#include "detect.h"
+
+/**
+ * @brief An instance of the capture, with its writer thread.
+ */
+typedef struct _Capture Capture;
+
+/**
+ * @brief The parameters of a Capture.
+ *
+ * Always initialize instances with captureConfigInit, so that the options
+ * that are not set explicitly have their default value.
+ */
+typedef struct {
+	/**
+	 * @brief The sample rate of the audio.
+	 */
+	unsigned int rate;
+
+	/**
+	 * @brief The minimum number of samples that can wait for the writer.
+	 *
+	 * It is rounded up to the capacity of a SampleRing.
+	 */
+	size_t capacity;
+
+	/**
+	 * @brief The number of events that can wait for the writer.
+	 */
+	unsigned int events;
+
+	/**
+	 * @brief The milliseconds that the writer sleeps between two drains.
+	 */
+	unsigned int writerSleep;
+} CaptureConfig;
+
+/**
+ * @brief The counters of the capture.
+ */
+typedef struct {
+	/**
+	 * @brief The number of blocks that have been queued.
+	 */
+	unsigned long blocks;
+
+	/**
+	 * @brief The number of blocks that have been dropped because the ring was
+	 *  full.
+	 */
+	unsigned long droppedBlocks;
+
+	/**
+	 * @brief The number of samples of the dropped blocks.
+	 */
+	unsigned long droppedSamples;
+
+	/**
+	 * @brief The number of events that have been queued.
+	 */
+	unsigned long events;
+
+	/**
+	 * @brief The number of events that have been dropped because the queue
+	 *  was full.
+	 */
+	unsigned long droppedEvents;
+
+	/**
+	 * @brief The number of samples that have been written to the file,
+	 *  including the silence in place of the dropped blocks.
+	 */
+	unsigned long writtenSamples;
+
+	/**
+	 * @brief The number of failed writes.
+	 *
+	 * The data of a failed write is discarded, so that the ring doesn't fill
+	 * up because of the disk.
+	 */
+	unsigned long writeErrors;
+} CaptureStats;
+
+/**
+ * @brief Initialize a CaptureConfig with the default options.
+ *
+ * By default two seconds of audio can wait for the writer.
+ *
+ * @param config The configuration to initialize
+ * @param rate The sample rate of the audio
+ */
+extern void captureConfigInit(CaptureConfig *config, unsigned int rate);
+
+/**
+ * @brief Open the files of a capture, and start its writer.
+ *
+ * @param config The configuration of the capture
+ * @param path The path of the files without the extension: the audio is
+ *  written to path.wav and the events to path.log
+ * @return The capture, or 0 in case of error
+ */
+extern Capture *captureStart(const CaptureConfig *config, const char *path);
+
+/**
+ * @brief Stop the writer, after it has written everything in the queues, and
+ *  close the files.
+ * @note If capture is null, the function will safely return without doing
+ *  anything.
+ *
+ * @param capture The capture to stop, which will be freed
+ * @param stats Output parameter for the final counters. If null it will be
+ *  ignored
+ */
+extern void captureStop(Capture *capture, CaptureStats *stats);
+
+/**
+ * @brief Queue a block of samples, or drop it if it doesn't fit.
+ *
+ * It doesn't lock and doesn't allocate, so it can be called by the audio
+ * callback.
+ * @note This function must be called always by the same thread.
+ *
+ * @param capture The capture
+ * @param samples The samples, which are the continuation of the previous
+ *  block
+ * @param count The number of samples
+ * @return 1 if the block has been queued, 0 if it has been dropped
+ */
+extern int captureWrite(Capture *capture, const float *samples, size_t count);
+
+/**
+ * @brief Queue an event of the detection, or drop it if the queue is full.
+ *
+ * It doesn't lock and doesn't allocate.
+ * @note This function must be called always by the same thread.
+ *
+ * @param capture The capture
+ * @param event The event, whose position is relative to the first block of
+ *  the capture
+ * @return 1 if the event has been queued, 0 if it has been dropped
+ */
+extern int captureEvent(Capture *capture, const DetectEvent *event);
+
+/**
+ * @brief Get the counters of the capture.
+ *
+ * They can be read by any thread while the capture is running.
+ *
+ * @param capture The capture
+ * @param stats Output parameter for the counters
+ */
+extern void captureGetStats(Capture *capture, CaptureStats *stats);
+
+/**
+ * @brief Write an event to a log, in the format of the captures.
+ *
+ * Each event is a line with its position, its type and its details, e.g.
+ * "1024 note 24 110.00".
+ *
+ * @param log The log
+ * @param event The event
+ */
+extern void captureLogEvent(FILE *log, const DetectEvent *event);
+
+#endif /* __CAPTURE_H */
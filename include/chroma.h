@@ -0,0 +1,218 @@
+/**
+ * @file chroma.h
+ * @brief Recognize the chords by their pitch classes.
+ *
+ * The magnitude spectrum of the window is folded onto the twelve pitch
+ * classes, and the resulting chroma vector, smoothed over the windows, is
+ * compared to the templates of the chords of each root.
+ * It only tells the name of the chord, not which notes are played, so it is
+ * much cheaper than the chord estimator of poly.h: a short FFT and a sum for
+ * each bin.
+ */
+
+#ifndef __CHROMA_H
+#define __CHROMA_H
+
+// size_t
+#include <stddef.h>
+
+// Arena
+#include "arena.h"
+
+// semitone_t, Tuning, GUITAR_MAX_STRINGS
+#include "guitar.h"
+
+/**
+ * @brief The number of pitch classes.
+ */
+#define CHROMA_CLASSES 12
+
+/**
+ * @brief The size of the buffers for the chord names, including the
+ *  terminator.
+ * @sa chromaChordName
+ */
+#define CHROMA_NAME_SIZE 8
+
+/**
+ * @brief An instance of the chord recognizer with its own buffers.
+ */
+typedef struct _ChromaEstimator ChromaEstimator;
+
+/**
+ * @brief The kinds of chords that can be recognized.
+ */
+typedef enum {
+	/**
+	 * @brief The major triad.
+	 */
+	CHROMA_MAJOR = 0,
+
+	/**
+	 * @brief The minor triad.
+	 */
+	CHROMA_MINOR,
+
+	/**
+	 * @brief The dominant seventh.
+	 */
+	CHROMA_SEVENTH,
+
+	/**
+	 * @brief The minor seventh.
+	 */
+	CHROMA_MINOR_SEVENTH,
+
+	/**
+	 * @brief The number of kinds.
+	 */
+	CHROMA_KINDS
+} ChromaKind;
+
+/**
+ * @brief A recognized chord.
+ */
+typedef struct {
+	/**
+	 * @brief The pitch class of the root, from 0 (A) to 11 (G#).
+	 *
+	 * It is the remainder of the semitones from A0 divided by 12.
+	 */
+	semitone_t root;
+
+	/**
+	 * @brief The kind of the chord.
+	 */
+	ChromaKind kind;
+
+	/**
+	 * @brief The similarity between the chroma vector and the template of the
+	 *  chord, from 0 to 1.
+	 */
+	double score;
+} ChromaChord;
+
+/**
+ * @brief The parameters of a ChromaEstimator.
+ *
+ * Always initialize instances with chromaConfigInit, so that the options that
+ * are not set explicitly have their default value.
+ */
+typedef struct {
+	/**
+	 * @brief The sample rate of the signal.
+	 */
+	unsigned int rate;
+
+	/**
+	 * @brief The number of samples of the windows, a power of two.
+	 */
+	int window;
+
+	/**
+	 * @brief The lowest frequency that is folded, in Hz.
+	 *
+	 * Below it the bins are wider than a semitone, so they would spread over
+	 * more pitch classes.
+	 */
+	double lowest;
+
+	/**
+	 * @brief The highest frequency that is folded, in Hz.
+	 */
+	double highest;
+
+	/**
+	 * @brief The weight of the previous chroma vector in the new one, from 0
+	 *  (no smoothing) to less than 1.
+	 */
+	double smoothing;
+
+	/**
+	 * @brief The minimum score of a chord to be recognized.
+	 */
+	double minScore;
+
+	/**
+	 * @brief The frequency of A4, in Hz.
+	 */
+	double reference;
+} ChromaConfig;
+
+/**
+ * @brief Initialize a ChromaConfig with the default options.
+ *
+ * The default window is about 0.1 seconds.
+ *
+ * @param config The configuration to initialize
+ * @param rate The sample rate of the signal
+ */
+extern void chromaConfigInit(ChromaConfig *config, unsigned int rate);
+
+/**
+ * @brief Get the memory that chromaCreate will take from the arena.
+ *
+ * @param config The configuration of the estimator
+ * @return The size in bytes, including the alignment padding, or 0 if the
+ *  configuration is not valid
+ */
+extern size_t chromaMemorySize(const ChromaConfig *config);
+
+/**
+ * @brief Create a chord recognizer.
+ *
+ * @param arena The arena to take the memory from. It must have at least
+ *  chromaMemorySize bytes available
+ * @param config The configuration of the estimator, which will be copied
+ * @return The estimator, or 0 in case of error
+ */
+extern ChromaEstimator *chromaCreate(Arena *arena, const ChromaConfig *config);
+
+/**
+ * @brief Add a window to the chroma vector, and recognize the chord.
+ *
+ * The estimator doesn't check the level of the signal, so the caller should
+ * skip the silent windows, and call chromaReset when the chord ends.
+ *
+ * @param estimator The estimator
+ * @param x The signal, with config.window samples
+ * @param chord Output parameter for the chord with the best score, which is
+ *  set even if it is not recognized
+ * @return 1 if the chord has been recognized, 0 otherwise
+ */
+extern int chromaRun(ChromaEstimator *estimator, const float *x,
+		ChromaChord *chord);
+
+/**
+ * @brief Forget the chroma vector of the previous windows.
+ *
+ * @param estimator The estimator
+ */
+extern void chromaReset(ChromaEstimator *estimator);
+
+/**
+ * @brief Get the name of a chord, e.g. "C#m7".
+ *
+ * @param chord The chord
+ * @param name The output buffer, with CHROMA_NAME_SIZE elements
+ */
+extern void chromaChordName(const ChromaChord *chord, char *name);
+
+/**
+ * @brief Find a shape of a chord on the neck.
+ *
+ * The shape is the one in the lowest position of the neck where each string
+ * plays a note of the chord within four frets, or the open string, the lowest
+ * string played is the root, and all the notes of the chord are played.
+ * The strings below the root are not played.
+ *
+ * @param tuning The tuning of the instrument
+ * @param chord The chord
+ * @param frets Output parameter for the fret of each string, with
+ *  GUITAR_MAX_STRINGS elements, -1 for the strings that are not played
+ * @return The number of strings played, or 0 if no shape has been found
+ */
+extern unsigned int chromaShape(const Tuning *tuning, const ChromaChord *chord,
+		semitone_t *frets);
+
+#endif /* __CHROMA_H */
@@ -3,8 +3,26 @@
  * @brief Detect which note has been played in a sequency of audio samples.
  */
 
-// SoundIoRingBuffer
-#include <soundio/soundio.h>
+#ifndef __DETECT_H
+#define __DETECT_H
+
+// SampleRing
+#include "sample_ring.h"
+
+// semitone_t, Tuning, GUITAR_MAX_STRINGS, QUANTIZER_STANDARD_REFERENCE
+#include "guitar.h"
+
+// PolyNote, POLY_MAX_NOTES
+#include "poly.h"
+
+// ChromaChord
+#include "chroma.h"
+
+// FlightTrigger, FlightHeader
+#include "flight.h"
+
+// HwStageCounts
+#include "hw_counters.h"
 
 /**
  * @brief The lowest note to detect.
@@ -27,19 +45,612 @@
  */
 #define DETECT_HIGHEST "E", 7
 
+/**
+ * @brief The number of events that can wait to be polled.
+ *
+ * When the queue is full, new events are discarded and counted in the stats.
+ */
+#define DETECT_EVENTS_SIZE 64
+
+/**
+ * @brief The number of buckets of the histogram of the analysis times.
+ * @sa DetectStats.analysisTimes
+ */
+#define DETECT_TIME_BUCKETS 16
+
+/**
+ * @brief The upper bound of the first bucket of the histogram of the analysis
+ *  times, in seconds.
+ *
+ * Each bucket doubles the bound of the previous one, and the last one has no
+ * bound.
+ */
+#define DETECT_TIME_BUCKET_BASE 16e-6
+
 /**
  * @brief A struct to share data between the detection functions.
  */
 typedef struct _DetectContext DetectContext;
 
 /**
- * @brief Initialize a DetectContext.
+ * @brief The stages of the detection whose hardware counters are sampled.
+ * @sa DetectConfig.hwCounters
+ */
+typedef enum {
+	/**
+	 * @brief The preprocessing of the input: the filters, the gate and the
+	 *  gain.
+	 */
+	DETECT_STAGE_ENVELOPE = 0,
+
+	/**
+	 * @brief The analysis of a window: the estimation of the period, of the
+	 *  notes and of the chords.
+	 */
+	DETECT_STAGE_ESTIMATOR,
+
+	/**
+	 * @brief The number of stages.
+	 */
+	DETECT_STAGES
+} DetectStage;
+
+/**
+ * @brief The configurations of the analysis, from the most to the least
+ *  expensive.
+ *
+ * When the analysis cannot keep up with the audio, the detection steps down
+ * through them, and it steps back up when CPU time is available again.
+ */
+typedef enum {
+	/**
+	 * @brief The full search, with the configured hop.
+	 */
+	DETECT_TIER_FULL = 0,
+
+	/**
+	 * @brief The full search, but with a hop twice as large.
+	 */
+	DETECT_TIER_LONG_HOP,
+
+	/**
+	 * @brief The search on the signal decimated by 2, with the large hop.
+	 */
+	DETECT_TIER_DECIMATED,
+
+	/**
+	 * @brief The search only around the last detected note, with the large
+	 *  hop.
+	 *
+	 * When no note has been detected, the decimated search is used.
+	 */
+	DETECT_TIER_TRACKING,
+
+	/**
+	 * @brief The number of tiers.
+	 */
+	DETECT_TIERS
+} DetectTier;
+
+/**
+ * @brief The parameters of the detection.
+ *
+ * Always initialize instances with detectConfigInit, so that the options that
+ * are not set explicitly have their default value.
+ */
+typedef struct {
+	/**
+	 * @brief The sample rate of the audio.
+	 */
+	unsigned int rate;
+
+	/**
+	 * @brief The number of samples between the beginning of two analysis
+	 *  windows.
+	 *
+	 * The window is always two times the longest period, which is the minimum
+	 * that the period estimator needs.
+	 * If the hop is shorter than the window, windows overlap.
+	 */
+	unsigned int hop;
+
+	/**
+	 * @brief Let the governor choose cheaper tiers under CPU pressure.
+	 *
+	 * If 0, the detection always uses DETECT_TIER_FULL.
+	 */
+	int governor;
+
+	/**
+	 * @brief The seconds of noise after which the detection becomes idle.
+	 *
+	 * While idle, the detection only checks the energy of the new samples, and
+	 * the pitch estimation and the events are suspended until it rises again.
+	 * If 0, the detection never becomes idle.
+	 */
+	double idleTimeout;
+
+	/**
+	 * @brief The ratio between the RMS of a block and the noise floor above
+	 *  which the block is considered signal.
+	 *
+	 * The noise floor is tracked on the input, so the gate doesn't depend on
+	 * the level of the pickups.
+	 * It should be well below the ratio of a note, so that the attack of a
+	 * note always wakes the detection up.
+	 */
+	float gateRatio;
+
+	/**
+	 * @brief Normalize the level of the input before the detection.
+	 */
+	int agc;
+
+	/**
+	 * @brief The cutoff frequency of the DC blocker, or 0 to disable it.
+	 *
+	 * The offset of some interfaces biases the autocorrelation.
+	 */
+	double dcBlocker;
+
+	/**
+	 * @brief The cutoff frequency of the high-pass filter, or 0 to disable it.
+	 *
+	 * It removes the rumble under the lowest note.
+	 */
+	double highPass;
+
+	/**
+	 * @brief The coefficient of the pre-emphasis filter, between 0 and 1, or 0
+	 *  to disable it.
+	 *
+	 * It boosts the harmonics over the fundamental.
+	 */
+	float preEmphasis;
+
+	/**
+	 * @brief The tuning of the instrument, or null for the standard tuning of
+	 *  the guitar.
+	 *
+	 * It is copied by detectInitWithConfig.
+	 */
+	const Tuning *tuning;
+
+	/**
+	 * @brief The frequency of A4, in Hz.
+	 *
+	 * The notes are quantized with respect to it, so that instruments tuned to
+	 * a different pitch standard are detected correctly.
+	 */
+	double reference;
+
+	/**
+	 * @brief The spacing of the lags of the coarse search of the period, in
+	 *  semitones, or 0 to evaluate every lag.
+	 * @sa EstimatorConfig.gridStep
+	 */
+	double gridStep;
+
+	/**
+	 * @brief The window of each lag of the period estimation, in periods, or
+	 *  0 to use the whole window for all the lags.
+	 *
+	 * It makes the analysis of the high notes cheaper, but not earlier: the
+	 * windows are still analyzed only when all their samples are available.
+	 * @sa EstimatorConfig.periods
+	 */
+	int windowPeriods;
+
+	/**
+	 * @brief Estimate the period separately on the low and on the high
+	 *  register in the full tiers.
+	 * @sa BandEstimator
+	 */
+	int bands;
+
+	/**
+	 * @brief Accumulate the products of the period estimation in float.
+	 * @sa EstimatorConfig.floatSums
+	 */
+	int floatSums;
+
+	/**
+	 * @brief Estimate the period with integer arithmetic in the full tiers.
+	 *
+	 * The window is converted to 16-bit samples in Q15, like the ones of the
+	 * capture of the targets without an FPU, and analyzed by the fixed-point
+	 * estimator. It searches every lag on the whole window, so gridStep and
+	 * windowPeriods don't apply to the full tiers, and it cannot be combined
+	 * with bands.
+	 * @sa FixedEstimator
+	 */
+	int fixedPoint;
+
+	/**
+	 * @brief The maximum number of simultaneous notes to detect, at most
+	 *  POLY_MAX_NOTES, or 0 to disable the detection of chords.
+	 *
+	 * The chords are estimated in the full tiers, on a longer window than the
+	 * one of the single notes, and they are reported with DETECT_EVENT_NOTES,
+	 * in addition to the events of the single notes.
+	 * @sa PolyEstimator
+	 */
+	unsigned int polyphony;
+
+	/**
+	 * @brief Recognize the names of the chords.
+	 *
+	 * The chroma vector is cheaper than the estimation of the notes, so it is
+	 * updated at each hop, in all the tiers, and the chords are reported with
+	 * DETECT_EVENT_CHORD.
+	 * @sa ChromaEstimator
+	 */
+	int chords;
+
+	/**
+	 * @brief The seconds of input kept by the flight recorder, or 0 to
+	 *  disable it.
+	 *
+	 * The recorder keeps the raw input and a record of each window, which can
+	 * be dumped with detectDumpFlight, e.g. on DETECT_EVENT_ANOMALY.
+	 * @sa FlightRecorder
+	 */
+	double flightSeconds;
+
+	/**
+	 * @brief The latency of the input, i.e. the period of the audio card, in
+	 *  seconds, or 0 if it is unknown.
+	 *
+	 * It doesn't change the analysis, it is only added to the effective
+	 * latency of the stats.
+	 * @sa DetectStats.latency
+	 */
+	double inputLatency;
+
+	/**
+	 * @brief Sample the hardware counters of the stages of the detection.
+	 *
+	 * The counters are opened for the thread that creates the context, so
+	 * it must also be the one that calls detectAnalyze.
+	 * When they are not available, the detection runs as if this were 0.
+	 * @sa DetectStats.stages
+	 */
+	int hwCounters;
+} DetectConfig;
+
+/**
+ * @brief The types of events that the detection generates.
+ */
+typedef enum {
+	/**
+	 * @brief A new note has been played.
+	 */
+	DETECT_EVENT_NOTE,
+
+	/**
+	 * @brief The last note is not played anymore.
+	 */
+	DETECT_EVENT_SILENCE,
+
+	/**
+	 * @brief The governor has changed the tier of the analysis.
+	 */
+	DETECT_EVENT_TIER,
+
+	/**
+	 * @brief The signal has been silent for a while, the detection is idle.
+	 * @sa DetectConfig.idleTimeout
+	 */
+	DETECT_EVENT_IDLE,
+
+	/**
+	 * @brief The signal is not silent anymore, the detection is active again.
+	 */
+	DETECT_EVENT_ACTIVE,
+
+	/**
+	 * @brief The set of the notes that are being played has changed.
+	 * @sa DetectConfig.polyphony
+	 */
+	DETECT_EVENT_NOTES,
+
+	/**
+	 * @brief The name of the chord that is being played has changed.
+	 * @sa DetectConfig.chords
+	 */
+	DETECT_EVENT_CHORD,
+
+	/**
+	 * @brief Something went wrong, and the flight recorder should be dumped.
+	 *
+	 * It is generated only when the flight recorder is enabled, and at most
+	 * once for each time the recorder is filled, so that a dump doesn't
+	 * overlap the previous one.
+	 * @sa DetectConfig.flightSeconds
+	 */
+	DETECT_EVENT_ANOMALY,
+} DetectEventType;
+
+/**
+ * @brief An event of the detection.
+ */
+typedef struct {
+	/**
+	 * @brief The type of the event.
+	 */
+	DetectEventType type;
+
+	/**
+	 * @brief The position in the stream of the first sample of the hop that
+	 *  has generated the event.
+	 */
+	size_t position;
+
+	/**
+	 * @brief The note, for DETECT_EVENT_NOTE events.
+	 */
+	semitone_t note;
+
+	/**
+	 * @brief The frets where the note can be played, for DETECT_EVENT_NOTE
+	 *  events, or the shape of the chord, for DETECT_EVENT_NOTES and
+	 *  DETECT_EVENT_CHORD events.
+	 *
+	 * A negative value means that the note cannot be played on that string,
+	 * or that the string is not part of the chord.
+	 * Only the first strings elements are meaningful.
+	 */
+	semitone_t frets[GUITAR_MAX_STRINGS];
+
+	/**
+	 * @brief The number of strings of the tuning, for DETECT_EVENT_NOTE,
+	 *  DETECT_EVENT_NOTES and DETECT_EVENT_CHORD events.
+	 */
+	unsigned int strings;
+
+	/**
+	 * @brief The estimated frequency, for DETECT_EVENT_NOTE events.
+	 */
+	double frequency;
+
+	/**
+	 * @brief The new tier, for DETECT_EVENT_TIER events.
+	 */
+	DetectTier tier;
+
+	/**
+	 * @brief The notes being played, for DETECT_EVENT_NOTES events.
+	 *
+	 * They have their string and fret, when they fit in the chord shape.
+	 */
+	PolyNote notes[POLY_MAX_NOTES];
+
+	/**
+	 * @brief The number of notes, for DETECT_EVENT_NOTES events.
+	 *
+	 * It is 0 when the chord has ended.
+	 */
+	unsigned int count;
+
+	/**
+	 * @brief The recognized chord, for DETECT_EVENT_CHORD events.
+	 *
+	 * Its root is INVALID_SEMITONE when the chord has ended, or it is not
+	 * recognized anymore.
+	 */
+	ChromaChord chord;
+
+	/**
+	 * @brief The kind of anomaly, for DETECT_EVENT_ANOMALY events.
+	 */
+	FlightTrigger trigger;
+} DetectEvent;
+
+/**
+ * @brief The counters of the detection.
+ */
+typedef struct {
+	/**
+	 * @brief The number of analyzed windows.
+	 */
+	unsigned long frames;
+
+	/**
+	 * @brief The number of windows analyzed in each tier.
+	 */
+	unsigned long tierFrames[DETECT_TIERS];
+
+	/**
+	 * @brief The number of notes that have been detected.
+	 */
+	unsigned long notes;
+
+	/**
+	 * @brief The number of times the set of the notes being played has
+	 *  changed.
+	 * @sa DETECT_EVENT_NOTES
+	 */
+	unsigned long chords;
+
+	/**
+	 * @brief The number of times the name of the chord has changed.
+	 * @sa DETECT_EVENT_CHORD
+	 */
+	unsigned long chordNames;
+
+	/**
+	 * @brief Windows discarded for their period or their periodicity quality.
+	 */
+	unsigned long droppedQuality;
+
+	/**
+	 * @brief Windows discarded because their note cannot be played.
+	 */
+	unsigned long droppedUnplayable;
+
+	/**
+	 * @brief Windows discarded because their amplitude is too low.
+	 */
+	unsigned long droppedSilence;
+
+	/**
+	 * @brief The events discarded because the queue was full.
+	 */
+	unsigned long eventsLost;
+
+	/**
+	 * @brief The number of times the governor has changed tier.
+	 */
+	unsigned long tierChanges;
+
+	/**
+	 * @brief The number of windows whose period is not a number, e.g.
+	 *  because the input contains NaN.
+	 */
+	unsigned long nanPeriods;
+
+	/**
+	 * @brief The number of blocks of the input with NaN or infinite samples,
+	 *  which have been replaced by silence.
+	 */
+	unsigned long invalidBlocks;
+
+	/**
+	 * @brief The number of windows whose analysis took longer than their hop.
+	 */
+	unsigned long deadlineMisses;
+
+	/**
+	 * @brief The current tier.
+	 */
+	DetectTier tier;
+
+	/**
+	 * @brief Whether the detection is idle.
+	 */
+	int idle;
+
+	/**
+	 * @brief The number of blocks that have only been checked for energy,
+	 *  because the detection was idle.
+	 */
+	unsigned long idleBlocks;
+
+	/**
+	 * @brief The RMS of the noise of the input, before the gain.
+	 */
+	float noiseFloor;
+
+	/**
+	 * @brief The gain of the automatic gain control.
+	 */
+	float gain;
+
+	/**
+	 * @brief The envelope of the input, before the gain, for level meters.
+	 *
+	 * It follows the peaks immediately and then it decays slowly.
+	 */
+	float envelope;
+
+	/**
+	 * @brief The smoothed ratio between analysis time and hop duration.
+	 */
+	double load;
+
+	/**
+	 * @brief The time needed to analyze the last window, in seconds.
+	 */
+	double lastAnalysisTime;
+
+	/**
+	 * @brief The longest time needed to analyze a window, in seconds.
+	 */
+	double maxAnalysisTime;
+
+	/**
+	 * @brief The histogram of the time needed to analyze a window.
+	 *
+	 * Each bucket counts the windows that took less than its bound, and not
+	 * less than the bound of the previous bucket.
+	 * @sa detectTimeBucketBound
+	 */
+	unsigned long analysisTimes[DETECT_TIME_BUCKETS];
+
+	/**
+	 * @brief The sum of the times needed to analyze the windows, in seconds.
+	 */
+	double analysisTimeSum;
+
+	/**
+	 * @brief The latency of the input, as configured.
+	 * @sa DetectConfig.inputLatency
+	 */
+	double inputLatency;
+
+	/**
+	 * @brief The effective latency of the detection, in seconds.
+	 *
+	 * It is the time between a sample entering the audio card and the end of
+	 * the analysis of its window, in the worst case: the input latency, a hop
+	 * of the current tier and the time of the last analysis.
+	 * The caller adds the interval between its calls to detectAnalyze.
+	 */
+	double latency;
+
+	/**
+	 * @brief Whether the hardware counters are being sampled.
+	 * @sa DetectConfig.hwCounters
+	 */
+	int hwCounters;
+
+	/**
+	 * @brief The hardware counters of the stages of the detection.
+	 */
+	HwStageCounts stages[DETECT_STAGES];
+} DetectStats;
+
+/**
+ * @brief Initialize a DetectConfig with the default options.
+ *
+ * @param config The configuration to initialize
+ * @param rate The sampling rate of frequencies
+ */
+extern void detectConfigInit(DetectConfig *config, unsigned int rate);
+
+/**
+ * @brief Initialize a DetectConfig with the options saved in a dump of the
+ *  flight recorder, to replay it.
+ *
+ * The governor is disabled, so that the replay always runs the same tier,
+ * and the options that don't change the decisions have their default value.
+ *
+ * @param config The configuration to initialize
+ * @param tuning Storage for the tuning of the dump, which config points to
+ * @param header The header of the dump
+ * @return 0 on success, -1 if the tuning of the dump is not valid
+ */
+extern int detectConfigFromFlight(DetectConfig *config, Tuning *tuning,
+		const FlightHeader *header);
+
+/**
+ * @brief Initialize a DetectContext with the default options.
  *
  * @param rate The sampling rate of frequencies
  * @return An instance of DetectContext or 0 in case of error
  */
 extern DetectContext *detectInit(unsigned int rate);
 
+/**
+ * @brief Initialize a DetectContext.
+ *
+ * All the memory the detection needs is allocated here.
+ *
+ * @param config The configuration of the detection
+ * @return An instance of DetectContext or 0 in case of error
+ */
+extern DetectContext *detectInitWithConfig(const DetectConfig *config);
+
 /**
  * @brief Free a DetectContext.
  * @note If context is null, the function will safely return without doing
@@ -50,16 +661,69 @@ extern DetectContext *detectInit(unsigned int rate);
 extern void detectFree(DetectContext *context);
 
 /**
- * @brief Analyze some audio samples and outputs the played note to the user.
- * @note This function assumes that at most one note is palyed per call, so, to
- *  get more accurate results, call it often.
+ * @brief Analyze some audio samples and queue the events for the user.
+ * @note This function assumes that at most one note is palyed per window, so,
+ *  to get more accurate results, call it often.
  * @note When data aren't enough to get estimate the frequency, the function
- *  simply doesn't advance the buffer read pointer, so that it can use these
- *  data in further calls, therefore please pass always the same ring buffer.
+ *  simply doesn't consume them, so that it can use these data in further
+ *  calls, therefore please pass always the same ring buffer.
+ * @note The function is the consumer of the ring, so it must always be called
+ *  by the same thread.
  *
  * @param context A valid DetectContext instance
- * @param buffer The audio buffer
+ * @param ring The ring that contains the audio samples
  * @return An error code, 0 if no errors occurred
  */
-extern int detectAnalyze(DetectContext *context,
-		struct SoundIoRingBuffer *buffer);
+extern int detectAnalyze(DetectContext *context, SampleRing *ring);
+
+/**
+ * @brief Get the oldest event that hasn't been polled yet.
+ * @note This function must be called by the thread that calls detectAnalyze.
+ *
+ * @param context A valid DetectContext instance
+ * @param event Output parameter for the event
+ * @return 1 if an event has been returned, 0 if the queue is empty
+ */
+extern int detectPollEvent(DetectContext *context, DetectEvent *event);
+
+/**
+ * @brief Tell whether the detection is idle.
+ *
+ * While idle, the caller can call detectAnalyze less often to save power.
+ * @sa DetectConfig.idleTimeout
+ *
+ * @param context A valid DetectContext instance
+ * @return 1 if the detection is idle, 0 otherwise
+ */
+extern int detectIsIdle(const DetectContext *context);
+
+/**
+ * @brief Get the counters of the detection.
+ *
+ * @param context A valid DetectContext instance
+ * @param stats Output parameter for the counters
+ */
+extern void detectGetStats(const DetectContext *context, DetectStats *stats);
+
+/**
+ * @brief Get the upper bound of a bucket of the histogram of the analysis
+ *  times.
+ *
+ * @param bucket The index of the bucket
+ * @return The bound, in seconds, or INFINITY for the last bucket
+ */
+extern double detectTimeBucketBound(unsigned int bucket);
+
+/**
+ * @brief Dump the flight recorder to a file.
+ *
+ * @param context A valid DetectContext instance
+ * @param path The path of the dump
+ * @param trigger The cause of the dump
+ * @return 0 on success, a negative number if the flight recorder is disabled
+ *  or in case of error
+ */
+extern int detectDumpFlight(const DetectContext *context, const char *path,
+		FlightTrigger trigger);
+
+#endif /* __DETECT_H */
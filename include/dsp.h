@@ -0,0 +1,216 @@
+/**
+ * @file dsp.h
+ * @brief Vectorized primitives on blocks of samples.
+ *
+ * These functions are used by the detection on each block of audio, so they
+ * use the SIMD instructions of the target when they are available (SSE on x86,
+ * NEON on ARM), with a portable implementation for the other CPUs.
+ */
+
+#ifndef __DSP_H
+#define __DSP_H
+
+// size_t
+#include <stddef.h>
+
+/**
+ * @brief The number of biquads of a cascade.
+ *
+ * Each stage runs in a lane of a SIMD register, so it is the width of the
+ * registers.
+ */
+#define DSP_CASCADE_STAGES 4
+
+/**
+ * @brief The coefficients of a biquad filter, normalized so that a0 = 1.
+ *
+ * y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+ *
+ * @link https://www.w3.org/TR/audio-eq-cookbook/
+ */
+typedef struct {
+	float b0;
+	float b1;
+	float b2;
+	float a1;
+	float a2;
+} DspBiquad;
+
+/**
+ * @brief A cascade of biquad filters, with its state.
+ *
+ * The stages are pipelined: at each sample, each stage processes the output
+ * that the previous stage produced for the previous sample, so all of them
+ * run in parallel in a SIMD register.
+ * As a consequence, the output is delayed by DSP_CASCADE_STAGES - 1 samples.
+ *
+ * Initialize it with dspCascadeInit, and treat its fields as constant.
+ */
+typedef struct {
+	/**
+	 * @brief The coefficients of each stage, one array for each coefficient,
+	 *  so that they can be loaded in SIMD registers.
+	 */
+	float b0[DSP_CASCADE_STAGES];
+	float b1[DSP_CASCADE_STAGES];
+	float b2[DSP_CASCADE_STAGES];
+	float a1[DSP_CASCADE_STAGES];
+	float a2[DSP_CASCADE_STAGES];
+
+	/**
+	 * @brief The state of each stage (transposed direct form II).
+	 */
+	float z1[DSP_CASCADE_STAGES];
+	float z2[DSP_CASCADE_STAGES];
+
+	/**
+	 * @brief The last output of each stage.
+	 */
+	float out[DSP_CASCADE_STAGES];
+} DspCascade;
+
+/**
+ * @brief Compute the sum of the squares of a block of samples.
+ *
+ * @param x The samples
+ * @param n The number of samples
+ * @return The sum of squares
+ */
+extern float dspSumSquares(const float *x, size_t n);
+
+/**
+ * @brief Compute the root mean square of a block of samples.
+ *
+ * @param x The samples
+ * @param n The number of samples. If 0, the function returns 0
+ * @return The RMS
+ */
+extern float dspRms(const float *x, size_t n);
+
+/**
+ * @brief Apply a gain ramp to a block of samples, in place, and measure it.
+ *
+ * The sum of squares of the original samples and the peak of the scaled ones
+ * are computed in the same pass that applies the gain.
+ * The gain of the sample i is gain + i * step, so a gain can be changed
+ * smoothly along the block, without audible (and periodic) steps.
+ *
+ * @param x The samples
+ * @param n The number of samples
+ * @param gain The gain of the first sample
+ * @param step The increment of the gain for each sample
+ * @param peak Output parameter for the maximum absolute value of the samples
+ *  after the gain. It can be null
+ * @return The sum of squares of the samples before the gain
+ */
+extern float dspGainMeasure(float *x, size_t n, float gain, float step,
+		float *peak);
+
+/**
+ * @brief Design a Butterworth low-pass filter.
+ *
+ * @param biquad Output parameter for the coefficients
+ * @param frequency The cutoff frequency
+ * @param rate The sample rate
+ */
+extern void dspBiquadLowPass(DspBiquad *biquad, double frequency,
+		double rate);
+
+/**
+ * @brief Design a Butterworth high-pass filter.
+ *
+ * @param biquad Output parameter for the coefficients
+ * @param frequency The cutoff frequency
+ * @param rate The sample rate
+ */
+extern void dspBiquadHighPass(DspBiquad *biquad, double frequency,
+		double rate);
+
+/**
+ * @brief Design a DC blocker, i.e. y[n] = x[n] - x[n-1] + R y[n-1].
+ *
+ * @param biquad Output parameter for the coefficients
+ * @param frequency The cutoff frequency, which sets the pole R
+ * @param rate The sample rate
+ */
+extern void dspBiquadDcBlocker(DspBiquad *biquad, double frequency,
+		double rate);
+
+/**
+ * @brief Design a pre-emphasis filter, i.e. y[n] = x[n] - a x[n-1].
+ *
+ * @param biquad Output parameter for the coefficients
+ * @param coefficient The coefficient a, between 0 and 1
+ */
+extern void dspBiquadPreEmphasis(DspBiquad *biquad, float coefficient);
+
+/**
+ * @brief Initialize a cascade whose stages let the signal pass unchanged.
+ *
+ * @param cascade The cascade
+ */
+extern void dspCascadeInit(DspCascade *cascade);
+
+/**
+ * @brief Clear the state of a cascade, keeping its stages.
+ *
+ * It is needed when the state is not finite anymore, e.g. after a NaN in the
+ * input, because the feedback of the stages would keep it forever.
+ *
+ * @param cascade The cascade
+ */
+extern void dspCascadeReset(DspCascade *cascade);
+
+/**
+ * @brief Set a stage of a cascade.
+ *
+ * The state is kept, so the stages should be set before filtering.
+ *
+ * @param cascade The cascade
+ * @param stage The index of the stage, less than DSP_CASCADE_STAGES
+ * @param biquad The coefficients of the stage
+ */
+extern void dspCascadeSet(DspCascade *cascade, unsigned int stage,
+		const DspBiquad *biquad);
+
+/**
+ * @brief Filter a block of samples in place with a cascade.
+ *
+ * The state is kept in the cascade, so a stream can be filtered in blocks of
+ * any size.
+ *
+ * @param cascade The cascade
+ * @param x The samples
+ * @param n The number of samples
+ */
+extern void dspCascadeProcess(DspCascade *cascade, float *x, size_t n);
+
+/**
+ * @brief Compute the twiddle factors of a FFT.
+ *
+ * The factors of each stage are contiguous, so that the butterflies of a
+ * stage read them sequentially: the ones of the stage with length len are at
+ * the indices [len / 2, len), with the real parts in the first n elements and
+ * the imaginary parts in the other n.
+ *
+ * @param twiddles The output buffer, with 2 * n elements
+ * @param n The size of the transform, a power of two
+ */
+extern void dspFftTwiddles(float *twiddles, size_t n);
+
+/**
+ * @brief Compute the discrete Fourier transform of a block in place.
+ *
+ * It is a radix-2 decimation in time, so the block is first permuted in
+ * bit-reversed order.
+ * The transform is not normalized, and it has the negative sign in the
+ * exponent, i.e. X[k] = sum of x[i] exp(-2 pi j i k / n).
+ *
+ * @param re The real parts, with n elements
+ * @param im The imaginary parts, with n elements
+ * @param twiddles The twiddle factors computed by dspFftTwiddles for n
+ * @param n The size of the transform, a power of two
+ */
+extern void dspFft(float *re, float *im, const float *twiddles, size_t n);
+
+#endif /* __DSP_H */
@@ -0,0 +1,80 @@
+/**
+ * @file endian_utils.h
+ * @brief Store and read numbers in little endian, whatever the platform.
+ *
+ * The files written by the program (the WAV captures and the dumps of the
+ * flight recorder) are little endian, so that they can be read on any
+ * platform. The pointers don't need to be aligned.
+ */
+
+#ifndef __ENDIAN_UTILS_H
+#define __ENDIAN_UTILS_H
+
+// uint32_t, uint64_t
+#include <stdint.h>
+
+/**
+ * @brief Store a 32 bits integer in little endian.
+ *
+ * @param dest The first byte
+ * @param value The value
+ */
+extern void storeLe32(unsigned char *dest, uint32_t value);
+
+/**
+ * @brief Store a 64 bits integer in little endian.
+ *
+ * @param dest The first byte
+ * @param value The value
+ */
+extern void storeLe64(unsigned char *dest, uint64_t value);
+
+/**
+ * @brief Store a float in little endian.
+ *
+ * @param dest The first byte
+ * @param value The value
+ */
+extern void storeFloat(unsigned char *dest, float value);
+
+/**
+ * @brief Store a double in little endian.
+ *
+ * @param dest The first byte
+ * @param value The value
+ */
+extern void storeDouble(unsigned char *dest, double value);
+
+/**
+ * @brief Read a 32 bits little endian integer.
+ *
+ * @param src The first byte
+ * @return The value
+ */
+extern uint32_t loadLe32(const unsigned char *src);
+
+/**
+ * @brief Read a 64 bits little endian integer.
+ *
+ * @param src The first byte
+ * @return The value
+ */
+extern uint64_t loadLe64(const unsigned char *src);
+
+/**
+ * @brief Read a little endian float.
+ *
+ * @param src The first byte
+ * @return The value
+ */
+extern float loadFloat(const unsigned char *src);
+
+/**
+ * @brief Read a little endian double.
+ *
+ * @param src The first byte
+ * @return The value
+ */
+extern double loadDouble(const unsigned char *src);
+
+#endif /* __ENDIAN_UTILS_H */
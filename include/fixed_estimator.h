@@ -0,0 +1,95 @@
+/**
+ * @file fixed_estimator.h
+ * @brief Estimate the period of a signal with integer arithmetic only.
+ *
+ * This is the normalized autocorrelation of period_estimator.h for the
+ * processors that have a weak FPU or no FPU at all.
+ * The samples are 16-bit integers in Q15, the sums of the lags are
+ * accumulated on 64 bits, and the normalization uses an integer square root,
+ * so the results are the same on every target.
+ * Only the search on every lag is available, with the whole signal for all
+ * the lags.
+ */
+
+#ifndef __FIXED_ESTIMATOR_H
+#define __FIXED_ESTIMATOR_H
+
+// size_t
+#include <stddef.h>
+
+// int16_t, int32_t
+#include <stdint.h>
+
+// Arena
+#include "arena.h"
+
+// EstimatorConfig
+#include "period_estimator.h"
+
+/**
+ * @brief The number of fractional bits of the qualities (Q30).
+ *
+ * The normalized autocorrelation can slightly exceed 1, so one integer bit is
+ * kept.
+ */
+#define FIXED_NAC_SHIFT 30
+
+/**
+ * @brief The number of fractional bits of the periods (Q16.16).
+ */
+#define FIXED_PERIOD_SHIFT 16
+
+/**
+ * @brief An instance of the fixed-point estimator with its own buffers.
+ */
+typedef struct _FixedEstimator FixedEstimator;
+
+/**
+ * @brief Get the memory that fixedCreate will take from the arena.
+ *
+ * @param config The configuration of the estimator
+ * @return The size in bytes, including the alignment padding
+ */
+extern size_t fixedMemorySize(const EstimatorConfig *config);
+
+/**
+ * @brief Create a fixed-point estimator.
+ *
+ * The lag grid and the windows per lag are not supported, so gridStep and
+ * periods of the configuration must be 0.
+ *
+ * @param arena The arena to take the memory from. It must have at least
+ *  fixedMemorySize bytes available
+ * @param config The configuration of the estimator, which will be copied
+ * @return The estimator, or 0 in case of error
+ */
+extern FixedEstimator *fixedCreate(Arena *arena, const EstimatorConfig *config);
+
+/**
+ * @brief Estimate the period of a signal.
+ * @sa estimatorRun
+ *
+ * @param estimator The estimator
+ * @param x The signal, in Q15
+ * @param n The number of samples. It must be at least 2*maxP.
+ * @param q Output parameter for the quality of the periodicity, in Q30
+ * @param periodInt Output parameter for the period without interpolation. If
+ *  null it will be ignored
+ * @return The period of the signal in Q16.16, or 0 if none has been found
+ */
+extern int32_t fixedRun(FixedEstimator *estimator, const int16_t *x, int n,
+		int32_t *q, int *periodInt);
+
+/**
+ * @brief Convert samples to Q15, saturating the ones out of [-1, 1].
+ *
+ * The capture on the embedded targets gives 16-bit samples directly, this is
+ * needed only when the signal is available as float.
+ *
+ * @param x The samples to convert
+ * @param out The output buffer, with n elements
+ * @param n The number of samples
+ */
+extern void fixedFromFloat(const float *x, int16_t *out, int n);
+
+#endif /* __FIXED_ESTIMATOR_H */
@@ -0,0 +1,431 @@
+/**
+ * @file flight.h
+ * @brief Keep the last seconds of the detection in memory, to dump them when
+ *  something goes wrong.
+ *
+ * The flight recorder has a circular buffer for the raw input samples, and
+ * one for a record of each analyzed window, with the output of the estimator
+ * and the decision of the filters.
+ * Both are allocated when it is created, so recording never allocates and
+ * costs a copy of the samples.
+ * A dump is first written to a temporary file, which is then renamed, so a
+ * dump is either complete or missing.
+ */
+
+#ifndef __FLIGHT_H
+#define __FLIGHT_H
+
+// size_t
+#include <stddef.h>
+
+// Arena
+#include "arena.h"
+
+// semitone_t, GUITAR_MAX_STRINGS
+#include "guitar.h"
+
+/**
+ * @brief An instance of the flight recorder with its buffers.
+ */
+typedef struct _FlightRecorder FlightRecorder;
+
+/**
+ * @brief The causes of a dump.
+ */
+typedef enum {
+	/**
+	 * @brief The dump has been requested explicitly, e.g. with a signal.
+	 */
+	FLIGHT_TRIGGER_REQUEST = 0,
+
+	/**
+	 * @brief Samples have been lost because the buffers were full.
+	 */
+	FLIGHT_TRIGGER_OVERFLOW,
+
+	/**
+	 * @brief The estimator has found a period that is not a number, or the
+	 *  input contains samples that are not numbers.
+	 */
+	FLIGHT_TRIGGER_NAN,
+
+	/**
+	 * @brief The analysis of a window has taken longer than its hop.
+	 */
+	FLIGHT_TRIGGER_DEADLINE,
+
+	/**
+	 * @brief The number of triggers.
+	 */
+	FLIGHT_TRIGGERS
+} FlightTrigger;
+
+/**
+ * @brief The outcomes of the analysis of a window.
+ */
+typedef enum {
+	/**
+	 * @brief The gate was closed for the whole hop, the window hasn't been
+	 *  analyzed.
+	 */
+	FLIGHT_DECISION_GATE = 0,
+
+	/**
+	 * @brief The period was not valid or its quality was too low.
+	 */
+	FLIGHT_DECISION_QUALITY,
+
+	/**
+	 * @brief The note cannot be played on the instrument.
+	 */
+	FLIGHT_DECISION_UNPLAYABLE,
+
+	/**
+	 * @brief The amplitude of the window was too low.
+	 */
+	FLIGHT_DECISION_SILENCE,
+
+	/**
+	 * @brief The note is the one that was already being played.
+	 */
+	FLIGHT_DECISION_SAME_NOTE,
+
+	/**
+	 * @brief A new note has been detected.
+	 */
+	FLIGHT_DECISION_NOTE,
+
+	/**
+	 * @brief The number of decisions.
+	 */
+	FLIGHT_DECISIONS
+} FlightDecision;
+
+/**
+ * @brief The record of an analyzed window.
+ */
+typedef struct {
+	/**
+	 * @brief The position of the first sample of the window in the stream.
+	 */
+	size_t position;
+
+	/**
+	 * @brief The estimated period, in samples.
+	 */
+	float period;
+
+	/**
+	 * @brief The quality of the periodicity.
+	 */
+	float quality;
+
+	/**
+	 * @brief The seconds that the analysis has taken.
+	 */
+	float elapsed;
+
+	/**
+	 * @brief The note of the period, or INVALID_SEMITONE if it hasn't been
+	 *  quantized.
+	 */
+	semitone_t note;
+
+	/**
+	 * @brief The tier of the analysis, a DetectTier.
+	 */
+	unsigned char tier;
+
+	/**
+	 * @brief The outcome of the analysis, a FlightDecision.
+	 */
+	unsigned char decision;
+} FlightRecord;
+
+/**
+ * @brief The options of the detection that change its decisions.
+ *
+ * They are saved in the dumps, so that a replay takes the same decisions as
+ * the detection that recorded them.
+ * @sa DetectConfig
+ */
+typedef struct {
+	/**
+	 * @brief The seconds of noise after which the detection becomes idle.
+	 */
+	double idleTimeout;
+
+	/**
+	 * @brief The ratio of the RMS to the noise floor that opens the gate.
+	 */
+	float gateRatio;
+
+	/**
+	 * @brief Whether the level of the input is normalized.
+	 */
+	int agc;
+
+	/**
+	 * @brief The cutoff frequency of the DC blocker, or 0.
+	 */
+	double dcBlocker;
+
+	/**
+	 * @brief The cutoff frequency of the high-pass filter, or 0.
+	 */
+	double highPass;
+
+	/**
+	 * @brief The coefficient of the pre-emphasis filter, or 0.
+	 */
+	float preEmphasis;
+
+	/**
+	 * @brief The number of strings of the tuning.
+	 */
+	unsigned int strings;
+
+	/**
+	 * @brief The number of frets of the tuning.
+	 */
+	unsigned int frets;
+
+	/**
+	 * @brief The note of each open string of the tuning.
+	 */
+	semitone_t open[GUITAR_MAX_STRINGS];
+
+	/**
+	 * @brief The frequency of A4, in Hz.
+	 */
+	double reference;
+
+	/**
+	 * @brief The spacing of the lags of the coarse search, in semitones.
+	 */
+	double gridStep;
+
+	/**
+	 * @brief The window of each lag of the period estimation, in periods.
+	 */
+	int windowPeriods;
+
+	/**
+	 * @brief Whether the period is estimated separately on two registers.
+	 */
+	int bands;
+
+	/**
+	 * @brief Whether the products of the estimation are summed in float.
+	 */
+	int floatSums;
+
+	/**
+	 * @brief Whether the full tiers estimate the period in fixed point.
+	 */
+	int fixedPoint;
+
+	/**
+	 * @brief The maximum number of simultaneous notes.
+	 */
+	unsigned int polyphony;
+
+	/**
+	 * @brief Whether the names of the chords are recognized.
+	 */
+	int chords;
+} FlightOptions;
+
+/**
+ * @brief The parameters of a FlightRecorder.
+ *
+ * Always initialize instances with flightConfigInit, so that the options that
+ * are not set explicitly have their default value.
+ */
+typedef struct {
+	/**
+	 * @brief The sample rate of the audio.
+	 */
+	unsigned int rate;
+
+	/**
+	 * @brief The hop of the detection, which is saved in the dumps to replay
+	 *  them.
+	 */
+	unsigned int hop;
+
+	/**
+	 * @brief The number of samples that are kept.
+	 */
+	size_t samples;
+
+	/**
+	 * @brief The number of records that are kept.
+	 */
+	size_t records;
+
+	/**
+	 * @brief The options of the detection, which are saved in the dumps.
+	 *
+	 * flightConfigInit clears them, the detection sets them.
+	 */
+	FlightOptions options;
+} FlightConfig;
+
+/**
+ * @brief The header of a dump.
+ */
+typedef struct {
+	/**
+	 * @brief The sample rate of the audio.
+	 */
+	unsigned int rate;
+
+	/**
+	 * @brief The hop of the detection.
+	 */
+	unsigned int hop;
+
+	/**
+	 * @brief The cause of the dump.
+	 */
+	FlightTrigger trigger;
+
+	/**
+	 * @brief The position of the first sample of the dump in the stream.
+	 */
+	size_t start;
+
+	/**
+	 * @brief The number of samples.
+	 */
+	size_t samples;
+
+	/**
+	 * @brief The number of records.
+	 */
+	size_t records;
+
+	/**
+	 * @brief The options of the detection that has recorded the dump.
+	 */
+	FlightOptions options;
+} FlightHeader;
+
+/**
+ * @brief A dump that has been loaded from a file.
+ */
+typedef struct {
+	/**
+	 * @brief The header of the dump.
+	 */
+	FlightHeader header;
+
+	/**
+	 * @brief The samples, from the oldest one.
+	 */
+	float *samples;
+
+	/**
+	 * @brief The records, from the oldest one.
+	 */
+	FlightRecord *records;
+} FlightDump;
+
+/**
+ * @brief Initialize a FlightConfig with the default options.
+ *
+ * @param config The configuration to initialize
+ * @param rate The sample rate of the audio
+ * @param hop The hop of the detection
+ * @param seconds The seconds of audio to keep
+ */
+extern void flightConfigInit(FlightConfig *config, unsigned int rate,
+		unsigned int hop, double seconds);
+
+/**
+ * @brief Get the memory that flightCreate will take from the arena.
+ *
+ * @param config The configuration of the recorder
+ * @return The size in bytes, including the alignment padding, or 0 if the
+ *  configuration is not valid
+ */
+extern size_t flightMemorySize(const FlightConfig *config);
+
+/**
+ * @brief Create a flight recorder.
+ *
+ * @param arena The arena to take the memory from. It must have at least
+ *  flightMemorySize bytes available
+ * @param config The configuration of the recorder, which will be copied
+ * @return The recorder, or 0 in case of error
+ */
+extern FlightRecorder *flightCreate(Arena *arena, const FlightConfig *config);
+
+/**
+ * @brief Add the next samples of the stream.
+ *
+ * @param recorder The recorder
+ * @param samples The samples
+ * @param count The number of samples. If it is more than the capacity, only
+ *  the last ones are kept
+ */
+extern void flightAudio(FlightRecorder *recorder, const float *samples,
+		size_t count);
+
+/**
+ * @brief Add the record of a window.
+ *
+ * @param recorder The recorder
+ * @param record The record
+ */
+extern void flightRecord(FlightRecorder *recorder, const FlightRecord *record);
+
+/**
+ * @brief Write the content of the recorder to a file.
+ *
+ * The file is written as path.tmp, and then renamed to path.
+ *
+ * @param recorder The recorder
+ * @param path The path of the dump
+ * @param trigger The cause of the dump
+ * @return 0 on success, a negative number in case of error
+ */
+extern int flightDump(const FlightRecorder *recorder, const char *path,
+		FlightTrigger trigger);
+
+/**
+ * @brief Load a dump from a file.
+ *
+ * @param path The path of the dump
+ * @return The dump, or 0 in case of error. The caller will have to free it
+ *  with flightDumpFree
+ */
+extern FlightDump *flightLoad(const char *path);
+
+/**
+ * @brief Free a dump returned by flightLoad.
+ * @note If dump is null, the function will safely return without doing
+ *  anything.
+ *
+ * @param dump The dump
+ */
+extern void flightDumpFree(FlightDump *dump);
+
+/**
+ * @brief Get the name of a trigger, e.g. "nan".
+ *
+ * @param trigger The trigger
+ * @return The name, or "unknown" if the trigger is not valid
+ */
+extern const char *flightTriggerName(FlightTrigger trigger);
+
+/**
+ * @brief Get the name of a decision, e.g. "quality".
+ *
+ * @param decision The decision
+ * @return The name, or "unknown" if the decision is not valid
+ */
+extern const char *flightDecisionName(FlightDecision decision);
+
+#endif /* __FLIGHT_H */
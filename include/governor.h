@@ -0,0 +1,102 @@
+/**
+ * @file governor.h
+ * @brief Adapt the cost of the analysis to the available CPU time.
+ *
+ * The analysis of each frame must take less time than the audio it advances
+ * (the hop), otherwise samples accumulate in the ring until it overflows.
+ * On shared machines the time available to the analysis thread changes, so
+ * the governor measures the load and selects a tier: tier 0 is the most
+ * accurate configuration, and each further tier is cheaper than the previous
+ * one.
+ * The meaning of tiers is decided by the user of the governor.
+ */
+
+#ifndef __GOVERNOR_H
+#define __GOVERNOR_H
+
+/**
+ * @brief The state of a governor.
+ *
+ * Initialize it with governorInit, and treat its fields as constant.
+ */
+typedef struct {
+	/**
+	 * @brief The current tier.
+	 */
+	int tier;
+
+	/**
+	 * @brief The cheapest tier.
+	 */
+	int maxTier;
+
+	/**
+	 * @brief The load, smoothed with an exponential moving average.
+	 *
+	 * The load of a frame is the ratio between the time needed to analyze it
+	 * and the duration of its hop.
+	 */
+	double load;
+
+	/**
+	 * @brief The consecutive frames with a load higher than GOVERNOR_HIGH_LOAD.
+	 */
+	unsigned int overloadedFrames;
+
+	/**
+	 * @brief The consecutive frames with a load lower than GOVERNOR_LOW_LOAD.
+	 */
+	unsigned int idleFrames;
+} Governor;
+
+/**
+ * @brief The load above which the governor selects a cheaper tier.
+ *
+ * It leaves some margin to the other threads (e.g. the callback of the audio
+ * card and the GUI).
+ */
+#define GOVERNOR_HIGH_LOAD 0.7
+
+/**
+ * @brief The load under which the governor selects a more expensive tier.
+ *
+ * Each tier costs about half of the previous one, so the load after going
+ * back should still be under GOVERNOR_HIGH_LOAD.
+ */
+#define GOVERNOR_LOW_LOAD 0.25
+
+/**
+ * @brief The frames the load must stay high to select a cheaper tier.
+ */
+#define GOVERNOR_STEP_DOWN_FRAMES 3
+
+/**
+ * @brief The frames the load must stay low to select a more expensive tier.
+ *
+ * Going back is slower than stepping down, to avoid oscillations.
+ */
+#define GOVERNOR_STEP_UP_FRAMES 50
+
+/**
+ * @brief Initialize a governor.
+ *
+ * @param governor The governor to initialize
+ * @param maxTier The cheapest tier. Tiers go from 0 to maxTier
+ */
+extern void governorInit(Governor *governor, int maxTier);
+
+/**
+ * @brief Update the governor with the measures of a frame.
+ *
+ * @param governor The governor
+ * @param analysisTime The time needed to analyze the frame
+ * @param hopDuration The duration of the audio the frame has advanced, with
+ *  the same unit of analysisTime
+ * @param backlog Whether samples are accumulating in the input buffer, in which
+ *  case the governor selects a cheaper tier immediately
+ * @return The tier for the next frame
+ */
+extern int governorUpdate(Governor *governor, double analysisTime,
+		double hopDuration, int backlog);
+
+#endif /* __GOVERNOR_H */
@@ -26,6 +26,9 @@
 // SHRT_MIN
 #include <limits.h>
 
+// size_t
+#include <stddef.h>
+
 /**
  * @brief A type used for operations on semitones.
  *
@@ -57,12 +60,91 @@ typedef short semitone_t;
  */
 #define GUITAR_FRETS 22
 
+/**
+ * @brief The maximum number of strings of a tuning.
+ *
+ * It is enough for extended range guitars and basses.
+ */
+#define GUITAR_MAX_STRINGS 8
+
+/**
+ * @brief The maximum number of semitones between the lowest and the highest
+ *  note of a tuning, including the frets.
+ */
+#define GUITAR_TUNING_RANGE 96
+
+/**
+ * @brief The number of semitones of a Quantizer.
+ *
+ * It is a power of two, so the binary search always takes the same steps.
+ */
+#define QUANTIZER_SIZE 128
+
+/**
+ * @brief The first semitone of a Quantizer, C0.
+ */
+#define QUANTIZER_FIRST (-9)
+
+/**
+ * @brief The standard frequency of A4, in Hz.
+ */
+#define QUANTIZER_STANDARD_REFERENCE 440.0
+
 /**
  * @brief Guitar standard tuning in semitones from A0.
  * @link https://en.wikipedia.org/wiki/Standard_tuning
  */
 extern const semitone_t STANDARD_TUNING[GUITAR_STRINGS];
 
+/**
+ * @brief A tuning, with the table of the positions of all its notes.
+ *
+ * The table is computed when the tuning is initialized, so converting a note
+ * to frets is just a lookup.
+ * The struct doesn't contain pointers, so it can be copied.
+ *
+ * Initialize it with tuningInit or tuningParse, and treat its fields as
+ * constant.
+ */
+typedef struct {
+	/**
+	 * @brief The number of strings.
+	 */
+	unsigned int strings;
+
+	/**
+	 * @brief The number of frets.
+	 */
+	unsigned int frets;
+
+	/**
+	 * @brief The note of each open string, from the first (the highest) one.
+	 */
+	semitone_t open[GUITAR_MAX_STRINGS];
+
+	/**
+	 * @brief The lowest note of the tuning, which is the first of the table.
+	 */
+	semitone_t lowest;
+
+	/**
+	 * @brief The number of notes of the table.
+	 */
+	unsigned int range;
+
+	/**
+	 * @brief The frets of each note, as returned by noteToFrets.
+	 *
+	 * The elements after the number of strings are always -1.
+	 */
+	semitone_t table[GUITAR_TUNING_RANGE][GUITAR_MAX_STRINGS];
+
+	/**
+	 * @brief The number of positions in which each note can be played.
+	 */
+	unsigned char positions[GUITAR_TUNING_RANGE];
+} Tuning;
+
 /**
  * @brief Convert a note name to semitones relative to A0.
  * @note This function uses English notation for notes (A ... G).
@@ -131,4 +213,123 @@ extern semitone_t frequencyToSemitones(double frequency, double *error);
 extern unsigned int noteToFrets(semitone_t note, const semitone_t *tuning,
 		semitone_t *frets, unsigned int strings, unsigned int fretsNumber);
 
+/**
+ * @brief A table to convert frequencies to semitones without logarithms.
+ *
+ * It covers QUANTIZER_SIZE semitones from QUANTIZER_FIRST, i.e. all the
+ * audible notes.
+ *
+ * Initialize it with quantizerInit, and treat its fields as constant.
+ */
+typedef struct {
+	/**
+	 * @brief The frequency of A4.
+	 */
+	double reference;
+
+	/**
+	 * @brief The lowest frequency of each semitone, i.e. the boundary with the
+	 *  previous one, a quarter tone below the note.
+	 */
+	double boundaries[QUANTIZER_SIZE];
+
+	/**
+	 * @brief The frequency of each semitone.
+	 */
+	double frequencies[QUANTIZER_SIZE];
+} Quantizer;
+
+/**
+ * @brief Initialize a quantizer.
+ *
+ * @param quantizer The quantizer to initialize
+ * @param reference The frequency of A4, usually QUANTIZER_STANDARD_REFERENCE
+ * @return 0 on success, -1 if the reference is not valid
+ */
+extern int quantizerInit(Quantizer *quantizer, double reference);
+
+/**
+ * @brief Convert a frequency to the nearest semitone.
+ *
+ * This is the same as frequencyToSemitones, but with a binary search in the
+ * table, without branches that depend on the frequency.
+ *
+ * @param quantizer The quantizer
+ * @param frequency The frequency
+ * @param cents Output parameter for the distance between the frequency and
+ *  the semitone, in cents, from -50 to 50. It can be null
+ * @return The semitone, or INVALID_SEMITONE if the frequency is out of the
+ *  table
+ */
+extern semitone_t quantize(const Quantizer *quantizer, double frequency,
+		float *cents);
+
+/**
+ * @brief Convert an array of frequencies to semitones.
+ * @sa quantize
+ *
+ * @param quantizer The quantizer
+ * @param frequencies The frequencies
+ * @param notes Output array for the semitones
+ * @param cents Output array for the errors, in cents. It can be null
+ * @param count The number of frequencies
+ */
+extern void quantizeBatch(const Quantizer *quantizer,
+		const double *frequencies, semitone_t *notes, float *cents,
+		size_t count);
+
+/**
+ * @brief Get the frequency of a semitone from the table.
+ *
+ * @param quantizer The quantizer
+ * @param note The semitone
+ * @return The frequency, or -1 if the semitone is out of the table
+ */
+extern double quantizerFrequency(const Quantizer *quantizer, semitone_t note);
+
+/**
+ * @brief Initialize a tuning and compute its table.
+ *
+ * @param tuning The tuning to initialize
+ * @param open The notes of the open strings, from the first (the highest) one
+ * @param strings The number of strings, at most GUITAR_MAX_STRINGS
+ * @param frets The number of frets
+ * @return 0 on success, -1 if the parameters are not valid or if the notes
+ *  are more than GUITAR_TUNING_RANGE
+ */
+extern int tuningInit(Tuning *tuning, const semitone_t *open,
+		unsigned int strings, unsigned int frets);
+
+/**
+ * @brief Initialize a tuning from a description.
+ *
+ * The description can be the name of a known tuning ("standard", "drop-d",
+ * "7-string", "bass"), or the notes of the open strings with their octave,
+ * separated by spaces, from the lowest string, as guitarists write them, e.g.
+ * "D2 A2 D3 G3 B3 E4".
+ *
+ * @param tuning The tuning to initialize
+ * @param description The description of the tuning
+ * @param frets The number of frets
+ * @return 0 on success, -1 if the description is not valid
+ */
+extern int tuningParse(Tuning *tuning, const char *description,
+		unsigned int frets);
+
+/**
+ * @brief Get all the frets in which a note can be played with a tuning.
+ *
+ * This is the same as noteToFrets, but with a lookup in the table.
+ *
+ * @param tuning The tuning
+ * @param note The note
+ * @param positions Output parameter for the number of frets in which the note
+ *  can be played. It can be null
+ * @return The frets of the note on each string (GUITAR_MAX_STRINGS elements,
+ *  with -1 for the strings where it cannot be played), or 0 if the note cannot
+ *  be played at all
+ */
+extern const semitone_t *tuningLookup(const Tuning *tuning, semitone_t note,
+		unsigned int *positions);
+
 #endif /* __GUITAR_H */
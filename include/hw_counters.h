@@ -0,0 +1,301 @@
+/**
+ * @file hw_counters.h
+ * @brief Sample the hardware performance counters around the stages of the
+ *  pipeline.
+ *
+ * The counters tell whether a stage is limited by the computation or by the
+ * memory, which the wall clock cannot tell.
+ * They are opened with perf_event_open on Linux, for a single thread. On
+ * x86 their pages are also mapped, so that the thread can read them with
+ * rdpmc, without system calls.
+ * When the kernel, the CPU or the permissions don't allow them, e.g. in
+ * virtual machines or with a high perf_event_paranoid, opening fails and all
+ * the functions become no-ops, so the callers don't need to check.
+ */
+
+#ifndef __HW_COUNTERS_H
+#define __HW_COUNTERS_H
+
+// FILE
+#include <stdio.h>
+
+/**
+ * @brief The events that are counted.
+ */
+typedef enum {
+	/**
+	 * @brief The CPU cycles.
+	 */
+	HW_CYCLES = 0,
+
+	/**
+	 * @brief The retired instructions.
+	 */
+	HW_INSTRUCTIONS,
+
+	/**
+	 * @brief The misses of the last level cache.
+	 */
+	HW_CACHE_MISSES,
+
+	/**
+	 * @brief The mispredicted branches.
+	 */
+	HW_BRANCH_MISSES,
+
+	/**
+	 * @brief The number of events.
+	 */
+	HW_COUNTERS
+} HwCounter;
+
+/**
+ * @brief The counters of a thread.
+ *
+ * The events are in a group, so they are always counted together.
+ */
+typedef struct {
+	/**
+	 * @brief The file descriptors of the events, or -1 for the events that
+	 *  are not available.
+	 *
+	 * The cycles are the leader of the group, so if they are not available
+	 * no event is.
+	 */
+	int fds[HW_COUNTERS];
+
+	/**
+	 * @brief The number of available events.
+	 */
+	unsigned int count;
+
+	/**
+	 * @brief The events in the order of the values of a read of the group.
+	 */
+	HwCounter order[HW_COUNTERS];
+
+	/**
+	 * @brief The pages of the events mapped in memory, or null if they are
+	 *  read with system calls.
+	 */
+	void *pages[HW_COUNTERS];
+
+	/**
+	 * @brief Whether all the available events are read from their pages.
+	 */
+	int userRead;
+} HwCounters;
+
+/**
+ * @brief A read of the counters of a thread.
+ */
+typedef struct {
+	/**
+	 * @brief The values of the events, 0 for the ones that are not available.
+	 */
+	unsigned long long values[HW_COUNTERS];
+
+	/**
+	 * @brief The nanoseconds that the group has been enabled.
+	 */
+	unsigned long long enabled;
+
+	/**
+	 * @brief The nanoseconds that the group has been counting.
+	 *
+	 * It is less than enabled when the events have been multiplexed with
+	 * other groups, which makes their values partial.
+	 */
+	unsigned long long running;
+
+	/**
+	 * @brief Whether the events were in the registers at the time of the
+	 *  read.
+	 *
+	 * A read of the mapped pages doesn't always know the current times, so
+	 * a group that has been multiplexed out is detected with this.
+	 */
+	int counting;
+} HwReading;
+
+/**
+ * @brief The totals of a stage.
+ */
+typedef struct {
+	/**
+	 * @brief The sum of the events of the sampled invocations.
+	 */
+	unsigned long long totals[HW_COUNTERS];
+
+	/**
+	 * @brief The number of sampled invocations.
+	 */
+	unsigned long samples;
+
+	/**
+	 * @brief The number of sampled invocations discarded because the events
+	 *  have been multiplexed.
+	 */
+	unsigned long discarded;
+} HwStageCounts;
+
+/**
+ * @brief The sampling of a stage.
+ */
+typedef struct {
+	/**
+	 * @brief The totals of the stage.
+	 */
+	HwStageCounts counts;
+
+	/**
+	 * @brief The read at the beginning of the current invocation.
+	 */
+	HwReading start;
+
+	/**
+	 * @brief One invocation in interval is sampled.
+	 */
+	unsigned int interval;
+
+	/**
+	 * @brief The number of invocations.
+	 */
+	unsigned long calls;
+
+	/**
+	 * @brief Whether the current invocation is sampled.
+	 */
+	int sampling;
+} HwStage;
+
+/**
+ * @brief Tell whether the user has enabled the counters.
+ *
+ * @return Non-zero if GUITARBIRO_HW_COUNTERS is set to a value other than
+ *  "0"
+ */
+extern int hwCountersRequested(void);
+
+/**
+ * @brief Initialize counters that are not available.
+ *
+ * @param counters The counters
+ */
+extern void hwCountersInit(HwCounters *counters);
+
+/**
+ * @brief Get the id of the calling thread, for hwCountersOpenThread.
+ *
+ * It is a system call on Linux, so callers on a real-time path should call it
+ * only once.
+ *
+ * @return The id, or 0 if the counters are not supported on the platform
+ */
+extern long hwCurrentThread(void);
+
+/**
+ * @brief Open the counters of the calling thread.
+ *
+ * The events that are not supported are skipped.
+ *
+ * @param counters The counters
+ * @return 0 if at least the cycles are available, -1 otherwise, and then
+ *  the counters are as initialized by hwCountersInit
+ */
+extern int hwCountersOpen(HwCounters *counters);
+
+/**
+ * @brief Open the counters of another thread of the process.
+ *
+ * It lets a control thread take the system calls of the opening off a thread
+ * that must not make them, e.g. the audio callback.
+ * @sa hwCountersOpen
+ *
+ * @param counters The counters
+ * @param thread The id of the thread, as returned by hwCurrentThread
+ * @return 0 if at least the cycles are available, -1 otherwise
+ */
+extern int hwCountersOpenThread(HwCounters *counters, long thread);
+
+/**
+ * @brief Close the counters.
+ *
+ * They can be closed even if they are not available.
+ *
+ * @param counters The counters, which are as initialized by hwCountersInit
+ *  after the call
+ */
+extern void hwCountersClose(HwCounters *counters);
+
+/**
+ * @brief Tell whether the counters are available.
+ *
+ * @param counters The counters
+ * @return Non-zero if they have been opened
+ */
+extern int hwCountersAvailable(const HwCounters *counters);
+
+/**
+ * @brief Tell whether the counters are read without system calls.
+ *
+ * @param counters The counters
+ * @return Non-zero if the counters are available and hwCountersRead uses
+ *  rdpmc
+ */
+extern int hwCountersUserRead(const HwCounters *counters);
+
+/**
+ * @brief Read the counters.
+ *
+ * With hwCountersUserRead, it reads the mapped pages and the registers of the
+ * CPU, so it must be called by the thread that is counted. Otherwise it is a
+ * single system call, which doesn't block.
+ *
+ * @param counters The counters
+ * @param reading Output parameter for the values
+ * @return 0 on success, -1 if the counters are not available or the read
+ *  failed
+ */
+extern int hwCountersRead(const HwCounters *counters, HwReading *reading);
+
+/**
+ * @brief Initialize the sampling of a stage.
+ *
+ * @param stage The stage
+ * @param interval One invocation in interval is sampled, to limit the cost
+ *  of the reads on stages that are short and frequent
+ */
+extern void hwStageInit(HwStage *stage, unsigned int interval);
+
+/**
+ * @brief Mark the beginning of an invocation of a stage.
+ *
+ * @param stage The stage
+ * @param counters The counters of the thread that runs the stage
+ */
+extern void hwStageBegin(HwStage *stage, const HwCounters *counters);
+
+/**
+ * @brief Mark the end of an invocation of a stage, and add its events to the
+ *  totals if it has been sampled.
+ *
+ * @param stage The stage
+ * @param counters The counters passed to hwStageBegin
+ */
+extern void hwStageEnd(HwStage *stage, const HwCounters *counters);
+
+/**
+ * @brief Print a line with the averages of a stage, e.g. its instructions
+ *  per cycle and its cache misses per thousand instructions.
+ *
+ * Nothing is printed for the stages without samples.
+ *
+ * @param fp The file to print to
+ * @param name The name of the stage
+ * @param counts The totals of the stage
+ */
+extern void hwStagePrint(FILE *fp, const char *name,
+		const HwStageCounts *counts);
+
+#endif /* __HW_COUNTERS_H */
@@ -0,0 +1,130 @@
+/**
+ * @file metrics.h
+ * @brief Export the counters of the pipeline in the Prometheus text format.
+ *
+ * The metrics are written to a file for the textfile collector of the node
+ * exporter, which the monitoring already scrapes, rather than served by an
+ * HTTP listener, which would need a socket and a parser in the program.
+ * The recording loop publishes a snapshot of its counters without locking
+ * and without allocating, and a low-priority thread rewrites the file
+ * periodically, so a slow disk never delays the audio or the analysis.
+ *
+ * @link https://prometheus.io/docs/instrumenting/exposition_formats/
+ */
+
+#ifndef __METRICS_H
+#define __METRICS_H
+
+// size_t
+#include <stddef.h>
+
+// FILE
+#include <stdio.h>
+
+// DetectStats
+#include "detect.h"
+
+/**
+ * @brief An exporter of the metrics, with its writer thread.
+ */
+typedef struct _MetricsExporter MetricsExporter;
+
+/**
+ * @brief The parameters of a MetricsExporter.
+ *
+ * Always initialize instances with metricsConfigInit, so that the options
+ * that are not set explicitly have their default value.
+ */
+typedef struct {
+	/**
+	 * @brief The milliseconds between two rewrites of the file.
+	 *
+	 * The file is rewritten only if a new snapshot has been published.
+	 */
+	unsigned int interval;
+} MetricsConfig;
+
+/**
+ * @brief The counters of the pipeline at a moment.
+ */
+typedef struct {
+	/**
+	 * @brief The counters of the detection.
+	 */
+	DetectStats detect;
+
+	/**
+	 * @brief The number of overflows of the audio card.
+	 */
+	unsigned long overflows;
+
+	/**
+	 * @brief The samples waiting for the detection in the ring.
+	 */
+	size_t ringFill;
+
+	/**
+	 * @brief The capacity of the ring, in samples.
+	 */
+	size_t ringCapacity;
+} MetricsSnapshot;
+
+/**
+ * @brief Initialize a MetricsConfig with the default options.
+ *
+ * By default the file is rewritten every five seconds, a fraction of the
+ * usual interval of the scrapes.
+ *
+ * @param config The configuration to initialize
+ */
+extern void metricsConfigInit(MetricsConfig *config);
+
+/**
+ * @brief Start the writer of the metrics.
+ *
+ * The file is written as path.tmp and then renamed to path, so the collector
+ * never reads a partial file. Its extension should be .prom for the node
+ * exporter.
+ *
+ * @param config The configuration of the exporter
+ * @param path The path of the file
+ * @return The exporter, or 0 in case of error
+ */
+extern MetricsExporter *metricsStart(const MetricsConfig *config,
+		const char *path);
+
+/**
+ * @brief Stop the writer, after it has written the last snapshot.
+ * @note If exporter is null, the function will safely return without doing
+ *  anything.
+ *
+ * @param exporter The exporter to stop, which will be freed
+ */
+extern void metricsStop(MetricsExporter *exporter);
+
+/**
+ * @brief Publish a snapshot of the counters.
+ *
+ * It doesn't lock, doesn't allocate and doesn't wait for the writer: the
+ * snapshots that the writer hasn't taken yet are replaced by the newer ones.
+ * @note This function must be called always by the same thread.
+ *
+ * @param exporter The exporter
+ * @param snapshot The snapshot, which is copied
+ */
+extern void metricsPublish(MetricsExporter *exporter,
+		const MetricsSnapshot *snapshot);
+
+/**
+ * @brief Write a snapshot in the Prometheus text format.
+ *
+ * The numbers are written with the decimal point of the C locale, so the
+ * caller must make sure that it is the locale of the thread.
+ *
+ * @param fp The file to write to
+ * @param snapshot The snapshot
+ * @return 0 on success, -1 if a write failed
+ */
+extern int metricsFormat(FILE *fp, const MetricsSnapshot *snapshot);
+
+#endif /* __METRICS_H */
@@ -6,6 +6,157 @@
 #ifndef __PERIOD_ESTIMATOR_H
 #define __PERIOD_ESTIMATOR_H
 
+// size_t
+#include <stddef.h>
+
+// Arena
+#include "arena.h"
+
+/**
+ * @brief An instance of the period estimator with its own buffers.
+ *
+ * estimatePeriod keeps its buffer in a global variable and enlarges it when
+ * needed, whereas instances of this type take all their memory from an arena
+ * when they are created, so running them never allocates.
+ */
+typedef struct _PeriodEstimator PeriodEstimator;
+
+/**
+ * @brief The parameters of a PeriodEstimator.
+ *
+ * Always initialize instances with estimatorConfigInit, so that the options
+ * that are not set explicitly have their default value.
+ */
+typedef struct {
+	/**
+	 * @brief Minimum period of interest.
+	 */
+	int minP;
+
+	/**
+	 * @brief Maximum period of interest.
+	 */
+	int maxP;
+
+	/**
+	 * @brief The spacing of the lags of the coarse search, in semitones, or 0
+	 *  to evaluate every lag.
+	 *
+	 * One-sample steps are much finer than a semitone for long periods, so the
+	 * autocorrelation can be evaluated only on a grid with logarithmic
+	 * spacing, and then on every lag only between the neighbours of the best
+	 * point of the grid.
+	 * Short periods are still evaluated on every lag, because the grid cannot
+	 * be finer than a sample.
+	 */
+	double gridStep;
+
+	/**
+	 * @brief The length of the window of each lag, in periods, or 0 to use
+	 *  the whole signal for all the lags.
+	 *
+	 * A short lag needs only a few periods to be recognized, so its
+	 * autocorrelation can be computed on the last samples of the signal only.
+	 * The correlation is normalized by the energy of the same samples, so the
+	 * values of lags with different windows can still be compared.
+	 * It must be at least 2.
+	 * @note The signal must still have 2*maxP samples: this reduces the work
+	 *  of the short lags, not the samples that the estimation waits for.
+	 */
+	int periods;
+
+	/**
+	 * @brief Accumulate the products of the lags in float, instead of double.
+	 *
+	 * The vectors hold twice as many floats as doubles, so the products can
+	 * be computed up to twice as fast.
+	 * The products are summed in blocks, and the blocks are summed pairwise,
+	 * to keep the error low on long windows.
+	 * When the lags share the whole signal, their sums of squares are still
+	 * updated in double.
+	 * The specialized kernels are not used.
+	 */
+	int floatSums;
+} EstimatorConfig;
+
+/**
+ * @brief A spacing of the lag grid that never misses the peak of a note.
+ * @sa EstimatorConfig.gridStep
+ *
+ * It is a quarter of semitone, so the coarse search evaluates about 50 lags
+ * per octave, for any sample rate.
+ */
+#define ESTIMATOR_GRID_STEP 0.25
+
+/**
+ * @brief A window length, in periods, that still recognizes sustained notes.
+ * @sa EstimatorConfig.periods
+ */
+#define ESTIMATOR_WINDOW_PERIODS 4
+
+/**
+ * @brief The relations between a candidate period and the estimated one.
+ */
+typedef enum {
+	/**
+	 * @brief The candidate is the estimated period.
+	 */
+	ESTIMATOR_CANDIDATE_CHOSEN = 1,
+
+	/**
+	 * @brief The candidate is a multiple of the estimated period, i.e. a
+	 *  lower note whose harmonic is the estimated one.
+	 */
+	ESTIMATOR_CANDIDATE_MULTIPLE = 2,
+
+	/**
+	 * @brief The candidate is a submultiple of the estimated period, i.e. a
+	 *  harmonic of the estimated note.
+	 */
+	ESTIMATOR_CANDIDATE_SUBMULTIPLE = 4,
+
+	/**
+	 * @brief The ratio with the estimated period is a power of two, i.e. the
+	 *  candidate is the same note in another octave.
+	 */
+	ESTIMATOR_CANDIDATE_OCTAVE = 8,
+} EstimatorCandidateFlags;
+
+/**
+ * @brief A peak of the normalized autocorrelation.
+ */
+typedef struct {
+	/**
+	 * @brief The interpolated period.
+	 *
+	 * The peaks that only the coarse search of the lag grid has seen have
+	 * the resolution of the grid.
+	 */
+	double period;
+
+	/**
+	 * @brief The normalized autocorrelation at the peak.
+	 */
+	double quality;
+
+	/**
+	 * @brief The lag of the peak, without interpolation.
+	 */
+	int lag;
+
+	/**
+	 * @brief The integer ratio between the candidate and the estimated period
+	 *  or vice versa, or 0 if they are not related.
+	 */
+	int ratio;
+
+	/**
+	 * @brief The relations with the estimated period, as a combination of
+	 *  EstimatorCandidateFlags.
+	 */
+	unsigned int flags;
+} PeriodCandidate;
+
 /**
  * @brief Estimate the period of a signal.
  *
@@ -30,7 +181,9 @@
  * @param periodInt Output parameter that if not null will have contain the
  *  period of the signal, obtained from the normalized autocorrelation without
  *  any interpolation or fix (as the octaves one!). If null it will be ignored
- * @return The period of signal (in number of elements of x array)
+ * @return The period of signal (in number of elements of x array), 0 if no
+ *  peak has been found, or NAN if the correlation is not a number, e.g.
+ *  because the signal contains NaN or infinite samples
  */
 double estimatePeriod(const float *x, int n, int minP, int maxP, double *q,
 		int *periodInt);
@@ -44,6 +197,158 @@ double estimatePeriod(const float *x, int n, int minP, int maxP, double *q,
  */
 void estimateFree();
 
+/**
+ * @brief Initialize an EstimatorConfig with the default options.
+ *
+ * @param config The configuration to initialize
+ * @param minP Minimum period of interest
+ * @param maxP Maximum period of interest
+ */
+void estimatorConfigInit(EstimatorConfig *config, int minP, int maxP);
+
+/**
+ * @brief Get the memory that estimatorCreate will take from the arena.
+ *
+ * @param config The configuration of the estimator
+ * @return The size in bytes, including the alignment padding
+ */
+size_t estimatorMemorySize(const EstimatorConfig *config);
+
+/**
+ * @brief Create a period estimator.
+ *
+ * @param arena The arena to take the memory from. It must have at least
+ *  estimatorMemorySize bytes available
+ * @param config The configuration of the estimator, which will be copied
+ * @return The estimator, or 0 in case of error
+ */
+PeriodEstimator *estimatorCreate(Arena *arena, const EstimatorConfig *config);
+
+/**
+ * @brief Estimate the period of a signal with a PeriodEstimator.
+ *
+ * This function is equivalent to estimatePeriod, with the periods of interest
+ * of the configuration of the estimator.
+ * @sa estimatePeriod
+ *
+ * @param estimator The estimator
+ * @param x The signal
+ * @param n The number of samples. It must be at least 2*maxP.
+ * @param q Quality of the periodicity (1 = perfectly periodic)
+ * @param periodInt Output parameter for the period without interpolation. If
+ *  null it will be ignored
+ * @return The period of signal (in number of elements of x array)
+ */
+double estimatorRun(PeriodEstimator *estimator, const float *x, int n,
+		double *q, int *periodInt);
+
+/**
+ * @brief Estimate the period of a signal, and get the best peaks of the
+ *  autocorrelation too.
+ *
+ * The peaks are collected while the estimator looks for the best one, so they
+ * don't need other passes on the signal or on the autocorrelation.
+ * @sa estimatorRun
+ *
+ * @param estimator The estimator
+ * @param x The signal
+ * @param n The number of samples. It must be at least 2*maxP.
+ * @param q Quality of the periodicity (1 = perfectly periodic)
+ * @param periodInt Output parameter for the period without interpolation. If
+ *  null it will be ignored
+ * @param candidates Output array for the peaks, from the strongest
+ * @param k The number of elements of candidates
+ * @param count Output parameter for the number of peaks that have been found,
+ *  at most k
+ * @return The period of signal (in number of elements of x array)
+ */
+double estimatorRunCandidates(PeriodEstimator *estimator, const float *x,
+		int n, double *q, int *periodInt, PeriodCandidate *candidates, int k,
+		int *count);
+
+/**
+ * @brief Estimate the period of a signal in a part of the range of interest.
+ *
+ * Searching a narrower range is cheaper, e.g. to track a note whose period is
+ * already approximately known.
+ * @sa estimatorRun
+ *
+ * @param estimator The estimator
+ * @param x The signal
+ * @param n The number of samples. It must be at least 2*maxP.
+ * @param minP Minimum period of interest. It must not be less than the one of
+ *  the configuration of the estimator
+ * @param maxP Maximum period of interest. It must not be greater than the one
+ *  of the configuration of the estimator
+ * @param q Quality of the periodicity (1 = perfectly periodic)
+ * @param periodInt Output parameter for the period without interpolation. If
+ *  null it will be ignored
+ * @return The period of signal (in number of elements of x array)
+ */
+double estimatorRunRange(PeriodEstimator *estimator, const float *x, int n,
+		int minP, int maxP, double *q, int *periodInt);
+
+/**
+ * @brief Tell whether the estimator uses a kernel specialized at build time.
+ *
+ * The kernels are generated for the configurations listed in the
+ * ESTIMATOR_KERNELS macro (see the SPECIALIZED_KERNELS option of CMake), and
+ * they are used only on the whole range of periods and on windows of the
+ * length they have been built for.
+ * The other cases use the generic code, which gives the same results.
+ *
+ * @param estimator The estimator
+ * @param n The number of samples of the windows
+ * @return 1 if the specialized kernel is used on windows of n samples, 0
+ *  otherwise
+ */
+int estimatorSpecialized(const PeriodEstimator *estimator, int n);
+
+/**
+ * @brief Compute the normalized autocorrelation of a signal at a lag.
+ *
+ * It is the quality that estimatePeriod gives when the period is the lag, so
+ * it can compare the candidates of different estimations on the same signal.
+ *
+ * @param x The signal
+ * @param n The number of samples
+ * @param p The lag, less than n
+ * @return The normalized autocorrelation, between -1 and 1
+ */
+double estimateQuality(const float *x, int n, int p);
+
+/**
+ * @brief The maximum number of threads of estimatePeriodBatch.
+ */
+#define ESTIMATOR_BATCH_MAX_THREADS 64
+
+/**
+ * @brief Estimate the period of many overlapping frames of a signal.
+ *
+ * Frame i starts at x + i * hop and has n samples, so x must have at least
+ * (frames - 1) * hop + n samples.
+ * The frames are split in contiguous ranges, one for each thread, and each
+ * thread creates a single estimator for all its frames.
+ * The results are the same as calling estimatorRun on each frame.
+ *
+ * @param x The signal
+ * @param n The number of samples of each frame, at least 2 * config->maxP
+ * @param hop The distance between the beginning of two frames
+ * @param frames The number of frames
+ * @param config The configuration of the estimators
+ * @param threads The number of threads, or 0 to use all the processors.
+ *  At most ESTIMATOR_BATCH_MAX_THREADS threads are used
+ * @param periods Output array for the period of each frame, or 0 if it has not
+ *  been found
+ * @param qualities Output array for the quality of each frame, -1 for the
+ *  frames whose estimator could not be created
+ * @return 0 on success, -1 if the memory for the estimators could not be
+ *  allocated
+ */
+int estimatePeriodBatch(const float *x, int n, int hop, int frames,
+		const EstimatorConfig *config, int threads, double *periods,
+		double *qualities);
+
 #endif /* __PERIOD_ESTIMATOR_H */
 
 /*
@@ -0,0 +1,203 @@
+/**
+ * @file poly.h
+ * @brief Estimate the notes of a chord.
+ *
+ * The notes are found one at a time on the magnitude spectrum of the window:
+ * the salience of each candidate note is the weighted sum of the amplitudes
+ * at its harmonics, the note with the highest salience is taken, its partials
+ * are removed from the spectrum, and the search is repeated on what remains,
+ * until a new note doesn't add enough salience to the ones already found.
+ * The candidates are the semitones of a range, so the cost of a window is
+ * fixed: a FFT and a few passes on the candidates.
+ * @link Klapuri, "Multiple fundamental frequency estimation by summing harmonic
+ *  amplitudes", ISMIR 2006
+ */
+
+#ifndef __POLY_H
+#define __POLY_H
+
+// size_t
+#include <stddef.h>
+
+// Arena
+#include "arena.h"
+
+// semitone_t, Tuning
+#include "guitar.h"
+
+/**
+ * @brief The maximum number of notes of a chord, one for each string of a
+ *  guitar.
+ */
+#define POLY_MAX_NOTES 6
+
+/**
+ * @brief The maximum number of harmonics of the salience.
+ */
+#define POLY_MAX_HARMONICS 32
+
+/**
+ * @brief An instance of the chord estimator with its own buffers.
+ */
+typedef struct _PolyEstimator PolyEstimator;
+
+/**
+ * @brief The parameters of a PolyEstimator.
+ *
+ * Always initialize instances with polyConfigInit, so that the options that
+ * are not set explicitly have their default value.
+ */
+typedef struct {
+	/**
+	 * @brief The sample rate of the signal.
+	 */
+	unsigned int rate;
+
+	/**
+	 * @brief The number of samples of the windows, a power of two.
+	 *
+	 * The bins of the spectrum must separate the harmonics of the notes a
+	 * semitone apart, even in the lowest octave.
+	 */
+	int window;
+
+	/**
+	 * @brief The lowest note that can be found.
+	 */
+	semitone_t lowest;
+
+	/**
+	 * @brief The highest note that can be found.
+	 */
+	semitone_t highest;
+
+	/**
+	 * @brief The maximum number of notes of each window, at most
+	 *  POLY_MAX_NOTES.
+	 */
+	unsigned int maxNotes;
+
+	/**
+	 * @brief The number of harmonics that contribute to the salience, at most
+	 *  POLY_MAX_HARMONICS.
+	 */
+	unsigned int harmonics;
+
+	/**
+	 * @brief The ratio between the salience of a note and the one of the
+	 *  first note below which it is discarded.
+	 */
+	double minSalience;
+
+	/**
+	 * @brief The exponent of the number of notes in the score of a chord.
+	 *
+	 * A note is added only if it increases the sum of the saliences divided by
+	 * the number of notes raised to this power, so with higher values more
+	 * salience is needed for each new note.
+	 */
+	double gamma;
+
+	/**
+	 * @brief The frequency of A4, in Hz.
+	 */
+	double reference;
+} PolyConfig;
+
+/**
+ * @brief A note of a chord.
+ */
+typedef struct {
+	/**
+	 * @brief The note.
+	 */
+	semitone_t note;
+
+	/**
+	 * @brief The fundamental frequency, estimated on the harmonics.
+	 */
+	double frequency;
+
+	/**
+	 * @brief The salience of the note when it has been found.
+	 */
+	double salience;
+
+	/**
+	 * @brief The string where the note is played, or -1 if it isn't assigned.
+	 * @sa polyAssignStrings
+	 */
+	int string;
+
+	/**
+	 * @brief The fret where the note is played, or -1 if it isn't assigned.
+	 */
+	semitone_t fret;
+} PolyNote;
+
+/**
+ * @brief Initialize a PolyConfig with the default options.
+ *
+ * The default range is from E2 to E6, the notes of a standard tuned guitar,
+ * and the window is about 0.2 seconds.
+ *
+ * @param config The configuration to initialize
+ * @param rate The sample rate of the signal
+ */
+extern void polyConfigInit(PolyConfig *config, unsigned int rate);
+
+/**
+ * @brief Get the memory that polyCreate will take from the arena.
+ *
+ * @param config The configuration of the estimator
+ * @return The size in bytes, including the alignment padding, or 0 if the
+ *  configuration is not valid
+ */
+extern size_t polyMemorySize(const PolyConfig *config);
+
+/**
+ * @brief Create a chord estimator.
+ *
+ * @param arena The arena to take the memory from. It must have at least
+ *  polyMemorySize bytes available
+ * @param config The configuration of the estimator, which will be copied
+ * @return The estimator, or 0 in case of error
+ */
+extern PolyEstimator *polyCreate(Arena *arena, const PolyConfig *config);
+
+/**
+ * @brief Estimate the notes played in a window.
+ *
+ * Two notes an octave apart share all the harmonics of the higher one, so
+ * usually only the lower one is found.
+ * The estimator doesn't check the level of the signal, so the caller should
+ * skip the silent windows.
+ *
+ * @param estimator The estimator
+ * @param x The signal, with config.window samples
+ * @param notes Output parameter for the notes, with at least config.maxNotes
+ *  elements, in the order they have been found. Their strings are not
+ *  assigned
+ * @return The number of notes
+ */
+extern unsigned int polyRun(PolyEstimator *estimator, const float *x,
+		PolyNote *notes);
+
+/**
+ * @brief Assign the notes of a chord to different strings.
+ *
+ * Among all the assignments on distinct strings, the one with the shortest
+ * span between the fretted notes is chosen, and then the one with the lowest
+ * frets.
+ * If the notes cannot be played all together, as many of them as possible are
+ * assigned, and the others have string and fret -1.
+ *
+ * @param tuning The tuning of the instrument
+ * @param notes The notes, whose string and fret are set
+ * @param count The number of notes, at most POLY_MAX_NOTES
+ * @return The number of notes that have been assigned
+ */
+extern unsigned int polyAssignStrings(const Tuning *tuning, PolyNote *notes,
+		unsigned int count);
+
+#endif /* __POLY_H */
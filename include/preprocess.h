@@ -0,0 +1,217 @@
+/**
+ * @file preprocess.h
+ * @brief Prepare the input signal for the detection.
+ *
+ * The level of the input depends on the pickups, on the sound card and on how
+ * the user plays, so absolute thresholds cannot tell notes from noise on all
+ * the rigs.
+ * The preprocessor tracks the noise floor with the minimum statistics of the
+ * RMS of the blocks, opens a gate only when a block is well above it, and
+ * normalizes the level of the notes with a smoothed automatic gain control.
+ * Before all of this, a cascade of filters can remove the DC offset and the
+ * low-frequency hum, which would bias the period estimator.
+ *
+ * @link https://doi.org/10.1109/89.928915
+ */
+
+#ifndef __PREPROCESS_H
+#define __PREPROCESS_H
+
+// size_t
+#include <stddef.h>
+
+// DspCascade
+#include "dsp.h"
+
+/**
+ * @brief The number of sub-windows of the minimum statistics.
+ *
+ * The minimum of each sub-window is kept, so the floor can follow a rising
+ * noise after a sub-window, instead of after the whole window.
+ */
+#define PREPROCESS_SUBWINDOWS 16
+
+/**
+ * @brief The duration of a sub-window, in seconds.
+ *
+ * The whole window must be longer than the notes, otherwise their sustain
+ * would be taken as noise: 8 seconds are longer than most of the notes of a
+ * guitar.
+ */
+#define PREPROCESS_SUBWINDOW_DURATION 0.5
+
+/**
+ * @brief The RMS level of the notes after the automatic gain control.
+ */
+#define PREPROCESS_TARGET_LEVEL 0.2f
+
+/**
+ * @brief The time the envelope needs to decay by a factor e, in seconds.
+ */
+#define PREPROCESS_ENVELOPE_RELEASE 0.3
+
+/**
+ * @brief The state of a preprocessor.
+ *
+ * Initialize it with preprocessInit, and treat its fields as constant.
+ */
+typedef struct {
+	/**
+	 * @brief The estimated RMS of the noise.
+	 */
+	float floor;
+
+	/**
+	 * @brief The ratio between the RMS of a block and the floor above which
+	 *  the block is considered signal.
+	 */
+	float gateRatio;
+
+	/**
+	 * @brief Whether the gate was open for the last block.
+	 */
+	int open;
+
+	/**
+	 * @brief The RMS of the last block, before the gain.
+	 */
+	float rms;
+
+	/**
+	 * @brief The maximum absolute value of the last block, after the gain.
+	 */
+	float peak;
+
+	/**
+	 * @brief The envelope of the input, before the gain.
+	 *
+	 * It follows the peaks of the blocks immediately, and then it decays
+	 * exponentially, as the level meters do.
+	 */
+	float envelope;
+
+	/**
+	 * @brief The sample rate of the signal.
+	 */
+	unsigned int rate;
+
+	/**
+	 * @brief The minimum RMS of each sub-window, used as a circular array.
+	 */
+	float minima[PREPROCESS_SUBWINDOWS];
+
+	/**
+	 * @brief The index of the current sub-window in minima.
+	 */
+	unsigned int subwindow;
+
+	/**
+	 * @brief The minimum RMS of the current sub-window.
+	 */
+	float minimum;
+
+	/**
+	 * @brief The samples processed in the current sub-window.
+	 */
+	size_t subwindowSamples;
+
+	/**
+	 * @brief The length of the sub-windows, in samples.
+	 */
+	size_t subwindowLength;
+
+	/**
+	 * @brief Whether the automatic gain control is enabled.
+	 */
+	int agc;
+
+	/**
+	 * @brief The smoothed RMS of the blocks with the gate open.
+	 */
+	float level;
+
+	/**
+	 * @brief The gain applied to the last sample.
+	 */
+	float gain;
+
+	/**
+	 * @brief The gain that the next block will reach.
+	 */
+	float targetGain;
+
+	/**
+	 * @brief Whether any filter has been set.
+	 */
+	int filtering;
+
+	/**
+	 * @brief Whether the last block contained samples that are not finite.
+	 *
+	 * Such a block is replaced by silence, and the state of the filters and
+	 * of the gain is reset, otherwise they would stay NaN.
+	 */
+	int invalid;
+
+	/**
+	 * @brief The filters, with their state.
+	 *
+	 * Each sample is filtered once, so the state is kept between the windows
+	 * of the detection, even when they overlap.
+	 */
+	DspCascade filters;
+} Preprocessor;
+
+/**
+ * @brief Initialize a preprocessor.
+ *
+ * @param pre The preprocessor to initialize
+ * @param rate The sample rate of the signal
+ * @param gateRatio The ratio between the RMS of a block and the noise floor
+ *  above which the block is considered signal
+ * @param agc Whether to normalize the level of the signal
+ */
+extern void preprocessInit(Preprocessor *pre, unsigned int rate,
+		float gateRatio, int agc);
+
+/**
+ * @brief Set the filters of a preprocessor.
+ *
+ * By default no filter is applied.
+ * The chain delays the signal by DSP_CASCADE_STAGES - 1 samples.
+ *
+ * @param pre The preprocessor
+ * @param rate The sample rate of the signal
+ * @param dcBlocker The cutoff of the DC blocker, or 0 to disable it
+ * @param highPass The cutoff of the high-pass filter, or 0 to disable it
+ * @param preEmphasis The coefficient of the pre-emphasis, or 0 to disable it
+ * @return 0 on success, or -1 if a parameter is not valid
+ */
+extern int preprocessSetFilters(Preprocessor *pre, unsigned int rate,
+		double dcBlocker, double highPass, float preEmphasis);
+
+/**
+ * @brief Process a block of samples in place.
+ *
+ * The block is filtered and scaled by the gain, and its RMS updates the noise
+ * floor, the gate and the gain of the next blocks.
+ * Its peak is measured in the same pass, and updates the envelope.
+ * A block with NaN or infinite samples is replaced by silence, and it closes
+ * the gate.
+ *
+ * @param pre The preprocessor
+ * @param x The samples
+ * @param n The number of samples
+ * @return Whether the gate is open, i.e. the block is not noise
+ */
+extern int preprocessBlock(Preprocessor *pre, float *x, size_t n);
+
+/**
+ * @brief Get the RMS above which a block is signal, after the gain.
+ *
+ * @param pre The preprocessor
+ * @return The threshold
+ */
+extern float preprocessGate(const Preprocessor *pre);
+
+#endif /* __PREPROCESS_H */
@@ -0,0 +1,88 @@
+/**
+ * @file profile.h
+ * @brief Save and load the capture and analysis settings of a machine.
+ *
+ * A profile is written by the calibration, with the tightest settings that
+ * have been stable on the machine, and it is loaded each time the recording
+ * starts.
+ * It is a text file with a "key value" pair per line, and lines starting
+ * with "#" are comments, so it can be edited by hand.
+ */
+
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+/**
+ * @brief The maximum length of the path of a profile.
+ */
+#define PROFILE_PATH_SIZE 4096
+
+/**
+ * @brief The settings of a machine.
+ */
+typedef struct {
+	/**
+	 * @brief The sample rate of the calibration.
+	 *
+	 * The hop is in samples, so it is valid only at this rate.
+	 */
+	unsigned int rate;
+
+	/**
+	 * @brief The target software latency of the input, in seconds, or 0 to
+	 *  let the backend choose it.
+	 */
+	double latency;
+
+	/**
+	 * @brief The hop of the detection, in samples, or 0 to use the default
+	 *  one.
+	 */
+	unsigned int hop;
+
+	/**
+	 * @brief The seconds of audio that the ring buffer can hold, or 0 to use
+	 *  the default size.
+	 */
+	double ring;
+
+	/**
+	 * @brief The engine of the period estimation: accumulate the products in
+	 *  float rather than in double.
+	 * @sa DetectConfig.floatSums
+	 */
+	int floatSums;
+} Profile;
+
+/**
+ * @brief Initialize a profile with the default settings.
+ *
+ * @param profile The profile
+ */
+extern void profileInit(Profile *profile);
+
+/**
+ * @brief Load a profile from a file.
+ *
+ * The settings that are missing from the file keep their current value.
+ *
+ * @param profile The profile, which is changed only on success
+ * @param path The path of the file
+ * @return 0 on success, -1 if the file cannot be opened, -2 if its content
+ *  is not valid
+ */
+extern int profileLoad(Profile *profile, const char *path);
+
+/**
+ * @brief Save a profile to a file.
+ *
+ * The file is written as path.tmp, and then renamed to path, so a crash never
+ * leaves a partial profile.
+ *
+ * @param profile The profile
+ * @param path The path of the file
+ * @return 0 on success, a negative number in case of error
+ */
+extern int profileSave(const Profile *profile, const char *path);
+
+#endif /* __PROFILE_H */
@@ -0,0 +1,141 @@
+/**
+ * @file sample_ring.h
+ * @brief A single-producer/single-consumer ring buffer of float samples.
+ *
+ * The ring is the link between the input sources (the libSoundIo callback, or
+ * any other source of samples) and the detection.
+ * The producer and the consumer can run in different threads without locks,
+ * as long as there is only one producer and only one consumer.
+ *
+ * The memory of the ring is mapped twice, one copy after the other, so any
+ * sequence of samples in the ring is contiguous, even when it crosses the end
+ * of the buffer.
+ * This allows the consumer to analyze windows of samples directly in the ring,
+ * and the producer to write blocks of any size without splitting them.
+ */
+
+#ifndef __SAMPLE_RING_H
+#define __SAMPLE_RING_H
+
+// size_t
+#include <stddef.h>
+
+/**
+ * @brief The ring buffer, whose content is private.
+ */
+typedef struct _SampleRing SampleRing;
+
+/**
+ * @brief Create a ring buffer.
+ *
+ * @param capacity The minimum number of samples that the ring must contain.
+ *  The actual capacity could be bigger, because it must be a multiple of the
+ *  size of memory pages
+ * @return The ring, or 0 in case of error
+ */
+extern SampleRing *sampleRingCreate(size_t capacity);
+
+/**
+ * @brief Destroy a ring buffer.
+ * @note If ring is null, the function will safely return without doing
+ *  anything.
+ *
+ * @param ring The ring to destroy or null
+ */
+extern void sampleRingFree(SampleRing *ring);
+
+/**
+ * @brief Get the number of samples that the ring can contain.
+ *
+ * @param ring The ring
+ * @return The capacity of the ring, in samples
+ */
+extern size_t sampleRingCapacity(const SampleRing *ring);
+
+/**
+ * @brief Get the number of samples that can be written.
+ * @note This function must be called only by the producer.
+ *
+ * @param ring The ring
+ * @return The free space, in samples
+ */
+extern size_t sampleRingFreeCount(SampleRing *ring);
+
+/**
+ * @brief Get the address where the producer can write new samples.
+ *
+ * Up to sampleRingFreeCount contiguous samples can be written from this
+ * address.
+ * They will be visible to the consumer only after sampleRingAdvanceWrite.
+ * @note This function must be called only by the producer.
+ *
+ * @param ring The ring
+ * @return The address of the first free sample
+ */
+extern float *sampleRingWritePtr(SampleRing *ring);
+
+/**
+ * @brief Publish the samples that have been written to the consumer.
+ * @note This function must be called only by the producer.
+ *
+ * @param ring The ring
+ * @param count The number of samples that have been written. It must not be
+ *  greater than the free count
+ */
+extern void sampleRingAdvanceWrite(SampleRing *ring, size_t count);
+
+/**
+ * @brief Copy some samples to the ring.
+ *
+ * This is a shorthand for sampleRingWritePtr, a copy and
+ * sampleRingAdvanceWrite, for producers that already have their samples in
+ * another buffer.
+ * @note This function must be called only by the producer.
+ *
+ * @param ring The ring
+ * @param samples The samples to copy
+ * @param count The number of samples
+ * @return The number of samples that have been copied, which is less than count
+ *  if the ring hasn't enough space
+ */
+extern size_t sampleRingWrite(SampleRing *ring, const float *samples,
+		size_t count);
+
+/**
+ * @brief Get the number of samples that can be read.
+ * @note This function must be called only by the consumer.
+ *
+ * @param ring The ring
+ * @return The available samples
+ */
+extern size_t sampleRingFillCount(SampleRing *ring);
+
+/**
+ * @brief Get the samples that can be read, without consuming them.
+ *
+ * The same samples will be returned again by further calls, until they are
+ * consumed with sampleRingConsume, so the consumer can analyze overlapping
+ * windows by consuming less samples than the ones it reads.
+ *
+ * Until they are consumed, the samples belong to the consumer, which can also
+ * modify them in place (e.g. to filter them).
+ * @note This function must be called only by the consumer.
+ *
+ * @param ring The ring
+ * @param count Output parameter for the number of contiguous samples that are
+ *  available from the returned address. If null it will be ignored
+ * @return The address of the oldest sample that hasn't been consumed
+ */
+extern float *sampleRingPeek(SampleRing *ring, size_t *count);
+
+/**
+ * @brief Release some samples to the producer.
+ * @note This function must be called only by the consumer.
+ *
+ * @param ring The ring
+ * @param count The number of samples to consume. It must not be greater than
+ *  the fill count
+ */
+extern void sampleRingConsume(SampleRing *ring, size_t count);
+
+#endif /* __SAMPLE_RING_H */
@@ -0,0 +1,31 @@
+/**
+ * @file thread_utils.h
+ * @brief Portable helpers for the threads of the program.
+ *
+ * The slow work that must not delay the analysis, e.g. writing files, runs in
+ * background threads with the lowest priority: they run only when no other
+ * thread needs the CPU, and if they starve, their work is only late or
+ * dropped, never the analysis.
+ */
+
+#ifndef __THREAD_UTILS_H
+#define __THREAD_UTILS_H
+
+/**
+ * @brief Sleep for some milliseconds, without busy waiting.
+ *
+ * @param ms The milliseconds to sleep
+ */
+extern void threadSleepMs(unsigned int ms);
+
+/**
+ * @brief Give the calling thread the lowest priority of the system.
+ *
+ * On Linux it is SCHED_IDLE, on the other platforms the priority is left
+ * unchanged.
+ *
+ * @return 0 on success, -1 if the priority hasn't been changed
+ */
+extern int threadSetIdlePriority(void);
+
+#endif /* __THREAD_UTILS_H */
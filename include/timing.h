@@ -0,0 +1,19 @@
+/**
+ * @file timing.h
+ * @brief A portable monotonic clock to measure the pipeline.
+ */
+
+#ifndef __TIMING_H
+#define __TIMING_H
+
+/**
+ * @brief Get the current time of a monotonic clock.
+ *
+ * The origin of the clock is not specified, so the value is useful only to
+ * compute time differences.
+ *
+ * @return The time in seconds
+ */
+extern double timeNow();
+
+#endif /* __TIMING_H */
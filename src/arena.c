@@ -0,0 +1,167 @@
+/**
+ * @file arena.c
+ * @brief A linear allocator for the buffers of the real-time path.
+ */
+
+#include "arena.h"
+
+// malloc, free
+#include <stdlib.h>
+// memset
+#include <string.h>
+// uintptr_t
+#include <stdint.h>
+// assert
+#include <assert.h>
+
+struct _Arena {
+	/**
+	 * @brief The first usable byte, aligned to ARENA_ALIGNMENT.
+	 */
+	char *memory;
+
+	/**
+	 * @brief The number of usable bytes.
+	 */
+	size_t capacity;
+
+	/**
+	 * @brief The number of bytes that have already been allocated.
+	 */
+	size_t used;
+};
+
+Arena *arenaCreate(size_t size)
+{
+	/// The address returned by malloc, which also contains the struct
+	char *raw;
+	/// The instance of Arena that will be returned
+	Arena *arena;
+	/// The address of the memory, to align it
+	uintptr_t address;
+
+	size = ARENA_ALIGN(size);
+
+	/* Allocate the struct and the memory together, with enough padding to
+	align the latter, because aligned_alloc isn't available everywhere. */
+	raw = (char *) malloc(sizeof(Arena) + ARENA_ALIGNMENT + size);
+	if(!raw) {
+		return 0;
+	}
+
+	arena = (Arena *) raw;
+	address = (uintptr_t) (raw + sizeof(Arena));
+	address = (address + ARENA_ALIGNMENT - 1) &
+			~(uintptr_t) (ARENA_ALIGNMENT - 1);
+
+	arena->memory = (char *) address;
+	arena->capacity = size;
+	arena->used = 0;
+
+	// Clearing the memory also makes the OS map all the pages now
+	memset(arena->memory, 0, size);
+
+	return arena;
+}
+
+void arenaFree(Arena *arena)
+{
+	if(!arena) {
+		return;
+	}
+
+	free(arena);
+}
+
+void *arenaAlloc(Arena *arena, size_t size)
+{
+	assert(arena);
+
+	/// The address of the block that will be returned
+	void *ret;
+
+	size = ARENA_ALIGN(size);
+	if(size > arena->capacity - arena->used) {
+		return 0;
+	}
+
+	ret = arena->memory + arena->used;
+	arena->used += size;
+
+	return ret;
+}
+
+void arenaReset(Arena *arena)
+{
+	assert(arena);
+	arena->used = 0;
+}
+
+size_t arenaUsed(const Arena *arena)
+{
+	assert(arena);
+	return arena->used;
+}
+
+#ifdef ALLOC_TRACKING
+
+/* The linker is asked to redirect the calls to malloc, calloc and realloc of
+our objects to these wrappers (-Wl,--wrap=malloc and so on), whereas the real
+functions are still available with the __real_ prefix.
+Only the calls made by our code are counted, so libraries and the GUI thread
+do not cause false positives. */
+
+extern void *__real_malloc(size_t size);
+extern void *__real_calloc(size_t count, size_t size);
+extern void *__real_realloc(void *ptr, size_t size);
+
+/**
+ * @brief Whether the allocations of this thread are being counted.
+ */
+static __thread int gTracking = 0;
+
+/**
+ * @brief The number of allocations of this thread since the tracking started.
+ */
+static __thread unsigned long gAllocations = 0;
+
+void *__wrap_malloc(size_t size)
+{
+	if(gTracking) {
+		gAllocations++;
+	}
+
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+	if(gTracking) {
+		gAllocations++;
+	}
+
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	if(gTracking) {
+		gAllocations++;
+	}
+
+	return __real_realloc(ptr, size);
+}
+
+void allocTrackingBegin(void)
+{
+	gAllocations = 0;
+	gTracking = 1;
+}
+
+unsigned long allocTrackingEnd(void)
+{
+	gTracking = 0;
+	return gAllocations;
+}
+
+#endif /* ALLOC_TRACKING */
@@ -9,31 +9,64 @@
 
 #include "detect.h"
 
+// chromaChordName, CHROMA_NAME_SIZE
+#include "chroma.h"
+
+// Capture, captureStart, captureWrite, captureEvent, captureStop
+#include "capture.h"
+
+// FlightTrigger, flightTriggerName
+#include "flight.h"
+
+// MetricsExporter, MetricsSnapshot, metricsConfigInit, metricsStart,
+// metricsPublish, metricsStop
+#include "metrics.h"
+
+// Profile, profileInit, profileLoad, profileSave, PROFILE_PATH_SIZE
+#include "profile.h"
+
+// HwCounters, HwStage, hwCountersRequested, hwCurrentThread,
+// hwCountersOpenThread, hwCountersUserRead, hwCountersClose,
+// hwCountersAvailable, hwStageInit, hwStageBegin, hwStageEnd, hwStagePrint
+#include "hw_counters.h"
+
+// timeNow
+#include "timing.h"
+
+// threadSleepMs
+#include "thread_utils.h"
+
+// guiHighlightFrets, guiResetHighlights
+#include "gui.h"
+
+// allocTrackingBegin, allocTrackingEnd
+#include "arena.h"
+
+// SampleRing
+#include "sample_ring.h"
+
+// Tuning, tuningParse, GUITAR_FRETS
+#include "guitar.h"
+
 // printf, scanf, fprintf
 #include <stdio.h>
-// malloc, free
+// malloc, free, getenv, atoi, atof
 #include <stdlib.h>
-// memset, memcpy
+// memset, memcpy, strcmp
 #include <string.h>
 // assert
 #include <assert.h>
+// ceil, INFINITY
+#include <math.h>
+// signal, sig_atomic_t, SIGUSR1
+#include <signal.h>
+// atomic_ulong, atomic_long, atomic_int, atomic_init, atomic_load,
+// atomic_store, atomic_fetch_add
+#include <stdatomic.h>
 
 // Endianness test done by SoundIo
 #include <soundio/endian.h>
 
-#ifdef WIN32
-	// Sleep
-#	include <windows.h>
-#elif defined(__linux__)
-	// usleep (on Linux)
-#	include <unistd.h>
-#endif
-
-#if defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 199309L
-	// nanosleep
-#	include <time.h>
-#endif
-
 /**
  * @brief The sample rates we accept from the sound card.
  *
@@ -79,6 +112,284 @@ static const int RING_BUFFER_DURATION = 30;
  */
 static const int ACQUISITION_SLEEP = 20;
 
+/**
+ * @brief The sleep time (in ms) of the acquiring loop when detection is idle.
+ *
+ * While idle the detection only checks the energy of the samples, so it can
+ * check them in larger batches, waking the CPU less often.
+ * This delays the detection of the first note after a silence, but the ring
+ * buffer is large enough to contain these samples.
+ */
+static const int IDLE_ACQUISITION_SLEEP = 100;
+
+/**
+ * @brief The environment variable with the target latency of the input, in
+ *  milliseconds.
+ *
+ * If it is set, the software latency of the stream is negotiated with the
+ * backend, and the hop of the detection and the sleep of the acquiring loop
+ * are aligned to the period that has been granted.
+ * Otherwise the backend chooses the latency, which is often 20-40 ms.
+ */
+static const char *LATENCY_VARIABLE = "GUITARBIRO_LATENCY";
+
+/**
+ * @brief The ratio between the granted and the target latency above which
+ *  the user is warned.
+ */
+static const double LATENCY_TOLERANCE = 1.5;
+
+/**
+ * @brief The environment variable with the path of the profile.
+ *
+ * If it is not set, the profile is PROFILE_FILE in the home directory.
+ * @sa audioCalibrate
+ */
+static const char *PROFILE_VARIABLE = "GUITARBIRO_PROFILE";
+
+/**
+ * @brief The name of the profile in the home directory.
+ */
+static const char *PROFILE_FILE = ".guitarbiro.profile";
+
+/**
+ * @brief The environment variable with the home directory.
+ */
+#ifdef WIN32
+static const char *HOME_VARIABLE = "USERPROFILE";
+#else
+static const char *HOME_VARIABLE = "HOME";
+#endif
+
+/**
+ * @brief The seconds that each step of the calibration runs.
+ */
+static const double CALIBRATION_SECONDS = 3;
+
+/**
+ * @brief The maximum ratio between the 99th percentile of the analysis time
+ *  and the hop for a stable step.
+ *
+ * The rest of the hop is left to the rest of the system, e.g. the GUI.
+ */
+static const double CALIBRATION_MAX_LOAD = 0.5;
+
+/**
+ * @brief The ratio between the ring of the profile and the largest backlog
+ *  of the calibration.
+ */
+static const double CALIBRATION_RING_MARGIN = 4;
+
+/**
+ * @brief The minimum seconds of the ring of the profile.
+ *
+ * The ring must also hold the samples that arrive while the detection is idle
+ * and the loop sleeps longer.
+ */
+static const double CALIBRATION_MIN_RING = 1;
+
+/**
+ * @brief The environment variable with the tuning of the instrument.
+ *
+ * It is read each time the recording starts, and it can contain any tuning
+ * description accepted by tuningParse, e.g. "drop-d" or "D2 A2 D3 G3 B3 E4".
+ */
+static const char *TUNING_VARIABLE = "GUITARBIRO_TUNING";
+
+/**
+ * @brief The environment variable with the maximum number of notes of the
+ *  chords.
+ *
+ * If it is set to a number between 1 and POLY_MAX_NOTES, the neck shows the
+ * shape of the chords instead of the positions of the single notes.
+ */
+static const char *POLYPHONY_VARIABLE = "GUITARBIRO_POLYPHONY";
+
+/**
+ * @brief The environment variable that enables the recognition of the chord
+ *  names.
+ *
+ * If it is set to a value other than "0", the neck shows a shape of the
+ * recognized chords, and their names are printed, regardless of the notes
+ * that are actually played.
+ */
+static const char *CHORDS_VARIABLE = "GUITARBIRO_CHORDS";
+
+/**
+ * @brief The environment variable that enables the fixed-point estimation.
+ *
+ * If it is set to a value other than "0", the full tiers convert the windows
+ * to 16-bit samples and estimate their period with integer arithmetic, to
+ * check on a desktop what the targets without an FPU would detect.
+ * @sa DetectConfig.fixedPoint
+ */
+static const char *FIXED_POINT_VARIABLE = "GUITARBIRO_FIXED_POINT";
+
+/**
+ * @brief The environment variable with the path of the capture.
+ *
+ * If it is set, the audio and the events of the detection are recorded to
+ * the path with the .wav and .log extensions.
+ * @sa Capture
+ */
+static const char *CAPTURE_VARIABLE = "GUITARBIRO_CAPTURE";
+
+/**
+ * @brief The environment variable with the path of the metrics.
+ *
+ * If it is set, the counters of the pipeline are exported to the path in the
+ * Prometheus text format, e.g. for the textfile collector of the node
+ * exporter.
+ * @sa MetricsExporter
+ */
+static const char *METRICS_VARIABLE = "GUITARBIRO_METRICS";
+
+/**
+ * @brief The environment variable with the path of the dumps of the flight
+ *  recorder.
+ *
+ * If it is set, the detection keeps the last FLIGHT_SECONDS in memory, and
+ * dumps them to path-N.flight on anomalies, on overflows and on SIGUSR1.
+ * The overflows are dumped at most once every FLIGHT_SECONDS, because they
+ * come in bursts.
+ * @sa FlightRecorder
+ */
+static const char *FLIGHT_VARIABLE = "GUITARBIRO_FLIGHT";
+
+/**
+ * @brief The seconds kept by the flight recorder.
+ */
+static const double FLIGHT_SECONDS = 10;
+
+/**
+ * @brief The maximum length of the path of a dump.
+ */
+#define FLIGHT_PATH_SIZE 4096
+
+/**
+ * @brief Set by the signal handler to request a dump of the flight recorder.
+ */
+static volatile sig_atomic_t gFlightRequested = 0;
+
+/**
+ * @brief One callback in this number is sampled with the hardware counters.
+ *
+ * The callbacks are short and frequent, so sampling all of them would make
+ * the reads of the counters a noticeable part of their time.
+ * @sa hwCountersRequested
+ */
+static const unsigned int HW_COPY_INTERVAL = 16;
+
+/**
+ * @brief What the neck shows.
+ */
+typedef enum {
+	/**
+	 * @brief The positions of the single notes.
+	 */
+	NECK_NOTES = 0,
+
+	/**
+	 * @brief The shape of the notes of the chords.
+	 */
+	NECK_CHORD_NOTES,
+
+	/**
+	 * @brief A shape of the recognized chords.
+	 */
+	NECK_CHORD_NAMES,
+} NeckMode;
+
+/**
+ * @brief A step of the calibration.
+ */
+typedef struct {
+	/**
+	 * @brief The target software latency, in seconds.
+	 */
+	double latency;
+
+	/**
+	 * @brief The divisor of the default hop of the detection.
+	 */
+	unsigned int hopDivisor;
+} CalibrationStep;
+
+/**
+ * @brief The steps of the calibration, from the most relaxed to the most
+ *  aggressive one.
+ *
+ * The last step has a null latency, as a condition to stop the iteration.
+ */
+static const CalibrationStep CALIBRATION_STEPS[] = {
+	{0.040, 1},
+	{0.020, 1},
+	{0.010, 1},
+	{0.005, 1},
+	{0.005, 2},
+	{0.0025, 2},
+	{0.0025, 4},
+	{0, 0},
+};
+
+/**
+ * @brief The measures of a step of the calibration.
+ */
+typedef struct {
+	/**
+	 * @brief The sample rate of the stream.
+	 */
+	unsigned int rate;
+
+	/**
+	 * @brief The software latency granted by the backend, in seconds.
+	 */
+	double latency;
+
+	/**
+	 * @brief The hop of the detection, aligned to the granted latency.
+	 */
+	unsigned int hop;
+
+	/**
+	 * @brief The difference between the longest and the mean interval
+	 *  between two callbacks, in seconds.
+	 */
+	double jitter;
+
+	/**
+	 * @brief The median of the analysis time, in seconds.
+	 *
+	 * It is the bound of a bucket of the histogram of the detection.
+	 */
+	double analysisMedian;
+
+	/**
+	 * @brief The 99th percentile of the analysis time, in seconds.
+	 */
+	double analysis99;
+
+	/**
+	 * @brief The number of analyzed windows.
+	 */
+	unsigned long frames;
+
+	/**
+	 * @brief The overflows of the card and of the ring.
+	 */
+	unsigned long overflows;
+
+	/**
+	 * @brief The largest number of samples waiting for the detection.
+	 */
+	size_t maxFill;
+
+	/**
+	 * @brief Whether the settings of the step can be used.
+	 */
+	int stable;
+} CalibrationResult;
+
 /**
  * @brief Struct to exchange data with recording function.
  *
@@ -95,8 +406,76 @@ typedef struct {
 	 *
 	 * Instead of using a normal buffer, we use a circular buffer, as advised in
 	 * libSoundIo documentation.
+	 * We use our own, because it is lock-free and the detection can read any
+	 * window from it without copying data.
+	 */
+	SampleRing *ring;
+
+	/**
+	 * @brief The capture of the session, or null if it is disabled.
+	 */
+	Capture *capture;
+
+	/**
+	 * @brief The number of overflows of the audio card, which have been
+	 *  replaced by silence.
+	 */
+	atomic_ulong overflows;
+
+	/**
+	 * @brief The time of the last callback, or 0 before the first one.
+	 *
+	 * It and the following counters are written by the callback, and they
+	 * can be read only after the stream has been destroyed.
+	 */
+	double lastCallback;
+
+	/**
+	 * @brief The number of measured intervals between two callbacks.
+	 */
+	unsigned long intervals;
+
+	/**
+	 * @brief The sum of the intervals between two callbacks, in seconds.
+	 */
+	double intervalSum;
+
+	/**
+	 * @brief The longest interval between two callbacks, in seconds.
+	 */
+	double maxInterval;
+
+	/**
+	 * @brief Whether the callback should record the id of its thread.
+	 */
+	int hwRequested;
+
+	/**
+	 * @brief The id of the thread of the callback, or 0 before the first
+	 *  callback.
+	 *
+	 * The backend creates the thread of the callback, so the first callback
+	 * records it, and the loop of audioRecord opens its counters: the
+	 * opening takes several system calls, which the callback must avoid.
+	 */
+	atomic_long callbackThread;
+
+	/**
+	 * @brief Whether hw can be used by the callback.
+	 *
+	 * It is set only if the counters can be read without system calls.
 	 */
-	struct SoundIoRingBuffer *ringBuffer;
+	atomic_int hwReady;
+
+	/**
+	 * @brief The hardware counters of the thread of the callback.
+	 */
+	HwCounters hw;
+
+	/**
+	 * @brief The sampling of the copy of the samples to the ring.
+	 */
+	HwStage copy;
 
 	/**
 	 * @brief A status variable that is used to report errors.
@@ -112,10 +491,26 @@ typedef struct {
 	int status;
 } RecordContext;
 
-static struct SoundIoInStream *createStream(struct SoundIoDevice *device);
+static struct SoundIoInStream *createStream(struct SoundIoDevice *device,
+		double latency);
 static void readCallback(struct SoundIoInStream *instream, int frameCountMin,
 		int frameCountMax);
-static void sleepMs(unsigned int ms);
+static int dispatchEvents(DetectContext *detection, NeckMode mode,
+		Capture *capture);
+static void dumpFlight(const DetectContext *detection, const char *prefix,
+		FlightTrigger trigger, unsigned int *dumps);
+static void requestFlight(int signum);
+static void publishMetrics(MetricsExporter *metrics,
+		const DetectContext *detection, RecordContext *rc);
+static int openCallbackCounters(RecordContext *rc);
+static unsigned int alignHop(unsigned int hop, unsigned int period);
+static unsigned int periodSleep(double latency);
+static void initRecordContext(RecordContext *rc);
+static int getProfilePath(char *path, size_t size);
+static int calibrateStep(AudioContext *context, const CalibrationStep *step,
+		int floatSums, CalibrationResult *result);
+static double timePercentile(const DetectStats *stats, double ratio);
+static void printCalibration(const CalibrationResult *result, int floatSums);
 
 int audioRecord(AudioContext *context, const char *keepRunning)
 {
@@ -131,41 +526,200 @@ int audioRecord(AudioContext *context, const char *keepRunning)
 	RecordContext rc;
 	/// The context for detection functions
 	DetectContext *detection = 0;
+	/// The exporter of the metrics, if it is enabled
+	MetricsExporter *metrics = 0;
+	/// What the neck shows
+	NeckMode mode = NECK_NOTES;
+	/// The prefix of the dumps of the flight recorder, if it is enabled
+	const char *flightPath = getenv(FLIGHT_VARIABLE);
+	/// The number of dumps of the flight recorder
+	unsigned int dumps = 0;
+	/// The overflows that have already been dumped
+	unsigned long seenOverflows = 0;
+	/// The time of the last dump, or 0 before the first one
+	double lastDump = 0;
+	/// The latency requested by the user, in seconds, or 0
+	double targetLatency = 0;
+	/// The sleep of the loop while the detection is active, in ms
+	unsigned int acquisitionSleep = ACQUISITION_SLEEP;
+	/// The settings of the machine
+	Profile profile;
+	/// The path of the profile
+	char profilePath[PROFILE_PATH_SIZE];
+	/// Whether the stages are sampled with the hardware counters
+	int hwCounters = hwCountersRequested();
+	/// Whether the counters of the callback still have to be opened
+	int hwPending = hwCounters;
 
 	if(!context->device) {
 		return 0;
 	}
 
+	profileInit(&profile);
+	if(!getProfilePath(profilePath, sizeof(profilePath)) &&
+			profileLoad(&profile, profilePath) == -2) {
+		fprintf(stderr, "The profile %s is not valid, run the calibration "
+				"again.\n", profilePath);
+	}
+	targetLatency = profile.latency;
+
+	/// The target latency, if any
+	const char *latency = getenv(LATENCY_VARIABLE);
+	if(latency && *latency) {
+		targetLatency = atof(latency) / 1000;
+		if(!(targetLatency > 0)) {
+			fprintf(stderr, "Invalid latency \"%s\", the backend will choose "
+					"it.\n", latency);
+			targetLatency = 0;
+		}
+	}
+
 	/// The input stream from the device
-	struct SoundIoInStream *inStream = createStream(context->device);
+	struct SoundIoInStream *inStream = createStream(context->device,
+			targetLatency);
 	if(!inStream) {
 		return 0;
 	}
 
 	inStream->userdata = &rc;
-	rc.status = 0;
+	initRecordContext(&rc);
+	rc.hwRequested = hwCounters;
 
 	if(err = soundio_instream_open(inStream)) {
 		fprintf(stderr, "Could not open input stream: %s.\n",
 				soundio_strerror(err));
 	}
 
+	/* Opening the stream replaces the requested latency with the granted one,
+	which can be very different, e.g. when the device has fixed periods. */
+	if(!err && targetLatency > 0) {
+		fprintf(stderr, "Requested %.1f ms of input latency, granted %.1f ms."
+				"\n", targetLatency * 1000, inStream->software_latency * 1000);
+		if(inStream->software_latency > LATENCY_TOLERANCE * targetLatency) {
+			fprintf(stderr, "The device cannot reach the requested latency.\n");
+		}
+	}
+
 	if(!err) {
-		int capacity = RING_BUFFER_DURATION * inStream->sample_rate *
-				inStream->bytes_per_frame;
-		rc.ringBuffer = soundio_ring_buffer_create(context->soundio, capacity);
+		size_t capacity = RING_BUFFER_DURATION * inStream->sample_rate;
+		if(profile.ring > 0) {
+			capacity = (size_t) (profile.ring * inStream->sample_rate);
+		}
+		rc.ring = sampleRingCreate(capacity);
 
-		if(!rc.ringBuffer) {
+		if(!rc.ring) {
 			fprintf(stderr, "Could not create the ring buffer.\n");
 			err = 1;
 		}
 	}
 
 	if(!err) {
-		detection = detectInit(inStream->sample_rate);
+		/// The configuration of the detection
+		DetectConfig config;
+		/// The tuning chosen by the user
+		Tuning tuning;
+		/// The description of the tuning, if any
+		const char *description = getenv(TUNING_VARIABLE);
+		/// The maximum number of notes of the chords, if any
+		const char *polyphony = getenv(POLYPHONY_VARIABLE);
+		/// Whether the names of the chords are recognized, if set
+		const char *chords = getenv(CHORDS_VARIABLE);
+		/// Whether the period is estimated in fixed point, if set
+		const char *fixedPoint = getenv(FIXED_POINT_VARIABLE);
+
+		detectConfigInit(&config, inStream->sample_rate);
+		config.inputLatency = inStream->software_latency;
+		config.floatSums = profile.floatSums;
+		// The hop of the profile is in samples
+		if(profile.hop && profile.rate == (unsigned int) inStream->sample_rate) {
+			config.hop = profile.hop;
+		}
+		// This thread both creates the detection and runs it
+		config.hwCounters = hwCounters;
+
+		if(targetLatency > 0 && inStream->software_latency > 0) {
+			/// The period that has been granted, in samples
+			unsigned int period = (unsigned int) (inStream->software_latency *
+					inStream->sample_rate + 0.5);
+
+			// Each hop ends with a callback, and the loop wakes up for it
+			config.hop = alignHop(config.hop, period);
+			acquisitionSleep = periodSleep(inStream->software_latency);
+		}
+
+		if(description && *description) {
+			if(tuningParse(&tuning, description, GUITAR_FRETS)) {
+				fprintf(stderr, "Invalid tuning \"%s\", using the standard "
+						"one.\n", description);
+			} else {
+				config.tuning = &tuning;
+			}
+		}
+
+		if(polyphony && *polyphony) {
+			int notes = atoi(polyphony);
+			if(notes < 0 || notes > POLY_MAX_NOTES) {
+				fprintf(stderr, "Invalid polyphony \"%s\", showing single "
+						"notes.\n", polyphony);
+			} else {
+				config.polyphony = (unsigned int) notes;
+				mode = notes > 0 ? NECK_CHORD_NOTES : NECK_NOTES;
+			}
+		}
+
+		if(chords && *chords && strcmp(chords, "0")) {
+			config.chords = 1;
+			mode = NECK_CHORD_NAMES;
+		}
+
+		if(fixedPoint && *fixedPoint && strcmp(fixedPoint, "0")) {
+			config.fixedPoint = 1;
+		}
+
+		if(flightPath && *flightPath) {
+			config.flightSeconds = FLIGHT_SECONDS;
+		} else {
+			flightPath = 0;
+		}
+
+		detection = detectInitWithConfig(&config);
 		err = detection == 0;
 	}
 
+	if(!err) {
+		/// The path of the capture, if any
+		const char *path = getenv(CAPTURE_VARIABLE);
+
+		if(path && *path) {
+			/// The configuration of the capture
+			CaptureConfig config;
+
+			captureConfigInit(&config, inStream->sample_rate);
+			rc.capture = captureStart(&config, path);
+			// The session can continue without the capture
+			if(!rc.capture) {
+				fprintf(stderr, "The session won't be captured.\n");
+			}
+		}
+	}
+
+	if(!err) {
+		/// The path of the metrics, if any
+		const char *path = getenv(METRICS_VARIABLE);
+
+		if(path && *path) {
+			/// The configuration of the exporter
+			MetricsConfig config;
+
+			metricsConfigInit(&config);
+			metrics = metricsStart(&config, path);
+			// The session can continue without the metrics
+			if(!metrics) {
+				fprintf(stderr, "The metrics won't be exported.\n");
+			}
+		}
+	}
+
 	if(!err && (err = soundio_instream_start(inStream))) {
 		fprintf(stderr, "Could not start input device: %s.\n",
 				soundio_strerror(err));
@@ -176,12 +730,75 @@ int audioRecord(AudioContext *context, const char *keepRunning)
 	it is reported with an assertion in debugging time. */
 	assert(*keepRunning);
 
+#ifdef SIGUSR1
+	if(flightPath) {
+		gFlightRequested = 0;
+		signal(SIGUSR1, requestFlight);
+	}
+#endif
+
+	/* Everything the loop needs has been allocated above: in debug builds
+	make sure that it stays this way. */
+	allocTrackingBegin();
+
 	while(*keepRunning && !rc.status && !err) {
 		soundio_flush_events(context->soundio);
-		sleepMs(ACQUISITION_SLEEP);
+		threadSleepMs(detectIsIdle(detection) ? IDLE_ACQUISITION_SLEEP :
+				acquisitionSleep);
+
+		err = detectAnalyze(detection, rc.ring);
+		/// The anomaly found by the detection, if any
+		int anomaly = dispatchEvents(detection, mode, rc.capture);
+		/// The overflows until now
+		unsigned long overflows = atomic_load(&rc.overflows);
+
+		publishMetrics(metrics, detection, &rc);
 
-		err = detectAnalyze(detection, rc.ringBuffer);
+		if(hwPending) {
+			hwPending = openCallbackCounters(&rc);
+		}
+
+		if(flightPath) {
+			/// The time of this pass, for the limit of the dumps
+			double now = timeNow();
+
+			/* A burst of overflows would write a dump at each pass, and block
+			the loop each time: like the anomalies of the detection, they are
+			dumped at most once per length of the recorder. The overflows
+			that are skipped are still in the recorder at the next dump. */
+			if(gFlightRequested) {
+				gFlightRequested = 0;
+				anomaly = FLIGHT_TRIGGER_REQUEST;
+			} else if(anomaly < 0 && overflows != seenOverflows &&
+					(!lastDump || now - lastDump >= FLIGHT_SECONDS)) {
+				anomaly = FLIGHT_TRIGGER_OVERFLOW;
+			}
+
+			if(anomaly >= 0) {
+				dumpFlight(detection, flightPath, (FlightTrigger) anomaly,
+						&dumps);
+				seenOverflows = overflows;
+				lastDump = now;
+			}
+		} else {
+			seenOverflows = overflows;
+		}
+	}
+
+#ifdef SIGUSR1
+	if(flightPath) {
+		signal(SIGUSR1, SIG_DFL);
+	}
+#endif
+
+#ifdef ALLOC_TRACKING
+	unsigned long allocations = allocTrackingEnd();
+	if(allocations) {
+		fprintf(stderr, "%lu heap allocations happened in the recording loop.\n",
+				allocations);
 	}
+	assert(!allocations);
+#endif
 
 	/* Pause the stream so that readingCallback won't be called anymore and
 	won't cause troubles, now that the ring buffer will be destroyed. */
@@ -189,16 +806,65 @@ int audioRecord(AudioContext *context, const char *keepRunning)
 	soundio_instream_destroy(inStream);
 
 	// Cleaning section
-	if(rc.ringBuffer) {
+	if(rc.ring) {
 		if(!err) {
 			// Be sure to analyze last data, too
-			err = detectAnalyze(detection, rc.ringBuffer);
+			err = detectAnalyze(detection, rc.ring);
+			dispatchEvents(detection, mode, rc.capture);
+			publishMetrics(metrics, detection, &rc);
 		}
 
-		// SoundIo documentation says nothing about cleaning a null ringBuffer.
-		soundio_ring_buffer_destroy(rc.ringBuffer);
+		sampleRingFree(rc.ring);
+	}
+
+	// The samples lost by the ring are what the dump should explain
+	if(flightPath && rc.status == 1) {
+		dumpFlight(detection, flightPath, FLIGHT_TRIGGER_OVERFLOW, &dumps);
+	}
+
+	// The writer writes the last snapshot before stopping
+	metricsStop(metrics);
+
+	if(rc.capture) {
+		/// The final counters of the capture
+		CaptureStats stats;
+
+		captureStop(rc.capture, &stats);
+		if(stats.droppedBlocks || stats.droppedEvents || stats.writeErrors) {
+			fprintf(stderr, "The capture dropped %lu of %lu blocks and %lu "
+					"events, with %lu write errors.\n", stats.droppedBlocks,
+					stats.blocks + stats.droppedBlocks, stats.droppedEvents,
+					stats.writeErrors);
+		}
 	}
 
+	if(hwCounters) {
+		/// The final counters of the detection
+		DetectStats stats;
+
+		if(detection) {
+			detectGetStats(detection, &stats);
+		} else {
+			stats.hwCounters = 0;
+		}
+
+		if(!hwCountersAvailable(&rc.hw) && !stats.hwCounters) {
+			fprintf(stderr, "The hardware counters are not available.\n");
+		} else if(hwCountersAvailable(&rc.hw) &&
+				!atomic_load(&rc.hwReady)) {
+			fprintf(stderr, "The hardware counters cannot be read without "
+					"system calls, the copy is not sampled.\n");
+		}
+		hwStagePrint(stderr, "copy", &rc.copy.counts);
+		if(stats.hwCounters) {
+			hwStagePrint(stderr, "envelope",
+					&stats.stages[DETECT_STAGE_ENVELOPE]);
+			hwStagePrint(stderr, "estimator",
+					&stats.stages[DETECT_STAGE_ESTIMATOR]);
+		}
+	}
+	hwCountersClose(&rc.hw);
+
 	// A null detection isn't a problem, so leave the check to detectFree
 	detectFree(detection);
 
@@ -211,9 +877,13 @@ int audioRecord(AudioContext *context, const char *keepRunning)
  * We need to have a buffer with input data, and to create it, libSoundIo needs
  * some parameters, like sample rate and data format.
  *
+ * @param device The device to read from
+ * @param latency The target software latency, in seconds, or 0 to let the
+ *  backend choose it
  * @return The pointer to the instream, or a null pointer in case of error.
  */
-static struct SoundIoInStream *createStream(struct SoundIoDevice *device)
+static struct SoundIoInStream *createStream(struct SoundIoDevice *device,
+		double latency)
 {
 	if(!device) {
 		return 0;
@@ -260,6 +930,20 @@ static struct SoundIoInStream *createStream(struct SoundIoDevice *device)
 		return 0;
 	}
 
+	/* The range of the device is only a hint, some backends report it as 0,
+	so the backend has the last word when the stream is opened. */
+	if(latency > 0) {
+		if(device->software_latency_min > 0 &&
+				latency < device->software_latency_min) {
+			latency = device->software_latency_min;
+		}
+		if(device->software_latency_max > 0 &&
+				latency > device->software_latency_max) {
+			latency = device->software_latency_max;
+		}
+		inStream->software_latency = latency;
+	}
+
 	return inStream;
 }
 
@@ -288,13 +972,38 @@ static void readCallback(struct SoundIoInStream *inStream, int frameCountMin,
 		return;
 	}
 
+	// A single system call, in the first callback
+	if(rc->hwRequested) {
+		rc->hwRequested = 0;
+		atomic_store(&rc->callbackThread, hwCurrentThread());
+	}
+	/// Whether the copy can be sampled
+	int hwReady = atomic_load(&rc->hwReady);
+
+	/// The time of this call, for the jitter of the callbacks
+	double now = timeNow();
+	if(rc->lastCallback > 0) {
+		/// The time since the previous call
+		double interval = now - rc->lastCallback;
+
+		rc->intervals++;
+		rc->intervalSum += interval;
+		if(interval > rc->maxInterval) {
+			rc->maxInterval = interval;
+		}
+	}
+	rc->lastCallback = now;
+
 	// These variables are needed by libSoundIo
 	struct SoundIoChannelArea *areas;
 	int err;
-	char *writePtr = soundio_ring_buffer_write_ptr(rc->ringBuffer);
+	/* The stream is mono and its format is float in native endianness, so a
+	frame is exactly one sample of the ring. */
+	float *writePtr = sampleRingWritePtr(rc->ring);
+	/// The first sample of this call, for the capture
+	const float *blockPtr = writePtr;
 
-	int freeBytes = soundio_ring_buffer_free_count(rc->ringBuffer);
-	int freeCount = freeBytes / inStream->bytes_per_frame;
+	int freeCount = (int) sampleRingFreeCount(rc->ring);
 	if(freeCount < frameCountMin) {
 		fprintf(stderr, "Ring buffer overflow\n");
 
@@ -309,6 +1018,9 @@ static void readCallback(struct SoundIoInStream *inStream, int frameCountMin,
 	sense and deserves to be noticed during programming time. */
 	assert(writeFrames);
 
+	if(hwReady) {
+		hwStageBegin(&rc->copy, &rc->hw);
+	}
 	for(int frameCount = writeFrames, framesLeft = writeFrames;
 			framesLeft > 0; framesLeft -= frameCount) {
 		if(err = soundio_instream_begin_read(inStream, &areas, &frameCount)) {
@@ -330,14 +1042,14 @@ static void readCallback(struct SoundIoInStream *inStream, int frameCountMin,
 			Note: a silence is ok for registration, but for audio detection
 			could not be very useful. A flag to report silence and so clear the
 			state of the played note would be better. */
-			memset(writePtr, 0, frameCount * inStream->bytes_per_frame);
+			memset(writePtr, 0, frameCount * sizeof(float));
+			writePtr += frameCount;
+			atomic_fetch_add(&rc->overflows, 1);
 		} else {
 			for(int frame = 0; frame < frameCount; frame++) {
-				for(int ch = 0; ch < inStream->layout.channel_count; ch++) {
-					memcpy(writePtr, areas[ch].ptr, inStream->bytes_per_sample);
-					areas[ch].ptr += areas[ch].step;
-					writePtr += inStream->bytes_per_sample;
-				}
+				memcpy(writePtr, areas[0].ptr, sizeof(float));
+				areas[0].ptr += areas[0].step;
+				writePtr++;
 			}
 		}
 
@@ -349,31 +1061,546 @@ static void readCallback(struct SoundIoInStream *inStream, int frameCountMin,
 		}
 	}
 
-	int advanceBytes = writeFrames * inStream->bytes_per_frame;
-	soundio_ring_buffer_advance_write_ptr(rc->ringBuffer, advanceBytes);
+	/* The capture never waits for the disk: if its writer is behind, the block
+	is dropped and counted. */
+	if(rc->capture) {
+		captureWrite(rc->capture, blockPtr, writeFrames);
+	}
+
+	sampleRingAdvanceWrite(rc->ring, writeFrames);
+	if(hwReady) {
+		hwStageEnd(&rc->copy, &rc->hw);
+	}
 }
 
 /**
- * @brief A sleep function with milliseconds precision.
- * @author Bernardo Ramos (http://stackoverflow.com/users/4626775/bernardo-ramos)
- * @link http://stackoverflow.com/a/28827188
- * @copyright Creative Commons Attribution-ShareAlike 3.0 Unported
+ * @brief Send the events of the detection to the GUI.
  *
- * This function has been taken from Stack Overflow.
+ * @param detection The context of the detection
+ * @param mode What the neck shows
+ * @param capture The capture that logs the events, or null
+ * @return The trigger of the last anomaly event, or -1 if there wasn't any
+ */
+static int dispatchEvents(DetectContext *detection, NeckMode mode,
+		Capture *capture)
+{
+	DetectEvent event;
+	/// The return value
+	int anomaly = -1;
+	/// The name of the recognized chord
+	char name[CHROMA_NAME_SIZE];
+
+	while(detectPollEvent(detection, &event)) {
+		if(capture) {
+			captureEvent(capture, &event);
+		}
+
+		switch(event.type) {
+			case DETECT_EVENT_NOTE:
+				if(mode == NECK_NOTES) {
+					guiHighlightFrets(event.frets);
+				}
+				break;
+
+			case DETECT_EVENT_SILENCE:
+				if(mode == NECK_NOTES) {
+					guiResetHighlights();
+				}
+				break;
+
+			case DETECT_EVENT_NOTES:
+				if(mode != NECK_CHORD_NOTES) {
+					break;
+				}
+				if(event.count) {
+					guiHighlightFrets(event.frets);
+				} else {
+					guiResetHighlights();
+				}
+				break;
+
+			// Chords without a shape on this tuning reset the highlights
+			case DETECT_EVENT_CHORD:
+				if(event.chord.root != INVALID_SEMITONE) {
+					chromaChordName(&event.chord, name);
+					fprintf(stderr, "Chord: %s\n", name);
+				}
+				if(mode == NECK_CHORD_NAMES) {
+					guiHighlightFrets(event.frets);
+				}
+				break;
+
+			case DETECT_EVENT_TIER:
+				fprintf(stderr, "The analysis switched to tier %d.\n",
+						event.tier);
+				break;
+
+			/* Going idle resets the note (so a silence event has already been
+			sent) and nothing has to be shown when it ends. */
+			case DETECT_EVENT_IDLE:
+			case DETECT_EVENT_ACTIVE:
+				break;
+
+			case DETECT_EVENT_ANOMALY:
+				anomaly = event.trigger;
+				break;
+		}
+	}
+
+	return anomaly;
+}
+
+/**
+ * @brief Dump the flight recorder of the detection to the next file.
  *
- * @param ms The milliseconds to sleep
+ * @param detection The context of the detection
+ * @param prefix The prefix of the path of the dumps
+ * @param trigger The cause of the dump
+ * @param dumps The number of previous dumps, which is incremented on success
  */
-inline static void sleepMs(unsigned int ms) {
-#ifdef WIN32
-	Sleep(ms);
-#elif defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 199309L
-	struct timespec ts;
-	ts.tv_sec = ms / 1000;
-	ts.tv_nsec = (ms % 1000) * 1000000;
-	nanosleep(&ts, NULL);
-#elif defined(__linux__)
-	usleep(ms * 1000);
-#else
-#	error "Unsupported platform"
-#endif
+static void dumpFlight(const DetectContext *detection, const char *prefix,
+		FlightTrigger trigger, unsigned int *dumps)
+{
+	/// The path of the dump
+	char path[FLIGHT_PATH_SIZE];
+
+	snprintf(path, sizeof(path), "%s-%u.flight", prefix, *dumps);
+	if(detectDumpFlight(detection, path, trigger)) {
+		fprintf(stderr, "Could not dump the flight recorder to %s.\n", path);
+		return;
+	}
+
+	(*dumps)++;
+	fprintf(stderr, "Flight recorder dumped to %s (%s).\n", path,
+			flightTriggerName(trigger));
+}
+
+/**
+ * @brief Align the hop of the detection to the period of the audio card.
+ *
+ * The hop becomes the largest multiple of the period that is not longer than
+ * the hop, so that the samples of a hop are complete when a callback returns.
+ * Periods longer than the hop deliver more hops per callback, and they leave
+ * the hop unchanged.
+ *
+ * @param hop The hop, in samples
+ * @param period The period, in samples
+ * @return The aligned hop
+ */
+static unsigned int alignHop(unsigned int hop, unsigned int period)
+{
+	if(!period || period >= hop) {
+		return hop;
+	}
+
+	return hop / period * period;
+}
+
+/**
+ * @brief Get the sleep of the acquiring loop for a period of the audio card.
+ *
+ * @param latency The software latency of the stream, in seconds
+ * @return The period in ms, rounded up, between 1 and ACQUISITION_SLEEP
+ */
+static unsigned int periodSleep(double latency)
+{
+	/// The return value
+	unsigned int sleep = (unsigned int) ceil(latency * 1000);
+
+	if(sleep < 1) {
+		return 1;
+	}
+
+	return sleep < (unsigned int) ACQUISITION_SLEEP ? sleep :
+			(unsigned int) ACQUISITION_SLEEP;
+}
+
+/**
+ * @brief Handle the signal that requests a dump of the flight recorder.
+ *
+ * The dump itself is done by the recording loop, since writing a file is not
+ * async-signal-safe.
+ *
+ * @param signum The number of the signal
+ */
+static void requestFlight(int signum)
+{
+	(void) signum;
+	gFlightRequested = 1;
+}
+
+/**
+ * @brief Publish a snapshot of the counters of the pipeline.
+ *
+ * It is called by the recording loop, so it only copies the counters: the
+ * exporter formats and writes them in its own thread.
+ *
+ * @param metrics The exporter, or null if the metrics are disabled
+ * @param detection The detection
+ * @param rc The context of the recording, with the ring and the overflows
+ */
+static void publishMetrics(MetricsExporter *metrics,
+		const DetectContext *detection, RecordContext *rc)
+{
+	/// The counters of the pipeline
+	MetricsSnapshot snapshot;
+
+	if(!metrics) {
+		return;
+	}
+
+	detectGetStats(detection, &snapshot.detect);
+	snapshot.overflows = atomic_load(&rc->overflows);
+	snapshot.ringFill = sampleRingFillCount(rc->ring);
+	snapshot.ringCapacity = sampleRingCapacity(rc->ring);
+	metricsPublish(metrics, &snapshot);
+}
+
+/**
+ * @brief Open the hardware counters of the thread of the callback, once it
+ *  has recorded its id.
+ *
+ * The callback uses them only if they can be read with rdpmc, because it
+ * must not make system calls.
+ *
+ * @param rc The context of the recording
+ * @return 1 if the callback hasn't recorded its thread yet, 0 otherwise
+ */
+static int openCallbackCounters(RecordContext *rc)
+{
+	/// The thread of the callback, if it has already run
+	long thread = atomic_load(&rc->callbackThread);
+
+	if(!thread) {
+		return 1;
+	}
+
+	// The counters are complete before the callback can see them
+	if(!hwCountersOpenThread(&rc->hw, thread) &&
+			hwCountersUserRead(&rc->hw)) {
+		atomic_store(&rc->hwReady, 1);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Initialize the fields of a RecordContext.
+ *
+ * @param rc The context
+ */
+static void initRecordContext(RecordContext *rc)
+{
+	rc->status = 0;
+	rc->ring = 0;
+	rc->capture = 0;
+	atomic_init(&rc->overflows, 0);
+	rc->lastCallback = 0;
+	rc->intervals = 0;
+	rc->intervalSum = 0;
+	rc->maxInterval = 0;
+	rc->hwRequested = 0;
+	atomic_init(&rc->callbackThread, 0);
+	atomic_init(&rc->hwReady, 0);
+	hwCountersInit(&rc->hw);
+	hwStageInit(&rc->copy, HW_COPY_INTERVAL);
+}
+
+/**
+ * @brief Get the path of the profile of the machine.
+ *
+ * @param path Output buffer for the path
+ * @param size The size of the buffer
+ * @return 0 on success, -1 if the path is not available or too long
+ */
+static int getProfilePath(char *path, size_t size)
+{
+	/// The path chosen by the user, if any
+	const char *custom = getenv(PROFILE_VARIABLE);
+	/// The home directory
+	const char *home = getenv(HOME_VARIABLE);
+	/// The length of the path
+	int length;
+
+	if(custom && *custom) {
+		length = snprintf(path, size, "%s", custom);
+	} else if(home && *home) {
+		length = snprintf(path, size, "%s/%s", home, PROFILE_FILE);
+	} else {
+		return -1;
+	}
+
+	return length < 0 || (size_t) length >= size ? -1 : 0;
+}
+
+int audioCalibrate(AudioContext *context)
+{
+	/// The path of the profile
+	char path[PROFILE_PATH_SIZE];
+	/// The tightest stable settings
+	Profile best;
+	/// Whether a stable step has been found
+	int found = 0;
+	/// The effective latency of the best settings, in seconds
+	double bestLatency = INFINITY;
+	/// The engine of the estimation, chosen on the first step
+	int floatSums = 0;
+
+	if(!context->device) {
+		return 0;
+	}
+
+	if(getProfilePath(path, sizeof(path))) {
+		fprintf(stderr, "Set %s to the path of the profile.\n",
+				PROFILE_VARIABLE);
+		return 0;
+	}
+
+	printf("Calibrating, keep playing until it has finished.\n");
+
+	for(const CalibrationStep *step = CALIBRATION_STEPS; step->latency > 0;
+			step++) {
+		/// The measures of the step
+		CalibrationResult result;
+
+		if(calibrateStep(context, step, floatSums, &result)) {
+			break;
+		}
+
+		/* The first step is the most relaxed one, so both the engines are
+		measured on it, and the faster one is used for all the steps. */
+		if(step == CALIBRATION_STEPS) {
+			/// The measures with the other engine
+			CalibrationResult floatResult;
+
+			printCalibration(&result, 0);
+			if(calibrateStep(context, step, 1, &floatResult)) {
+				break;
+			}
+			printCalibration(&floatResult, 1);
+
+			if(floatResult.stable && (!result.stable ||
+					floatResult.analysis99 < result.analysis99)) {
+				floatSums = 1;
+				result = floatResult;
+			}
+		} else {
+			printCalibration(&result, floatSums);
+		}
+
+		// More aggressive settings are not going to be more stable
+		if(!result.stable) {
+			break;
+		}
+
+		/// The effective latency of the step
+		double latency = result.latency + result.hop / (double) result.rate;
+		if(latency < bestLatency) {
+			double ring = CALIBRATION_RING_MARGIN * result.maxFill /
+					result.rate;
+
+			profileInit(&best);
+			best.rate = result.rate;
+			best.latency = step->latency;
+			best.hop = result.hop;
+			best.ring = ring > CALIBRATION_MIN_RING ? ring :
+					CALIBRATION_MIN_RING;
+			best.floatSums = floatSums;
+			bestLatency = latency;
+			found = 1;
+		}
+	}
+
+	if(!found) {
+		fprintf(stderr, "No stable settings have been found, the profile "
+				"hasn't been changed.\n");
+		return 0;
+	}
+
+	if(profileSave(&best, path)) {
+		fprintf(stderr, "Could not save the profile to %s.\n", path);
+		return 0;
+	}
+
+	printf("Saved to %s: %.1f ms of latency, hop %u, %.1f s of ring, %s "
+			"sums.\n", path, best.latency * 1000, best.hop, best.ring,
+			best.floatSums ? "float" : "double");
+
+	return 1;
+}
+
+/**
+ * @brief Run the capture and the analysis with the settings of a step.
+ *
+ * The governor is disabled, so that the analysis always has the cost of the
+ * full tier.
+ *
+ * @param context The AudioContext instance
+ * @param step The step
+ * @param floatSums Accumulate the products of the estimation in float
+ * @param result Output parameter for the measures
+ * @return 0 on success, non-zero if the stream or the detection could not be
+ *  created
+ */
+static int calibrateStep(AudioContext *context, const CalibrationStep *step,
+		int floatSums, CalibrationResult *result)
+{
+	/// The status of the step
+	int err = 0;
+	/// A struct to exchange data with the recording callback
+	RecordContext rc;
+	/// The context for detection functions
+	DetectContext *detection = 0;
+	/// The sleep of the loop, in ms
+	unsigned int sleep = ACQUISITION_SLEEP;
+	/// The stream with the latency of the step
+	struct SoundIoInStream *inStream = createStream(context->device,
+			step->latency);
+
+	if(!inStream) {
+		return -1;
+	}
+
+	inStream->userdata = &rc;
+	initRecordContext(&rc);
+	memset(result, 0, sizeof(*result));
+
+	if(err = soundio_instream_open(inStream)) {
+		fprintf(stderr, "Could not open input stream: %s.\n",
+				soundio_strerror(err));
+	}
+
+	if(!err) {
+		rc.ring = sampleRingCreate(RING_BUFFER_DURATION *
+				inStream->sample_rate);
+		err = !rc.ring;
+	}
+
+	if(!err) {
+		/// The configuration of the detection
+		DetectConfig config;
+		/// The period that has been granted, in samples
+		unsigned int period = (unsigned int) (inStream->software_latency *
+				inStream->sample_rate + 0.5);
+
+		detectConfigInit(&config, inStream->sample_rate);
+		config.hop = alignHop(config.hop / step->hopDivisor, period);
+		config.governor = 0;
+		config.floatSums = floatSums;
+		config.inputLatency = inStream->software_latency;
+		// Analyze as many windows as possible, also between the notes
+		config.idleTimeout = 0;
+		config.gateRatio = 1;
+
+		result->rate = inStream->sample_rate;
+		result->latency = inStream->software_latency;
+		result->hop = config.hop;
+
+		detection = detectInitWithConfig(&config);
+		err = !detection;
+		sleep = periodSleep(inStream->software_latency);
+	}
+
+	if(!err && (err = soundio_instream_start(inStream))) {
+		fprintf(stderr, "Could not start input device: %s.\n",
+				soundio_strerror(err));
+	}
+
+	/// The end of the step
+	double end = timeNow() + CALIBRATION_SECONDS;
+	while(!err && !rc.status && timeNow() < end) {
+		/// A detected event, which is discarded
+		DetectEvent event;
+
+		soundio_flush_events(context->soundio);
+		threadSleepMs(sleep);
+
+		/// The samples waiting for the detection
+		size_t fill = sampleRingFillCount(rc.ring);
+		if(fill > result->maxFill) {
+			result->maxFill = fill;
+		}
+
+		err = detectAnalyze(detection, rc.ring);
+		while(detectPollEvent(detection, &event)) {
+		}
+	}
+
+	// The callback doesn't run anymore, so its counters can be read
+	soundio_instream_pause(inStream, 1);
+	soundio_instream_destroy(inStream);
+
+	if(detection) {
+		/// The counters of the detection
+		DetectStats stats;
+
+		detectGetStats(detection, &stats);
+		result->frames = stats.frames;
+		result->analysisMedian = timePercentile(&stats, 0.5);
+		result->analysis99 = timePercentile(&stats, 0.99);
+	}
+
+	result->overflows = atomic_load(&rc.overflows) + (rc.status == 1);
+	if(rc.intervals) {
+		result->jitter = rc.maxInterval - rc.intervalSum / rc.intervals;
+	}
+
+	// A late callback must still find its samples in the buffer of the card
+	result->stable = !err && !rc.status && !result->overflows &&
+			result->jitter <= result->latency && result->analysis99 <=
+			CALIBRATION_MAX_LOAD * result->hop / result->rate;
+
+	sampleRingFree(rc.ring);
+	detectFree(detection);
+
+	return err || rc.status > 1;
+}
+
+/**
+ * @brief Get a percentile of the analysis time from its histogram.
+ *
+ * @param stats The counters of the detection
+ * @param ratio The percentile, between 0 and 1
+ * @return The bound of the bucket of the percentile, in seconds, or 0 if no
+ *  window has been analyzed
+ */
+static double timePercentile(const DetectStats *stats, double ratio)
+{
+	/// The number of analyzed windows
+	unsigned long total = 0;
+	/// The windows in the buckets up to the current one
+	unsigned long count = 0;
+
+	for(unsigned int i = 0; i < DETECT_TIME_BUCKETS; i++) {
+		total += stats->analysisTimes[i];
+	}
+
+	if(!total) {
+		return 0;
+	}
+
+	for(unsigned int i = 0; i < DETECT_TIME_BUCKETS; i++) {
+		count += stats->analysisTimes[i];
+		if(count >= ratio * total) {
+			return detectTimeBucketBound(i);
+		}
+	}
+
+	return INFINITY;
+}
+
+/**
+ * @brief Print the measures of a step of the calibration.
+ *
+ * @param result The measures
+ * @param floatSums Whether the products have been accumulated in float
+ */
+static void printCalibration(const CalibrationResult *result, int floatSums)
+{
+	printf("Latency %.1f ms, hop %u, %s sums: jitter %.2f ms, analysis "
+			"p50 < %.3f ms, p99 < %.3f ms on %lu windows, %lu overflows: %s.\n",
+			result->latency * 1000, result->hop, floatSums ? "float" : "double",
+			result->jitter * 1000, result->analysisMedian * 1000,
+			result->analysis99 * 1000, result->frames, result->overflows,
+			result->stable ? "stable" : "unstable");
 }
@@ -0,0 +1,418 @@
+/**
+ * @file band_estimator.c
+ * @brief Estimate the period of a signal separately on two registers.
+ */
+
+#include "band_estimator.h"
+
+// PeriodEstimator, estimatorCreate, estimatorRun, estimateQuality
+#include "period_estimator.h"
+
+// DspBiquad, DspCascade, dspBiquadLowPass, dspCascadeProcess
+#include "dsp.h"
+
+// memcpy
+#include <string.h>
+
+// floor, ceil, fabs, pow
+#include <math.h>
+
+// assert
+#include <assert.h>
+
+/**
+ * @brief The ratio between the Nyquist frequency of the decimated low band
+ *  and the cutoff of its low-pass filter.
+ *
+ * The filter is not steep, so a margin limits the aliasing.
+ */
+static const double DECIMATION_MARGIN = 1.25;
+
+/**
+ * @brief The highest frequency of the low band, in octaves above the
+ *  crossover.
+ *
+ * The low band keeps the first harmonics of its notes, which make the
+ * autocorrelation peaks narrower.
+ */
+static const double LOW_BAND_OCTAVES = 2;
+
+/**
+ * @brief The maximum distance of the ratio between two candidates from an
+ *  integer, relative to the integer, to consider them harmonics.
+ */
+static const double HARMONIC_TOLERANCE = 0.03;
+
+/**
+ * @brief The highest multiple between two candidates that is checked.
+ *
+ * The bands overlap for an octave, so the candidates of the same note are
+ * near harmonics, whereas the short lags of a spurious candidate of the high
+ * band can be near any multiple of a low note.
+ */
+static const int MAX_MULTIPLE = 8;
+
+/**
+ * @brief The ratio between the quality of the submultiples of the longer
+ *  candidate and the quality of the longer candidate above which the shorter
+ *  one is the real period.
+ * @sa fixOctaves in period_estimator.c
+ */
+static const double SUBMULTIPLE_THRESHOLD = 0.9;
+
+struct _BandEstimator {
+	/**
+	 * @brief The configuration of the estimator.
+	 */
+	BandConfig config;
+
+	/**
+	 * @brief The decimation factor of the low band.
+	 */
+	unsigned int factor;
+
+	/**
+	 * @brief The estimator of the decimated low band.
+	 */
+	PeriodEstimator *low;
+
+	/**
+	 * @brief The estimator of the high band.
+	 */
+	PeriodEstimator *high;
+
+	/**
+	 * @brief The estimator that refines the period of the low band on the
+	 *  whole signal, at full rate.
+	 */
+	PeriodEstimator *refine;
+
+	/**
+	 * @brief The anti-aliasing filter of the low band, with an empty state.
+	 *
+	 * It is copied at each window, because the windows can overlap.
+	 */
+	DspCascade lowPass;
+
+	/**
+	 * @brief The crossover filter of the high band, with an empty state.
+	 */
+	DspCascade highPass;
+
+	/**
+	 * @brief The buffer for the filtered window of the low band.
+	 */
+	float *lowFiltered;
+
+	/**
+	 * @brief The buffer for the decimated window of the low band.
+	 */
+	float *lowDecimated;
+
+	/**
+	 * @brief The number of samples of the decimated window.
+	 */
+	int lowWindow;
+
+	/**
+	 * @brief The buffer for the filtered window of the high band, after the
+	 *  samples needed by the filter to settle.
+	 */
+	float *highFiltered;
+
+	/**
+	 * @brief The number of samples of the high band window.
+	 */
+	int highWindow;
+
+	/**
+	 * @brief The number of samples filtered before the high band window.
+	 */
+	int highWarmup;
+};
+
+/**
+ * @brief Compute the parameters of the bands from the configuration.
+ *
+ * They are needed both to size the arena and to create the estimator.
+ *
+ * @param config The configuration of the estimator
+ * @param factor Output parameter for the decimation factor of the low band
+ * @param low Output parameter for the configuration of the low band
+ * @param high Output parameter for the configuration of the high band
+ * @param refine Output parameter for the configuration of the refinement
+ * @return 0 on success, -1 if the configuration is not valid
+ */
+static int computeBands(const BandConfig *config, unsigned int *factor,
+		EstimatorConfig *low, EstimatorConfig *high, EstimatorConfig *refine);
+
+/**
+ * @brief Filter a part of a signal with a copy of a cascade.
+ *
+ * @param cascade The cascade, whose state is not changed
+ * @param x The signal
+ * @param out The buffer for the filtered signal
+ * @param n The number of samples
+ */
+static void filterWindow(const DspCascade *cascade, const float *x, float *out,
+		int n);
+
+void bandConfigInit(BandConfig *config, unsigned int rate, int minP, int maxP)
+{
+	assert(config);
+
+	config->rate = rate;
+	config->minP = minP;
+	config->maxP = maxP;
+	config->window = 2 * maxP;
+	config->crossover = maxP > 0 ? 4.0 * rate / maxP : 0;
+	config->factor = 0;
+	config->gridStep = ESTIMATOR_GRID_STEP;
+	config->floatSums = 0;
+}
+
+size_t bandMemorySize(const BandConfig *config)
+{
+	assert(config);
+
+	unsigned int factor;
+	EstimatorConfig low, high, refine;
+
+	if(computeBands(config, &factor, &low, &high, &refine)) {
+		return 0;
+	}
+
+	return ARENA_ALIGN(sizeof(BandEstimator)) + estimatorMemorySize(&low) +
+			estimatorMemorySize(&high) + estimatorMemorySize(&refine) +
+			ARENA_ALIGN(config->window * sizeof(float)) +
+			ARENA_ALIGN(config->window / factor * sizeof(float)) +
+			ARENA_ALIGN(3 * high.maxP * sizeof(float));
+}
+
+BandEstimator *bandCreate(Arena *arena, const BandConfig *config)
+{
+	assert(arena);
+	assert(config);
+
+	/// The configurations of the estimators
+	EstimatorConfig low, high, refine;
+	/// The decimation factor of the low band
+	unsigned int factor;
+	/// The coefficients of the filters
+	DspBiquad biquad;
+	/// The instance that will be returned
+	BandEstimator *ret;
+
+	if(computeBands(config, &factor, &low, &high, &refine)) {
+		return 0;
+	}
+
+	ret = arenaAlloc(arena, sizeof(BandEstimator));
+	if(!ret) {
+		return 0;
+	}
+
+	ret->config = *config;
+	ret->factor = factor;
+	ret->low = estimatorCreate(arena, &low);
+	ret->high = estimatorCreate(arena, &high);
+	ret->refine = estimatorCreate(arena, &refine);
+
+	ret->lowWindow = config->window / (int) factor;
+	ret->highWindow = 2 * high.maxP;
+	ret->highWarmup = high.maxP;
+	ret->lowFiltered = arenaAlloc(arena, config->window * sizeof(float));
+	ret->lowDecimated = arenaAlloc(arena, ret->lowWindow * sizeof(float));
+	ret->highFiltered = arenaAlloc(arena,
+			(ret->highWindow + ret->highWarmup) * sizeof(float));
+	if(!ret->low || !ret->high || !ret->refine || !ret->lowFiltered ||
+			!ret->lowDecimated || !ret->highFiltered) {
+		return 0;
+	}
+
+	// The filters are steeper when all the stages are used
+	dspCascadeInit(&ret->lowPass);
+	dspBiquadLowPass(&biquad, config->rate / (2 * DECIMATION_MARGIN * factor),
+			config->rate);
+	for(unsigned int i = 0; i < DSP_CASCADE_STAGES; i++) {
+		dspCascadeSet(&ret->lowPass, i, &biquad);
+	}
+
+	dspCascadeInit(&ret->highPass);
+	dspBiquadHighPass(&biquad, config->crossover, config->rate);
+	for(unsigned int i = 0; i < DSP_CASCADE_STAGES; i++) {
+		dspCascadeSet(&ret->highPass, i, &biquad);
+	}
+
+	return ret;
+}
+
+double bandRunLow(BandEstimator *estimator, const float *x, double *q)
+{
+	assert(estimator);
+	assert(x);
+	assert(q);
+
+	/// The period of the decimated signal
+	double period;
+	/// The refined period, in samples at full rate
+	double center;
+	/// The range of the refinement
+	int lo, hi;
+	/// The decimation factor
+	int factor = (int) estimator->factor;
+
+	filterWindow(&estimator->lowPass, x, estimator->lowFiltered,
+			estimator->config.window);
+	for(int i = 0; i < estimator->lowWindow; i++) {
+		estimator->lowDecimated[i] = estimator->lowFiltered[i * factor];
+	}
+
+	period = estimatorRun(estimator->low, estimator->lowDecimated,
+			estimator->lowWindow, q, 0);
+	if(!(period > 0)) {
+		*q = 0;
+		return 0;
+	}
+
+	/* The decimated period is accurate to a fraction of its sample, i.e. to a
+	few samples at full rate, so the whole signal needs only a few lags. */
+	center = period * factor;
+	lo = (int) floor(center - factor);
+	hi = (int) ceil(center + factor);
+	lo = lo < estimator->config.minP ? estimator->config.minP : lo;
+	hi = hi > estimator->config.maxP ? estimator->config.maxP : hi;
+	if(hi <= lo) {
+		*q = 0;
+		return 0;
+	}
+
+	return estimatorRunRange(estimator->refine, x, estimator->config.window,
+			lo, hi, q, 0);
+}
+
+double bandRunHigh(BandEstimator *estimator, const float *x, double *q)
+{
+	assert(estimator);
+	assert(x);
+	assert(q);
+
+	/// The number of samples to filter
+	int n = estimator->highWindow + estimator->highWarmup;
+
+	// The high notes need only the last part of the window
+	filterWindow(&estimator->highPass, x + estimator->config.window - n,
+			estimator->highFiltered, n);
+
+	return estimatorRun(estimator->high,
+			estimator->highFiltered + estimator->highWarmup,
+			estimator->highWindow, q, 0);
+}
+
+double bandCombine(const float *x, int n, double low, double lowQ,
+		double high, double highQ, double *q)
+{
+	assert(x);
+	assert(q);
+
+	/// The shorter candidate
+	double shorter = low < high ? low : high;
+	/// The longer candidate
+	double longer = low < high ? high : low;
+	/// The ratio between the candidates
+	double ratio;
+	/// The nearest integer to ratio
+	double multiple;
+
+	if(!(low > 0) || !(high > 0)) {
+		*q = low > 0 ? lowQ : (high > 0 ? highQ : 0);
+		return low > 0 ? low : (high > 0 ? high : 0);
+	}
+
+	ratio = longer / shorter;
+	multiple = floor(ratio + 0.5);
+	if(multiple >= 2 && multiple <= MAX_MULTIPLE &&
+			fabs(ratio - multiple) < HARMONIC_TOLERANCE * multiple &&
+			longer < n) {
+		double threshold = SUBMULTIPLE_THRESHOLD *
+				estimateQuality(x, n, (int) (longer + 0.5));
+		double chosen = shorter;
+
+		for(int k = 1; k < multiple && chosen == shorter; k++) {
+			int lag = (int) (k * longer / multiple + 0.5);
+			if(estimateQuality(x, n, lag) < threshold) {
+				chosen = longer;
+			}
+		}
+
+		*q = chosen == low ? lowQ : highQ;
+		return chosen;
+	}
+
+	// The same note, or unrelated candidates
+	*q = lowQ >= highQ ? lowQ : highQ;
+	return lowQ >= highQ ? low : high;
+}
+
+double bandRun(BandEstimator *estimator, const float *x, double *q)
+{
+	assert(estimator);
+
+	double lowQ, highQ;
+	double low = bandRunLow(estimator, x, &lowQ);
+	double high = bandRunHigh(estimator, x, &highQ);
+
+	return bandCombine(x, estimator->config.window, low, lowQ, high, highQ, q);
+}
+
+int computeBands(const BandConfig *config, unsigned int *factor,
+		EstimatorConfig *low, EstimatorConfig *high, EstimatorConfig *refine)
+{
+	/// The cutoff of the low band
+	double lowCut = config->crossover * pow(2, LOW_BAND_OCTAVES);
+
+	if(!config->rate || config->minP < 2 || config->maxP <= config->minP ||
+			config->window < 2 * config->maxP || !(config->crossover > 0) ||
+			lowCut >= config->rate / (2 * DECIMATION_MARGIN) ||
+			config->gridStep < 0) {
+		return -1;
+	}
+
+	*factor = config->factor;
+	if(!*factor) {
+		*factor = (unsigned int) (config->rate /
+				(2 * DECIMATION_MARGIN * lowCut));
+	}
+
+	// The low band starts an octave above the crossover
+	estimatorConfigInit(low,
+			(int) floor(config->rate / (2 * config->crossover) / *factor),
+			config->window / (int) *factor / 2);
+	low->gridStep = config->gridStep;
+	low->floatSums = config->floatSums;
+
+	estimatorConfigInit(high, config->minP,
+			(int) ceil(config->rate / config->crossover));
+	high->gridStep = config->gridStep;
+	high->floatSums = config->floatSums;
+
+	estimatorConfigInit(refine, config->minP, config->maxP);
+	refine->floatSums = config->floatSums;
+
+	if(low->minP < 2 || low->maxP <= low->minP ||
+			high->maxP <= high->minP || high->maxP > config->maxP ||
+			3 * high->maxP > config->window) {
+		return -1;
+	}
+
+	return 0;
+}
+
+void filterWindow(const DspCascade *cascade, const float *x, float *out, int n)
+{
+	/// A copy of the cascade, with an empty state
+	DspCascade filter = *cascade;
+
+	memcpy(out, x, n * sizeof(float));
+	dspCascadeProcess(&filter, out, n);
+}
@@ -0,0 +1,806 @@
+/**
+ * @file capture.c
+ * @brief Record the audio that the detection sees, and its events, to disk.
+ *
+ * @link http://soundfile.sapp.org/doc/WaveFormat/
+ */
+
+#include "capture.h"
+
+// SampleRing, sampleRingCreate, sampleRingWrite, sampleRingPeek
+#include "sample_ring.h"
+
+// Arena, arenaCreate, arenaAlloc, arenaFree, ARENA_ALIGN
+#include "arena.h"
+
+// chromaChordName, CHROMA_NAME_SIZE
+#include "chroma.h"
+
+// INVALID_SEMITONE
+#include "guitar.h"
+
+// flightTriggerName
+#include "flight.h"
+
+// threadSleepMs, threadSetIdlePriority
+#include "thread_utils.h"
+
+// storeLe32, storeFloat
+#include "endian_utils.h"
+
+// fopen, fwrite, fprintf, fseek, fflush, fclose
+#include <stdio.h>
+// malloc, free
+#include <stdlib.h>
+// memcpy, memset, strlen, strcpy, strcat
+#include <string.h>
+// uint32_t
+#include <stdint.h>
+// assert
+#include <assert.h>
+// atomic_size_t, atomic_ulong, atomic_int, atomic_load_explicit
+#include <stdatomic.h>
+// pthread_t, pthread_create, pthread_join
+#include <pthread.h>
+
+/**
+ * @brief The default seconds of audio that can wait for the writer.
+ *
+ * The writer is the first thread to starve when the system is loaded, so it
+ * must be able to catch up on a few of its periods.
+ */
+static const double QUEUE_SECONDS = 2;
+
+/**
+ * @brief The default number of events that can wait for the writer.
+ */
+static const unsigned int QUEUE_EVENTS = 256;
+
+/**
+ * @brief The default sleep of the writer, in milliseconds.
+ */
+static const unsigned int WRITER_SLEEP = 50;
+
+/**
+ * @brief The number of gaps that can wait for the writer.
+ *
+ * Consecutive dropped blocks make a single gap.
+ */
+#define QUEUE_GAPS 64
+
+/**
+ * @brief The maximum number of samples of each write.
+ */
+#define WRITE_CHUNK 4096
+
+/**
+ * @brief The size of the header of the WAV files.
+ */
+#define WAV_HEADER_SIZE 44
+
+/**
+ * @brief A single-producer/single-consumer queue of fixed-size records.
+ *
+ * It is the same scheme of SampleRing, but with copies, because the records
+ * are few and small.
+ */
+typedef struct {
+	/**
+	 * @brief The records, with mask + 1 elements.
+	 */
+	char *items;
+
+	/**
+	 * @brief The size of each record, in bytes.
+	 */
+	size_t itemSize;
+
+	/**
+	 * @brief The number of records minus 1, to wrap the indices.
+	 */
+	size_t mask;
+
+	/**
+	 * @brief The number of records pushed, written only by the producer.
+	 */
+	atomic_size_t writeIndex;
+
+	/**
+	 * @brief The number of records popped, written only by the consumer.
+	 */
+	atomic_size_t readIndex;
+} RecordQueue;
+
+/**
+ * @brief A run of samples that have been dropped.
+ */
+typedef struct {
+	/**
+	 * @brief The position of the first dropped sample in the stream.
+	 */
+	size_t position;
+
+	/**
+	 * @brief The number of dropped samples.
+	 */
+	size_t samples;
+} CaptureGap;
+
+struct _Capture {
+	/**
+	 * @brief The configuration of the capture.
+	 */
+	CaptureConfig config;
+
+	/**
+	 * @brief The arena with this struct and the queues.
+	 */
+	Arena *arena;
+
+	/**
+	 * @brief The samples waiting for the writer.
+	 */
+	SampleRing *ring;
+
+	/**
+	 * @brief The events waiting for the writer.
+	 */
+	RecordQueue events;
+
+	/**
+	 * @brief The gaps waiting for the writer, in order of position.
+	 */
+	RecordQueue gaps;
+
+	/**
+	 * @brief The WAV file.
+	 */
+	FILE *wav;
+
+	/**
+	 * @brief The log of the events.
+	 */
+	FILE *log;
+
+	/**
+	 * @brief The writer thread.
+	 */
+	pthread_t writer;
+
+	/**
+	 * @brief Tells the writer to drain the queues for the last time and to
+	 *  exit.
+	 */
+	atomic_int stop;
+
+	/**
+	 * @brief The position in the stream of the next block.
+	 *
+	 * It is used only by the producer of the samples.
+	 */
+	size_t position;
+
+	/**
+	 * @brief The blocks dropped since the last gap that has been queued.
+	 *
+	 * It is used only by the producer of the samples, which queues the gap
+	 * before the next block that fits, so the gaps and the samples are always
+	 * in order.
+	 */
+	CaptureGap gap;
+
+	/**
+	 * @brief The buffer of the writer to convert the samples to little
+	 *  endian, with WRITE_CHUNK samples.
+	 */
+	unsigned char *chunk;
+
+	/**
+	 * @brief The position in the stream of the next sample that the writer
+	 *  takes, including the gaps and the failed writes.
+	 *
+	 * It is used only by the writer.
+	 */
+	size_t written;
+
+	/**
+	 * @brief The dropped blocks that the writer has already reported.
+	 */
+	unsigned long reportedDrops;
+
+	/**
+	 * @brief The number of blocks that have been queued.
+	 *
+	 * Each counter is updated by a single thread, but they can be read by any.
+	 */
+	atomic_ulong blocks;
+
+	/**
+	 * @brief The number of blocks that have been dropped.
+	 */
+	atomic_ulong droppedBlocks;
+
+	/**
+	 * @brief The number of samples of the dropped blocks.
+	 */
+	atomic_ulong droppedSamples;
+
+	/**
+	 * @brief The number of events that have been queued.
+	 */
+	atomic_ulong queuedEvents;
+
+	/**
+	 * @brief The number of events that have been dropped.
+	 */
+	atomic_ulong droppedEvents;
+
+	/**
+	 * @brief The number of samples written to the file.
+	 */
+	atomic_ulong writtenSamples;
+
+	/**
+	 * @brief The number of failed writes.
+	 */
+	atomic_ulong writeErrors;
+};
+
+/**
+ * @brief Get the memory of the records of a queue.
+ *
+ * @param count The minimum number of records
+ * @param itemSize The size of each record
+ * @return The size in bytes, including the alignment padding
+ */
+static size_t queueMemorySize(size_t count, size_t itemSize);
+
+/**
+ * @brief Initialize a queue with its records in an arena.
+ *
+ * @param queue The queue
+ * @param arena The arena, with at least queueMemorySize bytes available
+ * @param count The minimum number of records
+ * @param itemSize The size of each record
+ */
+static void queueInit(RecordQueue *queue, Arena *arena, size_t count,
+		size_t itemSize);
+
+/**
+ * @brief Copy a record to the queue.
+ * @note This function must be called only by the producer.
+ *
+ * @param queue The queue
+ * @param item The record
+ * @return 1 if the record has been queued, 0 if the queue is full
+ */
+static int queuePush(RecordQueue *queue, const void *item);
+
+/**
+ * @brief Copy the oldest record of the queue, without removing it.
+ * @note This function must be called only by the consumer.
+ *
+ * @param queue The queue
+ * @param item Output parameter for the record
+ * @return 1 if a record has been copied, 0 if the queue is empty
+ */
+static int queuePeek(RecordQueue *queue, void *item);
+
+/**
+ * @brief Remove the oldest record of the queue.
+ * @note This function must be called only by the consumer, after a successful
+ *  queuePeek.
+ *
+ * @param queue The queue
+ */
+static void queueDrop(RecordQueue *queue);
+
+/**
+ * @brief The main function of the writer thread.
+ *
+ * @param arg The capture
+ * @return Always null
+ */
+static void *writerMain(void *arg);
+
+/**
+ * @brief Write to disk everything that is in the queues.
+ *
+ * @param capture The capture
+ */
+static void drain(Capture *capture);
+
+/**
+ * @brief Write samples to the WAV file, as 32 bits little endian floats.
+ *
+ * @param capture The capture
+ * @param samples The samples, or null to write silence
+ * @param count The number of samples
+ */
+static void writeSamples(Capture *capture, const float *samples, size_t count);
+
+/**
+ * @brief Write the header of the WAV file, with the samples written until
+ *  now, and go back to the end of the file.
+ *
+ * @param capture The capture
+ */
+static void writeHeader(Capture *capture);
+
+/**
+ * @brief Open a file whose name is a path and an extension.
+ *
+ * @param path The path
+ * @param extension The extension, with the dot
+ * @return The file, open for writing, or 0 in case of error
+ */
+static FILE *openFile(const char *path, const char *extension);
+
+
+void captureConfigInit(CaptureConfig *config, unsigned int rate)
+{
+	assert(config);
+
+	config->rate = rate;
+	config->capacity = (size_t) (QUEUE_SECONDS * rate);
+	config->events = QUEUE_EVENTS;
+	config->writerSleep = WRITER_SLEEP;
+}
+
+Capture *captureStart(const CaptureConfig *config, const char *path)
+{
+	if(!config || !config->rate || !config->capacity || !config->events ||
+			!path) {
+		return 0;
+	}
+
+	/// The arena for the capture and its queues
+	Arena *arena;
+	/// The instance that will be returned
+	Capture *ret;
+
+	arena = arenaCreate(ARENA_ALIGN(sizeof(Capture)) +
+			queueMemorySize(config->events, sizeof(DetectEvent)) +
+			queueMemorySize(QUEUE_GAPS, sizeof(CaptureGap)) +
+			ARENA_ALIGN(WRITE_CHUNK * sizeof(float)));
+	if(!arena) {
+		fprintf(stderr, "Could not allocate the memory for the capture.\n");
+		return 0;
+	}
+
+	// The arena has been sized for these allocations, so they cannot fail
+	ret = (Capture *) arenaAlloc(arena, sizeof(Capture));
+	ret->arena = arena;
+	ret->config = *config;
+	queueInit(&ret->events, arena, config->events, sizeof(DetectEvent));
+	queueInit(&ret->gaps, arena, QUEUE_GAPS, sizeof(CaptureGap));
+	ret->chunk = arenaAlloc(arena, WRITE_CHUNK * sizeof(float));
+	assert(ret->chunk);
+
+	ret->position = 0;
+	ret->gap.position = 0;
+	ret->gap.samples = 0;
+	ret->written = 0;
+	ret->reportedDrops = 0;
+	atomic_init(&ret->stop, 0);
+	atomic_init(&ret->blocks, 0);
+	atomic_init(&ret->droppedBlocks, 0);
+	atomic_init(&ret->droppedSamples, 0);
+	atomic_init(&ret->queuedEvents, 0);
+	atomic_init(&ret->droppedEvents, 0);
+	atomic_init(&ret->writtenSamples, 0);
+	atomic_init(&ret->writeErrors, 0);
+
+	ret->ring = sampleRingCreate(config->capacity);
+	ret->wav = openFile(path, ".wav");
+	ret->log = openFile(path, ".log");
+
+	if(ret->ring && ret->wav && ret->log) {
+		writeHeader(ret);
+		fprintf(ret->log, "# %u Hz, the positions are in samples\n",
+				config->rate);
+
+		if(!pthread_create(&ret->writer, 0, writerMain, ret)) {
+			return ret;
+		}
+		fprintf(stderr, "Could not start the writer of the capture.\n");
+	} else {
+		fprintf(stderr, "Could not open the files of the capture %s.\n",
+				path);
+	}
+
+	sampleRingFree(ret->ring);
+	if(ret->wav) {
+		fclose(ret->wav);
+	}
+	if(ret->log) {
+		fclose(ret->log);
+	}
+	arenaFree(arena);
+
+	return 0;
+}
+
+void captureStop(Capture *capture, CaptureStats *stats)
+{
+	if(!capture) {
+		return;
+	}
+
+	atomic_store_explicit(&capture->stop, 1, memory_order_release);
+	pthread_join(capture->writer, 0);
+
+	// The producers have stopped, so the last gap won't be followed by samples
+	if(capture->gap.samples) {
+		fprintf(capture->log, "%zu dropped %zu\n", capture->gap.position,
+				capture->gap.samples);
+		writeSamples(capture, 0, capture->gap.samples);
+	}
+
+	writeHeader(capture);
+	if(fclose(capture->wav) || fclose(capture->log)) {
+		atomic_fetch_add_explicit(&capture->writeErrors, 1,
+				memory_order_relaxed);
+	}
+
+	if(stats) {
+		captureGetStats(capture, stats);
+	}
+
+	sampleRingFree(capture->ring);
+	// The capture itself is in the arena
+	arenaFree(capture->arena);
+}
+
+int captureWrite(Capture *capture, const float *samples, size_t count)
+{
+	assert(capture);
+
+	/// Whether the block can be queued
+	int fits = sampleRingFreeCount(capture->ring) >= count;
+
+	// The silence must be written before the samples that follow it
+	if(fits && capture->gap.samples) {
+		fits = queuePush(&capture->gaps, &capture->gap);
+		if(fits) {
+			capture->gap.samples = 0;
+		}
+	}
+
+	if(!fits) {
+		if(!capture->gap.samples) {
+			capture->gap.position = capture->position;
+		}
+		capture->gap.samples += count;
+		capture->position += count;
+
+		atomic_fetch_add_explicit(&capture->droppedBlocks, 1,
+				memory_order_relaxed);
+		atomic_fetch_add_explicit(&capture->droppedSamples, count,
+				memory_order_relaxed);
+		return 0;
+	}
+
+	sampleRingWrite(capture->ring, samples, count);
+	capture->position += count;
+	atomic_fetch_add_explicit(&capture->blocks, 1, memory_order_relaxed);
+
+	return 1;
+}
+
+int captureEvent(Capture *capture, const DetectEvent *event)
+{
+	assert(capture);
+	assert(event);
+
+	if(!queuePush(&capture->events, event)) {
+		atomic_fetch_add_explicit(&capture->droppedEvents, 1,
+				memory_order_relaxed);
+		return 0;
+	}
+
+	atomic_fetch_add_explicit(&capture->queuedEvents, 1,
+			memory_order_relaxed);
+	return 1;
+}
+
+void captureGetStats(Capture *capture, CaptureStats *stats)
+{
+	assert(capture);
+	assert(stats);
+
+	stats->blocks = atomic_load_explicit(&capture->blocks,
+			memory_order_relaxed);
+	stats->droppedBlocks = atomic_load_explicit(&capture->droppedBlocks,
+			memory_order_relaxed);
+	stats->droppedSamples = atomic_load_explicit(&capture->droppedSamples,
+			memory_order_relaxed);
+	stats->events = atomic_load_explicit(&capture->queuedEvents,
+			memory_order_relaxed);
+	stats->droppedEvents = atomic_load_explicit(&capture->droppedEvents,
+			memory_order_relaxed);
+	stats->writtenSamples = atomic_load_explicit(&capture->writtenSamples,
+			memory_order_relaxed);
+	stats->writeErrors = atomic_load_explicit(&capture->writeErrors,
+			memory_order_relaxed);
+}
+
+size_t queueMemorySize(size_t count, size_t itemSize)
+{
+	size_t pow2 = 1;
+	while(pow2 < count) {
+		pow2 <<= 1;
+	}
+
+	return ARENA_ALIGN(pow2 * itemSize);
+}
+
+void queueInit(RecordQueue *queue, Arena *arena, size_t count,
+		size_t itemSize)
+{
+	size_t pow2 = 1;
+	while(pow2 < count) {
+		pow2 <<= 1;
+	}
+
+	queue->items = arenaAlloc(arena, pow2 * itemSize);
+	assert(queue->items);
+	queue->itemSize = itemSize;
+	queue->mask = pow2 - 1;
+	atomic_init(&queue->writeIndex, 0);
+	atomic_init(&queue->readIndex, 0);
+}
+
+int queuePush(RecordQueue *queue, const void *item)
+{
+	size_t write = atomic_load_explicit(&queue->writeIndex,
+			memory_order_relaxed);
+	size_t read = atomic_load_explicit(&queue->readIndex,
+			memory_order_acquire);
+
+	if(write - read > queue->mask) {
+		return 0;
+	}
+
+	memcpy(queue->items + (write & queue->mask) * queue->itemSize, item,
+			queue->itemSize);
+
+	// Release: the record must be visible before the index
+	atomic_store_explicit(&queue->writeIndex, write + 1,
+			memory_order_release);
+
+	return 1;
+}
+
+int queuePeek(RecordQueue *queue, void *item)
+{
+	size_t read = atomic_load_explicit(&queue->readIndex,
+			memory_order_relaxed);
+	size_t write = atomic_load_explicit(&queue->writeIndex,
+			memory_order_acquire);
+
+	if(read == write) {
+		return 0;
+	}
+
+	memcpy(item, queue->items + (read & queue->mask) * queue->itemSize,
+			queue->itemSize);
+
+	return 1;
+}
+
+void queueDrop(RecordQueue *queue)
+{
+	size_t read = atomic_load_explicit(&queue->readIndex,
+			memory_order_relaxed);
+
+	// Release: the record must have been copied before it is overwritten
+	atomic_store_explicit(&queue->readIndex, read + 1, memory_order_release);
+}
+
+void *writerMain(void *arg)
+{
+	Capture *capture = (Capture *) arg;
+
+	// If the writer starves, the blocks are dropped and counted
+	threadSetIdlePriority();
+
+	while(!atomic_load_explicit(&capture->stop, memory_order_acquire)) {
+		drain(capture);
+		threadSleepMs(capture->config.writerSleep);
+	}
+
+	// The producers have stopped, so this is everything that is left
+	drain(capture);
+
+	return 0;
+}
+
+void drain(Capture *capture)
+{
+	/// The samples waiting for the writer
+	size_t available;
+	/// The first sample waiting for the writer
+	const float *samples = sampleRingPeek(capture->ring, &available);
+	/// The next gap
+	CaptureGap gap;
+	/// Whether there is a gap in the queue
+	int hasGap = queuePeek(&capture->gaps, &gap);
+	/// The event being logged
+	DetectEvent event;
+	/// The dropped blocks until now
+	unsigned long drops;
+
+	for(;;) {
+		if(hasGap && gap.position <= capture->written) {
+			fprintf(capture->log, "%zu dropped %zu\n", gap.position,
+					gap.samples);
+			writeSamples(capture, 0, gap.samples);
+			capture->written += gap.samples;
+			queueDrop(&capture->gaps);
+			hasGap = queuePeek(&capture->gaps, &gap);
+			continue;
+		}
+
+		/* The samples before the gap may have been queued after the peek:
+		they will be written in the next drain. */
+		if(!available) {
+			break;
+		}
+
+		size_t n = available < WRITE_CHUNK ? available : WRITE_CHUNK;
+		if(hasGap && gap.position - capture->written < n) {
+			n = gap.position - capture->written;
+		}
+
+		writeSamples(capture, samples, n);
+		sampleRingConsume(capture->ring, n);
+		samples += n;
+		available -= n;
+		capture->written += n;
+	}
+
+	while(queuePeek(&capture->events, &event)) {
+		captureLogEvent(capture->log, &event);
+		queueDrop(&capture->events);
+	}
+
+	/* Keep the header up to date, so that the file can be read even if the
+	program doesn't stop cleanly. */
+	writeHeader(capture);
+	fflush(capture->log);
+
+	drops = atomic_load_explicit(&capture->droppedBlocks,
+			memory_order_relaxed);
+	if(drops > capture->reportedDrops) {
+		fprintf(stderr, "The capture dropped %lu blocks, the disk is too "
+				"slow.\n", drops - capture->reportedDrops);
+		capture->reportedDrops = drops;
+	}
+}
+
+void writeSamples(Capture *capture, const float *samples, size_t count)
+{
+	while(count) {
+		size_t n = count < WRITE_CHUNK ? count : WRITE_CHUNK;
+
+		if(samples) {
+			for(size_t i = 0; i < n; i++) {
+				storeFloat(capture->chunk + i * sizeof(float), samples[i]);
+			}
+			samples += n;
+		} else {
+			memset(capture->chunk, 0, n * sizeof(float));
+		}
+
+		if(fwrite(capture->chunk, sizeof(float), n, capture->wav) == n) {
+			atomic_fetch_add_explicit(&capture->writtenSamples, n,
+					memory_order_relaxed);
+		} else {
+			atomic_fetch_add_explicit(&capture->writeErrors, 1,
+					memory_order_relaxed);
+		}
+
+		count -= n;
+	}
+}
+
+void writeHeader(Capture *capture)
+{
+	/// The header
+	unsigned char header[WAV_HEADER_SIZE];
+	/// The size of the samples, in bytes
+	uint32_t dataSize = (uint32_t) (atomic_load_explicit(
+			&capture->writtenSamples, memory_order_relaxed) * sizeof(float));
+
+	memcpy(header, "RIFF", 4);
+	storeLe32(header + 4, WAV_HEADER_SIZE - 8 + dataSize);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	storeLe32(header + 16, 16);
+	// IEEE float, 1 channel
+	storeLe32(header + 20, 3 | 1 << 16);
+	storeLe32(header + 24, capture->config.rate);
+	storeLe32(header + 28, capture->config.rate * sizeof(float));
+	// The size of a frame, and the bits of a sample
+	storeLe32(header + 32, sizeof(float) | 32 << 16);
+	memcpy(header + 36, "data", 4);
+	storeLe32(header + 40, dataSize);
+
+	if(fseek(capture->wav, 0, SEEK_SET) ||
+			fwrite(header, 1, WAV_HEADER_SIZE, capture->wav) !=
+			WAV_HEADER_SIZE || fseek(capture->wav, 0, SEEK_END) ||
+			fflush(capture->wav)) {
+		atomic_fetch_add_explicit(&capture->writeErrors, 1,
+				memory_order_relaxed);
+	}
+}
+
+void captureLogEvent(FILE *log, const DetectEvent *event)
+{
+	/// The name of a chord
+	char name[CHROMA_NAME_SIZE];
+
+	fprintf(log, "%zu ", event->position);
+
+	switch(event->type) {
+		case DETECT_EVENT_NOTE:
+			fprintf(log, "note %d %.2f\n", event->note, event->frequency);
+			break;
+
+		case DETECT_EVENT_SILENCE:
+			fprintf(log, "silence\n");
+			break;
+
+		case DETECT_EVENT_TIER:
+			fprintf(log, "tier %d\n", event->tier);
+			break;
+
+		case DETECT_EVENT_IDLE:
+			fprintf(log, "idle\n");
+			break;
+
+		case DETECT_EVENT_ACTIVE:
+			fprintf(log, "active\n");
+			break;
+
+		case DETECT_EVENT_NOTES:
+			fprintf(log, "notes");
+			for(unsigned int i = 0; i < event->count; i++) {
+				fprintf(log, " %d", event->notes[i].note);
+			}
+			fprintf(log, "\n");
+			break;
+
+		case DETECT_EVENT_CHORD:
+			if(event->chord.root == INVALID_SEMITONE) {
+				fprintf(log, "chord -\n");
+			} else {
+				chromaChordName(&event->chord, name);
+				fprintf(log, "chord %s %.3f\n", name, event->chord.score);
+			}
+			break;
+
+		case DETECT_EVENT_ANOMALY:
+			fprintf(log, "anomaly %s\n", flightTriggerName(event->trigger));
+			break;
+	}
+}
+
+FILE *openFile(const char *path, const char *extension)
+{
+	/// The name of the file
+	char *name = malloc(strlen(path) + strlen(extension) + 1);
+	/// The file
+	FILE *fp;
+
+	if(!name) {
+		return 0;
+	}
+
+	strcpy(name, path);
+	strcat(name, extension);
+	fp = fopen(name, "wb");
+	free(name);
+
+	return fp;
+}
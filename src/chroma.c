@@ -0,0 +1,464 @@
+/**
+ * @file chroma.c
+ * @brief Recognize the chords by their pitch classes.
+ */
+
+#include "chroma.h"
+
+// dspFftTwiddles, dspFft
+#include "dsp.h"
+
+// cos, log2, floor, sqrt, sqrtf, M_PI
+#include <math.h>
+
+// snprintf
+#include <stdio.h>
+
+// assert
+#include <assert.h>
+
+/**
+ * @brief The default duration of the window, in seconds.
+ *
+ * The window is the largest power of two that is not longer.
+ */
+static const double WINDOW_SECONDS = 0.1;
+
+/**
+ * @brief The default lowest frequency, about G2.
+ *
+ * The bins of the default window are wider than a semitone below it, so the
+ * fundamentals of the lowest notes are left out, but their harmonics are
+ * folded anyway.
+ */
+static const double LOWEST_FREQUENCY = 100;
+
+/**
+ * @brief The default highest frequency, in Hz.
+ */
+static const double HIGHEST_FREQUENCY = 2000;
+
+/**
+ * @brief The default smoothing of the chroma vector.
+ * @sa ChromaConfig.smoothing
+ */
+static const double SMOOTHING = 0.5;
+
+/**
+ * @brief The default minimum score.
+ * @sa ChromaConfig.minScore
+ */
+static const double MIN_SCORE = 0.8;
+
+/**
+ * @brief The maximum number of pitch classes of a chord.
+ */
+#define CHORD_NOTES 4
+
+/**
+ * @brief The intervals of the chords from their root, in semitones.
+ *
+ * The elements after the last note of a chord are -1.
+ */
+static const semitone_t INTERVALS[CHROMA_KINDS][CHORD_NOTES] = {
+	{0, 4, 7, -1},
+	{0, 3, 7, -1},
+	{0, 4, 7, 10},
+	{0, 3, 7, 10},
+};
+
+/**
+ * @brief The suffixes of the names of the chords.
+ */
+static const char *SUFFIXES[CHROMA_KINDS] = {"", "m", "7", "m7"};
+
+/**
+ * @brief The names of the pitch classes, from A.
+ */
+static const char *CLASS_NAMES[CHROMA_CLASSES] = {
+	"A", "A#", "B", "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#"
+};
+
+/**
+ * @brief The harmonics of each note of the templates.
+ *
+ * The third harmonic of the root is the fifth, and its fifth harmonic is the
+ * major third, so the templates include them, otherwise the minor chords
+ * would look like major ones.
+ * @link Gomez, "Tonal description of polyphonic audio for music content
+ *  processing", 2006
+ */
+static const int TEMPLATE_HARMONICS = 6;
+
+/**
+ * @brief The ratio between the weights of two consecutive harmonics of the
+ *  templates.
+ */
+static const double TEMPLATE_DECAY = 0.6;
+
+/**
+ * @brief The frets of a shape that are searched after its position.
+ */
+static const int SHAPE_FRETS = 4;
+
+struct _ChromaEstimator {
+	/**
+	 * @brief The configuration of the estimator.
+	 */
+	ChromaConfig config;
+
+	/**
+	 * @brief The Hann window, with config.window elements.
+	 */
+	float *hann;
+
+	/**
+	 * @brief The twiddle factors of the transform.
+	 */
+	float *twiddles;
+
+	/**
+	 * @brief The real part of the transform, with config.window elements.
+	 */
+	float *re;
+
+	/**
+	 * @brief The imaginary part of the transform, with config.window
+	 *  elements.
+	 */
+	float *im;
+
+	/**
+	 * @brief The first bin that is folded.
+	 */
+	int firstBin;
+
+	/**
+	 * @brief The number of bins that are folded.
+	 */
+	int bins;
+
+	/**
+	 * @brief The pitch class of each folded bin.
+	 */
+	unsigned char *classes;
+
+	/**
+	 * @brief The smoothed chroma vector.
+	 */
+	float chroma[CHROMA_CLASSES];
+
+	/**
+	 * @brief The template of each kind of chord with the root in the pitch
+	 *  class 0, normalized.
+	 */
+	float templates[CHROMA_KINDS][CHROMA_CLASSES];
+};
+
+/**
+ * @brief Tell whether a pitch class belongs to a chord.
+ *
+ * @param chord The chord
+ * @param pitchClass The pitch class, from 0 to 11
+ * @return The index of the note in the intervals of the chord, or -1
+ */
+static int chordNote(const ChromaChord *chord, int pitchClass);
+
+void chromaConfigInit(ChromaConfig *config, unsigned int rate)
+{
+	assert(config);
+
+	config->rate = rate;
+
+	config->window = 1;
+	while(2 * config->window <= rate * WINDOW_SECONDS) {
+		config->window *= 2;
+	}
+
+	config->lowest = LOWEST_FREQUENCY;
+	config->highest = HIGHEST_FREQUENCY;
+	config->smoothing = SMOOTHING;
+	config->minScore = MIN_SCORE;
+	config->reference = QUANTIZER_STANDARD_REFERENCE;
+}
+
+size_t chromaMemorySize(const ChromaConfig *config)
+{
+	assert(config);
+
+	if(!config->rate || config->window < 2 ||
+			(config->window & (config->window - 1)) ||
+			!(config->lowest > 0) || !(config->highest > config->lowest) ||
+			!(config->highest < config->rate / 2.0) ||
+			!(config->smoothing >= 0 && config->smoothing < 1) ||
+			!(config->reference > 0)) {
+		return 0;
+	}
+
+	return ARENA_ALIGN(sizeof(ChromaEstimator)) +
+			ARENA_ALIGN(config->window * sizeof(float)) +
+			ARENA_ALIGN(2 * config->window * sizeof(float)) +
+			2 * ARENA_ALIGN(config->window * sizeof(float)) +
+			ARENA_ALIGN(config->window / 2);
+}
+
+ChromaEstimator *chromaCreate(Arena *arena, const ChromaConfig *config)
+{
+	assert(arena);
+	assert(config);
+
+	/// The instance that will be returned
+	ChromaEstimator *ret;
+	/// The frequency of a bin
+	double binHz;
+	/// The frequency of A0, the pitch class 0
+	double a0;
+
+	if(!chromaMemorySize(config)) {
+		return 0;
+	}
+
+	ret = arenaAlloc(arena, sizeof(ChromaEstimator));
+	if(!ret) {
+		return 0;
+	}
+
+	ret->config = *config;
+
+	binHz = config->rate / (double) config->window;
+	a0 = config->reference / 16;
+	ret->firstBin = (int) ceil(config->lowest / binHz);
+	ret->bins = (int) floor(config->highest / binHz) - ret->firstBin + 1;
+
+	ret->hann = arenaAlloc(arena, config->window * sizeof(float));
+	ret->twiddles = arenaAlloc(arena, 2 * config->window * sizeof(float));
+	ret->re = arenaAlloc(arena, config->window * sizeof(float));
+	ret->im = arenaAlloc(arena, config->window * sizeof(float));
+	ret->classes = arenaAlloc(arena, config->window / 2);
+	if(!ret->hann || !ret->twiddles || !ret->re || !ret->im ||
+			!ret->classes) {
+		return 0;
+	}
+
+	for(int i = 0; i < config->window; i++) {
+		ret->hann[i] = (float) (0.5 - 0.5 * cos(2 * M_PI * i /
+				(config->window - 1)));
+	}
+
+	dspFftTwiddles(ret->twiddles, config->window);
+
+	for(int k = 0; k < ret->bins; k++) {
+		/// The nearest semitone from A0, negative below it
+		int semitone = (int) floor(12 * log2((ret->firstBin + k) * binHz /
+				a0) + 0.5);
+		ret->classes[k] = (unsigned char) (((semitone % CHROMA_CLASSES) +
+				CHROMA_CLASSES) % CHROMA_CLASSES);
+	}
+
+	for(int kind = 0; kind < CHROMA_KINDS; kind++) {
+		/// The norm of the template
+		double norm = 0;
+
+		for(int c = 0; c < CHROMA_CLASSES; c++) {
+			ret->templates[kind][c] = 0;
+		}
+
+		for(int i = 0; i < CHORD_NOTES && INTERVALS[kind][i] >= 0; i++) {
+			double weight = 1;
+			for(int h = 1; h <= TEMPLATE_HARMONICS; h++) {
+				int semitones = (int) floor(12 * log2(h) + 0.5);
+				ret->templates[kind][(INTERVALS[kind][i] + semitones) %
+						CHROMA_CLASSES] += (float) weight;
+				weight *= TEMPLATE_DECAY;
+			}
+		}
+
+		for(int c = 0; c < CHROMA_CLASSES; c++) {
+			norm += ret->templates[kind][c] * ret->templates[kind][c];
+		}
+		for(int c = 0; c < CHROMA_CLASSES; c++) {
+			ret->templates[kind][c] /= (float) sqrt(norm);
+		}
+	}
+
+	chromaReset(ret);
+
+	return ret;
+}
+
+int chromaRun(ChromaEstimator *estimator, const float *x, ChromaChord *chord)
+{
+	assert(estimator);
+	assert(x);
+	assert(chord);
+
+	/// The window
+	int n = estimator->config.window;
+	/// The chroma vector of this window
+	float current[CHROMA_CLASSES] = {0};
+	/// The sum of the chroma vector of this window
+	float total = 0;
+	/// The norm of the smoothed chroma vector
+	float norm = 0;
+	/// The last folded bin
+	int last = estimator->firstBin + estimator->bins - 1;
+
+	for(int i = 0; i < n; i++) {
+		estimator->re[i] = x[i] * estimator->hann[i];
+		estimator->im[i] = 0;
+	}
+
+	dspFft(estimator->re, estimator->im, estimator->twiddles, n);
+
+	// The power of the folded bins and of their neighbours, in place
+	for(int b = estimator->firstBin - 1; b <= last + 1; b++) {
+		estimator->re[b] = estimator->re[b] * estimator->re[b] +
+				estimator->im[b] * estimator->im[b];
+	}
+
+	/* Only the peaks are folded, otherwise the main lobes of the low partials,
+	which are wider than a semitone, would spread on the near classes. */
+	for(int k = 0; k < estimator->bins; k++) {
+		const float *power = estimator->re + estimator->firstBin + k;
+		if(power[0] >= power[-1] && power[0] >= power[1]) {
+			current[estimator->classes[k]] += sqrtf(power[0]);
+		}
+	}
+
+	for(int c = 0; c < CHROMA_CLASSES; c++) {
+		total += current[c];
+	}
+
+	// Each window has the same weight, whatever its level
+	for(int c = 0; c < CHROMA_CLASSES; c++) {
+		float value = total > 0 ? current[c] / total : 0;
+		estimator->chroma[c] = (float) (estimator->config.smoothing *
+				estimator->chroma[c] + (1 - estimator->config.smoothing) *
+				value);
+		norm += estimator->chroma[c] * estimator->chroma[c];
+	}
+	norm = sqrtf(norm);
+
+	chord->root = 0;
+	chord->kind = CHROMA_MAJOR;
+	chord->score = 0;
+
+	if(!(norm > 0)) {
+		return 0;
+	}
+
+	for(int kind = 0; kind < CHROMA_KINDS; kind++) {
+		for(int root = 0; root < CHROMA_CLASSES; root++) {
+			/// The cosine between the chroma vector and the template
+			double score = 0;
+
+			for(int c = 0; c < CHROMA_CLASSES; c++) {
+				score += estimator->chroma[(root + c) % CHROMA_CLASSES] *
+						estimator->templates[kind][c];
+			}
+			score /= norm;
+
+			if(score > chord->score) {
+				chord->root = (semitone_t) root;
+				chord->kind = (ChromaKind) kind;
+				chord->score = score;
+			}
+		}
+	}
+
+	return chord->score >= estimator->config.minScore;
+}
+
+void chromaReset(ChromaEstimator *estimator)
+{
+	assert(estimator);
+
+	for(int c = 0; c < CHROMA_CLASSES; c++) {
+		estimator->chroma[c] = 0;
+	}
+}
+
+void chromaChordName(const ChromaChord *chord, char *name)
+{
+	assert(chord);
+	assert(name);
+	assert(chord->root >= 0 && chord->root < CHROMA_CLASSES);
+	assert(chord->kind < CHROMA_KINDS);
+
+	snprintf(name, CHROMA_NAME_SIZE, "%s%s", CLASS_NAMES[chord->root],
+			SUFFIXES[chord->kind]);
+}
+
+unsigned int chromaShape(const Tuning *tuning, const ChromaChord *chord,
+		semitone_t *frets)
+{
+	assert(tuning);
+	assert(chord);
+	assert(frets);
+
+	for(int position = 1; position + SHAPE_FRETS - 1 <= (int) tuning->frets;
+			position++) {
+		/// The notes of the chord that are played, as a mask
+		unsigned int played = 0;
+		/// The number of strings played
+		unsigned int strings = 0;
+		/// Whether the lowest string played is the root
+		int rooted = 0;
+
+		// From the lowest string, so the ones below the root are muted
+		for(int s = (int) tuning->strings - 1; s >= 0; s--) {
+			frets[s] = -1;
+
+			for(int fret = 0; fret < position + SHAPE_FRETS; fret++) {
+				// The open string, then the frets of the position
+				if(fret && fret < position) {
+					continue;
+				}
+
+				int note = chordNote(chord, (tuning->open[s] + fret) %
+						CHROMA_CLASSES);
+				if(note < 0 || (!rooted && note)) {
+					continue;
+				}
+
+				frets[s] = (semitone_t) fret;
+				played |= 1u << note;
+				rooted = 1;
+				strings++;
+				break;
+			}
+		}
+
+		for(unsigned int s = tuning->strings; s < GUITAR_MAX_STRINGS; s++) {
+			frets[s] = -1;
+		}
+
+		/// The mask of all the notes of the chord
+		unsigned int all = 0;
+		for(int i = 0; i < CHORD_NOTES && INTERVALS[chord->kind][i] >= 0; i++) {
+			all |= 1u << i;
+		}
+
+		if(played == all && strings >= 3) {
+			return strings;
+		}
+	}
+
+	for(unsigned int s = 0; s < GUITAR_MAX_STRINGS; s++) {
+		frets[s] = -1;
+	}
+
+	return 0;
+}
+
+static int chordNote(const ChromaChord *chord, int pitchClass)
+{
+	for(int i = 0; i < CHORD_NOTES && INTERVALS[chord->kind][i] >= 0; i++) {
+		if((chord->root + INTERVALS[chord->kind][i]) % CHROMA_CLASSES ==
+				pitchClass) {
+			return i;
+		}
+	}
+
+	return -1;
+}
@@ -5,16 +5,53 @@
 
 #include "detect.h"
 
-// semitone_t, noteToFrequency, GUITAR_STRINGS
+// semitone_t, noteToFrequency, Tuning, tuningInit, tuningLookup, Quantizer,
+// quantizerInit, quantize
 #include "guitar.h"
 
-// estimatePeriod
+// PeriodEstimator, estimatorRun
 #include "period_estimator.h"
 
-// malloc, free
+// BandEstimator, bandCreate, bandRun
+#include "band_estimator.h"
+
+// FixedEstimator, fixedCreate, fixedRun, fixedFromFloat, FIXED_PERIOD_SHIFT,
+// FIXED_NAC_SHIFT
+#include "fixed_estimator.h"
+
+// PolyEstimator, polyCreate, polyRun, polyAssignStrings
+#include "poly.h"
+
+// ChromaEstimator, chromaCreate, chromaRun, chromaReset, chromaShape
+#include "chroma.h"
+
+// FlightRecorder, FlightHeader, flightCreate, flightAudio, flightRecord,
+// flightDump
+#include "flight.h"
+
+// HwCounters, hwCountersOpen, hwCountersClose, hwStageInit, hwStageBegin,
+// hwStageEnd
+#include "hw_counters.h"
+
+// Arena, arenaCreate, arenaAlloc
+#include "arena.h"
+
+// Governor, governorInit, governorUpdate
+#include "governor.h"
+
+// timeNow
+#include "timing.h"
+
+// Preprocessor, preprocessInit, preprocessBlock, preprocessGate
+#include "preprocess.h"
+
+// abs
 #include <stdlib.h>
 
-// floor, ceil, isfinite
+// memcpy
+#include <string.h>
+
+// floor, ceil, sqrt, isfinite, isnan, ldexp, INFINITY
 #include <math.h>
 
 // assert
@@ -23,9 +60,6 @@
 // printf
 #include <stdio.h>
 
-// guiHighlightFrets, guiResetHighlights
-#include "gui.h"
-
 /**
  * @brief Enable printing information about data filtering?
  */
@@ -37,14 +71,109 @@
 #	define FILTER_PRINTF(...) ;
 #endif
 
-/**
- * @brief The number of amplitude peaks to keep in memory.
- *
- *
- */
-#define PEAKS_SIZE 100
-
 struct _DetectContext {
+	/**
+	 * @brief The arena that contains the context and all its buffers.
+	 *
+	 * It is created by detectInit, with the size needed by the configuration,
+	 * so that the analysis never needs to allocate memory.
+	 */
+	Arena *arena;
+
+	/**
+	 * @brief The configuration of the detection.
+	 */
+	DetectConfig config;
+
+	/**
+	 * @brief The period estimator.
+	 */
+	PeriodEstimator *estimator;
+
+	/**
+	 * @brief The period estimator for the decimated signal.
+	 * @sa DETECT_TIER_DECIMATED
+	 */
+	PeriodEstimator *decimatedEstimator;
+
+	/**
+	 * @brief The band-split estimator for the full tiers, or null if it is
+	 *  disabled.
+	 * @sa DetectConfig.bands
+	 */
+	BandEstimator *bands;
+
+	/**
+	 * @brief The fixed-point estimator for the full tiers, or null if it is
+	 *  disabled.
+	 * @sa DetectConfig.fixedPoint
+	 */
+	FixedEstimator *fixed;
+
+	/**
+	 * @brief The window converted to Q15 for the fixed-point estimator.
+	 */
+	int16_t *fixedWindow;
+
+	/**
+	 * @brief The chord estimator, or null if it is disabled.
+	 * @sa DetectConfig.polyphony
+	 */
+	PolyEstimator *poly;
+
+	/**
+	 * @brief The chord recognizer, or null if it is disabled.
+	 * @sa DetectConfig.chords
+	 */
+	ChromaEstimator *chroma;
+
+	/**
+	 * @brief The flight recorder, or null if it is disabled.
+	 * @sa DetectConfig.flightSeconds
+	 */
+	FlightRecorder *flight;
+
+	/**
+	 * @brief The record of the window being analyzed.
+	 *
+	 * The analysis functions fill it, and it is added to the flight recorder
+	 * when the window is complete.
+	 */
+	FlightRecord record;
+
+	/**
+	 * @brief The samples after the last DETECT_EVENT_ANOMALY event before
+	 *  another one can be generated.
+	 */
+	size_t anomalyInterval;
+
+	/**
+	 * @brief The position of the last DETECT_EVENT_ANOMALY event.
+	 */
+	size_t lastAnomaly;
+
+	/**
+	 * @brief Whether a DETECT_EVENT_ANOMALY event has been generated.
+	 */
+	int anomalyReported;
+
+	/**
+	 * @brief The buffer for the decimated window.
+	 *
+	 * It has window / 2 elements.
+	 */
+	float *decimated;
+
+	/**
+	 * @brief The tuning of the instrument, with the positions of its notes.
+	 */
+	Tuning tuning;
+
+	/**
+	 * @brief The table to convert the frequencies to notes.
+	 */
+	Quantizer quantizer;
+
 	/**
 	 * @brief The sample rate
 	 *
@@ -64,27 +193,88 @@ struct _DetectContext {
 	 */
 	int maxPeriod;
 
+	/**
+	 * @brief The number of samples of each analysis window.
+	 */
+	int window;
+
+	/**
+	 * @brief The number of samples of the windows of the chords, or 0 if
+	 *  their detection is disabled.
+	 */
+	int polyWindow;
+
+	/**
+	 * @brief The notes of the last DETECT_EVENT_NOTES event.
+	 */
+	PolyNote chord[POLY_MAX_NOTES];
+
+	/**
+	 * @brief The number of notes of the last DETECT_EVENT_NOTES event.
+	 */
+	unsigned int chordCount;
+
+	/**
+	 * @brief The number of samples of the windows of the chord recognizer, or
+	 *  0 if it is disabled.
+	 */
+	int chromaWindow;
+
+	/**
+	 * @brief The longest of the windows, which all end at the same sample.
+	 */
+	int longestWindow;
+
+	/**
+	 * @brief The chord of the last DETECT_EVENT_CHORD event.
+	 *
+	 * Its root is INVALID_SEMITONE if no chord is being played.
+	 */
+	ChromaChord chordName;
+
 	/**
 	 * @brief The last note that has benn detected.
 	 */
 	semitone_t lastDetected;
 
 	/**
-	 * @brief Last peaks.
-	 * @sa PEAKS_SIZE
+	 * @brief The period of the last note that has been detected.
+	 *
+	 * It's the center of the search in DETECT_TIER_TRACKING.
+	 */
+	double lastPeriod;
+
+	/**
+	 * @brief The envelope of the signal: the peak of each block of the
+	 *  preprocessor, after the gain.
 	 *
-	 * This array is intended to be used as a circular array jointly with
-	 * lastPeak.
+	 * The peak of the block that starts at the position p of the stream is at
+	 * the index (p / block) & envelopeMask, and the array has enough elements
+	 * for an analysis window, so the amplitude checks never read the samples.
 	 * For the logic of the program, even when not peaks have been saved,
 	 * considering them as 0 is a valid behaviour.
 	 */
-	double peaks[PEAKS_SIZE];
+	float *envelope;
+
+	/**
+	 * @brief The mask to get the index of a block in envelope.
+	 */
+	size_t envelopeMask;
+
+	/**
+	 * @brief The number of samples consumed from the ring.
+	 *
+	 * It's the position of the first sample of the ring in the stream.
+	 */
+	size_t position;
 
 	/**
-	 * @brief Index of used last element of peaks
-	 * @sa peaks
+	 * @brief The first block that hasn't been checked for a quick raise yet.
+	 *
+	 * When windows overlap, only the blocks of the new part are checked, so
+	 * that a raise is found only once.
 	 */
-	unsigned int lastPeak;
+	size_t raiseBlock;
 
 	/**
 	 * @brief Samples filtered out from last update.
@@ -96,6 +286,87 @@ struct _DetectContext {
 	 * Setting no valid note counts as an update.
 	 */
 	unsigned int droppedSamples;
+
+	/**
+	 * @brief The preprocessor of the input.
+	 */
+	Preprocessor preprocessor;
+
+	/**
+	 * @brief The number of samples of the blocks of the preprocessor.
+	 *
+	 * Blocks start at multiples of it in the stream, but the preprocessor
+	 * might process a block in more pieces, when a window ends in the middle
+	 * of it.
+	 */
+	unsigned int block;
+
+	/**
+	 * @brief The position in the stream up to which samples have been
+	 *  preprocessed.
+	 *
+	 * The preprocessor works in place on the ring, so, when windows overlap,
+	 * it must process only the new part of each window.
+	 */
+	size_t preprocessedEnd;
+
+	/**
+	 * @brief The number of consecutive samples with the gate closed.
+	 * @sa DetectConfig.idleTimeout
+	 */
+	size_t quietSamples;
+
+	/**
+	 * @brief The number of silent samples after which the detection is idle.
+	 *
+	 * If 0, the detection never becomes idle.
+	 */
+	size_t idleSamples;
+
+	/**
+	 * @brief The governor that chooses the tier of the analysis.
+	 */
+	Governor governor;
+
+	/**
+	 * @brief The samples that were in the ring at the previous call.
+	 *
+	 * They are used to tell whether the backlog is growing.
+	 */
+	size_t lastFill;
+
+	/**
+	 * @brief The queue of events, used as a circular array.
+	 *
+	 * It has DETECT_EVENTS_SIZE elements.
+	 */
+	DetectEvent *events;
+
+	/**
+	 * @brief The index of the oldest event in the queue.
+	 */
+	unsigned int eventsHead;
+
+	/**
+	 * @brief The number of events in the queue.
+	 */
+	unsigned int eventsCount;
+
+	/**
+	 * @brief The hardware counters of the thread that runs the detection.
+	 * @sa DetectConfig.hwCounters
+	 */
+	HwCounters hw;
+
+	/**
+	 * @brief The sampling of the hardware counters of the stages.
+	 */
+	HwStage stages[DETECT_STAGES];
+
+	/**
+	 * @brief The counters of the detection.
+	 */
+	DetectStats stats;
 };
 
 /**
@@ -109,15 +380,31 @@ static const double MINIMUM_QUALITY = 0.85;
 /**
  * @brief Threshold for signal amplitude
  *
- * A second filter concerns the signal amplitude: guitar pickups (especially
- * single coils) and not properly filtered sound cards add some noise to signal,
- * so if no sample exceeds this threshold, then that sequcence is treated as
- * silence.
+ * A second filter concerns the signal amplitude: the tail of a note is still
+ * above the noise gate, but it is too weak for a reliable estimation, so if no
+ * sample exceeds this threshold, then that sequcence is treated as silence.
  *
- * @note This threshold is applied to absolute value of the amplitude.
+ * @note This threshold is applied to absolute value of the amplitude, after
+ *  the automatic gain control, so it is relative to the level of the notes.
  */
 static const double NOISE_THRESHOLD = 0.1;
 
+/**
+ * @brief The default cutoff of the DC blocker, in Hz.
+ * @sa DetectConfig.dcBlocker
+ */
+static const double DC_BLOCKER_FREQUENCY = 5;
+
+/**
+ * @brief The default ratio between the RMS of signal and the noise floor.
+ * @sa DetectConfig.gateRatio
+ *
+ * Guitar pickups (especially single coils) and not properly filtered sound
+ * cards add some noise to signal, and the minimum statistics underestimate
+ * it, so the gate is about 16dB above the floor.
+ */
+static const float GATE_RATIO = 6.0f;
+
 /**
  * @brief Threshold to detect note replay.
  *
@@ -132,162 +419,881 @@ static const double NOISE_THRESHOLD = 0.1;
  */
 static const double RAISE_THRESHOLD = 0.12;
 
+/**
+ * @brief The ratio between the last period and the limits of the tracking
+ *  search.
+ *
+ * 2^(4/12), i.e. four semitones in each direction.
+ */
+static const double TRACKING_RANGE = 1.259921;
+
+/**
+ * @brief The backlog, in windows, above which the governor is alerted.
+ */
+static const unsigned int BACKLOG_WINDOWS = 4;
+
+/**
+ * @brief Analyze a window of samples.
+ *
+ * @param context An instance of DetectContext
+ * @param buf The window, with context->window samples
+ * @param start The position of the window in the stream
+ * @param newSamples The number of samples the window advances
+ * @param tier The tier of the analysis
+ */
+static void analyzeWindow(DetectContext *context, float *buf, size_t start,
+		unsigned int newSamples, DetectTier tier);
+
+/**
+ * @brief Estimate the notes of a window, and queue an event if they have
+ *  changed.
+ *
+ * @param context An instance of DetectContext
+ * @param buf The window, with context->polyWindow samples
+ * @param start The position of the window in the stream
+ */
+static void analyzeChord(DetectContext *context, const float *buf,
+		size_t start);
+
+/**
+ * @brief Recognize the chord of a window, and queue an event if it has
+ *  changed.
+ *
+ * @param context An instance of DetectContext
+ * @param buf The window, with context->chromaWindow samples
+ * @param start The position of the window in the stream
+ */
+static void analyzeChordName(DetectContext *context, const float *buf,
+		size_t start);
+
+/**
+ * @brief Tell if the envelope of a window surpasses the amplitude threshold.
+ *
+ * @param context An instance of DetectContext
+ * @param start The position of the window in the stream
+ * @param size The number of samples of the window
+ * @return 1 if at least a block surpasses the threshold, 0 otherwise
+ */
+static int windowAboveThreshold(const DetectContext *context, size_t start,
+		size_t size);
+
 /**
  * @brief Performs the analysis on already filtered signal.
  *
  * detectAnalyze has to do some checks on the signal, and so it's used as a
  * public interface, but this is the function that performs the analysis on
  * signals that have already been filtered.
+ * The checks on the amplitude use the envelope, so the samples aren't needed.
  *
  * @param context An instance of DetectContext
- * @param buf The buffer of samples
+ * @param start The position of the buffer in the stream
  * @param size The size of the buffer
  * @param freq The frequency of the buffer
- * @param period The period of the buffer as number of elements
  */
-static void analyzeFiltered(DetectContext *context, float *buf, int size,
-		double freq, int period);
+static void analyzeFiltered(DetectContext *context, size_t start, int size,
+		double freq);
 
-DetectContext *detectInit(unsigned int rate)
-{
-	if(!rate) {
-		return 0;
-	}
+/**
+ * @brief Get the hop of a tier.
+ *
+ * @param context An instance of DetectContext
+ * @param tier The tier
+ * @return The hop, in samples
+ */
+static unsigned int tierHop(const DetectContext *context, DetectTier tier);
 
-	/// The instance of DetectContext that will be returned
-	DetectContext *ret = (DetectContext *) malloc(sizeof(DetectContext));
+/**
+ * @brief Get the bucket of the histogram of the analysis times for a time.
+ *
+ * @param elapsed The time, in seconds
+ * @return The index of the bucket
+ */
+static unsigned int timeBucket(double elapsed);
 
-	ret->rate = rate;
+/**
+ * @brief Add an event to the queue, or count it as lost if the queue is full.
+ *
+ * @param context An instance of DetectContext
+ * @param event The event
+ */
+static void pushEvent(DetectContext *context, const DetectEvent *event);
 
-	// Note: highest note/frequency = minimum period and vice versa
-	ret->minPeriod = (int) floor(rate / noteToFrequency(DETECT_HIGHEST));
-	ret->maxPeriod = (int) ceil(rate / noteToFrequency(DETECT_LOWEST));
+/**
+ * @brief Queue a silence event, if a note was being played, and forget it.
+ *
+ * @param context An instance of DetectContext
+ */
+static void resetNote(DetectContext *context);
 
-	ret->lastDetected = INVALID_SEMITONE;
+/**
+ * @brief Queue an event without notes, if a chord was being played, and
+ *  forget it.
+ *
+ * @param context An instance of DetectContext
+ */
+static void resetChord(DetectContext *context);
 
-	for(int i = 0; i < PEAKS_SIZE; i++) {
-		ret->peaks[i] = 0;
-	}
-	// First element will be ((PEAKS_SIZE - 1) + 1) % PEAKS_SIZE = 0
-	ret->lastPeak = PEAKS_SIZE - 1;
+/**
+ * @brief Queue an event without a chord, if a chord was recognized, and
+ *  forget it.
+ *
+ * @param context An instance of DetectContext
+ */
+static void resetChordName(DetectContext *context);
 
-	ret->droppedSamples = 0;
+/**
+ * @brief Queue an anomaly event, unless the flight recorder is disabled or
+ *  the last anomaly is too recent.
+ *
+ * @param context An instance of DetectContext
+ * @param trigger The kind of anomaly
+ */
+static void reportAnomaly(DetectContext *context, FlightTrigger trigger);
 
-	return ret;
-}
+/**
+ * @brief Get the amplitude that at least a sample of a window must surpass
+ *  for the window not to be silence.
+ *
+ * @param context An instance of DetectContext
+ * @return The threshold, after the gain
+ */
+static double amplitudeThreshold(const DetectContext *context);
 
-void detectFree(DetectContext *context)
+/**
+ * @brief Preprocess the samples of the ring up to a position, and update the
+ *  idle state.
+ *
+ * @param context An instance of DetectContext
+ * @param buf The samples of the ring
+ * @param end The number of samples of buf that must be preprocessed
+ */
+static void preprocess(DetectContext *context, float *buf, size_t end);
+
+/**
+ * @brief Queue an event without any data.
+ *
+ * @param context An instance of DetectContext
+ * @param type The type of the event
+ */
+static void pushSimpleEvent(DetectContext *context, DetectEventType type);
+
+void detectConfigInit(DetectConfig *config, unsigned int rate)
 {
-	if(!context) {
-		return;
-	}
+	assert(config);
+
+	config->rate = rate;
 
-	free(context);
+	/* By default windows don't overlap, so every sample is analyzed once.
+	See detectInitWithConfig for the size of the window. */
+	config->hop = rate ? 2 * (unsigned int) ceil(rate /
+			noteToFrequency(DETECT_LOWEST)) : 0;
+
+	config->governor = 1;
+
+	config->idleTimeout = 2.0;
+	config->gateRatio = GATE_RATIO;
+	config->agc = 1;
+
+	config->dcBlocker = DC_BLOCKER_FREQUENCY;
+	config->highPass = rate ? noteToFrequency(DETECT_LOWEST) / 2 : 0;
+	config->preEmphasis = 0;
+
+	config->tuning = 0;
+	config->reference = QUANTIZER_STANDARD_REFERENCE;
+	config->gridStep = ESTIMATOR_GRID_STEP;
+	/* Short windows let wrong high notes win on the attack of the low ones,
+	so the whole window is used by default. */
+	config->windowPeriods = 0;
+	config->bands = 0;
+	config->floatSums = 0;
+	config->fixedPoint = 0;
+	config->polyphony = 0;
+	config->chords = 0;
+	config->flightSeconds = 0;
+	config->inputLatency = 0;
+	config->hwCounters = 0;
 }
 
-int detectAnalyze(DetectContext *context, struct SoundIoRingBuffer *buffer)
+int detectConfigFromFlight(DetectConfig *config, Tuning *tuning,
+		const FlightHeader *header)
 {
-	assert(context);
-	assert(context->minPeriod > 0);
-	assert(context->maxPeriod > context->minPeriod);
+	assert(config);
+	assert(tuning);
+	assert(header);
 
-	/// The number of available samples (in bytes)
-	int availableBytes;
-	/// The number of available samples (in floats)
-	int available;
-	/// The data buffer
-	float *buf;
-	/// The period of the note (in sample units)
-	double period;
-	/// The periodicity quality
-	double quality;
-	/// The period as integer
-	int intPeriod;
+	/// The options of the detection that has recorded the dump
+	const FlightOptions *options = &header->options;
 
-	availableBytes = soundio_ring_buffer_fill_count(buffer);
-	available = availableBytes / sizeof(float);
+	detectConfigInit(config, header->rate);
+	config->hop = header->hop;
+	config->governor = 0;
 
-	// Not enough samples to detect frequency
-	if(available < (2 * context->maxPeriod)) {
-		return 0;
+	if(tuningInit(tuning, options->open, options->strings, options->frets)) {
+		return -1;
 	}
 
-	if(context->droppedSamples > context->rate) {
+	config->idleTimeout = options->idleTimeout;
+	config->gateRatio = options->gateRatio;
+	config->agc = options->agc;
+	config->dcBlocker = options->dcBlocker;
+	config->highPass = options->highPass;
+	config->preEmphasis = options->preEmphasis;
+	config->tuning = tuning;
+	config->reference = options->reference;
+	config->gridStep = options->gridStep;
+	config->windowPeriods = options->windowPeriods;
+	config->bands = options->bands;
+	config->floatSums = options->floatSums;
+	config->fixedPoint = options->fixedPoint;
+	config->polyphony = options->polyphony;
+	config->chords = options->chords;
+
+	return 0;
+}
+
+DetectContext *detectInit(unsigned int rate)
+{
+	DetectConfig config;
+
+	detectConfigInit(&config, rate);
+
+	return detectInitWithConfig(&config);
+}
+
+DetectContext *detectInitWithConfig(const DetectConfig *config)
+{
+	if(!config || !config->rate || !config->hop || config->gateRatio < 1 ||
+			!(config->reference > 0) || config->gridStep < 0 ||
+			config->windowPeriods < 0 || config->windowPeriods == 1 ||
+			config->polyphony > POLY_MAX_NOTES || config->flightSeconds < 0 ||
+			config->inputLatency < 0 ||
+			(config->fixedPoint && config->bands)) {
+		return 0;
+	}
+
+	/// The arena for the context and its buffers
+	Arena *arena;
+	/// The configuration of the period estimator
+	EstimatorConfig estimatorConfig;
+	/// The configuration of the period estimator for the decimated signal
+	EstimatorConfig decimatedConfig;
+	/// The size of the analysis window
+	int window;
+	/// The size of the blocks of the preprocessor
+	unsigned int block;
+	/// The number of blocks of the envelope
+	size_t envelopeSize = 1;
+	/// The configuration of the band-split estimator
+	BandConfig bandConfig;
+	/// The memory of the band-split estimator
+	size_t bandSize = 0;
+	/// The configuration of the fixed-point estimator
+	EstimatorConfig fixedConfig;
+	/// The memory of the fixed-point estimator and of its window
+	size_t fixedSize = 0;
+	/// The tuning of the instrument
+	Tuning tuning;
+	/// The configuration of the chord estimator
+	PolyConfig polyConfig;
+	/// The memory of the chord estimator
+	size_t polySize = 0;
+	/// The configuration of the chord recognizer
+	ChromaConfig chromaConfig;
+	/// The memory of the chord recognizer
+	size_t chromaSize = 0;
+	/// The configuration of the flight recorder
+	FlightConfig flightConfig;
+	/// The memory of the flight recorder
+	size_t flightSize = 0;
+	/// The longest window, of the notes or of the chords
+	int longest;
+	/// The instance of DetectContext that will be returned
+	DetectContext *ret;
+
+	// Note: highest note/frequency = minimum period and vice versa
+	estimatorConfigInit(&estimatorConfig,
+			(int) floor(config->rate / noteToFrequency(DETECT_HIGHEST)),
+			(int) ceil(config->rate / noteToFrequency(DETECT_LOWEST)));
+
+	// The estimator needs at least two times the maximum period
+	window = 2 * estimatorConfig.maxP;
+
+	/* The decimated window has window / 2 samples, so the maximum period must
+	be rounded down. */
+	estimatorConfigInit(&decimatedConfig, estimatorConfig.minP / 2,
+			estimatorConfig.maxP / 2);
+	if(decimatedConfig.minP < 2) {
+		decimatedConfig.minP = 2;
+	}
+	estimatorConfig.gridStep = config->gridStep;
+	decimatedConfig.gridStep = config->gridStep;
+	estimatorConfig.periods = config->windowPeriods;
+	decimatedConfig.periods = config->windowPeriods;
+	estimatorConfig.floatSums = config->floatSums;
+	decimatedConfig.floatSums = config->floatSums;
+
+	/* Each block contains at least a period of any note, so the peak of a
+	block is the peak of the waveform, and the envelope doesn't ripple.
+	The noise floor and the gate are updated once per block, too. */
+	block = (unsigned int) estimatorConfig.maxP;
+
+	if(config->tuning) {
+		tuning = *config->tuning;
+	} else {
+		tuningInit(&tuning, STANDARD_TUNING, GUITAR_STRINGS, GUITAR_FRETS);
+	}
+
+	if(config->polyphony) {
+		// Only the notes of the instrument are candidates
+		polyConfigInit(&polyConfig, config->rate);
+		polyConfig.lowest = tuning.lowest;
+		polyConfig.highest = tuning.lowest + (semitone_t) tuning.range - 1;
+		polyConfig.maxNotes = config->polyphony;
+		polyConfig.reference = config->reference;
+		polySize = polyMemorySize(&polyConfig);
+		if(!polySize) {
+			return 0;
+		}
+	}
+
+	if(config->chords) {
+		chromaConfigInit(&chromaConfig, config->rate);
+		chromaConfig.reference = config->reference;
+		chromaSize = chromaMemorySize(&chromaConfig);
+		if(!chromaSize) {
+			return 0;
+		}
+	}
+
+	if(config->flightSeconds > 0) {
+		flightConfigInit(&flightConfig, config->rate, config->hop,
+				config->flightSeconds);
+		// Saved in the dumps, so that the replays take the same decisions
+		flightConfig.options.idleTimeout = config->idleTimeout;
+		flightConfig.options.gateRatio = config->gateRatio;
+		flightConfig.options.agc = config->agc;
+		flightConfig.options.dcBlocker = config->dcBlocker;
+		flightConfig.options.highPass = config->highPass;
+		flightConfig.options.preEmphasis = config->preEmphasis;
+		flightConfig.options.strings = tuning.strings;
+		flightConfig.options.frets = tuning.frets;
+		memcpy(flightConfig.options.open, tuning.open, sizeof(tuning.open));
+		flightConfig.options.reference = config->reference;
+		flightConfig.options.gridStep = config->gridStep;
+		flightConfig.options.windowPeriods = config->windowPeriods;
+		flightConfig.options.bands = config->bands;
+		flightConfig.options.floatSums = config->floatSums;
+		flightConfig.options.fixedPoint = config->fixedPoint;
+		flightConfig.options.polyphony = config->polyphony;
+		flightConfig.options.chords = config->chords;
+		flightSize = flightMemorySize(&flightConfig);
+		if(!flightSize) {
+			return 0;
+		}
+	}
+
+	longest = config->polyphony && polyConfig.window > window ?
+			polyConfig.window : window;
+	if(config->chords && chromaConfig.window > longest) {
+		longest = chromaConfig.window;
+	}
+
+	/* The envelope must contain all the blocks of a window, which can start
+	and end in the middle of a block, and the one before it. */
+	while(envelopeSize < longest / block + 3) {
+		envelopeSize <<= 1;
+	}
+
+	if(config->bands) {
+		bandConfigInit(&bandConfig, config->rate, estimatorConfig.minP,
+				estimatorConfig.maxP);
+		bandConfig.window = window;
+		bandConfig.gridStep = config->gridStep;
+		bandConfig.floatSums = config->floatSums;
+		bandSize = bandMemorySize(&bandConfig);
+		if(!bandSize) {
+			return 0;
+		}
+	}
+
+	if(config->fixedPoint) {
+		// It supports only the search on every lag, with the whole window
+		fixedConfig = estimatorConfig;
+		fixedConfig.gridStep = 0;
+		fixedConfig.periods = 0;
+		fixedSize = fixedMemorySize(&fixedConfig) +
+				ARENA_ALIGN(window * sizeof(int16_t));
+	}
+
+	arena = arenaCreate(ARENA_ALIGN(sizeof(DetectContext)) + bandSize +
+			fixedSize + polySize + chromaSize + flightSize +
+			ARENA_ALIGN(envelopeSize * sizeof(float)) +
+			estimatorMemorySize(&estimatorConfig) +
+			estimatorMemorySize(&decimatedConfig) +
+			ARENA_ALIGN(window / 2 * sizeof(float)) +
+			ARENA_ALIGN(DETECT_EVENTS_SIZE * sizeof(DetectEvent)));
+	if(!arena) {
+		fprintf(stderr, "Could not allocate the memory for the detection.\n");
+		return 0;
+	}
+
+	// The arena has been sized for these allocations, so they cannot fail
+	ret = (DetectContext *) arenaAlloc(arena, sizeof(DetectContext));
+	ret->arena = arena;
+	ret->config = *config;
+	ret->estimator = estimatorCreate(arena, &estimatorConfig);
+	ret->decimatedEstimator = estimatorCreate(arena, &decimatedConfig);
+	ret->bands = config->bands ? bandCreate(arena, &bandConfig) : 0;
+	ret->fixed = config->fixedPoint ? fixedCreate(arena, &fixedConfig) : 0;
+	ret->fixedWindow = config->fixedPoint ?
+			arenaAlloc(arena, window * sizeof(int16_t)) : 0;
+	ret->poly = config->polyphony ? polyCreate(arena, &polyConfig) : 0;
+	ret->chroma = config->chords ? chromaCreate(arena, &chromaConfig) : 0;
+	ret->flight = flightSize ? flightCreate(arena, &flightConfig) : 0;
+	ret->decimated = arenaAlloc(arena, window / 2 * sizeof(float));
+	ret->events = arenaAlloc(arena, DETECT_EVENTS_SIZE * sizeof(DetectEvent));
+	ret->envelope = arenaAlloc(arena, envelopeSize * sizeof(float));
+	assert(ret->estimator && ret->decimatedEstimator && ret->decimated &&
+			ret->events && ret->envelope && (ret->bands || !config->bands) &&
+			((ret->fixed && ret->fixedWindow) || !config->fixedPoint) &&
+			(ret->poly || !config->polyphony) &&
+			(ret->chroma || !config->chords) && (ret->flight || !flightSize));
+
+	ret->tuning = tuning;
+	quantizerInit(&ret->quantizer, config->reference);
+
+	ret->rate = config->rate;
+	ret->minPeriod = estimatorConfig.minP;
+	ret->maxPeriod = estimatorConfig.maxP;
+	ret->window = window;
+	ret->polyWindow = config->polyphony ? polyConfig.window : 0;
+	ret->chordCount = 0;
+	ret->chromaWindow = config->chords ? chromaConfig.window : 0;
+	ret->longestWindow = longest;
+	ret->chordName.root = INVALID_SEMITONE;
+	ret->anomalyInterval = flightSize ? flightConfig.samples : 0;
+	ret->lastAnomaly = 0;
+	ret->anomalyReported = 0;
+
+	ret->lastDetected = INVALID_SEMITONE;
+	ret->lastPeriod = 0;
+
+	// The arena is already clear, so the envelope is 0
+	ret->envelopeMask = envelopeSize - 1;
+
+	ret->position = 0;
+	ret->raiseBlock = 0;
+	ret->droppedSamples = 0;
+
+	preprocessInit(&ret->preprocessor, config->rate, config->gateRatio,
+			config->agc);
+	if(preprocessSetFilters(&ret->preprocessor, config->rate,
+			config->dcBlocker, config->highPass, config->preEmphasis)) {
+		fprintf(stderr, "Invalid filters for the detection.\n");
+		arenaFree(arena);
+		return 0;
+	}
+	ret->block = block;
+	ret->preprocessedEnd = 0;
+
+	ret->quietSamples = 0;
+	ret->idleSamples = (size_t) (config->idleTimeout * config->rate);
+
+	governorInit(&ret->governor, config->governor ? DETECT_TIERS - 1 : 0);
+	ret->lastFill = 0;
+
+	ret->eventsHead = 0;
+	ret->eventsCount = 0;
+
+	// The arena is already clear, but the tier must be valid in any case
+	ret->stats.tier = DETECT_TIER_FULL;
+
+	/* The stages run once per hop, which is long compared to a read of the
+	counters, so all of them are sampled. */
+	for(int i = 0; i < DETECT_STAGES; i++) {
+		hwStageInit(&ret->stages[i], 1);
+	}
+	// When they are not available, the stages are simply not sampled
+	hwCountersInit(&ret->hw);
+	if(config->hwCounters) {
+		hwCountersOpen(&ret->hw);
+	}
+
+	return ret;
+}
+
+void detectFree(DetectContext *context)
+{
+	if(!context) {
+		return;
+	}
+
+	hwCountersClose(&context->hw);
+
+	// The context itself is in the arena
+	arenaFree(context->arena);
+}
+
+int detectAnalyze(DetectContext *context, SampleRing *ring)
+{
+	assert(context);
+	assert(context->minPeriod > 0);
+	assert(context->maxPeriod > context->minPeriod);
+
+	/// The number of available samples
+	size_t available;
+	/// The data buffer
+	float *buf;
+	/// Whether samples are accumulating in the ring
+	int backlog;
+
+	buf = sampleRingPeek(ring, &available);
+
+	/* The backlog is reported only once per call, otherwise the governor would
+	step down once for each window it is catching up on.
+	The samples that are kept for the longer windows of the chords are not a
+	backlog. */
+	backlog = available > BACKLOG_WINDOWS * (size_t) context->window +
+			(size_t) (context->longestWindow - context->window) &&
+			available > context->lastFill;
+	context->lastFill = available;
+
+	for(;;) {
+		/// The tier of this window
+		DetectTier tier = context->stats.tier;
+		/// The samples this window advances
+		unsigned int hop = tierHop(context, tier);
+		/**
+		 * The samples needed for this window.
+		 *
+		 * When the hop is longer than the window, the window is taken at the
+		 * end of the hop, to analyze the most recent samples.
+		 * The windows of the chords end at the same sample.
+		 */
+		size_t needed = hop > (unsigned int) context->longestWindow ? hop :
+				(size_t) context->longestWindow;
+		/// The time when the analysis started
+		double startTime;
+		/// The time needed by the analysis
+		double elapsed;
+
+		// Not enough samples to detect frequency
+		if(available < needed) {
+			break;
+		}
+
+		/* If the preprocessor finds the attack of a note, the detection wakes
+		up and the window is analyzed. */
+		hwStageBegin(&context->stages[DETECT_STAGE_ENVELOPE], &context->hw);
+		preprocess(context, buf, needed);
+		hwStageEnd(&context->stages[DETECT_STAGE_ENVELOPE], &context->hw);
+
+		if(context->stats.idle || context->quietSamples >= hop) {
+			/* The gate has been closed for all the new samples, so they are
+			noise, and running the estimator on them would be wasted. */
+			if(!context->stats.idle) {
+				resetNote(context);
+				resetChord(context);
+				resetChordName(context);
+				context->droppedSamples = 0;
+				context->stats.droppedSilence++;
+
+				if(context->flight) {
+					context->record.position = context->position;
+					context->record.period = 0;
+					context->record.quality = 0;
+					context->record.elapsed = 0;
+					context->record.note = INVALID_SEMITONE;
+					context->record.tier = (unsigned char) tier;
+					context->record.decision = FLIGHT_DECISION_GATE;
+					flightRecord(context->flight, &context->record);
+				}
+			}
+
+			sampleRingConsume(ring, hop);
+			context->position += hop;
+			buf = sampleRingPeek(ring, &available);
+			continue;
+		}
+
+		context->record.position = context->position + needed -
+				context->window;
+		context->record.period = 0;
+		context->record.quality = 0;
+		context->record.note = INVALID_SEMITONE;
+		context->record.tier = (unsigned char) tier;
+		context->record.decision = FLIGHT_DECISION_QUALITY;
+
+		startTime = timeNow();
+		hwStageBegin(&context->stages[DETECT_STAGE_ESTIMATOR], &context->hw);
+		analyzeWindow(context, buf + needed - context->window,
+				context->position + needed - context->window, hop, tier);
+		if(context->poly && tier <= DETECT_TIER_LONG_HOP) {
+			analyzeChord(context, buf + needed - context->polyWindow,
+					context->position + needed - context->polyWindow);
+		}
+		if(context->chroma) {
+			analyzeChordName(context, buf + needed - context->chromaWindow,
+					context->position + needed - context->chromaWindow);
+		}
+		hwStageEnd(&context->stages[DETECT_STAGE_ESTIMATOR], &context->hw);
+		elapsed = timeNow() - startTime;
+
+		context->stats.frames++;
+		context->stats.tierFrames[tier]++;
+		context->stats.lastAnalysisTime = elapsed;
+		if(elapsed > context->stats.maxAnalysisTime) {
+			context->stats.maxAnalysisTime = elapsed;
+		}
+		context->stats.analysisTimes[timeBucket(elapsed)]++;
+		context->stats.analysisTimeSum += elapsed;
+
+		if(context->flight) {
+			context->record.elapsed = (float) elapsed;
+			flightRecord(context->flight, &context->record);
+		}
+
+		if(elapsed > hop / (double) context->rate) {
+			context->stats.deadlineMisses++;
+			reportAnomaly(context, FLIGHT_TRIGGER_DEADLINE);
+		}
+
+		DetectTier newTier = (DetectTier) governorUpdate(&context->governor,
+				elapsed, hop / (double) context->rate, backlog);
+		backlog = 0;
+		context->stats.load = context->governor.load;
+
+		if(newTier != tier) {
+			DetectEvent event;
+			event.type = DETECT_EVENT_TIER;
+			event.tier = newTier;
+			pushEvent(context, &event);
+
+			context->stats.tier = newTier;
+			context->stats.tierChanges++;
+		}
+
+		sampleRingConsume(ring, hop);
+		context->position += hop;
+
+		buf = sampleRingPeek(ring, &available);
+	}
+
+	return 0;
+}
+
+int detectPollEvent(DetectContext *context, DetectEvent *event)
+{
+	assert(context);
+	assert(event);
+
+	if(!context->eventsCount) {
+		return 0;
+	}
+
+	*event = context->events[context->eventsHead];
+	context->eventsHead = (context->eventsHead + 1) % DETECT_EVENTS_SIZE;
+	context->eventsCount--;
+
+	return 1;
+}
+
+int detectIsIdle(const DetectContext *context)
+{
+	assert(context);
+	return context->stats.idle;
+}
+
+int detectDumpFlight(const DetectContext *context, const char *path,
+		FlightTrigger trigger)
+{
+	assert(context);
+	assert(path);
+
+	if(!context->flight) {
+		return -1;
+	}
+
+	return flightDump(context->flight, path, trigger);
+}
+
+void detectGetStats(const DetectContext *context, DetectStats *stats)
+{
+	assert(context);
+	assert(stats);
+
+	*stats = context->stats;
+	stats->noiseFloor = context->preprocessor.floor;
+	stats->gain = context->preprocessor.gain;
+	stats->envelope = context->preprocessor.envelope;
+	stats->inputLatency = context->config.inputLatency;
+	stats->latency = context->config.inputLatency +
+			tierHop(context, context->stats.tier) / (double) context->rate +
+			context->stats.lastAnalysisTime;
+	stats->hwCounters = hwCountersAvailable(&context->hw);
+	for(int i = 0; i < DETECT_STAGES; i++) {
+		stats->stages[i] = context->stages[i].counts;
+	}
+}
+
+double detectTimeBucketBound(unsigned int bucket)
+{
+	if(bucket >= DETECT_TIME_BUCKETS - 1) {
+		return INFINITY;
+	}
+
+	return ldexp(DETECT_TIME_BUCKET_BASE, (int) bucket);
+}
+
+void analyzeWindow(DetectContext *context, float *buf, size_t start,
+		unsigned int newSamples, DetectTier tier)
+{
+	/// The period of the note (in sample units)
+	double period;
+	/// The periodicity quality
+	double quality;
+	/// The period as integer
+	int intPeriod = 0;
+
+	if(context->droppedSamples > context->rate) {
 		// A second of noise or spurious data is enogh to make the note invalid
-		guiResetHighlights();
-		context->lastDetected = INVALID_SEMITONE;
+		resetNote(context);
 		context->droppedSamples = 0;
 	}
 
-	buf = (float *) soundio_ring_buffer_read_ptr(buffer);
-	period = estimatePeriod(buf, available, context->minPeriod,
-			context->maxPeriod, &quality, &intPeriod);
+	if(tier == DETECT_TIER_TRACKING &&
+			context->lastDetected == INVALID_SEMITONE) {
+		// Nothing to track, search all the notes, but with a cheap search
+		tier = DETECT_TIER_DECIMATED;
+	}
+
+	switch(tier) {
+		case DETECT_TIER_TRACKING: {
+			int minP = (int) floor(context->lastPeriod / TRACKING_RANGE);
+			int maxP = (int) ceil(context->lastPeriod * TRACKING_RANGE);
+
+			minP = minP < context->minPeriod ? context->minPeriod : minP;
+			maxP = maxP > context->maxPeriod ? context->maxPeriod : maxP;
+
+			period = estimatorRunRange(context->estimator, buf, context->window,
+					minP, maxP, &quality, &intPeriod);
+			break;
+		}
+
+		case DETECT_TIER_DECIMATED: {
+			int half = context->window / 2;
+
+			// Averaging is a (weak) low-pass filter, needed against aliasing
+			for(int i = 0; i < half; i++) {
+				context->decimated[i] = 0.5f * (buf[2 * i] + buf[2 * i + 1]);
+			}
+
+			period = 2 * estimatorRun(context->decimatedEstimator,
+					context->decimated, half, &quality, &intPeriod);
+			intPeriod *= 2;
+			break;
+		}
+
+		default:
+			if(context->fixed) {
+				/// The quality in Q30
+				int32_t fixedQuality;
+				/// The period in Q16.16, or 0
+				int32_t fixedPeriod;
+
+				fixedFromFloat(buf, context->fixedWindow, context->window);
+				fixedPeriod = fixedRun(context->fixed, context->fixedWindow,
+						context->window, &fixedQuality, &intPeriod);
+				period = ldexp(fixedPeriod, -FIXED_PERIOD_SHIFT);
+				quality = ldexp(fixedQuality, -FIXED_NAC_SHIFT);
+			} else if(context->bands) {
+				period = bandRun(context->bands, buf, &quality);
+				intPeriod = (int) (period + 0.5);
+			} else {
+				period = estimatorRun(context->estimator, buf, context->window,
+						&quality, &intPeriod);
+			}
+			break;
+	}
+
+	context->record.period = (float) period;
+	context->record.quality = (float) quality;
+
+	if(isnan(period)) {
+		context->stats.nanPeriods++;
+		reportAnomaly(context, FLIGHT_TRIGGER_NAN);
+	}
 
 	// First filter: skip signals with negative period and low periodicity
 	if(isfinite(period) && intPeriod > 0 && quality >= MINIMUM_QUALITY) {
 		double freq = context->rate / period;
-		analyzeFiltered(context, buf, available, freq, intPeriod);
+		// analyzeFiltered resets the counter if the window is accepted
+		context->droppedSamples += newSamples;
+		analyzeFiltered(context, start, context->window, freq);
+		if(context->lastDetected != INVALID_SEMITONE) {
+			context->lastPeriod = period;
+		}
 	} else {
-		context->droppedSamples += available;
+		context->droppedSamples += newSamples;
+		context->stats.droppedQuality++;
 		FILTER_PRINTF("Negative period or insufficient quality! T: %f Q: %f\n",
 				period, quality);
 	}
-
-	soundio_ring_buffer_advance_read_ptr(buffer, availableBytes);
-
-	return 0;
 }
 
-void analyzeFiltered(DetectContext *context, float *buf, int size, double freq,
-		int period)
+void analyzeFiltered(DetectContext *context, size_t start, int size,
+		double freq)
 {
 	/* The function should be called only from detectAnalyze, so data should
 	have already been checked, but let's check them anyway in debug stage. */
 	assert(size > 0);
 	assert(freq > 0);
-	assert(period > 0);
 
-	/// The array to store in which frets the note can be played
-	semitone_t frets[GUITAR_STRINGS];
 	/// The note that has been played
-	semitone_t note = frequencyToSemitones(freq, 0);
+	semitone_t note = quantize(&context->quantizer, freq, 0);
+	/// The frets in which the note can be played
+	const semitone_t *frets = tuningLookup(&context->tuning, note, 0);
 	/// The difference, in semitones from the previous played note
 	semitone_t noteDelta;
-	/// Tells if NOISE_THRESHOLD has been surpassed
+	/// The amplitude that at least a sample must surpass
+	double threshold = amplitudeThreshold(context);
+	/// Tells if threshold has been surpassed
 	char minSurpassed = 0;
 	/// Tells if a quick raise has happened
 	char quickRaise = 0;
+	/// The first block of the window
+	size_t first = start / context->block;
+	/// The last block of the window
+	size_t last = (start + size - 1) / context->block;
+
+	context->record.note = note;
 
-	if(!noteToFrets(note, STANDARD_TUNING, frets, GUITAR_STRINGS, GUITAR_FRETS)) {
+	if(!frets) {
+		context->record.decision = FLIGHT_DECISION_UNPLAYABLE;
 		FILTER_PRINTF("Non playable note (%hd)...\n", note);
-		context->droppedSamples += size;
+		context->stats.droppedUnplayable++;
 		return;
 	}
 
-	/* All the tests on signal amplitude exploit the fact that the signal is
-	periodic: this should allow to check a feature only on the peak of a period
-	(that is true, for example, for amplitude decay, or for minumum threshold to
-	pass not to be detected as a silent signal). */
-	for(int j = 0, limit = size - period; j < limit; j += period) {
-		double peak = 0;
+	for(size_t b = first; b <= last; b++) {
+		float peak = context->envelope[b & context->envelopeMask];
 
-		for(int i = 0; i < period; i++) {
-			double tmp = fabs(buf[j + i]);
-			if(tmp > peak) {
-				peak = tmp;
-			}
-		}
+		minSurpassed = minSurpassed || peak > threshold;
 
-		/* Detect quick raise. Note that if a quick raise has already been
-		detected, then all further checks will be skipped. */
-		quickRaise = quickRaise ||
-				peak - context->peaks[context->lastPeak] > RAISE_THRESHOLD;
+		// Blocks already seen by an overlapping window
+		if(b < context->raiseBlock) {
+			continue;
+		}
 
-		context->lastPeak++;
-		context->lastPeak %= PEAKS_SIZE;
-		context->peaks[context->lastPeak] = peak;
+		/* Detect quick raise. The block before the first one of the stream is
+		the last element of the array, which is 0. */
+		quickRaise = quickRaise || peak -
+				context->envelope[(b - 1) & context->envelopeMask] >
+				RAISE_THRESHOLD;
+	}
 
-		minSurpassed = minSurpassed || peak > NOISE_THRESHOLD;
+	if(last >= context->raiseBlock) {
+		context->raiseBlock = last + 1;
 	}
 
 	/* At this point we will for sure detect silence or a valid note, so, even
@@ -296,20 +1302,322 @@ void analyzeFiltered(DetectContext *context, float *buf, int size, double freq,
 	context->droppedSamples = 0;
 
 	if(!minSurpassed) {
-		guiResetHighlights();
 		// In this way the next note will always be detected as a new one
-		context->lastDetected = INVALID_SEMITONE;
+		resetNote(context);
+		context->stats.droppedSilence++;
+		context->record.decision = FLIGHT_DECISION_SILENCE;
 		FILTER_PRINTF("No minium threshold on amplitude!\n");
 		return;
 	}
 
 	noteDelta = abs(note - context->lastDetected) % 12;
+	context->record.decision = FLIGHT_DECISION_SAME_NOTE;
 	if(quickRaise || (noteDelta != 0 && noteDelta != 7) ||
 			context->lastDetected == INVALID_SEMITONE) {
-		/*printf("New note: %hd (f: %f)\n", note, freq);
-		printf("Frets: %hd %hd %hd %hd %hd %hd\n", frets[0], frets[1],
-				frets[2], frets[3], frets[4], frets[5]);*/
-		guiHighlightFrets(frets);
+		DetectEvent event;
+
+		event.type = DETECT_EVENT_NOTE;
+		event.note = note;
+		event.frequency = freq;
+		for(int i = 0; i < GUITAR_MAX_STRINGS; i++) {
+			event.frets[i] = frets[i];
+		}
+		event.strings = context->tuning.strings;
+		pushEvent(context, &event);
+
 		context->lastDetected = note;
+		context->stats.notes++;
+		context->record.decision = FLIGHT_DECISION_NOTE;
+	}
+}
+
+void analyzeChord(DetectContext *context, const float *buf, size_t start)
+{
+	/// The notes of the window
+	PolyNote notes[POLY_MAX_NOTES];
+	/// The number of notes
+	unsigned int count = 0;
+	/// Whether the notes are the same of the last event
+	int same;
+
+	if(windowAboveThreshold(context, start, (size_t) context->polyWindow)) {
+		count = polyRun(context->poly, buf, notes);
+		polyAssignStrings(&context->tuning, notes, count);
+	}
+
+	// The notes are in order of salience, which changes as they decay
+	same = count == context->chordCount;
+	for(unsigned int i = 0; same && i < count; i++) {
+		int found = 0;
+		for(unsigned int j = 0; j < context->chordCount; j++) {
+			found = found || notes[i].note == context->chord[j].note;
+		}
+		same = found;
+	}
+
+	if(same) {
+		return;
+	}
+
+	DetectEvent event;
+	event.type = DETECT_EVENT_NOTES;
+	event.count = count;
+	event.strings = context->tuning.strings;
+	for(int i = 0; i < GUITAR_MAX_STRINGS; i++) {
+		event.frets[i] = -1;
+	}
+	for(unsigned int i = 0; i < count; i++) {
+		event.notes[i] = notes[i];
+		context->chord[i] = notes[i];
+		if(notes[i].string >= 0) {
+			event.frets[notes[i].string] = notes[i].fret;
+		}
+	}
+	pushEvent(context, &event);
+
+	context->chordCount = count;
+	context->stats.chords++;
+}
+
+void analyzeChordName(DetectContext *context, const float *buf, size_t start)
+{
+	/// The chord with the best score
+	ChromaChord chord;
+
+	if(!windowAboveThreshold(context, start,
+			(size_t) context->chromaWindow)) {
+		resetChordName(context);
+		return;
+	}
+
+	if(!chromaRun(context->chroma, buf, &chord)) {
+		/* The chroma vector is kept, so that the chord can be recognized
+		again when the ringing of the change of chord has faded. */
+		chord.root = INVALID_SEMITONE;
+	}
+
+	if(chord.root == context->chordName.root &&
+			(chord.root == INVALID_SEMITONE ||
+			chord.kind == context->chordName.kind)) {
+		return;
+	}
+
+	DetectEvent event;
+	event.type = DETECT_EVENT_CHORD;
+	event.chord = chord;
+	event.strings = context->tuning.strings;
+	if(chord.root == INVALID_SEMITONE ||
+			!chromaShape(&context->tuning, &chord, event.frets)) {
+		for(int i = 0; i < GUITAR_MAX_STRINGS; i++) {
+			event.frets[i] = -1;
+		}
+	}
+	pushEvent(context, &event);
+
+	context->chordName = chord;
+	context->stats.chordNames++;
+}
+
+int windowAboveThreshold(const DetectContext *context, size_t start,
+		size_t size)
+{
+	/// The amplitude that at least a sample must surpass
+	double threshold = amplitudeThreshold(context);
+	/// The last block of the window
+	size_t last = (start + size - 1) / context->block;
+
+	for(size_t b = start / context->block; b <= last; b++) {
+		if(context->envelope[b & context->envelopeMask] > threshold) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+unsigned int tierHop(const DetectContext *context, DetectTier tier)
+{
+	if(tier == DETECT_TIER_FULL) {
+		return context->config.hop;
+	}
+
+	return 2 * context->config.hop;
+}
+
+unsigned int timeBucket(double elapsed)
+{
+	/// The return value
+	unsigned int bucket = 0;
+	/// The bound of the bucket
+	double bound = DETECT_TIME_BUCKET_BASE;
+
+	while(bucket < DETECT_TIME_BUCKETS - 1 && elapsed >= bound) {
+		bucket++;
+		bound *= 2;
+	}
+
+	return bucket;
+}
+
+void pushEvent(DetectContext *context, const DetectEvent *event)
+{
+	if(context->eventsCount == DETECT_EVENTS_SIZE) {
+		context->stats.eventsLost++;
+		return;
+	}
+
+	unsigned int tail = (context->eventsHead + context->eventsCount) %
+			DETECT_EVENTS_SIZE;
+	context->events[tail] = *event;
+	context->events[tail].position = context->position;
+	context->eventsCount++;
+}
+
+void resetNote(DetectContext *context)
+{
+	if(context->lastDetected != INVALID_SEMITONE) {
+		pushSimpleEvent(context, DETECT_EVENT_SILENCE);
 	}
+
+	context->lastDetected = INVALID_SEMITONE;
+}
+
+void resetChord(DetectContext *context)
+{
+	if(!context->chordCount) {
+		return;
+	}
+
+	DetectEvent event;
+	event.type = DETECT_EVENT_NOTES;
+	event.count = 0;
+	event.strings = context->tuning.strings;
+	for(int i = 0; i < GUITAR_MAX_STRINGS; i++) {
+		event.frets[i] = -1;
+	}
+	pushEvent(context, &event);
+
+	context->chordCount = 0;
+	context->stats.chords++;
+}
+
+void resetChordName(DetectContext *context)
+{
+	if(context->chroma) {
+		chromaReset(context->chroma);
+	}
+
+	if(context->chordName.root == INVALID_SEMITONE) {
+		return;
+	}
+
+	DetectEvent event;
+	event.type = DETECT_EVENT_CHORD;
+	event.chord.root = INVALID_SEMITONE;
+	event.strings = context->tuning.strings;
+	for(int i = 0; i < GUITAR_MAX_STRINGS; i++) {
+		event.frets[i] = -1;
+	}
+	pushEvent(context, &event);
+
+	context->chordName.root = INVALID_SEMITONE;
+	context->stats.chordNames++;
+}
+
+void reportAnomaly(DetectContext *context, FlightTrigger trigger)
+{
+	if(!context->flight || (context->anomalyReported &&
+			context->position - context->lastAnomaly <
+			context->anomalyInterval)) {
+		return;
+	}
+
+	DetectEvent event;
+	event.type = DETECT_EVENT_ANOMALY;
+	event.trigger = trigger;
+	pushEvent(context, &event);
+
+	context->lastAnomaly = context->position;
+	context->anomalyReported = 1;
+}
+
+double amplitudeThreshold(const DetectContext *context)
+{
+	/// The peak of a sinusoid at the level of the gate
+	double gatePeak = sqrt(2) * preprocessGate(&context->preprocessor);
+
+	return gatePeak > NOISE_THRESHOLD ? gatePeak : NOISE_THRESHOLD;
+}
+
+void preprocess(DetectContext *context, float *buf, size_t end)
+{
+	size_t i = context->preprocessedEnd > context->position ?
+			context->preprocessedEnd - context->position : 0;
+
+	while(i < end) {
+		/// The position of the piece in the stream
+		size_t position = context->position + i;
+		/// The offset of the piece in its block
+		size_t offset = position % context->block;
+		/// The samples of the piece, up to the end of the block
+		size_t n = context->block - offset;
+		/// The element of the envelope for the block
+		float *peak = &context->envelope[(position / context->block) &
+				context->envelopeMask];
+
+		if(n > end - i) {
+			n = end - i;
+		}
+
+		// The recorder keeps the samples before they are filtered in place
+		if(context->flight) {
+			flightAudio(context->flight, buf + i, n);
+		}
+
+		int open = preprocessBlock(&context->preprocessor, buf + i, n);
+		i += n;
+
+		// The preprocessor has replaced the invalid samples with silence
+		if(context->preprocessor.invalid) {
+			context->stats.invalidBlocks++;
+			reportAnomaly(context, FLIGHT_TRIGGER_NAN);
+		}
+
+		if(!offset || context->preprocessor.peak > *peak) {
+			*peak = context->preprocessor.peak;
+		}
+
+		if(context->stats.idle) {
+			context->stats.idleBlocks++;
+		}
+
+		if(open) {
+			context->quietSamples = 0;
+
+			if(context->stats.idle) {
+				context->stats.idle = 0;
+				pushSimpleEvent(context, DETECT_EVENT_ACTIVE);
+			}
+		} else {
+			context->quietSamples += n;
+
+			if(!context->stats.idle && context->idleSamples &&
+					context->quietSamples >= context->idleSamples) {
+				resetNote(context);
+				resetChord(context);
+				resetChordName(context);
+				context->stats.idle = 1;
+				pushSimpleEvent(context, DETECT_EVENT_IDLE);
+			}
+		}
+	}
+
+	context->preprocessedEnd = context->position + end;
+}
+
+void pushSimpleEvent(DetectContext *context, DetectEventType type)
+{
+	DetectEvent event;
+	event.type = type;
+	pushEvent(context, &event);
 }
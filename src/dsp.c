@@ -0,0 +1,409 @@
+/**
+ * @file dsp.c
+ * @brief Vectorized primitives on blocks of samples.
+ */
+
+#include "dsp.h"
+
+// sqrtf, fabsf, fmaxf, sin, cos, sqrt, M_PI
+#include <math.h>
+
+// assert
+#include <assert.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#	define DSP_SSE 1
+	// _mm_loadu_ps, _mm_add_ps, _mm_mul_ps, _mm_castsi128_ps...
+#	include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#	define DSP_NEON 1
+	// vld1q_f32, vmlaq_f32...
+#	include <arm_neon.h>
+#endif
+
+float dspSumSquares(const float *x, size_t n)
+{
+	/// The index of the first sample that the vector loop didn't process
+	size_t i = 0;
+	/// The result
+	float sum;
+
+#if DSP_SSE
+	// Two accumulators hide the latency of the additions
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	float lanes[4];
+
+	for(; i + 8 <= n; i += 8) {
+		__m128 a = _mm_loadu_ps(x + i);
+		__m128 b = _mm_loadu_ps(x + i + 4);
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(a, a));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(b, b));
+	}
+
+	_mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif DSP_NEON
+	float32x4_t acc0 = vdupq_n_f32(0);
+	float32x4_t acc1 = vdupq_n_f32(0);
+	float lanes[4];
+
+	for(; i + 8 <= n; i += 8) {
+		float32x4_t a = vld1q_f32(x + i);
+		float32x4_t b = vld1q_f32(x + i + 4);
+		acc0 = vmlaq_f32(acc0, a, a);
+		acc1 = vmlaq_f32(acc1, b, b);
+	}
+
+	vst1q_f32(lanes, vaddq_f32(acc0, acc1));
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#else
+	/* Independent accumulators let the compiler vectorize the loop and the
+	CPU run the additions in parallel. */
+	float acc[4] = {0, 0, 0, 0};
+
+	for(; i + 4 <= n; i += 4) {
+		acc[0] += x[i] * x[i];
+		acc[1] += x[i + 1] * x[i + 1];
+		acc[2] += x[i + 2] * x[i + 2];
+		acc[3] += x[i + 3] * x[i + 3];
+	}
+
+	sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#endif
+
+	for(; i < n; i++) {
+		sum += x[i] * x[i];
+	}
+
+	return sum;
+}
+
+float dspRms(const float *x, size_t n)
+{
+	if(!n) {
+		return 0;
+	}
+
+	return sqrtf(dspSumSquares(x, n) / n);
+}
+
+float dspGainMeasure(float *x, size_t n, float gain, float step, float *peak)
+{
+	/// The index of the first sample that the vector loop didn't process
+	size_t i = 0;
+	/// The result
+	float sum;
+	/// The maximum absolute value after the gain
+	float max;
+
+#if DSP_SSE
+	// Clearing the sign bit gives the absolute value
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	__m128 acc = _mm_setzero_ps();
+	__m128 maxAcc = _mm_setzero_ps();
+	__m128 gains = _mm_setr_ps(gain, gain + step, gain + 2 * step,
+			gain + 3 * step);
+	__m128 gainStep = _mm_set1_ps(4 * step);
+	float lanes[4];
+	float maxLanes[4];
+
+	for(; i + 4 <= n; i += 4) {
+		__m128 a = _mm_loadu_ps(x + i);
+		__m128 y = _mm_mul_ps(a, gains);
+		acc = _mm_add_ps(acc, _mm_mul_ps(a, a));
+		maxAcc = _mm_max_ps(maxAcc, _mm_and_ps(y, absMask));
+		_mm_storeu_ps(x + i, y);
+		gains = _mm_add_ps(gains, gainStep);
+	}
+
+	_mm_storeu_ps(lanes, acc);
+	_mm_storeu_ps(maxLanes, maxAcc);
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif DSP_NEON
+	const float first[4] = {gain, gain + step, gain + 2 * step,
+			gain + 3 * step};
+	float32x4_t acc = vdupq_n_f32(0);
+	float32x4_t maxAcc = vdupq_n_f32(0);
+	float32x4_t gains = vld1q_f32(first);
+	float32x4_t gainStep = vdupq_n_f32(4 * step);
+	float lanes[4];
+	float maxLanes[4];
+
+	for(; i + 4 <= n; i += 4) {
+		float32x4_t a = vld1q_f32(x + i);
+		float32x4_t y = vmulq_f32(a, gains);
+		acc = vmlaq_f32(acc, a, a);
+		maxAcc = vmaxq_f32(maxAcc, vabsq_f32(y));
+		vst1q_f32(x + i, y);
+		gains = vaddq_f32(gains, gainStep);
+	}
+
+	vst1q_f32(lanes, acc);
+	vst1q_f32(maxLanes, maxAcc);
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#else
+	float acc[4] = {0, 0, 0, 0};
+	float maxLanes[4] = {0, 0, 0, 0};
+
+	for(; i + 4 <= n; i += 4) {
+		for(int j = 0; j < 4; j++) {
+			acc[j] += x[i + j] * x[i + j];
+			x[i + j] *= gain + (i + j) * step;
+			maxLanes[j] = fmaxf(maxLanes[j], fabsf(x[i + j]));
+		}
+	}
+
+	sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#endif
+
+	max = fmaxf(fmaxf(maxLanes[0], maxLanes[1]),
+			fmaxf(maxLanes[2], maxLanes[3]));
+
+	for(; i < n; i++) {
+		sum += x[i] * x[i];
+		x[i] *= gain + i * step;
+		max = fmaxf(max, fabsf(x[i]));
+	}
+
+	if(peak) {
+		*peak = max;
+	}
+
+	return sum;
+}
+
+void dspBiquadLowPass(DspBiquad *biquad, double frequency, double rate)
+{
+	assert(biquad);
+	assert(frequency > 0 && frequency < rate / 2);
+
+	double w0 = 2 * M_PI * frequency / rate;
+	// Q = 1 / sqrt(2) for a Butterworth response
+	double alpha = sin(w0) / sqrt(2);
+	double a0 = 1 + alpha;
+
+	biquad->b0 = (float) ((1 - cos(w0)) / 2 / a0);
+	biquad->b1 = (float) ((1 - cos(w0)) / a0);
+	biquad->b2 = biquad->b0;
+	biquad->a1 = (float) (-2 * cos(w0) / a0);
+	biquad->a2 = (float) ((1 - alpha) / a0);
+}
+
+void dspBiquadHighPass(DspBiquad *biquad, double frequency, double rate)
+{
+	assert(biquad);
+	assert(frequency > 0 && frequency < rate / 2);
+
+	double w0 = 2 * M_PI * frequency / rate;
+	// Q = 1 / sqrt(2) for a Butterworth response
+	double alpha = sin(w0) / sqrt(2);
+	double a0 = 1 + alpha;
+
+	biquad->b0 = (float) ((1 + cos(w0)) / 2 / a0);
+	biquad->b1 = (float) (-(1 + cos(w0)) / a0);
+	biquad->b2 = biquad->b0;
+	biquad->a1 = (float) (-2 * cos(w0) / a0);
+	biquad->a2 = (float) ((1 - alpha) / a0);
+}
+
+void dspBiquadDcBlocker(DspBiquad *biquad, double frequency, double rate)
+{
+	assert(biquad);
+	assert(frequency > 0 && frequency < rate / 2);
+
+	biquad->b0 = 1;
+	biquad->b1 = -1;
+	biquad->b2 = 0;
+	biquad->a1 = (float) -(1 - 2 * M_PI * frequency / rate);
+	biquad->a2 = 0;
+}
+
+void dspBiquadPreEmphasis(DspBiquad *biquad, float coefficient)
+{
+	assert(biquad);
+
+	biquad->b0 = 1;
+	biquad->b1 = -coefficient;
+	biquad->b2 = 0;
+	biquad->a1 = 0;
+	biquad->a2 = 0;
+}
+
+void dspCascadeInit(DspCascade *cascade)
+{
+	assert(cascade);
+
+	DspBiquad identity = {1, 0, 0, 0, 0};
+
+	for(unsigned int i = 0; i < DSP_CASCADE_STAGES; i++) {
+		dspCascadeSet(cascade, i, &identity);
+	}
+	dspCascadeReset(cascade);
+}
+
+void dspCascadeReset(DspCascade *cascade)
+{
+	assert(cascade);
+
+	for(unsigned int i = 0; i < DSP_CASCADE_STAGES; i++) {
+		cascade->z1[i] = 0;
+		cascade->z2[i] = 0;
+		cascade->out[i] = 0;
+	}
+}
+
+void dspCascadeSet(DspCascade *cascade, unsigned int stage,
+		const DspBiquad *biquad)
+{
+	assert(cascade);
+	assert(stage < DSP_CASCADE_STAGES);
+	assert(biquad);
+
+	cascade->b0[stage] = biquad->b0;
+	cascade->b1[stage] = biquad->b1;
+	cascade->b2[stage] = biquad->b2;
+	cascade->a1[stage] = biquad->a1;
+	cascade->a2[stage] = biquad->a2;
+}
+
+void dspCascadeProcess(DspCascade *cascade, float *x, size_t n)
+{
+	assert(cascade);
+
+#if DSP_SSE
+	const __m128 b0 = _mm_loadu_ps(cascade->b0);
+	const __m128 b1 = _mm_loadu_ps(cascade->b1);
+	const __m128 b2 = _mm_loadu_ps(cascade->b2);
+	const __m128 a1 = _mm_loadu_ps(cascade->a1);
+	const __m128 a2 = _mm_loadu_ps(cascade->a2);
+	__m128 z1 = _mm_loadu_ps(cascade->z1);
+	__m128 z2 = _mm_loadu_ps(cascade->z2);
+	__m128 out = _mm_loadu_ps(cascade->out);
+
+	for(size_t i = 0; i < n; i++) {
+		// {x[i], out[0], out[1], out[2]}: each stage takes the previous output
+		__m128 in = _mm_move_ss(_mm_shuffle_ps(out, out,
+				_MM_SHUFFLE(2, 1, 0, 3)), _mm_set_ss(x[i]));
+
+		out = _mm_add_ps(_mm_mul_ps(b0, in), z1);
+		z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, in), _mm_mul_ps(a1, out)),
+				z2);
+		z2 = _mm_sub_ps(_mm_mul_ps(b2, in), _mm_mul_ps(a2, out));
+
+		x[i] = _mm_cvtss_f32(_mm_shuffle_ps(out, out,
+				_MM_SHUFFLE(3, 3, 3, 3)));
+	}
+
+	_mm_storeu_ps(cascade->z1, z1);
+	_mm_storeu_ps(cascade->z2, z2);
+	_mm_storeu_ps(cascade->out, out);
+#elif DSP_NEON
+	const float32x4_t b0 = vld1q_f32(cascade->b0);
+	const float32x4_t b1 = vld1q_f32(cascade->b1);
+	const float32x4_t b2 = vld1q_f32(cascade->b2);
+	const float32x4_t a1 = vld1q_f32(cascade->a1);
+	const float32x4_t a2 = vld1q_f32(cascade->a2);
+	float32x4_t z1 = vld1q_f32(cascade->z1);
+	float32x4_t z2 = vld1q_f32(cascade->z2);
+	float32x4_t out = vld1q_f32(cascade->out);
+
+	for(size_t i = 0; i < n; i++) {
+		// {x[i], out[0], out[1], out[2]}: each stage takes the previous output
+		float32x4_t in = vextq_f32(vdupq_n_f32(x[i]), out, 3);
+
+		out = vmlaq_f32(z1, b0, in);
+		z1 = vmlsq_f32(vmlaq_f32(z2, b1, in), a1, out);
+		z2 = vmlsq_f32(vmulq_f32(b2, in), a2, out);
+
+		x[i] = vgetq_lane_f32(out, 3);
+	}
+
+	vst1q_f32(cascade->z1, z1);
+	vst1q_f32(cascade->z2, z2);
+	vst1q_f32(cascade->out, out);
+#else
+	for(size_t i = 0; i < n; i++) {
+		float in[DSP_CASCADE_STAGES];
+
+		in[0] = x[i];
+		for(int s = 1; s < DSP_CASCADE_STAGES; s++) {
+			in[s] = cascade->out[s - 1];
+		}
+
+		for(int s = 0; s < DSP_CASCADE_STAGES; s++) {
+			float y = cascade->b0[s] * in[s] + cascade->z1[s];
+			cascade->z1[s] = cascade->b1[s] * in[s] - cascade->a1[s] * y +
+					cascade->z2[s];
+			cascade->z2[s] = cascade->b2[s] * in[s] - cascade->a2[s] * y;
+			cascade->out[s] = y;
+		}
+
+		x[i] = cascade->out[DSP_CASCADE_STAGES - 1];
+	}
+#endif
+}
+
+void dspFftTwiddles(float *twiddles, size_t n)
+{
+	assert(twiddles);
+	assert(n >= 2 && !(n & (n - 1)));
+
+	for(size_t len = 2; len <= n; len <<= 1) {
+		for(size_t k = 0; k < len / 2; k++) {
+			double angle = -2 * M_PI * k / len;
+			twiddles[len / 2 + k] = (float) cos(angle);
+			twiddles[n + len / 2 + k] = (float) sin(angle);
+		}
+	}
+}
+
+void dspFft(float *re, float *im, const float *twiddles, size_t n)
+{
+	assert(re && im && twiddles);
+	assert(n >= 2 && !(n & (n - 1)));
+
+	// Bit-reversal permutation, with j the reverse of i
+	for(size_t i = 1, j = 0; i < n; i++) {
+		size_t bit = n >> 1;
+		for(; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+
+		if(i < j) {
+			float t = re[i];
+			re[i] = re[j];
+			re[j] = t;
+			t = im[i];
+			im[i] = im[j];
+			im[j] = t;
+		}
+	}
+
+	for(size_t len = 2; len <= n; len <<= 1) {
+		/// The half of the butterflies of this stage
+		size_t half = len / 2;
+		/// The real parts of the twiddle factors of this stage
+		const float *wr = twiddles + half;
+		/// The imaginary parts of the twiddle factors of this stage
+		const float *wi = twiddles + n + half;
+
+		for(size_t i = 0; i < n; i += len) {
+			float *ar = re + i;
+			float *ai = im + i;
+			float *br = re + i + half;
+			float *bi = im + i + half;
+
+			// The loop has no dependencies, so the compiler can vectorize it
+			for(size_t k = 0; k < half; k++) {
+				float tr = br[k] * wr[k] - bi[k] * wi[k];
+				float ti = br[k] * wi[k] + bi[k] * wr[k];
+				br[k] = ar[k] - tr;
+				bi[k] = ai[k] - ti;
+				ar[k] += tr;
+				ai[k] += ti;
+			}
+		}
+	}
+}
@@ -0,0 +1,69 @@
+/**
+ * @file endian_utils.c
+ * @brief Store and read numbers in little endian, whatever the platform.
+ */
+
+#include "endian_utils.h"
+
+// memcpy
+#include <string.h>
+
+void storeLe32(unsigned char *dest, uint32_t value)
+{
+	dest[0] = (unsigned char) value;
+	dest[1] = (unsigned char) (value >> 8);
+	dest[2] = (unsigned char) (value >> 16);
+	dest[3] = (unsigned char) (value >> 24);
+}
+
+void storeLe64(unsigned char *dest, uint64_t value)
+{
+	storeLe32(dest, (uint32_t) value);
+	storeLe32(dest + 4, (uint32_t) (value >> 32));
+}
+
+void storeFloat(unsigned char *dest, float value)
+{
+	uint32_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	storeLe32(dest, bits);
+}
+
+uint32_t loadLe32(const unsigned char *src)
+{
+	return src[0] | src[1] << 8 | src[2] << 16 | (uint32_t) src[3] << 24;
+}
+
+uint64_t loadLe64(const unsigned char *src)
+{
+	return loadLe32(src) | (uint64_t) loadLe32(src + 4) << 32;
+}
+
+float loadFloat(const unsigned char *src)
+{
+	uint32_t bits = loadLe32(src);
+	float value;
+
+	memcpy(&value, &bits, sizeof(value));
+
+	return value;
+}
+
+void storeDouble(unsigned char *dest, double value)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	storeLe64(dest, bits);
+}
+
+double loadDouble(const unsigned char *src)
+{
+	uint64_t bits = loadLe64(src);
+	double value;
+
+	memcpy(&value, &bits, sizeof(value));
+
+	return value;
+}
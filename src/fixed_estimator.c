@@ -0,0 +1,380 @@
+/**
+ * @file fixed_estimator.c
+ * @brief Estimate the period of a signal with integer arithmetic only.
+ *
+ * The algorithm is the same as period_estimator.c, step by step, so the two
+ * can be compared.
+ */
+
+#include "fixed_estimator.h"
+
+// INT16_MAX, INT16_MIN, INT32_MAX, INT64_C, uint64_t
+#include <stdint.h>
+
+// assert
+#include <assert.h>
+
+struct _FixedEstimator {
+	/**
+	 * @brief The configuration of the estimator.
+	 */
+	EstimatorConfig config;
+
+	/**
+	 * @brief The buffer of the normalized auto correlation, in Q30.
+	 *
+	 * It has maxP + 2 elements, like the one of estimatePeriod.
+	 */
+	int32_t *nac;
+};
+
+/**
+ * @brief Computes the normalized auto correlation of the lags of interest.
+ *
+ * @param x The signal
+ * @param n The number of samples in the signal
+ * @param minP The minimum period of interest
+ * @param maxP The maximum period of interest
+ * @param nac The array of the correlation
+ */
+static void computeNac(const int16_t *x, int n, int minP, int maxP,
+		int32_t *nac);
+
+/**
+ * @brief Normalize an autocorrelation by the energy of its two parts.
+ *
+ * @param ac The autocorrelation
+ * @param sumSqBeg The sum of squares of the beginning part
+ * @param sumSqEnd The sum of squares of the ending part
+ * @return ac / sqrt(sumSqBeg * sumSqEnd) in Q30, or 0 if a sum is 0
+ */
+static int32_t normalize(int64_t ac, uint64_t sumSqBeg, uint64_t sumSqEnd);
+
+/**
+ * @brief Shift a positive number to the left as much as possible, by an even
+ *  number of bits, without exceeding 62 bits.
+ *
+ * @param v The number, which is changed
+ * @return Half of the shift, that is the shift of its square root
+ */
+static int scaleForRoot(uint64_t *v);
+
+/**
+ * @brief Get the number of bits of a number.
+ *
+ * @param v The number
+ * @return The position of the highest bit set plus 1, or 0 if v is 0
+ */
+static int bitLength(uint64_t v);
+
+/**
+ * @brief Computes the integer part of the square root of a number.
+ *
+ * @param v The number
+ * @return The square root, rounded down
+ */
+static uint32_t isqrt64(uint64_t v);
+
+/**
+ * @brief Find the peak of the auto correlation in the range of interest.
+ *
+ * @param nac The array of the correlation
+ * @param minP The minimum period of interest
+ * @param maxP The maximum period of interest
+ * @param period Output parameter for the interpolated period, in Q16.16
+ * @return The index of the element with the maximum auto correlation, or -1
+ *  if it is not a peak
+ */
+static int findPeak(const int32_t *nac, int minP, int maxP, int32_t *period);
+
+/**
+ * @brief Interpolate the position of a peak with its neighbours.
+ *
+ * @param nac The array of the correlation
+ * @param best The index of the peak
+ * @return The interpolated period, in Q16.16
+ */
+static int32_t interpolatePeak(const int32_t *nac, int best);
+
+/**
+ * @brief Check for and correct the octave errors.
+ * @sa fixOctaves of period_estimator.c
+ *
+ * @param nac The array of the correlation
+ * @param minP The minimum period of interest
+ * @param period The estimated period, in Q16.16
+ * @param maxNac The index of the element that has maximum auto correlation
+ * @return The (eventually) changed period
+ */
+static int32_t fixOctaves(const int32_t *nac, int minP, int32_t period,
+		int maxNac);
+
+size_t fixedMemorySize(const EstimatorConfig *config)
+{
+	return ARENA_ALIGN(sizeof(FixedEstimator)) +
+			ARENA_ALIGN((config->maxP + 2) * sizeof(int32_t));
+}
+
+FixedEstimator *fixedCreate(Arena *arena, const EstimatorConfig *config)
+{
+	assert(arena);
+	assert(config);
+	assert(config->minP > 1);
+	assert(config->maxP > config->minP);
+	assert(config->gridStep == 0 && config->periods == 0);
+
+	/// The instance that will be returned
+	FixedEstimator *ret = arenaAlloc(arena, sizeof(FixedEstimator));
+	if(!ret) {
+		return 0;
+	}
+
+	ret->config = *config;
+
+	// See estimatePeriod for the size of the buffer
+	ret->nac = arenaAlloc(arena, (config->maxP + 2) * sizeof(int32_t));
+	if(!ret->nac) {
+		return 0;
+	}
+
+	return ret;
+}
+
+int32_t fixedRun(FixedEstimator *estimator, const int16_t *x, int n,
+		int32_t *q, int *periodInt)
+{
+	assert(estimator);
+	assert(x);
+	assert(q);
+	assert(n >= 2 * estimator->config.maxP);
+
+	/// The minimum period of interest
+	int minP = estimator->config.minP;
+	/// The maximum period of interest
+	int maxP = estimator->config.maxP;
+	/// The array of the correlation
+	int32_t *nac = estimator->nac;
+	/// The interpolated period
+	int32_t period;
+
+	*q = 0;
+
+	computeNac(x, n, minP, maxP, nac);
+
+	/// The index of the peak
+	int maxNac = findPeak(nac, minP, maxP, &period);
+	if(maxNac == -1) {
+		return 0;
+	}
+
+	*q = nac[maxNac];
+
+	if(periodInt) {
+		*periodInt = maxNac;
+	}
+
+	return fixOctaves(nac, minP, period, maxNac);
+}
+
+void fixedFromFloat(const float *x, int16_t *out, int n)
+{
+	assert(x);
+	assert(out);
+
+	for(int i = 0; i < n; i++) {
+		/// The sample in Q15, rounded to the nearest integer
+		float v = x[i] * 32767.0f;
+		v += v < 0 ? -0.5f : 0.5f;
+
+		if(v >= 32767.0f) {
+			out[i] = INT16_MAX;
+		} else if(v <= -32768.0f) {
+			out[i] = INT16_MIN;
+		} else {
+			out[i] = (int16_t) v;
+		}
+	}
+}
+
+static void computeNac(const int16_t *x, int n, int minP, int maxP,
+		int32_t *nac)
+{
+	/// Sum of squares of beginning part
+	uint64_t sumSqBeg = 0;
+	/// Sum of squares of ending part, see computeNac of period_estimator.c
+	uint64_t sumSqEnd = (int32_t) x[minP - 2] * x[minP - 2];
+
+	for(int i = 0, j = minP - 1; i < n - minP + 1; i++, j++) {
+		sumSqBeg += (int32_t) x[i] * x[i];
+		sumSqEnd += (int32_t) x[j] * x[j];
+	}
+
+	for(int p = minP - 1; p <= maxP + 1; p++) {
+		/// Standard auto-correlation
+		int64_t ac = 0;
+
+		sumSqBeg -= (int32_t) x[n - p] * x[n - p];
+		sumSqEnd -= (int32_t) x[p - 1] * x[p - 1];
+
+		// Each product fits in 31 bits, the sum of the window needs 64 bits
+		for(int i = 0; i < n - p; i++) {
+			ac += (int32_t) x[i] * x[i + p];
+		}
+
+		nac[p] = normalize(ac, sumSqBeg, sumSqEnd);
+	}
+}
+
+static int32_t normalize(int64_t ac, uint64_t sumSqBeg, uint64_t sumSqEnd)
+{
+	if(sumSqBeg == 0 || sumSqEnd == 0) {
+		return 0;
+	}
+
+	/* The roots are computed on the sums scaled to 62 bits, so they have 31
+	significant bits, and their product still fits in 64 bits. */
+	int shift = FIXED_NAC_SHIFT + scaleForRoot(&sumSqBeg) +
+			scaleForRoot(&sumSqEnd);
+	uint64_t den = (uint64_t) isqrt64(sumSqBeg) * isqrt64(sumSqEnd);
+
+	/// The absolute value of the numerator
+	uint64_t num = ac < 0 ? (uint64_t) -ac : (uint64_t) ac;
+
+	// The numerator is shifted only as long as it fits, then den is shifted
+	int headroom = 62 - bitLength(num);
+	if(shift > headroom) {
+		den >>= shift - headroom;
+		shift = headroom;
+	}
+	if(den == 0) {
+		return 0;
+	}
+
+	/// The absolute value of the result
+	uint64_t ret = (num << shift) / den;
+	if(ret > INT32_MAX) {
+		ret = INT32_MAX;
+	}
+
+	return ac < 0 ? -(int32_t) ret : (int32_t) ret;
+}
+
+static int scaleForRoot(uint64_t *v)
+{
+	int shift = (62 - bitLength(*v)) / 2;
+	*v <<= 2 * shift;
+	return shift;
+}
+
+static int bitLength(uint64_t v)
+{
+	int ret = 0;
+
+	while(v) {
+		v >>= 1;
+		ret++;
+	}
+
+	return ret;
+}
+
+static uint32_t isqrt64(uint64_t v)
+{
+	/// The root computed so far
+	uint64_t root = 0;
+	/// The highest power of 4 that is not greater than v
+	uint64_t bit = (uint64_t) 1 << 62;
+
+	while(bit > v) {
+		bit >>= 2;
+	}
+
+	while(bit) {
+		if(v >= root + bit) {
+			v -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return (uint32_t) root;
+}
+
+static int findPeak(const int32_t *nac, int minP, int maxP, int32_t *period)
+{
+	/// The return value
+	int best = minP;
+
+	for(int p = minP; p <= maxP; p++) {
+		if(nac[p] > nac[best]) {
+			best = p;
+		}
+	}
+
+	/*  Give up if it's highest value, but not actually a peak.
+	This can happen if the period is outside the range [minP, maxP] */
+	if(nac[best] < nac[best - 1] && nac[best] < nac[best + 1]) {
+		return -1;
+	}
+
+	*period = interpolatePeak(nac, best);
+
+	return best;
+}
+
+static int32_t interpolatePeak(const int32_t *nac, int best)
+{
+	/// The interpolated period
+	int32_t period = (int32_t) best << FIXED_PERIOD_SHIFT;
+
+	int64_t mid   = nac[best];
+	int64_t left  = nac[best - 1];
+	int64_t right = nac[best + 1];
+	int64_t den = 2 * mid - left - right;
+
+	if(den != 0) {
+		// 0.5 * (right - left) / den, in Q16.16
+		int64_t shift = ((right - left) * (INT64_C(1) << (FIXED_PERIOD_SHIFT -
+				1))) / den;
+
+		// The shift is ignored when it is not less than 0.2 * best
+		if(5 * (shift < 0 ? -shift : shift) <
+				((int64_t) best << FIXED_PERIOD_SHIFT)) {
+			period += (int32_t) shift;
+		}
+	}
+
+	return period;
+}
+
+static int32_t fixOctaves(const int32_t *nac, int minP, int32_t period,
+		int maxNac)
+{
+	/// The rounding of the submultiples to the nearest integer
+	const int64_t half = INT64_C(1) << (FIXED_PERIOD_SHIFT - 1);
+
+	//  For each possible multiple error (starting with the biggest)
+	int maxMul = maxNac / minP;
+	for(int mul = maxMul; mul >= 1; mul--) {
+		// Check whether all submultiples of original peak are nearly as strong
+		int subsAllStrong = 1;
+
+		for(int k = 1; subsAllStrong && k < mul; k++) {
+			int subMulP = (int) (((int64_t) k * period / mul + half) >>
+					FIXED_PERIOD_SHIFT);
+
+			// The threshold is 0.9 of the peak
+			if(10 * (int64_t) nac[subMulP] < 9 * (int64_t) nac[maxNac]) {
+				subsAllStrong = 0;
+			}
+		}
+
+		if(subsAllStrong) {
+			return period / mul;
+		}
+	}
+
+	return period;
+}
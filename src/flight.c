@@ -0,0 +1,492 @@
+/**
+ * @file flight.c
+ * @brief Keep the last seconds of the detection in memory, to dump them when
+ *  something goes wrong.
+ *
+ * The dumps are little endian, whatever the platform:
+ *  - a header of FLIGHT_HEADER_SIZE bytes: the magic "GBFR", the version, the
+ *    sample rate, the hop and the trigger on 32 bits, and the position of the
+ *    first sample, the number of samples and the number of records on 64
+ *    bits;
+ *  - the options of the detection, in FLIGHT_OPTIONS_SIZE bytes: the idle
+ *    timeout as a 64 bits float, the gate ratio as a 32 bits float, the AGC
+ *    on 32 bits, the DC blocker and the high-pass as 64 bits floats, the
+ *    pre-emphasis as a 32 bits float, the strings and the frets of the tuning
+ *    on 32 bits, its open strings on 16 bits each, the reference and the grid
+ *    step as 64 bits floats, and the window periods, the bands, the float
+ *    sums, the fixed point, the polyphony and the chords on 32 bits;
+ *  - the samples, as 32 bits floats;
+ *  - the records, of FLIGHT_RECORD_SIZE bytes each: the position on 64 bits,
+ *    the period, the quality and the elapsed time as 32 bits floats, the note
+ *    on 16 bits, the tier and the decision on 8 bits.
+ */
+
+#include "flight.h"
+
+// storeLe32, storeLe64, storeFloat, storeDouble, loadLe32, loadLe64,
+// loadFloat, loadDouble
+#include "endian_utils.h"
+
+// fopen, fwrite, fread, fclose, rename, remove, snprintf
+#include <stdio.h>
+// malloc, free
+#include <stdlib.h>
+// memcpy, memcmp, memset
+#include <string.h>
+// uint16_t, uint32_t, uint64_t
+#include <stdint.h>
+// assert
+#include <assert.h>
+
+/**
+ * @brief The magic number at the beginning of the dumps.
+ */
+static const char FLIGHT_MAGIC[4] = {'G', 'B', 'F', 'R'};
+
+/**
+ * @brief The version of the format of the dumps.
+ */
+static const uint32_t FLIGHT_VERSION = 3;
+
+/**
+ * @brief The size of the options of the detection in the dumps, in bytes.
+ */
+#define FLIGHT_OPTIONS_SIZE (84 + 2 * GUITAR_MAX_STRINGS)
+
+/**
+ * @brief The size of the header of the dumps, in bytes.
+ */
+#define FLIGHT_HEADER_SIZE (44 + FLIGHT_OPTIONS_SIZE)
+
+/**
+ * @brief The size of a record in the dumps, in bytes.
+ */
+#define FLIGHT_RECORD_SIZE 24
+
+/**
+ * @brief The number of samples that are converted for each write.
+ */
+#define FLIGHT_CHUNK 1024
+
+/**
+ * @brief The maximum length of the path of a dump, with the extension of the
+ *  temporary file.
+ */
+#define FLIGHT_PATH_SIZE 4096
+
+/**
+ * @brief The names of the triggers.
+ */
+static const char *TRIGGER_NAMES[FLIGHT_TRIGGERS] = {
+	"request", "overflow", "nan", "deadline"
+};
+
+/**
+ * @brief The names of the decisions.
+ */
+static const char *DECISION_NAMES[FLIGHT_DECISIONS] = {
+	"gate", "quality", "unplayable", "silence", "same", "note"
+};
+
+struct _FlightRecorder {
+	/**
+	 * @brief The configuration of the recorder.
+	 */
+	FlightConfig config;
+
+	/**
+	 * @brief The circular buffer of the samples, with config.samples
+	 *  elements.
+	 */
+	float *samples;
+
+	/**
+	 * @brief The circular buffer of the records, with config.records
+	 *  elements.
+	 */
+	FlightRecord *records;
+
+	/**
+	 * @brief The number of samples added since the creation.
+	 *
+	 * The next sample is written at this index modulo the capacity.
+	 */
+	size_t sampleCount;
+
+	/**
+	 * @brief The number of records added since the creation.
+	 */
+	size_t recordCount;
+};
+
+/**
+ * @brief Store the options of the detection.
+ *
+ * @param dest The first byte, followed by FLIGHT_OPTIONS_SIZE bytes
+ * @param options The options
+ */
+static void storeOptions(unsigned char *dest, const FlightOptions *options);
+
+/**
+ * @brief Read the options of the detection.
+ *
+ * @param src The first byte, followed by FLIGHT_OPTIONS_SIZE bytes
+ * @param options Output parameter for the options
+ */
+static void loadOptions(const unsigned char *src, FlightOptions *options);
+
+/**
+ * @brief Write the content of the recorder to an open file.
+ *
+ * @param recorder The recorder
+ * @param fp The file
+ * @param trigger The cause of the dump
+ * @return 0 on success, -1 in case of error
+ */
+static int writeDump(const FlightRecorder *recorder, FILE *fp,
+		FlightTrigger trigger);
+
+void flightConfigInit(FlightConfig *config, unsigned int rate,
+		unsigned int hop, double seconds)
+{
+	assert(config);
+
+	config->rate = rate;
+	config->hop = hop;
+	config->samples = (size_t) (seconds * rate);
+	// Each hop produces at most a record
+	config->records = hop ? config->samples / hop + 1 : 0;
+	memset(&config->options, 0, sizeof(config->options));
+}
+
+size_t flightMemorySize(const FlightConfig *config)
+{
+	if(!config || !config->rate || !config->hop || !config->samples ||
+			!config->records) {
+		return 0;
+	}
+
+	return ARENA_ALIGN(sizeof(FlightRecorder)) +
+			ARENA_ALIGN(config->samples * sizeof(float)) +
+			ARENA_ALIGN(config->records * sizeof(FlightRecord));
+}
+
+FlightRecorder *flightCreate(Arena *arena, const FlightConfig *config)
+{
+	if(!arena || !flightMemorySize(config)) {
+		return 0;
+	}
+
+	/// The instance that will be returned
+	FlightRecorder *ret = arenaAlloc(arena, sizeof(FlightRecorder));
+	if(!ret) {
+		return 0;
+	}
+
+	ret->config = *config;
+	ret->samples = arenaAlloc(arena, config->samples * sizeof(float));
+	ret->records = arenaAlloc(arena, config->records * sizeof(FlightRecord));
+	if(!ret->samples || !ret->records) {
+		return 0;
+	}
+
+	ret->sampleCount = 0;
+	ret->recordCount = 0;
+
+	return ret;
+}
+
+void flightAudio(FlightRecorder *recorder, const float *samples,
+		size_t count)
+{
+	assert(recorder);
+	assert(samples || !count);
+
+	/// The capacity of the buffer
+	size_t capacity = recorder->config.samples;
+
+	if(count > capacity) {
+		recorder->sampleCount += count - capacity;
+		samples += count - capacity;
+		count = capacity;
+	}
+
+	while(count) {
+		/// The position of the next sample in the buffer
+		size_t offset = recorder->sampleCount % capacity;
+		/// The samples until the end of the buffer
+		size_t n = capacity - offset < count ? capacity - offset : count;
+
+		memcpy(recorder->samples + offset, samples, n * sizeof(float));
+		recorder->sampleCount += n;
+		samples += n;
+		count -= n;
+	}
+}
+
+void flightRecord(FlightRecorder *recorder, const FlightRecord *record)
+{
+	assert(recorder);
+	assert(record);
+
+	recorder->records[recorder->recordCount % recorder->config.records] =
+			*record;
+	recorder->recordCount++;
+}
+
+int flightDump(const FlightRecorder *recorder, const char *path,
+		FlightTrigger trigger)
+{
+	assert(recorder);
+	assert(path);
+
+	/// The path of the temporary file
+	char tmp[FLIGHT_PATH_SIZE];
+	/// The temporary file
+	FILE *fp;
+	/// The result of the writes
+	int err;
+
+	if(snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int) sizeof(tmp)) {
+		return -1;
+	}
+
+	fp = fopen(tmp, "wb");
+	if(!fp) {
+		return -1;
+	}
+
+	err = writeDump(recorder, fp, trigger);
+	if(fclose(fp)) {
+		err = -1;
+	}
+
+	// The file appears with its final name only when it is complete
+	if(err || rename(tmp, path)) {
+		remove(tmp);
+		return -1;
+	}
+
+	return 0;
+}
+
+FlightDump *flightLoad(const char *path)
+{
+	/// The file of the dump
+	FILE *fp = fopen(path, "rb");
+	/// The header
+	unsigned char header[FLIGHT_HEADER_SIZE];
+	/// A sample or a record being read
+	unsigned char item[FLIGHT_RECORD_SIZE];
+	/// The dump that will be returned
+	FlightDump *ret;
+
+	if(!fp) {
+		return 0;
+	}
+
+	if(fread(header, 1, FLIGHT_HEADER_SIZE, fp) != FLIGHT_HEADER_SIZE ||
+			memcmp(header, FLIGHT_MAGIC, sizeof(FLIGHT_MAGIC)) ||
+			loadLe32(header + 4) != FLIGHT_VERSION ||
+			loadLe32(header + 16) >= FLIGHT_TRIGGERS) {
+		fclose(fp);
+		return 0;
+	}
+
+	ret = malloc(sizeof(FlightDump));
+	if(!ret) {
+		fclose(fp);
+		return 0;
+	}
+
+	ret->header.rate = loadLe32(header + 8);
+	ret->header.hop = loadLe32(header + 12);
+	ret->header.trigger = (FlightTrigger) loadLe32(header + 16);
+	ret->header.start = (size_t) loadLe64(header + 20);
+	ret->header.samples = (size_t) loadLe64(header + 28);
+	ret->header.records = (size_t) loadLe64(header + 36);
+	loadOptions(header + 44, &ret->header.options);
+
+	// One more element, so that empty dumps are not null
+	ret->samples = malloc((ret->header.samples + 1) * sizeof(float));
+	ret->records = malloc((ret->header.records + 1) * sizeof(FlightRecord));
+	if(!ret->samples || !ret->records) {
+		fclose(fp);
+		flightDumpFree(ret);
+		return 0;
+	}
+
+	for(size_t i = 0; i < ret->header.samples; i++) {
+		if(fread(item, 1, sizeof(float), fp) != sizeof(float)) {
+			fclose(fp);
+			flightDumpFree(ret);
+			return 0;
+		}
+		ret->samples[i] = loadFloat(item);
+	}
+
+	for(size_t i = 0; i < ret->header.records; i++) {
+		FlightRecord *record = &ret->records[i];
+
+		if(fread(item, 1, FLIGHT_RECORD_SIZE, fp) != FLIGHT_RECORD_SIZE) {
+			fclose(fp);
+			flightDumpFree(ret);
+			return 0;
+		}
+
+		record->position = (size_t) loadLe64(item);
+		record->period = loadFloat(item + 8);
+		record->quality = loadFloat(item + 12);
+		record->elapsed = loadFloat(item + 16);
+		record->note = (semitone_t) (item[20] | item[21] << 8);
+		record->tier = item[22];
+		record->decision = item[23];
+	}
+
+	fclose(fp);
+
+	return ret;
+}
+
+void flightDumpFree(FlightDump *dump)
+{
+	if(!dump) {
+		return;
+	}
+
+	free(dump->samples);
+	free(dump->records);
+	free(dump);
+}
+
+const char *flightTriggerName(FlightTrigger trigger)
+{
+	if(trigger < 0 || trigger >= FLIGHT_TRIGGERS) {
+		return "unknown";
+	}
+
+	return TRIGGER_NAMES[trigger];
+}
+
+const char *flightDecisionName(FlightDecision decision)
+{
+	if(decision < 0 || decision >= FLIGHT_DECISIONS) {
+		return "unknown";
+	}
+
+	return DECISION_NAMES[decision];
+}
+
+int writeDump(const FlightRecorder *recorder, FILE *fp, FlightTrigger trigger)
+{
+	/// The header, and then the converted samples
+	unsigned char buf[FLIGHT_CHUNK * sizeof(float)];
+	/// The number of samples in the dump
+	size_t samples = recorder->sampleCount < recorder->config.samples ?
+			recorder->sampleCount : recorder->config.samples;
+	/// The number of records in the dump
+	size_t records = recorder->recordCount < recorder->config.records ?
+			recorder->recordCount : recorder->config.records;
+	/// The index of the oldest sample
+	size_t first = recorder->sampleCount - samples;
+
+	memcpy(buf, FLIGHT_MAGIC, sizeof(FLIGHT_MAGIC));
+	storeLe32(buf + 4, FLIGHT_VERSION);
+	storeLe32(buf + 8, recorder->config.rate);
+	storeLe32(buf + 12, recorder->config.hop);
+	storeLe32(buf + 16, (uint32_t) trigger);
+	storeLe64(buf + 20, first);
+	storeLe64(buf + 28, samples);
+	storeLe64(buf + 36, records);
+	storeOptions(buf + 44, &recorder->config.options);
+	if(fwrite(buf, 1, FLIGHT_HEADER_SIZE, fp) != FLIGHT_HEADER_SIZE) {
+		return -1;
+	}
+
+	for(size_t i = 0; i < samples; i += FLIGHT_CHUNK) {
+		size_t n = samples - i < FLIGHT_CHUNK ? samples - i : FLIGHT_CHUNK;
+
+		for(size_t j = 0; j < n; j++) {
+			storeFloat(buf + j * sizeof(float), recorder->samples[
+					(first + i + j) % recorder->config.samples]);
+		}
+
+		if(fwrite(buf, sizeof(float), n, fp) != n) {
+			return -1;
+		}
+	}
+
+	for(size_t i = recorder->recordCount - records;
+			i < recorder->recordCount; i++) {
+		const FlightRecord *record =
+				&recorder->records[i % recorder->config.records];
+
+		storeLe64(buf, record->position);
+		storeFloat(buf + 8, record->period);
+		storeFloat(buf + 12, record->quality);
+		storeFloat(buf + 16, record->elapsed);
+		buf[20] = (unsigned char) record->note;
+		buf[21] = (unsigned char) ((uint16_t) record->note >> 8);
+		buf[22] = record->tier;
+		buf[23] = record->decision;
+
+		if(fwrite(buf, 1, FLIGHT_RECORD_SIZE, fp) != FLIGHT_RECORD_SIZE) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void storeOptions(unsigned char *dest, const FlightOptions *options)
+{
+	storeDouble(dest, options->idleTimeout);
+	storeFloat(dest + 8, options->gateRatio);
+	storeLe32(dest + 12, (uint32_t) options->agc);
+	storeDouble(dest + 16, options->dcBlocker);
+	storeDouble(dest + 24, options->highPass);
+	storeFloat(dest + 32, options->preEmphasis);
+	storeLe32(dest + 36, options->strings);
+	storeLe32(dest + 40, options->frets);
+	dest += 44;
+
+	for(int i = 0; i < GUITAR_MAX_STRINGS; i++, dest += 2) {
+		dest[0] = (unsigned char) options->open[i];
+		dest[1] = (unsigned char) ((uint16_t) options->open[i] >> 8);
+	}
+
+	storeDouble(dest, options->reference);
+	storeDouble(dest + 8, options->gridStep);
+	storeLe32(dest + 16, (uint32_t) options->windowPeriods);
+	storeLe32(dest + 20, (uint32_t) options->bands);
+	storeLe32(dest + 24, (uint32_t) options->floatSums);
+	storeLe32(dest + 28, (uint32_t) options->fixedPoint);
+	storeLe32(dest + 32, options->polyphony);
+	storeLe32(dest + 36, (uint32_t) options->chords);
+}
+
+void loadOptions(const unsigned char *src, FlightOptions *options)
+{
+	options->idleTimeout = loadDouble(src);
+	options->gateRatio = loadFloat(src + 8);
+	options->agc = (int32_t) loadLe32(src + 12);
+	options->dcBlocker = loadDouble(src + 16);
+	options->highPass = loadDouble(src + 24);
+	options->preEmphasis = loadFloat(src + 32);
+	options->strings = loadLe32(src + 36);
+	options->frets = loadLe32(src + 40);
+	src += 44;
+
+	for(int i = 0; i < GUITAR_MAX_STRINGS; i++, src += 2) {
+		options->open[i] = (semitone_t) (src[0] | src[1] << 8);
+	}
+
+	options->reference = loadDouble(src);
+	options->gridStep = loadDouble(src + 8);
+	options->windowPeriods = (int32_t) loadLe32(src + 16);
+	options->bands = (int32_t) loadLe32(src + 20);
+	options->floatSums = (int32_t) loadLe32(src + 24);
+	options->fixedPoint = (int32_t) loadLe32(src + 28);
+	options->polyphony = loadLe32(src + 32);
+	options->chords = (int32_t) loadLe32(src + 36);
+}
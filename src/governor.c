@@ -0,0 +1,62 @@
+/**
+ * @file governor.c
+ * @brief Adapt the cost of the analysis to the available CPU time.
+ */
+
+#include "governor.h"
+
+// assert
+#include <assert.h>
+
+/**
+ * @brief The weight of a new frame in the moving average of the load.
+ */
+static const double LOAD_SMOOTHING = 0.3;
+
+void governorInit(Governor *governor, int maxTier)
+{
+	assert(governor);
+	assert(maxTier >= 0);
+
+	governor->tier = 0;
+	governor->maxTier = maxTier;
+	governor->load = 0;
+	governor->overloadedFrames = 0;
+	governor->idleFrames = 0;
+}
+
+int governorUpdate(Governor *governor, double analysisTime,
+		double hopDuration, int backlog)
+{
+	assert(governor);
+	assert(hopDuration > 0);
+
+	double load = analysisTime / hopDuration;
+	governor->load += LOAD_SMOOTHING * (load - governor->load);
+
+	if(governor->load > GOVERNOR_HIGH_LOAD || backlog) {
+		governor->overloadedFrames++;
+		governor->idleFrames = 0;
+	} else if(governor->load < GOVERNOR_LOW_LOAD) {
+		governor->idleFrames++;
+		governor->overloadedFrames = 0;
+	} else {
+		governor->overloadedFrames = 0;
+		governor->idleFrames = 0;
+	}
+
+	if(governor->tier < governor->maxTier && (backlog ||
+			governor->overloadedFrames >= GOVERNOR_STEP_DOWN_FRAMES)) {
+		governor->tier++;
+		governor->overloadedFrames = 0;
+		/* The load of the new tier is unknown, start again from the
+		threshold, to avoid stepping up immediately. */
+		governor->load = GOVERNOR_HIGH_LOAD;
+	} else if(governor->tier > 0 &&
+			governor->idleFrames >= GOVERNOR_STEP_UP_FRAMES) {
+		governor->tier--;
+		governor->idleFrames = 0;
+	}
+
+	return governor->tier;
+}
@@ -5,6 +5,10 @@
 
 #include "gui.h"
 
+// HwCounters, HwStage, hwCountersRequested, hwCountersInit, hwCountersOpen,
+// hwCountersClose, hwStageInit, hwStageBegin, hwStageEnd, hwStagePrint
+#include "hw_counters.h"
+
 // fprintf, snprintf
 #include <stdio.h>
 // malloc, free
@@ -274,6 +278,21 @@ static short gFrets[GUITAR_STRINGS] = {-1, -1, -1, -1, -1, -1};
  */
 static GtkWidget *gDrawArea;
 
+/**
+ * @brief The hardware counters of the GUI thread.
+ *
+ * Like gDrawArea, they are needed by a callback that doesn't have the
+ * context, and they are opened by guiInitMain, which runs in the same thread
+ * as the drawing.
+ * @sa hwCountersRequested
+ */
+static HwCounters gHwCounters;
+
+/**
+ * @brief The sampling of the drawing of the guitar neck.
+ */
+static HwStage gRenderStage;
+
 GUIContext *guiInitMain(AudioContext *audio)
 {
 	GUIContext *ctx;
@@ -304,6 +323,13 @@ GUIContext *guiInitMain(AudioContext *audio)
 
 	g_object_unref(builder);
 
+	// The frets are redrawn only when they change, so all of them are sampled
+	hwCountersInit(&gHwCounters);
+	hwStageInit(&gRenderStage, 1);
+	if(hwCountersRequested()) {
+		hwCountersOpen(&gHwCounters);
+	}
+
 	gtk_widget_show(ctx->mainWindow);
 
 	return ctx;
@@ -311,6 +337,9 @@ GUIContext *guiInitMain(AudioContext *audio)
 
 void guiFree(GUIContext *context)
 {
+	hwStagePrint(stderr, "render", &gRenderStage.counts);
+	hwCountersClose(&gHwCounters);
+
 	// Just need to free the structure, because GTK will free anything else
 	free(context);
 }
@@ -454,6 +483,8 @@ void drawGuitar(GtkWidget *widget, cairo_t *cr, gpointer userData)
 	width = gtk_widget_get_allocated_width(widget);
 	height = gtk_widget_get_allocated_height(widget);
 
+	hwStageBegin(&gRenderStage, &gHwCounters);
+
 	rsvgHandle = rsvg_handle_new_from_file(GUITAR_NECK_FILE, NULL);
 	if(!rsvgHandle) {
 		fprintf(stderr, "Could not open the neck file.\n");
@@ -483,6 +514,8 @@ void drawGuitar(GtkWidget *widget, cairo_t *cr, gpointer userData)
 	}
 
 	g_object_unref(rsvgHandle);
+
+	hwStageEnd(&gRenderStage, &gHwCounters);
 }
 
 void menuQuit(GtkMenuItem *menuItem, gpointer mainWindow)
@@ -10,6 +10,15 @@
 
 #include <stdio.h>
 
+// strcmp, strspn, strchr, memcpy
+#include <string.h>
+
+// strtol
+#include <stdlib.h>
+
+// isdigit
+#include <ctype.h>
+
 const semitone_t STANDARD_TUNING[GUITAR_STRINGS] = {
    43,	// E4
    38,	// B3
@@ -19,11 +28,59 @@ const semitone_t STANDARD_TUNING[GUITAR_STRINGS] = {
    19	// E2
 };
 
+/**
+ * @brief A tuning that can be loaded by name.
+ */
+typedef struct {
+	/**
+	 * @brief The name of the tuning.
+	 */
+	const char *name;
+
+	/**
+	 * @brief The notes of the open strings, from the lowest.
+	 */
+	const char *notes;
+} NamedTuning;
+
+/**
+ * @brief The tunings known by tuningParse.
+ *
+ * The last element has null fields.
+ */
+static const NamedTuning NAMED_TUNINGS[] = {
+	{"standard", "E2 A2 D3 G3 B3 E4"},
+	{"drop-d", "D2 A2 D3 G3 B3 E4"},
+	{"7-string", "B1 E2 A2 D3 G3 B3 E4"},
+	{"bass", "E1 A1 D2 G2"},
+	{0, 0},
+};
+
+/**
+ * @brief The characters that separate the notes of a tuning description.
+ */
+static const char *TUNING_SEPARATORS = " \t,";
+
 /**
  * @brief The frequency of A0.
  */
 static const double A0 = 27.5;
 
+/**
+ * @brief The semitones of A4 from A0.
+ */
+static const int A4 = 48;
+
+/**
+ * @brief The ratio between two frequencies a quarter tone apart, 2^(1/24).
+ */
+static const double QUARTER_TONE = 1.0293022366434921;
+
+/**
+ * @brief The cents in a neper, i.e. 1200 / ln(2).
+ */
+static const double CENTS_PER_NEPER = 1731.2340490667560;
+
 /**
  * @brief Interval between notes in semitones.
  *
@@ -118,3 +175,218 @@ unsigned int noteToFrets(semitone_t note, const semitone_t *tuning,
 
 	return valid;
 }
+
+int tuningInit(Tuning *tuning, const semitone_t *open, unsigned int strings,
+		unsigned int frets)
+{
+	/// The lowest open string
+	semitone_t lowest;
+	/// The highest open string
+	semitone_t highest;
+
+	if(!tuning || !open || !strings || strings > GUITAR_MAX_STRINGS) {
+		return -1;
+	}
+
+	lowest = highest = open[0];
+	for(unsigned int i = 0; i < strings; i++) {
+		if(open[i] == INVALID_SEMITONE) {
+			return -1;
+		}
+
+		lowest = open[i] < lowest ? open[i] : lowest;
+		highest = open[i] > highest ? open[i] : highest;
+	}
+
+	if(highest + (int) frets - lowest >= GUITAR_TUNING_RANGE) {
+		return -1;
+	}
+
+	tuning->strings = strings;
+	tuning->frets = frets;
+	tuning->lowest = lowest;
+	tuning->range = highest + frets - lowest + 1;
+
+	for(unsigned int i = 0; i < GUITAR_MAX_STRINGS; i++) {
+		tuning->open[i] = i < strings ? open[i] : INVALID_SEMITONE;
+	}
+
+	for(unsigned int i = 0; i < GUITAR_TUNING_RANGE; i++) {
+		for(unsigned int j = 0; j < GUITAR_MAX_STRINGS; j++) {
+			tuning->table[i][j] = -1;
+		}
+
+		tuning->positions[i] = i < tuning->range ? noteToFrets(lowest + i,
+				open, tuning->table[i], strings, frets) : 0;
+	}
+
+	return 0;
+}
+
+int tuningParse(Tuning *tuning, const char *description, unsigned int frets)
+{
+	/// The notes of the strings, in the order of the description
+	semitone_t notes[GUITAR_MAX_STRINGS];
+	/// The notes in the order of tuningInit
+	semitone_t open[GUITAR_MAX_STRINGS];
+	/// The number of strings found in the description
+	unsigned int strings = 0;
+
+	if(!tuning || !description) {
+		return -1;
+	}
+
+	for(int i = 0; NAMED_TUNINGS[i].name; i++) {
+		if(!strcmp(description, NAMED_TUNINGS[i].name)) {
+			description = NAMED_TUNINGS[i].notes;
+			break;
+		}
+	}
+
+	for(;;) {
+		/// The name of the note, without the octave
+		char name[3];
+		/// The length of the name
+		size_t length;
+		/// The end of the octave
+		char *end;
+
+		description += strspn(description, TUNING_SEPARATORS);
+		if(!*description) {
+			break;
+		}
+
+		if(strings == GUITAR_MAX_STRINGS) {
+			return -1;
+		}
+
+		// A letter, an optional accidental, and the octave
+		length = description[1] == '#' || description[1] == 'b' ? 2 : 1;
+		memcpy(name, description, length);
+		name[length] = 0;
+
+		if(!isdigit((unsigned char) description[length])) {
+			return -1;
+		}
+
+		long octave = strtol(description + length, &end, 10);
+		if(end == description + length || (*end &&
+				!strchr(TUNING_SEPARATORS, *end))) {
+			return -1;
+		}
+
+		notes[strings] = noteToSemitones(name, (semitone_t) octave);
+		if(notes[strings] == INVALID_SEMITONE) {
+			return -1;
+		}
+
+		strings++;
+		description = end;
+	}
+
+	// The first string is the highest one, the last in the description
+	for(unsigned int i = 0; i < strings; i++) {
+		open[i] = notes[strings - 1 - i];
+	}
+
+	return tuningInit(tuning, open, strings, frets);
+}
+
+const semitone_t *tuningLookup(const Tuning *tuning, semitone_t note,
+		unsigned int *positions)
+{
+	/* Notes lower than the lowest one become large unsigned numbers, so a
+	single comparison checks both the limits. */
+	unsigned int index = (unsigned int) (note - tuning->lowest);
+
+	if(note == INVALID_SEMITONE || index >= tuning->range ||
+			!tuning->positions[index]) {
+		if(positions) {
+			*positions = 0;
+		}
+		return 0;
+	}
+
+	if(positions) {
+		*positions = tuning->positions[index];
+	}
+
+	return tuning->table[index];
+}
+
+int quantizerInit(Quantizer *quantizer, double reference)
+{
+	if(!quantizer || !(reference > 0)) {
+		return -1;
+	}
+
+	quantizer->reference = reference;
+
+	/* The logarithms are computed only here: a quarter tone below each note,
+	the next one is nearer. */
+	for(int i = 0; i < QUANTIZER_SIZE; i++) {
+		semitone_t note = QUANTIZER_FIRST + i;
+		quantizer->frequencies[i] = reference * pow(2, (note - A4) / 12.0);
+		quantizer->boundaries[i] = reference * pow(2,
+				(note - A4 - 0.5) / 12.0);
+	}
+
+	return 0;
+}
+
+semitone_t quantize(const Quantizer *quantizer, double frequency,
+		float *cents)
+{
+	/// The first element of the part of the table that is searched
+	const double *base = quantizer->boundaries;
+	/// The index of the semitone in the table
+	int index;
+
+	/* The part of the table halves at each step, and the compiler can choose
+	the half with a conditional move, because both are valid addresses. */
+	for(size_t n = QUANTIZER_SIZE; n > 1; n /= 2) {
+		base = base[n / 2] <= frequency ? base + n / 2 : base;
+	}
+	index = (int) (base - quantizer->boundaries);
+
+	/* The search stops on the first element also for lower frequencies, and
+	on the last one for any higher frequency. */
+	if(!(frequency >= quantizer->boundaries[0]) ||
+			frequency >= quantizer->frequencies[QUANTIZER_SIZE - 1] *
+			QUARTER_TONE) {
+		if(cents) {
+			*cents = 0;
+		}
+		return INVALID_SEMITONE;
+	}
+
+	if(cents) {
+		/* The ratio is near 1, so 2 * atanh((r - 1) / (r + 1)) converges fast
+		to ln(r): the first omitted term, 2u^5/5, is at most 5 * 10^-7 cents
+		at a quarter-tone, far below the float precision of the result. */
+		double ratio = frequency / quantizer->frequencies[index];
+		double u = (ratio - 1) / (ratio + 1);
+		*cents = (float) (CENTS_PER_NEPER * 2 * u * (1 + u * u / 3));
+	}
+
+	return (semitone_t) (QUANTIZER_FIRST + index);
+}
+
+void quantizeBatch(const Quantizer *quantizer, const double *frequencies,
+		semitone_t *notes, float *cents, size_t count)
+{
+	for(size_t i = 0; i < count; i++) {
+		notes[i] = quantize(quantizer, frequencies[i], cents ? cents + i : 0);
+	}
+}
+
+double quantizerFrequency(const Quantizer *quantizer, semitone_t note)
+{
+	unsigned int index = (unsigned int) (note - QUANTIZER_FIRST);
+
+	if(note == INVALID_SEMITONE || index >= QUANTIZER_SIZE) {
+		return -1.0;
+	}
+
+	return quantizer->frequencies[index];
+}
@@ -0,0 +1,433 @@
+/**
+ * @file hw_counters.c
+ * @brief Sample the hardware performance counters around the stages of the
+ *  pipeline.
+ *
+ * @link https://man7.org/linux/man-pages/man2/perf_event_open.2.html
+ */
+
+#include "hw_counters.h"
+
+// getenv
+#include <stdlib.h>
+// memset, strcmp
+#include <string.h>
+// assert
+#include <assert.h>
+
+#ifdef __linux__
+	// perf_event_attr, PERF_*
+#	include <linux/perf_event.h>
+	// syscall, SYS_perf_event_open, SYS_gettid
+#	include <sys/syscall.h>
+	// read, close, sysconf
+#	include <unistd.h>
+	// ioctl
+#	include <sys/ioctl.h>
+	// uint32_t, uint64_t, int64_t
+#	include <stdint.h>
+	// mmap, munmap, PROT_READ, MAP_SHARED, MAP_FAILED
+#	include <sys/mman.h>
+#endif
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__))
+	/**
+	 * @brief Read the counters in user space, with rdpmc and rdtsc.
+	 */
+#	define HW_USER_READ
+#endif
+
+/**
+ * @brief The environment variable that enables the counters.
+ */
+static const char *HW_COUNTERS_VARIABLE = "GUITARBIRO_HW_COUNTERS";
+
+#ifdef __linux__
+/**
+ * @brief The generic hardware events of the counters, in the order of
+ *  HwCounter.
+ */
+static const uint64_t EVENTS[HW_COUNTERS] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+/**
+ * @brief Open an event of a thread.
+ *
+ * Only the user space is counted, so the paranoid level 2, the default of
+ * many distributions, is enough.
+ *
+ * @param event The generic hardware event
+ * @param thread The id of the thread, or 0 for the calling one
+ * @param group The file descriptor of the leader of the group, or -1 to open
+ *  a leader
+ * @return The file descriptor, or -1 in case of error
+ */
+static int openEvent(uint64_t event, long thread, int group);
+#endif
+
+#ifdef HW_USER_READ
+/**
+ * @brief Read the counters from their mapped pages.
+ *
+ * It follows the sequence of the documentation of perf_event_mmap_page: the
+ * value is the offset of the kernel plus the register, and the times are
+ * advanced with the time stamp counter since the last update of the kernel,
+ * when the kernel allows it.
+ * A value that is not in a register, e.g. because the group has been
+ * multiplexed, is only the offset, and the reading is not counting.
+ *
+ * @param counters The counters, with their pages
+ * @param reading Output parameter for the values
+ * @return 0 on success, -1 if the kernel doesn't allow rdpmc
+ */
+static int readUser(const HwCounters *counters, HwReading *reading);
+#endif
+
+int hwCountersRequested(void)
+{
+	/// The value of the variable
+	const char *value = getenv(HW_COUNTERS_VARIABLE);
+
+	return value && *value && strcmp(value, "0");
+}
+
+void hwCountersInit(HwCounters *counters)
+{
+	assert(counters);
+
+	for(int i = 0; i < HW_COUNTERS; i++) {
+		counters->fds[i] = -1;
+		counters->order[i] = HW_CYCLES;
+		counters->pages[i] = 0;
+	}
+	counters->count = 0;
+	counters->userRead = 0;
+}
+
+long hwCurrentThread(void)
+{
+#ifdef __linux__
+	return (long) syscall(SYS_gettid);
+#else
+	return 0;
+#endif
+}
+
+int hwCountersOpen(HwCounters *counters)
+{
+	return hwCountersOpenThread(counters, 0);
+}
+
+int hwCountersOpenThread(HwCounters *counters, long thread)
+{
+	hwCountersInit(counters);
+
+#ifdef __linux__
+	/// The leader of the group
+	int leader = openEvent(EVENTS[HW_CYCLES], thread, -1);
+	if(leader < 0) {
+		return -1;
+	}
+
+	counters->fds[HW_CYCLES] = leader;
+	counters->order[counters->count++] = HW_CYCLES;
+
+	// E.g. the cache misses are missing on some virtual machines
+	for(int i = HW_CYCLES + 1; i < HW_COUNTERS; i++) {
+		counters->fds[i] = openEvent(EVENTS[i], thread, leader);
+		if(counters->fds[i] >= 0) {
+			counters->order[counters->count++] = (HwCounter) i;
+		}
+	}
+
+#	ifdef HW_USER_READ
+	/// The size of the page of each event
+	long pageSize = sysconf(_SC_PAGESIZE);
+
+	// Only the first page, which has the index of the register and the times
+	counters->userRead = 1;
+	for(unsigned int i = 0; i < counters->count; i++) {
+		/// The event to map
+		HwCounter event = counters->order[i];
+		/// The page of the event
+		void *page = mmap(0, (size_t) pageSize, PROT_READ, MAP_SHARED,
+				counters->fds[event], 0);
+
+		if(page == MAP_FAILED) {
+			counters->userRead = 0;
+		} else {
+			counters->pages[event] = page;
+		}
+	}
+#	endif
+
+	ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	if(ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP)) {
+		hwCountersClose(counters);
+		return -1;
+	}
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+void hwCountersClose(HwCounters *counters)
+{
+	assert(counters);
+
+#ifdef __linux__
+	// The members of the group first, the leader last
+	for(int i = HW_COUNTERS - 1; i >= 0; i--) {
+		if(counters->pages[i]) {
+			munmap(counters->pages[i], (size_t) sysconf(_SC_PAGESIZE));
+		}
+		if(counters->fds[i] >= 0) {
+			close(counters->fds[i]);
+		}
+	}
+#endif
+
+	hwCountersInit(counters);
+}
+
+int hwCountersAvailable(const HwCounters *counters)
+{
+	assert(counters);
+
+	return counters->fds[HW_CYCLES] >= 0;
+}
+
+int hwCountersUserRead(const HwCounters *counters)
+{
+	assert(counters);
+
+	return hwCountersAvailable(counters) && counters->userRead;
+}
+
+int hwCountersRead(const HwCounters *counters, HwReading *reading)
+{
+	assert(counters);
+	assert(reading);
+
+	memset(reading, 0, sizeof(*reading));
+
+	if(!hwCountersAvailable(counters)) {
+		return -1;
+	}
+
+#ifdef HW_USER_READ
+	// A failed read would need the system call, which the caller avoids
+	if(counters->userRead) {
+		reading->counting = 1;
+		return readUser(counters, reading);
+	}
+#endif
+
+#ifdef __linux__
+	/// The number of values, the times and the values of the group
+	uint64_t data[3 + HW_COUNTERS];
+	/// The expected size of the data
+	ssize_t size = (3 + counters->count) * sizeof(uint64_t);
+
+	if(read(counters->fds[HW_CYCLES], data, size) != size ||
+			data[0] != counters->count) {
+		return -1;
+	}
+
+	reading->enabled = data[1];
+	reading->running = data[2];
+	reading->counting = 1;
+	for(unsigned int i = 0; i < counters->count; i++) {
+		reading->values[counters->order[i]] = data[3 + i];
+	}
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+void hwStageInit(HwStage *stage, unsigned int interval)
+{
+	assert(stage);
+
+	memset(stage, 0, sizeof(*stage));
+	stage->interval = interval ? interval : 1;
+}
+
+void hwStageBegin(HwStage *stage, const HwCounters *counters)
+{
+	assert(stage);
+	assert(counters);
+
+	stage->sampling = 0;
+	if(!hwCountersAvailable(counters) ||
+			stage->calls++ % stage->interval) {
+		return;
+	}
+
+	stage->sampling = !hwCountersRead(counters, &stage->start);
+}
+
+void hwStageEnd(HwStage *stage, const HwCounters *counters)
+{
+	assert(stage);
+	assert(counters);
+
+	/// The read at the end of the invocation
+	HwReading end;
+
+	if(!stage->sampling || hwCountersRead(counters, &end)) {
+		return;
+	}
+	stage->sampling = 0;
+
+	// A partial count of a short invocation cannot be scaled reliably
+	if(!stage->start.counting || !end.counting ||
+			end.running - stage->start.running !=
+			end.enabled - stage->start.enabled) {
+		stage->counts.discarded++;
+		return;
+	}
+
+	for(int i = 0; i < HW_COUNTERS; i++) {
+		stage->counts.totals[i] += end.values[i] - stage->start.values[i];
+	}
+	stage->counts.samples++;
+}
+
+void hwStagePrint(FILE *fp, const char *name, const HwStageCounts *counts)
+{
+	assert(fp);
+	assert(name);
+	assert(counts);
+
+	if(!counts->samples) {
+		return;
+	}
+
+	/// The number of samples, as a divisor
+	double samples = (double) counts->samples;
+	/// The thousands of instructions, as a divisor of the misses
+	double kiloInstructions = counts->totals[HW_INSTRUCTIONS] / 1e3;
+
+	fprintf(fp, "%s: %lu samples, %.0f cycles and %.0f instructions per "
+			"sample", name, counts->samples,
+			counts->totals[HW_CYCLES] / samples,
+			counts->totals[HW_INSTRUCTIONS] / samples);
+	if(counts->totals[HW_CYCLES]) {
+		fprintf(fp, ", IPC %.2f", (double) counts->totals[HW_INSTRUCTIONS] /
+				counts->totals[HW_CYCLES]);
+	}
+	if(kiloInstructions > 0) {
+		fprintf(fp, ", %.2f cache and %.2f branch misses per 1k instructions",
+				counts->totals[HW_CACHE_MISSES] / kiloInstructions,
+				counts->totals[HW_BRANCH_MISSES] / kiloInstructions);
+	}
+	fprintf(fp, ".\n");
+}
+
+#ifdef __linux__
+int openEvent(uint64_t event, long thread, int group)
+{
+	/// The attributes of the event
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = event;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+			PERF_FORMAT_TOTAL_TIME_RUNNING;
+	// The leader enables the whole group when it is ready
+	attr.disabled = group < 0;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	// The thread 0 is the calling one
+	return (int) syscall(SYS_perf_event_open, &attr, (pid_t) thread, -1,
+			group, 0);
+}
+#endif
+
+#ifdef HW_USER_READ
+int readUser(const HwCounters *counters, HwReading *reading)
+{
+	for(unsigned int i = 0; i < counters->count; i++) {
+		/// The event being read
+		HwCounter event = counters->order[i];
+		/// Its page, which the kernel updates while it is being read
+		const volatile struct perf_event_mmap_page *page =
+				counters->pages[event];
+		/// The sequence number of the update of the kernel
+		uint32_t seq;
+		/// The value of the event
+		uint64_t value;
+		/// The times of the last update of the kernel
+		uint64_t enabled, running;
+		/// The nanoseconds since the last update
+		uint64_t delta;
+		/// The register of the event plus 1, or 0 if it isn't counting
+		uint32_t index;
+
+		/// The halves of the registers
+		uint32_t low, high;
+
+		do {
+			seq = page->lock;
+			__asm__ __volatile__("" ::: "memory");
+
+			if(!page->cap_user_rdpmc) {
+				return -1;
+			}
+
+			enabled = page->time_enabled;
+			running = page->time_running;
+			index = page->index;
+			value = page->offset;
+
+			// E.g. virtual machines without a stable time stamp counter
+			delta = 0;
+			if(page->cap_user_time) {
+				/// The time stamp counter, with the factors of the page
+				uint64_t cycles;
+				uint16_t shift = page->time_shift;
+				uint32_t mult = page->time_mult;
+
+				__asm__ __volatile__("rdtsc" : "=a" (low), "=d" (high));
+				cycles = (uint64_t) high << 32 | low;
+				delta = page->time_offset + (cycles >> shift) * mult +
+						(((cycles & (((uint64_t) 1 << shift) - 1)) * mult) >>
+						shift);
+			}
+
+			if(index) {
+				/// The width of the register, whose upper bits are garbage
+				unsigned int width = 64 - page->pmc_width;
+
+				__asm__ __volatile__("rdpmc" : "=a" (low), "=d" (high)
+						: "c" (index - 1));
+				value += (uint64_t) ((int64_t) (((uint64_t) high << 32 | low)
+						<< width) >> width);
+			}
+
+			__asm__ __volatile__("" ::: "memory");
+		} while(page->lock != seq);
+
+		reading->values[event] = value;
+		reading->counting = reading->counting && index;
+		if(event == HW_CYCLES) {
+			reading->enabled = enabled + delta;
+			reading->running = index ? running + delta : running;
+		}
+	}
+
+	return 0;
+}
+#endif
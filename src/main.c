@@ -12,6 +12,8 @@
 
 // fprintf
 #include <stdio.h>
+// strcmp
+#include <string.h>
 
 #include <gtk/gtk.h>
 
@@ -33,6 +35,14 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	// The calibration doesn't need the GUI
+	if(argc > 1 && !strcmp(argv[1], "--calibrate")) {
+		int calibrated = audioCalibrate(audio);
+		audioClose(audio);
+		estimateFree();
+		return calibrated ? 0 : 3;
+	}
+
 	gtk_init(&argc, &argv);
 
 	if(!(ctx = guiInitMain(audio))) {
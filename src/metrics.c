@@ -0,0 +1,428 @@
+/**
+ * @file metrics.c
+ * @brief Export the counters of the pipeline in the Prometheus text format.
+ *
+ * @link https://prometheus.io/docs/instrumenting/exposition_formats/
+ */
+
+// newlocale, uselocale
+#define _GNU_SOURCE
+
+#include "metrics.h"
+
+// Arena, arenaCreate, arenaAlloc, arenaFree, ARENA_ALIGN
+#include "arena.h"
+
+// threadSleepMs, threadSetIdlePriority
+#include "thread_utils.h"
+
+// fopen, fprintf, fclose, rename, remove
+#include <stdio.h>
+// memcpy, strlen, strcpy, strcat
+#include <string.h>
+// assert
+#include <assert.h>
+// atomic_uint, atomic_int, atomic_exchange_explicit, atomic_load_explicit
+#include <stdatomic.h>
+// pthread_t, pthread_create, pthread_join
+#include <pthread.h>
+// newlocale, uselocale, freelocale, setlocale
+#include <locale.h>
+
+/**
+ * @brief The default milliseconds between two rewrites of the file.
+ */
+static const unsigned int WRITE_INTERVAL = 5000;
+
+/**
+ * @brief The milliseconds that the writer sleeps between two checks of the
+ *  snapshots and of the stop request.
+ */
+static const unsigned int WRITER_SLEEP = 50;
+
+/**
+ * @brief The flag of the shared slot of the snapshots when it contains a
+ *  snapshot that the writer hasn't taken yet.
+ */
+#define SLOT_FRESH 4u
+
+/**
+ * @brief The names of the tiers, as labels of the metrics.
+ */
+static const char *TIER_NAMES[DETECT_TIERS] = {
+	"full", "long_hop", "decimated", "tracking"
+};
+
+struct _MetricsExporter {
+	/**
+	 * @brief The arena of the exporter.
+	 */
+	Arena *arena;
+
+	/**
+	 * @brief The configuration of the exporter.
+	 */
+	MetricsConfig config;
+
+	/**
+	 * @brief The path of the file.
+	 */
+	char *path;
+
+	/**
+	 * @brief The path of the temporary file.
+	 */
+	char *tmpPath;
+
+	/**
+	 * @brief The snapshots, used as a triple buffer.
+	 *
+	 * At any time, one of them is being written by the producer, one is
+	 * being read by the writer, and the third one is shared: the producer
+	 * and the writer swap their slot with it atomically, so neither of them
+	 * ever waits for the other.
+	 */
+	MetricsSnapshot slots[3];
+
+	/**
+	 * @brief The slot of the producer.
+	 */
+	unsigned int back;
+
+	/**
+	 * @brief The shared slot, with SLOT_FRESH if it contains a snapshot that
+	 *  the writer hasn't taken yet.
+	 */
+	atomic_uint middle;
+
+	/**
+	 * @brief The slot of the writer.
+	 */
+	unsigned int front;
+
+	/**
+	 * @brief The writer thread.
+	 */
+	pthread_t writer;
+
+	/**
+	 * @brief Set to stop the writer.
+	 */
+	atomic_int stop;
+
+	/**
+	 * @brief Whether a failed write has already been reported.
+	 *
+	 * The failures are reported only once, not at each rewrite.
+	 */
+	int reportedError;
+};
+
+/**
+ * @brief The main function of the writer thread.
+ *
+ * @param arg The exporter
+ * @return Always null
+ */
+static void *writerMain(void *arg);
+
+/**
+ * @brief Write the file with the last snapshot, if the writer hasn't taken
+ *  it yet.
+ *
+ * @param exporter The exporter
+ * @return 1 if the file has been written, 0 if there wasn't a new snapshot
+ *  or the write failed
+ */
+static int writeLatest(MetricsExporter *exporter);
+
+/**
+ * @brief Write the comments that describe a metric.
+ *
+ * @param fp The file to write to
+ * @param name The name of the metric
+ * @param type The type of the metric
+ * @param help The description of the metric
+ * @return 0 on success, -1 if the write failed
+ */
+static int writeHelp(FILE *fp, const char *name, const char *type,
+		const char *help);
+
+
+void metricsConfigInit(MetricsConfig *config)
+{
+	assert(config);
+
+	config->interval = WRITE_INTERVAL;
+}
+
+MetricsExporter *metricsStart(const MetricsConfig *config, const char *path)
+{
+	if(!config || !path || !*path) {
+		return 0;
+	}
+
+	/// The length of the path
+	size_t length = strlen(path);
+	/// The arena for the exporter and its paths
+	Arena *arena;
+	/// The instance that will be returned
+	MetricsExporter *ret;
+
+	arena = arenaCreate(ARENA_ALIGN(sizeof(MetricsExporter)) +
+			ARENA_ALIGN(length + 1) + ARENA_ALIGN(length + sizeof(".tmp")));
+	if(!arena) {
+		fprintf(stderr, "Could not allocate the memory for the metrics.\n");
+		return 0;
+	}
+
+	// The arena has been sized for these allocations, so they cannot fail
+	ret = (MetricsExporter *) arenaAlloc(arena, sizeof(MetricsExporter));
+	ret->arena = arena;
+	ret->config = *config;
+	ret->path = arenaAlloc(arena, length + 1);
+	ret->tmpPath = arenaAlloc(arena, length + sizeof(".tmp"));
+	assert(ret->path && ret->tmpPath);
+	strcpy(ret->path, path);
+	strcpy(ret->tmpPath, path);
+	strcat(ret->tmpPath, ".tmp");
+
+	ret->back = 0;
+	atomic_init(&ret->middle, 1);
+	ret->front = 2;
+	atomic_init(&ret->stop, 0);
+	ret->reportedError = 0;
+
+	if(!pthread_create(&ret->writer, 0, writerMain, ret)) {
+		return ret;
+	}
+
+	fprintf(stderr, "Could not start the writer of the metrics.\n");
+	arenaFree(arena);
+
+	return 0;
+}
+
+void metricsStop(MetricsExporter *exporter)
+{
+	if(!exporter) {
+		return;
+	}
+
+	atomic_store_explicit(&exporter->stop, 1, memory_order_release);
+	pthread_join(exporter->writer, 0);
+
+	// The exporter itself is in the arena
+	arenaFree(exporter->arena);
+}
+
+void metricsPublish(MetricsExporter *exporter,
+		const MetricsSnapshot *snapshot)
+{
+	assert(exporter);
+	assert(snapshot);
+
+	memcpy(&exporter->slots[exporter->back], snapshot,
+			sizeof(MetricsSnapshot));
+
+	/* Release: the snapshot must be visible before its slot is shared.
+	Acquire: the writer must have finished with the slot that comes back. */
+	exporter->back = atomic_exchange_explicit(&exporter->middle,
+			exporter->back | SLOT_FRESH, memory_order_acq_rel) & ~SLOT_FRESH;
+}
+
+int metricsFormat(FILE *fp, const MetricsSnapshot *snapshot)
+{
+	assert(fp);
+	assert(snapshot);
+
+	/// The counters of the detection
+	const DetectStats *stats = &snapshot->detect;
+	/// The windows counted by the histogram until the current bucket
+	unsigned long cumulative = 0;
+	/// Negative if a write failed
+	int err = 0;
+
+	err |= writeHelp(fp, "guitarbiro_windows_total", "counter",
+			"Windows analyzed by the detection, by tier.");
+	for(int i = 0; i < DETECT_TIERS; i++) {
+		err |= fprintf(fp, "guitarbiro_windows_total{tier=\"%s\"} %lu\n",
+				TIER_NAMES[i], stats->tierFrames[i]);
+	}
+
+	err |= writeHelp(fp, "guitarbiro_detections_total", "counter",
+			"Notes, chord shapes and chord names detected.");
+	err |= fprintf(fp, "guitarbiro_detections_total{kind=\"note\"} %lu\n"
+			"guitarbiro_detections_total{kind=\"chord\"} %lu\n"
+			"guitarbiro_detections_total{kind=\"chord_name\"} %lu\n",
+			stats->notes, stats->chords, stats->chordNames);
+
+	err |= writeHelp(fp, "guitarbiro_drops_total", "counter",
+			"Windows and events discarded by the detection, by reason.");
+	err |= fprintf(fp, "guitarbiro_drops_total{reason=\"quality\"} %lu\n"
+			"guitarbiro_drops_total{reason=\"unplayable\"} %lu\n"
+			"guitarbiro_drops_total{reason=\"silence\"} %lu\n"
+			"guitarbiro_drops_total{reason=\"events_lost\"} %lu\n",
+			stats->droppedQuality, stats->droppedUnplayable,
+			stats->droppedSilence, stats->eventsLost);
+
+	err |= writeHelp(fp, "guitarbiro_anomalies_total", "counter",
+			"Windows with a NaN period or analyzed after their deadline, and "
+			"blocks of invalid input.");
+	err |= fprintf(fp, "guitarbiro_anomalies_total{kind=\"nan\"} %lu\n"
+			"guitarbiro_anomalies_total{kind=\"deadline\"} %lu\n"
+			"guitarbiro_anomalies_total{kind=\"invalid_input\"} %lu\n",
+			stats->nanPeriods, stats->deadlineMisses, stats->invalidBlocks);
+
+	err |= writeHelp(fp, "guitarbiro_overflows_total", "counter",
+			"Overflows of the audio card, replaced by silence.");
+	err |= fprintf(fp, "guitarbiro_overflows_total %lu\n",
+			snapshot->overflows);
+
+	err |= writeHelp(fp, "guitarbiro_ring_fill_samples", "gauge",
+			"Samples waiting for the detection.");
+	err |= fprintf(fp, "guitarbiro_ring_fill_samples %zu\n",
+			snapshot->ringFill);
+	err |= writeHelp(fp, "guitarbiro_ring_capacity_samples", "gauge",
+			"Samples that the ring can hold.");
+	err |= fprintf(fp, "guitarbiro_ring_capacity_samples %zu\n",
+			snapshot->ringCapacity);
+
+	err |= writeHelp(fp, "guitarbiro_analysis_seconds", "histogram",
+			"Time needed to analyze a window.");
+	for(unsigned int i = 0; i < DETECT_TIME_BUCKETS - 1; i++) {
+		cumulative += stats->analysisTimes[i];
+		err |= fprintf(fp, "guitarbiro_analysis_seconds_bucket{le=\"%.9g\"} "
+				"%lu\n", detectTimeBucketBound(i), cumulative);
+	}
+	cumulative += stats->analysisTimes[DETECT_TIME_BUCKETS - 1];
+	err |= fprintf(fp, "guitarbiro_analysis_seconds_bucket{le=\"+Inf\"} %lu\n"
+			"guitarbiro_analysis_seconds_sum %.9g\n"
+			"guitarbiro_analysis_seconds_count %lu\n", cumulative,
+			stats->analysisTimeSum, cumulative);
+
+	err |= writeHelp(fp, "guitarbiro_analysis_max_seconds", "gauge",
+			"Longest time needed to analyze a window.");
+	err |= fprintf(fp, "guitarbiro_analysis_max_seconds %.9g\n",
+			stats->maxAnalysisTime);
+
+	err |= writeHelp(fp, "guitarbiro_engine_tier", "gauge",
+			"Tier of the analysis, from 0 (full) to 3 (tracking).");
+	err |= fprintf(fp, "guitarbiro_engine_tier %d\n", (int) stats->tier);
+	err |= writeHelp(fp, "guitarbiro_tier_changes_total", "counter",
+			"Changes of tier made by the governor.");
+	err |= fprintf(fp, "guitarbiro_tier_changes_total %lu\n",
+			stats->tierChanges);
+	err |= writeHelp(fp, "guitarbiro_load_ratio", "gauge",
+			"Smoothed ratio between analysis time and hop duration.");
+	err |= fprintf(fp, "guitarbiro_load_ratio %.6g\n", stats->load);
+
+	err |= writeHelp(fp, "guitarbiro_idle", "gauge",
+			"Whether the detection is idle because of silence.");
+	err |= fprintf(fp, "guitarbiro_idle %d\n", stats->idle ? 1 : 0);
+	err |= writeHelp(fp, "guitarbiro_latency_seconds", "gauge",
+			"Effective latency of the detection.");
+	err |= fprintf(fp, "guitarbiro_latency_seconds %.9g\n", stats->latency);
+
+	// fprintf returns a negative number on errors
+	return err < 0 ? -1 : 0;
+}
+
+void *writerMain(void *arg)
+{
+	MetricsExporter *exporter = (MetricsExporter *) arg;
+	/// The milliseconds since the last rewrite
+	unsigned int waited = exporter->config.interval;
+
+	// If the writer starves, the file is only older
+	threadSetIdlePriority();
+
+	/* The GUI sets the locale of the user, but the format needs the decimal
+	point: change it only for this thread. */
+#ifdef WIN32
+	_configthreadlocale(_ENABLE_PER_THREAD_LOCALE);
+	setlocale(LC_NUMERIC, "C");
+#else
+	locale_t locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t) 0);
+	if(locale) {
+		uselocale(locale);
+	}
+#endif
+
+	while(!atomic_load_explicit(&exporter->stop, memory_order_acquire)) {
+		// If there is nothing new, the next snapshot is written immediately
+		if(waited >= exporter->config.interval && writeLatest(exporter)) {
+			waited = 0;
+		}
+		threadSleepMs(WRITER_SLEEP);
+		waited += WRITER_SLEEP;
+	}
+
+	// The producer has stopped, so this is its last snapshot
+	writeLatest(exporter);
+
+#ifndef WIN32
+	if(locale) {
+		uselocale(LC_GLOBAL_LOCALE);
+		freelocale(locale);
+	}
+#endif
+
+	return 0;
+}
+
+int writeLatest(MetricsExporter *exporter)
+{
+	/// The file being written
+	FILE *fp;
+	/// The result of the writes
+	int err = 0;
+
+	if(!(atomic_load_explicit(&exporter->middle, memory_order_relaxed) &
+			SLOT_FRESH)) {
+		return 0;
+	}
+
+	// Acquire: the snapshot must be visible before it is read
+	exporter->front = atomic_exchange_explicit(&exporter->middle,
+			exporter->front, memory_order_acq_rel) & ~SLOT_FRESH;
+
+	fp = fopen(exporter->tmpPath, "w");
+	if(!fp) {
+		err = -1;
+	} else {
+		err = metricsFormat(fp, &exporter->slots[exporter->front]);
+		if(fclose(fp)) {
+			err = -1;
+		}
+	}
+
+	// The collector must never read a partial file
+	if(!err && rename(exporter->tmpPath, exporter->path)) {
+		err = -1;
+	}
+
+	if(err) {
+		if(fp) {
+			remove(exporter->tmpPath);
+		}
+		if(!exporter->reportedError) {
+			fprintf(stderr, "Could not write the metrics to %s.\n",
+					exporter->path);
+			exporter->reportedError = 1;
+		}
+		return 0;
+	}
+
+	return 1;
+}
+
+int writeHelp(FILE *fp, const char *name, const char *type, const char *help)
+{
+	if(fprintf(fp, "# HELP %s %s\n# TYPE %s %s\n", name, help, name,
+			type) < 0) {
+		return -1;
+	}
+
+	return 0;
+}
@@ -27,18 +27,179 @@
  THE SOFTWARE.
  */
 
+#include "period_estimator.h"
+
 // free, malloc, realloc
 #include <stdlib.h>
 
 // fprintf
 #include <stdio.h>
 
-// sqrt, isnan
+// sqrt, isnan, pow, NAN
 #include <math.h>
 
 // assert
 #include <assert.h>
 
+// pthread_t, pthread_create, pthread_join
+#include <pthread.h>
+
+// sysconf
+#include <unistd.h>
+
+#ifdef __GNUC__
+	/**
+	 * @brief Inline a function even when it is big.
+	 *
+	 * The specialized kernels need the body inlined, so that the compiler sees
+	 * their constant bounds.
+	 */
+#	define ESTIMATOR_INLINE inline __attribute__((always_inline))
+#else
+#	define ESTIMATOR_INLINE inline
+#endif
+
+/**
+ * @brief The number of lags whose products are computed in the same loop.
+ */
+#define LAG_TILE 4
+
+/**
+ * @brief The number of independent sums of the float accumulation.
+ *
+ * They are 8 so that they fill an AVX register.
+ */
+#define SUM_LANES 8
+
+/**
+ * @brief The number of products that are added in float before the pairwise
+ *  summation.
+ */
+#define SUM_BLOCK 64
+
+/**
+ * @brief A version of the autocorrelation specialized for a configuration.
+ * @sa ESTIMATOR_KERNELS
+ */
+typedef struct {
+	/**
+	 * @brief The minimum period of the configuration.
+	 */
+	int minP;
+
+	/**
+	 * @brief The maximum period of the configuration.
+	 */
+	int maxP;
+
+	/**
+	 * @brief The number of samples of the windows.
+	 */
+	int window;
+
+	/**
+	 * @brief The autocorrelation of minP - 1 to maxP + 1 on window samples.
+	 * @sa computeNac
+	 */
+	void (*compute)(const float *x, double *nac, double ratio);
+} NacKernel;
+
+struct _PeriodEstimator {
+	/**
+	 * @brief The configuration of the estimator.
+	 */
+	EstimatorConfig config;
+
+	/**
+	 * @brief The buffer for the normalized auto correlation.
+	 *
+	 * It has maxP + 2 elements, like the one of estimatePeriod.
+	 */
+	double *nac;
+
+	/**
+	 * @brief The kernel specialized for the configuration, or null to use
+	 *  the generic one.
+	 */
+	const NacKernel *kernel;
+};
+
+/**
+ * @brief The candidates that an estimation is collecting.
+ */
+typedef struct {
+	/**
+	 * @brief The candidates, from the strongest.
+	 */
+	PeriodCandidate *items;
+
+	/**
+	 * @brief The number of elements of items.
+	 */
+	int capacity;
+
+	/**
+	 * @brief The number of candidates collected so far.
+	 */
+	int count;
+} CandidateList;
+
+/**
+ * @brief The maximum distance of the ratio between two periods from an
+ *  integer, relative to the integer, to consider them related.
+ */
+static const double CANDIDATE_TOLERANCE = 0.03;
+
+/**
+ * @brief The frames of estimatePeriodBatch that a thread estimates.
+ */
+typedef struct {
+	/**
+	 * @brief The signal.
+	 */
+	const float *x;
+
+	/**
+	 * @brief The number of samples of each frame.
+	 */
+	int n;
+
+	/**
+	 * @brief The distance between the beginning of two frames.
+	 */
+	int hop;
+
+	/**
+	 * @brief The first frame of the thread.
+	 */
+	int first;
+
+	/**
+	 * @brief The frame after the last one of the thread.
+	 */
+	int last;
+
+	/**
+	 * @brief The configuration of the estimator.
+	 */
+	const EstimatorConfig *config;
+
+	/**
+	 * @brief The output array of the periods of all the frames.
+	 */
+	double *periods;
+
+	/**
+	 * @brief The output array of the qualities of all the frames.
+	 */
+	double *qualities;
+
+	/**
+	 * @brief Set to 1 if the estimator could not be created.
+	 */
+	int error;
+} BatchJob;
+
 /**
  * @brief The buffer that contains the normalized auto correlation.
  *
@@ -53,6 +214,22 @@ static double *gNac = 0;
  */
 static size_t gLength = 0;
 
+/**
+ * @brief Estimate the frames of a BatchJob.
+ *
+ * @param arg The job
+ * @return Always null
+ */
+static void *runBatch(void *arg);
+
+/**
+ * @brief Find the specialized kernel of a configuration.
+ *
+ * @param config The configuration of the estimator
+ * @return The kernel, or null if the build has none for the configuration
+ */
+static const NacKernel *findKernel(const EstimatorConfig *config);
+
 /**
  * @brief Allocate the buffer for the auto correlation.
  *
@@ -62,6 +239,29 @@ static size_t gLength = 0;
  */
 static double *alloc(size_t size);
 
+/**
+ * @brief Estimate the period of a signal, with the buffer passed by the caller.
+ *
+ * This is the body shared by estimatePeriod and estimatorRun.
+ * @sa estimatePeriod
+ *
+ * @param x The signal
+ * @param n The number of samples
+ * @param minP Minimum period of interest
+ * @param maxP Maximum period of interest
+ * @param q Quality of the periodicity
+ * @param periodInt The period without interpolation, or null
+ * @param nac The buffer for the normalized autocorrelation, with at least
+ *  maxP + 2 elements
+ * @param config The options of the search. Its range is ignored
+ * @param candidates The list for the peaks, or null
+ * @param kernel The specialized kernel of the estimator, or null
+ * @return The period of the signal
+ */
+static double estimate(const float *x, int n, int minP, int maxP, double *q,
+		int *periodInt, double *nac, const EstimatorConfig *config,
+		CandidateList *candidates, const NacKernel *kernel);
+
 /**
  * @brief Computes the normalized auto correlation.
  *
@@ -70,13 +270,161 @@ static double *alloc(size_t size);
  * NAC is also exactly 1.0 for periodic signal with exponential decay or
  * increase in magnitude.
  *
+ * The lags are evaluated from minP - 1 to maxP + 1.
+ * When ratio is greater than 1, each evaluated lag is about ratio times the
+ * previous one, and the other elements of nac are set to NAN.
+ *
+ * @param x The signal
+ * @param n The number of samples in the signal
+ * @param minP The minimum period of interest
+ * @param maxP The maximum period of interest
+ * @param nac The array of the correlation
+ * @param ratio The ratio between two evaluated lags, 1 to evaluate all of them
+ * @param config The options of the estimator, for the window of the lags and
+ *  the precision of the sums
+ */
+static void computeNac(const float *x, int n, int minP, int maxP, double *nac,
+		double ratio, const EstimatorConfig *config);
+
+/**
+ * @brief Computes the normalized auto correlation on the whole signal.
+ *
+ * This is the body of computeNac when the sums of squares are shared by all
+ * the lags.
+ * It is always inlined, so the kernels that call it with constant arguments
+ * get constant trip counts.
+ * @sa computeNac
+ *
  * @param x The signal
  * @param n The number of samples in the signal
  * @param minP The minimum period of interest
  * @param maxP The maximum period of interest
  * @param nac The array of the correlation
+ * @param ratio The ratio between two evaluated lags, 1 to evaluate all of them
+ * @param floatSums Accumulate the products in float
+ * @sa EstimatorConfig.floatSums
+ */
+static ESTIMATOR_INLINE void sharedNac(const float *x, int n, int minP,
+		int maxP, double *nac, double ratio, int floatSums);
+
+/**
+ * @brief Computes the products of LAG_TILE consecutive lags.
+ *
+ * Each sample is loaded once for all the lags, and each sum is accumulated in
+ * the same order as a loop on a single lag would do, so the results are the
+ * same.
+ *
+ * @param x The signal
+ * @param n The number of samples in the signal
+ * @param p The first lag
+ * @param ac Output array for the LAG_TILE autocorrelations
+ */
+static ESTIMATOR_INLINE void tileProducts(const float *x, int n, int p,
+		double *ac);
+
+/**
+ * @brief Computes the normalized auto correlation of a single lag.
+ *
+ * It is used for the lags that the coarse search has skipped, and for all
+ * the lags when each one has its own window.
+ *
+ * @param x The signal
+ * @param n The number of samples in the signal
+ * @param p The lag
+ * @param config The options of the estimator, for the window of the lag and
+ *  the precision of the sums
+ * @return The normalized auto correlation
  */
-static void computeNac(const float *x, int n, int minP, int maxP, double *nac);
+static double lagNac(const float *x, int n, int p,
+		const EstimatorConfig *config);
+
+/**
+ * @brief Computes the sum of the products of two arrays in float.
+ *
+ * The products are accumulated on SUM_LANES independent lanes in blocks of
+ * SUM_BLOCK samples, and then the sums of the blocks are added pairwise, so
+ * the error grows with the logarithm of the length, rather than linearly.
+ *
+ * @param a The first array
+ * @param b The second array
+ * @param n The number of elements
+ * @return The sum of the products
+ */
+static float pairwiseProducts(const float *a, const float *b, int n);
+
+/**
+ * @brief Computes the products of LAG_TILE consecutive lags in float.
+ *
+ * Each lag has its own lanes and its own pairwise sums, on the same blocks as
+ * pairwiseProducts, so the error is the same as a call to it for each lag,
+ * but each sample is loaded once for all the lags.
+ *
+ * @param x The signal
+ * @param n The number of samples in the signal
+ * @param p The first lag
+ * @param ac Output array for the LAG_TILE autocorrelations
+ */
+static void tilePairwiseProducts(const float *x, int n, int p, double *ac);
+
+/**
+ * @brief Add the sum of a block to the pending pairwise sums.
+ * @sa pairwiseProducts
+ *
+ * @param levels The pending sums, the i-th one has 2^i blocks
+ * @param blocks The number of blocks added so far
+ * @param sum The sum of the new block
+ */
+static ESTIMATOR_INLINE void addBlock(float *levels, unsigned int blocks,
+		float sum);
+
+/**
+ * @brief Add the pending pairwise sums.
+ * @sa pairwiseProducts
+ *
+ * @param levels The pending sums, the i-th one has 2^i blocks
+ * @param blocks The number of blocks added
+ * @return The total sum
+ */
+static ESTIMATOR_INLINE float sumLevels(const float *levels,
+		unsigned int blocks);
+
+/**
+ * @brief Computes the sum of the products of a block of two arrays.
+ * @sa pairwiseProducts
+ *
+ * @param a The first array
+ * @param b The second array
+ * @param n The number of elements, at most SUM_BLOCK
+ * @return The sum of the products
+ */
+static ESTIMATOR_INLINE float blockProducts(const float *a, const float *b,
+		int n);
+
+/**
+ * @brief Computes the sums of the products of a full block of LAG_TILE
+ *  consecutive lags.
+ * @sa tilePairwiseProducts
+ *
+ * @param a The first array
+ * @param b The second array, shifted by the first lag
+ * @param sums Output array for the LAG_TILE sums
+ */
+static ESTIMATOR_INLINE void tileBlockProducts(const float *a, const float *b,
+		float *sums);
+
+/**
+ * @brief Find the best lag of the coarse search.
+ *
+ * @param nac The array of the correlation, with NAN on the skipped lags
+ * @param minP The minimum period of interest
+ * @param maxP The maximum period of interest
+ * @param lo Output parameter for the evaluated lag before the best one, or
+ *  minP
+ * @param hi Output parameter for the evaluated lag after the best one, or maxP
+ * @param candidates The list for the peaks of the grid, or null
+ */
+static void findGridPeak(const double *nac, int minP, int maxP, int *lo,
+		int *hi, CandidateList *candidates);
 
 /**
  * @brief Find the peak of the auto correlation in the range of interest.
@@ -85,9 +433,40 @@ static void computeNac(const float *x, int n, int minP, int maxP, double *nac);
  * @param minP The minimum period of interest
  * @param maxP The maximum period of interest
  * @param period The estimated period from interpolation
+ * @param candidates The list for the peaks, or null
  * @return The index of the element with the maximum auto correlation
  */
-static int findPeak(const double *nac, int minP, int maxP, double *period);
+static int findPeak(const double *nac, int minP, int maxP, double *period,
+		CandidateList *candidates);
+
+/**
+ * @brief Interpolate the position of a peak with its neighbours.
+ *
+ * @param nac The array of the correlation
+ * @param best The index of the peak
+ * @return The interpolated period
+ */
+static double interpolatePeak(const double *nac, int best);
+
+/**
+ * @brief Add a peak to a list of candidates, if it is among the strongest.
+ *
+ * @param candidates The list, or null
+ * @param nac The array of the correlation
+ * @param lag The lag of the peak
+ */
+static void addCandidate(CandidateList *candidates, const double *nac,
+		int lag);
+
+/**
+ * @brief Interpolate the candidates and relate them to the estimated period.
+ *
+ * @param candidates The list
+ * @param nac The array of the correlation
+ * @param period The estimated period
+ */
+static void finishCandidates(CandidateList *candidates, const double *nac,
+		double period);
 
 /**
  * @brief Check for and correct the octave errors.
@@ -103,22 +482,148 @@ static int findPeak(const double *nac, int minP, int maxP, double *period);
  * E.g. if we think the real period is at 1/3 our initial estimate, we check
  * whether the NAC is strong at 1/3 and 2/3 of the original period estimate.
  *
+ * The lags skipped by the coarse search are evaluated only when they are
+ * checked.
+ *
+ * @param x The signal
+ * @param n The number of samples in the signal
+ * @param config The options of the estimator, to compute the skipped lags
  * @param nac The array of the correlation
  * @param minP The minimum period of interest
  * @param period The estimated period
  * @param maxNac The index of the element that has maximum auto correlation
  * @return The (eventually) changed period
  */
-static double fixOctaves(const double *nac, int minP, double period, int maxNac);
+static double fixOctaves(const float *x, int n, const EstimatorConfig *config,
+		double *nac, int minP, double period, int maxNac);
 
 double estimatePeriod(const float *x, int n, int minP, int maxP, double *q,
 		int *periodInt)
 {
+	assert(q);
+
+	/// The buffer to store normalized auto correlation into
+	double *nac;
+
+	/* Size is maxP + 2 (not maxP + 1) because we need up to element maxP + 1 to
+	check whether element at maxP is a peak.
+	Thanks to Les Cargill for spotting the bug. */
+	if(!(nac = alloc(maxP + 2))) {
+		fprintf(stderr, "Could not allocate the buffer for the autocorrelation.\n");
+		*q = -1.0;
+		return 0;
+	}
+
+	/// The default options
+	EstimatorConfig config;
+	estimatorConfigInit(&config, minP, maxP);
+
+	return estimate(x, n, minP, maxP, q, periodInt, nac, &config, 0, 0);
+}
+
+void estimatorConfigInit(EstimatorConfig *config, int minP, int maxP)
+{
+	assert(config);
+
+	config->minP = minP;
+	config->maxP = maxP;
+	config->gridStep = 0;
+	config->periods = 0;
+	config->floatSums = 0;
+}
+
+size_t estimatorMemorySize(const EstimatorConfig *config)
+{
+	return ARENA_ALIGN(sizeof(PeriodEstimator)) +
+			ARENA_ALIGN((config->maxP + 2) * sizeof(double));
+}
+
+PeriodEstimator *estimatorCreate(Arena *arena, const EstimatorConfig *config)
+{
+	assert(arena);
+	assert(config);
+	assert(config->minP > 1);
+	assert(config->maxP > config->minP);
+	assert(config->periods == 0 || config->periods >= 2);
+
+	/// The instance that will be returned
+	PeriodEstimator *ret = arenaAlloc(arena, sizeof(PeriodEstimator));
+	if(!ret) {
+		return 0;
+	}
+
+	ret->config = *config;
+
+	// See estimatePeriod for the size of the buffer
+	ret->nac = arenaAlloc(arena, (config->maxP + 2) * sizeof(double));
+	if(!ret->nac) {
+		return 0;
+	}
+
+	ret->kernel = findKernel(config);
+
+	return ret;
+}
+
+int estimatorSpecialized(const PeriodEstimator *estimator, int n)
+{
+	assert(estimator);
+	return estimator->kernel && estimator->kernel->window == n;
+}
+
+double estimatorRun(PeriodEstimator *estimator, const float *x, int n,
+		double *q, int *periodInt)
+{
+	assert(estimator);
+
+	return estimate(x, n, estimator->config.minP, estimator->config.maxP, q,
+			periodInt, estimator->nac, &estimator->config, 0, estimator->kernel);
+}
+
+double estimatorRunCandidates(PeriodEstimator *estimator, const float *x,
+		int n, double *q, int *periodInt, PeriodCandidate *candidates, int k,
+		int *count)
+{
+	assert(estimator);
+	assert(candidates || k == 0);
+	assert(count);
+
+	/// The list of the candidates
+	CandidateList list = {candidates, k, 0};
+	/// The estimated period
+	double period = estimate(x, n, estimator->config.minP,
+			estimator->config.maxP, q, periodInt, estimator->nac,
+			&estimator->config, &list, estimator->kernel);
+
+	*count = list.count;
+
+	return period;
+}
+
+double estimatorRunRange(PeriodEstimator *estimator, const float *x, int n,
+		int minP, int maxP, double *q, int *periodInt)
+{
+	assert(estimator);
+	assert(minP >= estimator->config.minP);
+	assert(maxP <= estimator->config.maxP);
+
+	return estimate(x, n, minP, maxP, q, periodInt, estimator->nac,
+			&estimator->config, 0, estimator->kernel);
+}
+
+static double estimate(const float *x, int n, int minP, int maxP, double *q,
+		int *periodInt, double *nac, const EstimatorConfig *config,
+		CandidateList *candidates, const NacKernel *kernel)
+{
+	/// The spacing of the coarse search
+	double gridStep = config->gridStep;
+
 	assert(minP > 1);
 	assert(maxP > minP);
 	assert(n >= 2*maxP);
 	assert(x != NULL);
 	assert(q);
+	assert(nac);
 
 	/// The period of the signal
 	double period = 0.0;
@@ -131,25 +636,52 @@ double estimatePeriod(const float *x, int n, int minP, int maxP, double *q,
 	 */
 	int maxNac;
 
-	/// The buffer to store normalized auto correlation into
-	double *nac;
-
 	*q = 0;
 
-	/* Size is maxP + 2 (not maxP + 1) because we need up to element maxP + 1 to
-	check whether element at maxP is a peak.
-	Thanks to Les Cargill for spotting the bug. */
-	if(!(nac = alloc(maxP + 2))) {
-		fprintf(stderr, "Could not allocate the buffer for the autocorrelation.\n");
-		*q = -1.0;
-		return 0;
+	// The kernel is valid only for the whole range and the same window
+	if(kernel && (n != kernel->window || minP != kernel->minP ||
+			maxP != kernel->maxP)) {
+		kernel = 0;
 	}
 
-	computeNac(x, n, minP, maxP, nac);
+	if(gridStep > 0) {
+		/// The evaluated lags around the best one of the grid
+		int lo, hi;
+
+		if(kernel) {
+			kernel->compute(x, nac, pow(2, gridStep / 12));
+		} else {
+			computeNac(x, n, minP, maxP, nac, pow(2, gridStep / 12), config);
+		}
+		findGridPeak(nac, minP, maxP, &lo, &hi, candidates);
 
-	maxNac = findPeak(nac, minP, maxP, &period);
+		// The peak is between the neighbours, so only this part is refined
+		computeNac(x, n, lo, hi, nac, 1, config);
+		maxNac = findPeak(nac, lo, hi, &period, 0);
+
+		// The refined peak replaces the point of the grid it comes from
+		for(int i = 0; candidates && maxNac != -1 && i < candidates->count;
+				i++) {
+			if(candidates->items[i].lag >= lo &&
+					candidates->items[i].lag <= hi) {
+				candidates->items[i].lag = maxNac;
+				break;
+			}
+		}
+	} else {
+		if(kernel) {
+			kernel->compute(x, nac, 1);
+		} else {
+			computeNac(x, n, minP, maxP, nac, 1, config);
+		}
+		maxNac = findPeak(nac, minP, maxP, &period, candidates);
+	}
 	if(maxNac == -1) {
-		return 0.0;
+		if(candidates) {
+			candidates->count = 0;
+		}
+		// NaN if the correlation was, 0 otherwise
+		return period;
 	}
 
 	/* "Quality" of periodicity is the normalized autocorrelation at the best
@@ -160,11 +692,96 @@ double estimatePeriod(const float *x, int n, int minP, int maxP, double *q,
 		*periodInt = maxNac;
 	}
 
-	period = fixOctaves(nac, minP, period, maxNac);
+	period = fixOctaves(x, n, config, nac, minP, period, maxNac);
+
+	if(candidates) {
+		finishCandidates(candidates, nac, period);
+	}
 
 	return period;
 }
 
+static void *runBatch(void *arg)
+{
+	/// The job of this thread
+	BatchJob *job = (BatchJob *) arg;
+	/// The memory of the estimator
+	Arena *arena = arenaCreate(estimatorMemorySize(job->config));
+	/// The estimator shared by all the frames of the job
+	PeriodEstimator *estimator = arena ? estimatorCreate(arena, job->config) :
+			0;
+
+	if(!estimator) {
+		job->error = 1;
+	}
+
+	for(int i = job->first; i < job->last; i++) {
+		if(estimator) {
+			job->periods[i] = estimatorRun(estimator,
+					job->x + (size_t) i * job->hop, job->n, &job->qualities[i], 0);
+		} else {
+			job->periods[i] = 0;
+			job->qualities[i] = -1.0;
+		}
+	}
+
+	if(arena) {
+		arenaFree(arena);
+	}
+
+	return 0;
+}
+
+#ifdef ESTIMATOR_KERNELS
+
+/* Each kernel is the shared body of computeNac with the bounds of its
+configuration as constants, so the compiler can unroll the tiles and knows all
+the trip counts. */
+#define ESTIMATOR_KERNEL(RATE, MINP, MAXP, WINDOW) \
+	static void nacKernel_##RATE##_##MINP##_##MAXP##_##WINDOW(const float *x, \
+			double *nac, double ratio) \
+	{ \
+		sharedNac(x, WINDOW, MINP, MAXP, nac, ratio, 0); \
+	}
+ESTIMATOR_KERNELS
+#undef ESTIMATOR_KERNEL
+
+/**
+ * @brief The kernels chosen when the program was built.
+ */
+static const NacKernel KERNELS[] = {
+#define ESTIMATOR_KERNEL(RATE, MINP, MAXP, WINDOW) \
+	{MINP, MAXP, WINDOW, nacKernel_##RATE##_##MINP##_##MAXP##_##WINDOW},
+	ESTIMATOR_KERNELS
+#undef ESTIMATOR_KERNEL
+};
+
+static const NacKernel *findKernel(const EstimatorConfig *config)
+{
+	// The per-lag windows and the float sums need a different body
+	if(config->periods || config->floatSums) {
+		return 0;
+	}
+
+	for(size_t i = 0; i < sizeof(KERNELS) / sizeof(KERNELS[0]); i++) {
+		if(KERNELS[i].minP == config->minP && KERNELS[i].maxP == config->maxP) {
+			return &KERNELS[i];
+		}
+	}
+
+	return 0;
+}
+
+#else
+
+static const NacKernel *findKernel(const EstimatorConfig *config)
+{
+	(void) config;
+	return 0;
+}
+
+#endif
+
 static double *alloc(size_t size)
 {
 	if(gNac == 0) {
@@ -178,8 +795,38 @@ static double *alloc(size_t size)
 	return gNac;
 }
 
-static void computeNac(const float *x, int n, int minP, int maxP, double *nac)
+static void computeNac(const float *x, int n, int minP, int maxP, double *nac,
+		double ratio, const EstimatorConfig *config)
 {
+	/// The next lag to evaluate
+	int next = minP - 1;
+
+	/* Each lag has its own window, so the sums of squares cannot be shared,
+	but the short lags use only a few periods of the signal. */
+	if(config->periods) {
+		for(int p = minP - 1; p <= maxP + 1; p++) {
+			if(p < next) {
+				nac[p] = NAN;
+				continue;
+			}
+			next = (int) (p * ratio + 0.5);
+			if(next <= p) {
+				next = p + 1;
+			}
+
+			nac[p] = lagNac(x, n, p, config);
+		}
+		return;
+	}
+
+	sharedNac(x, n, minP, maxP, nac, ratio, config->floatSums);
+}
+
+static ESTIMATOR_INLINE void sharedNac(const float *x, int n, int minP,
+		int maxP, double *nac, double ratio, int floatSums)
+{
+	/// The next lag to evaluate
+	int next = minP - 1;
 	/// Sum of squares of beginning part
 	double sumSqBeg = 0.0;
 	/**
@@ -197,39 +844,289 @@ static void computeNac(const float *x, int n, int minP, int maxP, double *nac)
 		sumSqEnd += x[j] * x[j];
 	}
 
+	/// Standard auto-correlation of the lags of the current tile
+	double ac[LAG_TILE];
+	/// The first lag of the current tile
+	int tile = minP - 1;
+	/// The last lag of the current tile
+	int tileEnd = minP - 2;
+
 	for(int p = minP - 1; p <= maxP + 1; p++) {
-		/// Standard auto-correlation
-		double ac = 0.0;
+		// The sums of squares must be updated also for the skipped lags
+		sumSqBeg -= x[n - p] * x[n - p];
+		sumSqEnd -= x[p - 1] * x[p - 1];
 
-		for(int i = 0; i < n - p; i++) {
-			ac += x[i] * x[i + p];
+		if(p < next) {
+			nac[p] = NAN;
+			continue;
+		}
+		next = (int) (p * ratio + 0.5);
+		if(next <= p) {
+			next = p + 1;
 		}
 
-		sumSqBeg -= x[n - p] * x[n - p];
-		sumSqEnd -= x[p - 1] * x[p - 1];
+		/* The lags are consecutive when the grid is finer than a sample, so
+		they are computed in tiles. */
+		if(p > tileEnd) {
+			tile = p;
+			if(p + LAG_TILE - 1 <= maxP + 1 &&
+					(int) ((p + LAG_TILE - 2) * ratio + 0.5) <= p + LAG_TILE - 1) {
+				tileEnd = p + LAG_TILE - 1;
+				if(floatSums) {
+					tilePairwiseProducts(x, n, p, ac);
+				} else {
+					tileProducts(x, n, p, ac);
+				}
+			} else if(floatSums) {
+				tileEnd = p;
+				ac[0] = pairwiseProducts(x, x + p, n - p);
+			} else {
+				tileEnd = p;
+				ac[0] = 0.0;
+				for(int i = 0; i < n - p; i++) {
+					ac[0] += x[i] * x[i + p];
+				}
+			}
+		}
 
 		if(sumSqBeg != 0 && sumSqEnd != 0) {
-			nac[p] = ac / sqrt(sumSqBeg * sumSqEnd);
+			nac[p] = ac[p - tile] / sqrt(sumSqBeg * sumSqEnd);
 		} else {
 			nac[p] = 0;
 		}
 	}
 }
 
-static int findPeak(const double *nac, int minP, int maxP, double *period)
+static ESTIMATOR_INLINE void tileProducts(const float *x, int n, int p,
+		double *ac)
 {
-	/**
-	 * @brief The maximum relative error to accept the frequency interpolation.
-	 *
-	 * Once the peak is found, there's a linear interpolation between the peak
-	 * and the previous and following values of autocorrelation.
-	 *
-	 * However if these three values are too near, the shift explodes, and
-	 * during tests this lead to negative frequencies in some cases!
-	 * So if the shift value is too high, we just ignore it.
-	 */
-	const double shiftMaxError = 0.2;
+	/// The products that all the lags of the tile have
+	int common = n - p - (LAG_TILE - 1);
+
+	for(int j = 0; j < LAG_TILE; j++) {
+		ac[j] = 0.0;
+	}
+
+	for(int i = 0; i < common; i++) {
+		ac[0] += x[i] * x[i + p];
+		ac[1] += x[i] * x[i + p + 1];
+		ac[2] += x[i] * x[i + p + 2];
+		ac[3] += x[i] * x[i + p + 3];
+	}
+
+	// The shorter lags have some more products
+	for(int j = 0; j < LAG_TILE - 1; j++) {
+		for(int i = common; i < n - p - j; i++) {
+			ac[j] += x[i] * x[i + p + j];
+		}
+	}
+}
+
+static double lagNac(const float *x, int n, int p,
+		const EstimatorConfig *config)
+{
+	/// The window of the lag in periods
+	int periods = config->periods;
+	/// Standard auto-correlation
+	double ac = 0.0;
+	/// Sum of squares of beginning part
+	double sumSqBeg = 0.0;
+	/// Sum of squares of ending part
+	double sumSqEnd = 0.0;
+
+	// The window is made of the most recent samples
+	if(periods && periods * p < n) {
+		x += n - periods * p;
+		n = periods * p;
+	}
+
+	if(config->floatSums) {
+		ac = pairwiseProducts(x, x + p, n - p);
+		sumSqBeg = pairwiseProducts(x, x, n - p);
+		sumSqEnd = pairwiseProducts(x + p, x + p, n - p);
+	} else {
+		for(int i = 0; i < n - p; i++) {
+			ac += x[i] * x[i + p];
+			sumSqBeg += x[i] * x[i];
+			sumSqEnd += x[i + p] * x[i + p];
+		}
+	}
+
+	if(sumSqBeg != 0 && sumSqEnd != 0) {
+		return ac / sqrt(sumSqBeg * sumSqEnd);
+	}
+
+	return 0;
+}
+
+static float pairwiseProducts(const float *a, const float *b, int n)
+{
+	/// The pending sums, the i-th one has 2^i blocks
+	float levels[sizeof(int) * 8];
+	/// The number of blocks added so far
+	unsigned int blocks = 0;
+
+	for(int i = 0; i < n; i += SUM_BLOCK, blocks++) {
+		addBlock(levels, blocks, blockProducts(a + i, b + i,
+				n - i < SUM_BLOCK ? n - i : SUM_BLOCK));
+	}
+
+	return sumLevels(levels, blocks);
+}
+
+static void tilePairwiseProducts(const float *x, int n, int p, double *ac)
+{
+	/// The pending sums of each lag, the i-th one has 2^i blocks
+	float levels[LAG_TILE][sizeof(int) * 8];
+	/// The number of blocks added so far to each lag
+	unsigned int blocks[LAG_TILE] = {0};
+	/// The sums of the current block of each lag
+	float sums[LAG_TILE];
+	/// The first product that not all the lags of the tile have
+	int common = n - p - (LAG_TILE - 1);
+	int i = 0;
+
+	for(; i + SUM_BLOCK <= common; i += SUM_BLOCK) {
+		tileBlockProducts(x + i, x + p + i, sums);
+		for(int j = 0; j < LAG_TILE; j++) {
+			addBlock(levels[j], blocks[j]++, sums[j]);
+		}
+	}
+
+	// The last block is shorter, and it is empty for some lags
+	for(; i < n - p; i += SUM_BLOCK) {
+		for(int j = 0; j < LAG_TILE && i < n - p - j; j++) {
+			int m = n - p - j - i;
+			addBlock(levels[j], blocks[j]++, blockProducts(x + i, x + p + j + i,
+					m < SUM_BLOCK ? m : SUM_BLOCK));
+		}
+	}
+
+	for(int j = 0; j < LAG_TILE; j++) {
+		ac[j] = sumLevels(levels[j], blocks[j]);
+	}
+}
+
+static ESTIMATOR_INLINE void addBlock(float *levels, unsigned int blocks,
+		float sum)
+{
+	// Like a binary counter, the sums of the same size are merged
+	int level = 0;
+	for(unsigned int carry = blocks; carry & 1; carry >>= 1) {
+		sum += levels[level++];
+	}
+	levels[level] = sum;
+}
 
+static ESTIMATOR_INLINE float sumLevels(const float *levels,
+		unsigned int blocks)
+{
+	/// The return value
+	float ret = 0;
+
+	for(int level = 0; blocks >> level; level++) {
+		if((blocks >> level) & 1) {
+			ret += levels[level];
+		}
+	}
+
+	return ret;
+}
+
+static ESTIMATOR_INLINE float blockProducts(const float *a, const float *b,
+		int n)
+{
+	/// The independent sums, which are the lanes of the vectors
+	float lanes[SUM_LANES] = {0};
+	int i = 0;
+
+	for(; i + SUM_LANES <= n; i += SUM_LANES) {
+		for(int j = 0; j < SUM_LANES; j++) {
+			lanes[j] += a[i + j] * b[i + j];
+		}
+	}
+	for(; i < n; i++) {
+		lanes[0] += a[i] * b[i];
+	}
+
+	// The lanes are added pairwise too
+	for(int width = SUM_LANES / 2; width > 0; width /= 2) {
+		for(int j = 0; j < width; j++) {
+			lanes[j] += lanes[j + width];
+		}
+	}
+
+	return lanes[0];
+}
+
+static ESTIMATOR_INLINE void tileBlockProducts(const float *a, const float *b,
+		float *sums)
+{
+	/// The independent sums of each lag, like those of blockProducts
+	float lanes[LAG_TILE][SUM_LANES] = {{0}};
+
+	for(int i = 0; i < SUM_BLOCK; i += SUM_LANES) {
+		for(int k = 0; k < SUM_LANES; k++) {
+			lanes[0][k] += a[i + k] * b[i + k];
+			lanes[1][k] += a[i + k] * b[i + k + 1];
+			lanes[2][k] += a[i + k] * b[i + k + 2];
+			lanes[3][k] += a[i + k] * b[i + k + 3];
+		}
+	}
+
+	for(int j = 0; j < LAG_TILE; j++) {
+		for(int width = SUM_LANES / 2; width > 0; width /= 2) {
+			for(int k = 0; k < width; k++) {
+				lanes[j][k] += lanes[j][k + width];
+			}
+		}
+		sums[j] = lanes[j][0];
+	}
+}
+
+static void findGridPeak(const double *nac, int minP, int maxP, int *lo,
+		int *hi, CandidateList *candidates)
+{
+	/// The best evaluated lag
+	int best = -1;
+	/// The last evaluated lag
+	int previous = minP;
+	/// Whether the correlation was rising at the last evaluated lag
+	int rising = 1;
+
+	*lo = minP;
+	*hi = maxP;
+
+	for(int p = minP; p <= maxP; p++) {
+		if(isnan(nac[p])) {
+			continue;
+		}
+
+		// The previous lag is a peak of the grid
+		if(best >= 0 && rising && nac[p] <= nac[previous]) {
+			addCandidate(candidates, nac, previous);
+		}
+		rising = best < 0 || nac[p] > nac[previous];
+
+		if(best < 0 || nac[p] > nac[best]) {
+			best = p;
+			*lo = previous;
+			*hi = maxP;
+		} else if(*hi == maxP && best == previous) {
+			*hi = p;
+		}
+
+		previous = p;
+	}
+
+	if(rising && best >= 0) {
+		addCandidate(candidates, nac, previous);
+	}
+}
+
+static int findPeak(const double *nac, int minP, int maxP, double *period,
+		CandidateList *candidates)
+{
 	/// The return value
 	int best = minP;
 
@@ -237,6 +1134,11 @@ static int findPeak(const double *nac, int minP, int maxP, double *period)
 		if(nac[p] > nac[best]) {
 			best = p;
 		}
+
+		// The local maxima are collected in the same pass
+		if(candidates && nac[p] > nac[p - 1] && nac[p] >= nac[p + 1]) {
+			addCandidate(candidates, nac, p);
+		}
 	}
 
 	/*  Give up if it's highest value, but not actually a peak.
@@ -245,6 +1147,46 @@ static int findPeak(const double *nac, int minP, int maxP, double *period)
 		return -1;
 	}
 
+	*period = interpolatePeak(nac, best);
+
+	/*
+	 * Some ill formed signals can contain NaN values.
+	 * This could happen, on guitar signals, when cables are defective and they
+	 * produce high power noises, or when mechanical switches (pickup selector,
+	 * volume potentiometer...) are used.
+	 *
+	 * During tests we encountered some situations of this kind, and a peak was
+	 * found correctly, but since the signal is corrupted, we prefer returning
+	 * an error.
+	 * The period is set to NaN, so that the callers can tell a corrupted
+	 * signal from one without a peak. The interpolation can hide the NaN of
+	 * the correlation, so the peak is checked too.
+	 */
+	if(isnan(nac[best]) || isnan(*period)) {
+		*period = NAN;
+		return -1;
+	}
+
+	return best;
+}
+
+static double interpolatePeak(const double *nac, int best)
+{
+	/**
+	 * @brief The maximum relative error to accept the frequency interpolation.
+	 *
+	 * Once the peak is found, there's a linear interpolation between the peak
+	 * and the previous and following values of autocorrelation.
+	 *
+	 * However if these three values are too near, the shift explodes, and
+	 * during tests this lead to negative frequencies in some cases!
+	 * So if the shift value is too high, we just ignore it.
+	 */
+	const double shiftMaxError = 0.2;
+
+	/// The interpolated period
+	double period = best;
+
 	/* Interpolate based on neighboring values.
 	E.g. if value to right is bigger than value to the left, real peak is a bit
 	to the right of discretized peak.
@@ -255,37 +1197,98 @@ static int findPeak(const double *nac, int minP, int maxP, double *period)
 	double left  = nac[best - 1];
 	double right = nac[best + 1];
 
-	*period = best;
-
 	if(2 * mid - left - right != 0.0) {
 		double shift = 0.5 * (right - left) / ( 2 * mid - left - right );
 
 		if(fabs(shift) < shiftMaxError * best) {
-			*period = best + shift;
+			period = best + shift;
 		}
 	}
 	/* else mid == (left + right) / 2 => no shift required and "best" is already
 	the best period. */
 
-	/*
-	 * Some ill formed signals can contain NaN values.
-	 * This could happen, on guitar signals, when cables are defective and they
-	 * produce high power noises, or when mechanical switches (pickup selector,
-	 * volume potentiometer...) are used.
-	 *
-	 * During tests we encountered some situations of this kind, and a peak was
-	 * found correctly, but since the signal is corrupted, we prefer returning
-	 * an error.
-	 */
-	if(isnan(*period)) {
-		*period = 0.0;
-		return -1;
+	return period;
+}
+
+static void addCandidate(CandidateList *candidates, const double *nac,
+		int lag)
+{
+	/// The position of the new candidate in the list
+	int i;
+
+	if(!candidates || !candidates->capacity) {
+		return;
 	}
 
-	return best;
+	i = candidates->count < candidates->capacity ? candidates->count :
+			candidates->capacity - 1;
+	if(candidates->count == candidates->capacity &&
+			!(nac[lag] > candidates->items[i].quality)) {
+		return;
+	}
+
+	// The weaker candidates move down, and the weakest one can be dropped
+	for(; i > 0 && candidates->items[i - 1].quality < nac[lag]; i--) {
+		candidates->items[i] = candidates->items[i - 1];
+	}
+	candidates->items[i].lag = lag;
+	candidates->items[i].quality = nac[lag];
+	if(candidates->count < candidates->capacity) {
+		candidates->count++;
+	}
+}
+
+static void finishCandidates(CandidateList *candidates, const double *nac,
+		double period)
+{
+	for(int i = 0; i < candidates->count; i++) {
+		PeriodCandidate *c = &candidates->items[i];
+		/// The ratio between the longer and the shorter period
+		double ratio;
+		/// The nearest integer to ratio
+		int multiple;
+
+		// Only the dense parts have the neighbours for the interpolation
+		c->quality = nac[c->lag];
+		if(isnan(nac[c->lag - 1]) || isnan(nac[c->lag + 1])) {
+			c->period = c->lag;
+		} else {
+			c->period = interpolatePeak(nac, c->lag);
+		}
+
+		ratio = c->period > period ? c->period / period : period / c->period;
+		multiple = (int) (ratio + 0.5);
+		c->flags = 0;
+		c->ratio = 0;
+		if(fabs(ratio - multiple) >= CANDIDATE_TOLERANCE * multiple) {
+			continue;
+		}
+
+		c->ratio = multiple;
+		if(multiple == 1) {
+			c->flags = ESTIMATOR_CANDIDATE_CHOSEN;
+		} else {
+			c->flags = c->period > period ? ESTIMATOR_CANDIDATE_MULTIPLE :
+					ESTIMATOR_CANDIDATE_SUBMULTIPLE;
+			if(!(multiple & (multiple - 1))) {
+				c->flags |= ESTIMATOR_CANDIDATE_OCTAVE;
+			}
+		}
+	}
+
+	// The refinement can change the order
+	for(int i = 1; i < candidates->count; i++) {
+		PeriodCandidate c = candidates->items[i];
+		int j = i;
+		for(; j > 0 && candidates->items[j - 1].quality < c.quality; j--) {
+			candidates->items[j] = candidates->items[j - 1];
+		}
+		candidates->items[j] = c;
+	}
 }
 
-static double fixOctaves(const double *nac, int minP, double period, int maxNac)
+static double fixOctaves(const float *x, int n, const EstimatorConfig *config,
+		double *nac, int minP, double period, int maxNac)
 {
 	/**
 	 * @brief Threshold to detect the real period.
@@ -303,8 +1306,13 @@ static double fixOctaves(const double *nac, int minP, double period, int maxNac)
 		int subsAllStrong = 1;
 
 		//  For each submultiple
-		for(int k = 1; k < mul; k++) {
+		for(int k = 1; subsAllStrong && k < mul; k++) {
 			int subMulP = (int)(k * period / mul + 0.5);
+
+			if(isnan(nac[subMulP])) {
+				nac[subMulP] = lagNac(x, n, subMulP, config);
+			}
+
 			/* If it's not strong relative to the peak NAC, then not all
 			submultiples are strong, so we haven't found the correct
 			submultiple. */
@@ -329,6 +1337,88 @@ static double fixOctaves(const double *nac, int minP, double period, int maxNac)
 	return period;
 }
 
+double estimateQuality(const float *x, int n, int p)
+{
+	assert(x);
+	assert(p > 0 && p < n);
+
+	/// The default options, for the whole signal in double
+	EstimatorConfig config;
+	estimatorConfigInit(&config, p, p + 1);
+
+	return lagNac(x, n, p, &config);
+}
+
+int estimatePeriodBatch(const float *x, int n, int hop, int frames,
+		const EstimatorConfig *config, int threads, double *periods,
+		double *qualities)
+{
+	assert(x);
+	assert(config);
+	assert(n >= 2 * config->maxP);
+	assert(hop > 0);
+	assert(frames >= 0);
+	assert(periods || !frames);
+	assert(qualities || !frames);
+
+	/// The jobs of the threads
+	BatchJob jobs[ESTIMATOR_BATCH_MAX_THREADS];
+	/// The threads that have been started
+	pthread_t ids[ESTIMATOR_BATCH_MAX_THREADS];
+	/// Whether each job runs on its own thread
+	int started[ESTIMATOR_BATCH_MAX_THREADS] = {0};
+	/// The return value
+	int ret = 0;
+
+	if(!frames) {
+		return 0;
+	}
+
+	if(threads <= 0) {
+		long processors = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = processors > 0 ? (int) processors : 1;
+	}
+	if(threads > frames) {
+		threads = frames;
+	}
+	if(threads > ESTIMATOR_BATCH_MAX_THREADS) {
+		threads = ESTIMATOR_BATCH_MAX_THREADS;
+	}
+
+	for(int t = 0; t < threads; t++) {
+		jobs[t].x = x;
+		jobs[t].n = n;
+		jobs[t].hop = hop;
+		jobs[t].first = (int) ((long long) frames * t / threads);
+		jobs[t].last = (int) ((long long) frames * (t + 1) / threads);
+		jobs[t].config = config;
+		jobs[t].periods = periods;
+		jobs[t].qualities = qualities;
+		jobs[t].error = 0;
+	}
+
+	// The calling thread takes the first job, and any job without a thread
+	for(int t = 1; t < threads; t++) {
+		started[t] = !pthread_create(&ids[t], 0, runBatch, &jobs[t]);
+	}
+	for(int t = 0; t < threads; t++) {
+		if(!started[t]) {
+			runBatch(&jobs[t]);
+		}
+	}
+
+	for(int t = 0; t < threads; t++) {
+		if(started[t]) {
+			pthread_join(ids[t], 0);
+		}
+		if(jobs[t].error) {
+			ret = -1;
+		}
+	}
+
+	return ret;
+}
+
 void estimateFree()
 {
 	if(gNac) {
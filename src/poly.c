@@ -0,0 +1,599 @@
+/**
+ * @file poly.c
+ * @brief Estimate the notes of a chord.
+ */
+
+#include "poly.h"
+
+// dspFftTwiddles, dspFft
+#include "dsp.h"
+
+// floor, ceil, cos, pow, sqrtf, M_PI
+#include <math.h>
+
+// assert
+#include <assert.h>
+
+/**
+ * @brief The default duration of the window, in seconds.
+ *
+ * The window is the largest power of two that is not longer, so that the
+ * harmonics of E2 and F2 are a few bins apart.
+ */
+static const double WINDOW_SECONDS = 0.2;
+
+/**
+ * @brief The default number of harmonics of the salience.
+ */
+static const unsigned int HARMONICS = 20;
+
+/**
+ * @brief The default minimum salience, relative to the first note.
+ * @sa PolyConfig.minSalience
+ */
+static const double MIN_SALIENCE = 0.15;
+
+/**
+ * @brief The default exponent of the score of a chord.
+ * @sa PolyConfig.gamma
+ */
+static const double GAMMA = 0.4;
+
+/**
+ * @brief The constants of the weight of the harmonics, in Hz.
+ *
+ * The weight of the harmonic m of f0 is (f0 + ALPHA) / (m f0 + BETA), so the
+ * high harmonics of the low notes count less than the fundamental of the high
+ * notes at the same frequency.
+ * @link Klapuri, ISMIR 2006
+ */
+static const double WEIGHT_ALPHA = 27;
+static const double WEIGHT_BETA = 320;
+
+/**
+ * @brief The bins on each side of a harmonic in which its peak is searched
+ *  for the salience.
+ *
+ * The window is zero-padded to twice its length, so a bin is half of the
+ * resolution of the window.
+ */
+static const int SALIENCE_BINS = 1;
+
+/**
+ * @brief The distance of the peak of a partial from its harmonic, in
+ *  semitones, when it is removed.
+ *
+ * It is larger than the band of the salience, because the strings are
+ * slightly inharmonic.
+ */
+static const double PARTIAL_RANGE = 0.5;
+
+/**
+ * @brief The bins on each side of the peak of a partial that are attenuated
+ *  when it is removed, the width of the main lobe of the Hann window.
+ */
+static const int PARTIAL_BINS = 3;
+
+/**
+ * @brief The number of harmonics used to refine the frequency of a note.
+ */
+static const unsigned int REFINE_HARMONICS = 8;
+
+struct _PolyEstimator {
+	/**
+	 * @brief The configuration of the estimator.
+	 */
+	PolyConfig config;
+
+	/**
+	 * @brief The size of the transform, twice the window.
+	 */
+	size_t fftSize;
+
+	/**
+	 * @brief The frequency of a bin of the spectrum.
+	 */
+	double binHz;
+
+	/**
+	 * @brief The Hann window, with config.window elements.
+	 */
+	float *hann;
+
+	/**
+	 * @brief The twiddle factors of the transform.
+	 */
+	float *twiddles;
+
+	/**
+	 * @brief The real part of the transform, with fftSize elements.
+	 */
+	float *re;
+
+	/**
+	 * @brief The imaginary part of the transform, with fftSize elements.
+	 */
+	float *im;
+
+	/**
+	 * @brief The magnitude of the spectrum, with fftSize / 2 elements.
+	 *
+	 * The partials of the notes that have been found are removed from it, so
+	 * it is the residual of the chord.
+	 */
+	float *residual;
+
+	/**
+	 * @brief The fundamental frequency of each candidate, from the lowest one.
+	 */
+	double *candidates;
+};
+
+/**
+ * @brief Compute the salience of a candidate on the residual.
+ *
+ * @param estimator The estimator
+ * @param f0 The fundamental frequency of the candidate
+ * @return The weighted sum of the peaks at its harmonics
+ */
+static double salience(const PolyEstimator *estimator, double f0);
+
+/**
+ * @brief Remove the partials of a note from the residual, and estimate its
+ *  frequency on them.
+ *
+ * Each partial is attenuated to the level of its neighbours, rather than
+ * removed completely, so that the harmonics it shares with another note are
+ * kept for that note.
+ *
+ * @param estimator The estimator
+ * @param f0 The fundamental frequency of the candidate
+ * @return The refined frequency
+ */
+static double removeNote(PolyEstimator *estimator, double f0);
+
+/**
+ * @brief The state of the search of polyAssignStrings.
+ */
+typedef struct {
+	/**
+	 * @brief The frets of each note, or 0 if it cannot be played.
+	 */
+	const semitone_t *frets[POLY_MAX_NOTES];
+
+	/**
+	 * @brief The number of notes.
+	 */
+	unsigned int count;
+
+	/**
+	 * @brief The number of strings of the tuning.
+	 */
+	unsigned int strings;
+
+	/**
+	 * @brief The string of each note in the current assignment, or -1.
+	 */
+	int current[POLY_MAX_NOTES];
+
+	/**
+	 * @brief The string of each note in the best assignment, or -1.
+	 */
+	int best[POLY_MAX_NOTES];
+
+	/**
+	 * @brief The notes assigned by the best assignment.
+	 */
+	unsigned int bestAssigned;
+
+	/**
+	 * @brief The span of the fretted notes of the best assignment.
+	 */
+	int bestSpan;
+
+	/**
+	 * @brief The sum of the frets of the best assignment.
+	 */
+	int bestSum;
+} AssignSearch;
+
+/**
+ * @brief Try all the strings for a note, and recurse on the next ones.
+ *
+ * @param search The state of the search
+ * @param index The index of the note
+ * @param used The mask of the strings that are already taken
+ * @param assigned The number of notes assigned before this one
+ * @param minFret The lowest fretted note so far, or GUITAR_TUNING_RANGE
+ * @param maxFret The highest fretted note so far, or 0
+ * @param sum The sum of the frets so far
+ */
+static void assignNote(AssignSearch *search, unsigned int index,
+		unsigned int used, unsigned int assigned, int minFret, int maxFret,
+		int sum);
+
+void polyConfigInit(PolyConfig *config, unsigned int rate)
+{
+	assert(config);
+
+	config->rate = rate;
+
+	config->window = 1;
+	while(2 * config->window <= rate * WINDOW_SECONDS) {
+		config->window *= 2;
+	}
+
+	config->lowest = noteToSemitones("E", 2);
+	config->highest = noteToSemitones("E", 6);
+	config->maxNotes = POLY_MAX_NOTES;
+	config->harmonics = HARMONICS;
+	config->minSalience = MIN_SALIENCE;
+	config->gamma = GAMMA;
+	config->reference = QUANTIZER_STANDARD_REFERENCE;
+}
+
+size_t polyMemorySize(const PolyConfig *config)
+{
+	assert(config);
+
+	if(!config->rate || config->window < 2 ||
+			(config->window & (config->window - 1)) ||
+			config->lowest > config->highest || !config->maxNotes ||
+			config->maxNotes > POLY_MAX_NOTES || !config->harmonics ||
+			config->harmonics > POLY_MAX_HARMONICS ||
+			!(config->reference > 0)) {
+		return 0;
+	}
+
+	/// The size of the transform
+	size_t fftSize = 2 * (size_t) config->window;
+	/// The number of candidates
+	size_t candidates = (size_t) (config->highest - config->lowest + 1);
+
+	return ARENA_ALIGN(sizeof(PolyEstimator)) +
+			ARENA_ALIGN(config->window * sizeof(float)) +
+			ARENA_ALIGN(2 * fftSize * sizeof(float)) +
+			2 * ARENA_ALIGN(fftSize * sizeof(float)) +
+			ARENA_ALIGN(fftSize / 2 * sizeof(float)) +
+			ARENA_ALIGN(candidates * sizeof(double));
+}
+
+PolyEstimator *polyCreate(Arena *arena, const PolyConfig *config)
+{
+	assert(arena);
+	assert(config);
+
+	/// The instance that will be returned
+	PolyEstimator *ret;
+	/// The size of the transform
+	size_t fftSize = 2 * (size_t) config->window;
+	/// The number of candidates
+	int candidates = config->highest - config->lowest + 1;
+	/// A4, the note of the reference
+	semitone_t a4 = noteToSemitones("A", 4);
+
+	if(!polyMemorySize(config)) {
+		return 0;
+	}
+
+	ret = arenaAlloc(arena, sizeof(PolyEstimator));
+	if(!ret) {
+		return 0;
+	}
+
+	ret->config = *config;
+	ret->fftSize = fftSize;
+	ret->binHz = config->rate / (double) fftSize;
+
+	ret->hann = arenaAlloc(arena, config->window * sizeof(float));
+	ret->twiddles = arenaAlloc(arena, 2 * fftSize * sizeof(float));
+	ret->re = arenaAlloc(arena, fftSize * sizeof(float));
+	ret->im = arenaAlloc(arena, fftSize * sizeof(float));
+	ret->residual = arenaAlloc(arena, fftSize / 2 * sizeof(float));
+	ret->candidates = arenaAlloc(arena, candidates * sizeof(double));
+	if(!ret->hann || !ret->twiddles || !ret->re || !ret->im ||
+			!ret->residual || !ret->candidates) {
+		return 0;
+	}
+
+	for(int i = 0; i < config->window; i++) {
+		ret->hann[i] = (float) (0.5 - 0.5 * cos(2 * M_PI * i /
+				(config->window - 1)));
+	}
+
+	dspFftTwiddles(ret->twiddles, fftSize);
+
+	for(int c = 0; c < candidates; c++) {
+		ret->candidates[c] = config->reference * pow(2,
+				(config->lowest + c - a4) / 12.0);
+	}
+
+	return ret;
+}
+
+unsigned int polyRun(PolyEstimator *estimator, const float *x,
+		PolyNote *notes)
+{
+	assert(estimator);
+	assert(x);
+	assert(notes);
+
+	/// The configuration of the estimator
+	const PolyConfig *config = &estimator->config;
+	/// The number of candidates
+	int candidates = config->highest - config->lowest + 1;
+	/// The number of notes that have been found
+	unsigned int found = 0;
+	/// The salience of the first note
+	double first = 0;
+	/// The sum of the saliences of the notes that have been found
+	double total = 0;
+	/// The score of the notes that have been found
+	double score = 0;
+
+	for(int i = 0; i < config->window; i++) {
+		estimator->re[i] = x[i] * estimator->hann[i];
+		estimator->im[i] = 0;
+	}
+	for(size_t i = config->window; i < estimator->fftSize; i++) {
+		estimator->re[i] = 0;
+		estimator->im[i] = 0;
+	}
+
+	dspFft(estimator->re, estimator->im, estimator->twiddles,
+			estimator->fftSize);
+
+	for(size_t k = 0; k < estimator->fftSize / 2; k++) {
+		estimator->residual[k] = sqrtf(estimator->re[k] * estimator->re[k] +
+				estimator->im[k] * estimator->im[k]);
+	}
+
+	while(found < config->maxNotes) {
+		/// The salience of the best candidate
+		double best = 0;
+		/// The index of the best candidate
+		int bestCandidate = -1;
+
+		for(int c = 0; c < candidates; c++) {
+			/// Whether the candidate has already been found
+			int taken = 0;
+			for(unsigned int i = 0; i < found; i++) {
+				taken = taken || notes[i].note == config->lowest + c;
+			}
+			if(taken) {
+				continue;
+			}
+
+			double s = salience(estimator, estimator->candidates[c]);
+			if(s > best) {
+				best = s;
+				bestCandidate = c;
+			}
+		}
+
+		if(bestCandidate < 0) {
+			break;
+		}
+
+		if(!found) {
+			first = best;
+		} else if(best < config->minSalience * first) {
+			break;
+		}
+
+		/// The score with this note
+		double newScore = (total + best) / pow(found + 1, config->gamma);
+		if(newScore <= score) {
+			break;
+		}
+
+		score = newScore;
+		total += best;
+
+		notes[found].note = config->lowest + bestCandidate;
+		notes[found].salience = best;
+		notes[found].frequency = removeNote(estimator,
+				estimator->candidates[bestCandidate]);
+		notes[found].string = -1;
+		notes[found].fret = -1;
+		found++;
+	}
+
+	return found;
+}
+
+unsigned int polyAssignStrings(const Tuning *tuning, PolyNote *notes,
+		unsigned int count)
+{
+	assert(tuning);
+	assert(notes || !count);
+	assert(count <= POLY_MAX_NOTES);
+
+	/// The state of the search
+	AssignSearch search;
+
+	search.count = count;
+	search.strings = tuning->strings;
+	search.bestAssigned = 0;
+	search.bestSpan = GUITAR_TUNING_RANGE;
+	search.bestSum = 0;
+
+	for(unsigned int i = 0; i < count; i++) {
+		search.frets[i] = tuningLookup(tuning, notes[i].note, 0);
+		search.current[i] = -1;
+		search.best[i] = -1;
+	}
+
+	assignNote(&search, 0, 0, 0, GUITAR_TUNING_RANGE, 0, 0);
+
+	for(unsigned int i = 0; i < count; i++) {
+		notes[i].string = search.best[i];
+		notes[i].fret = search.best[i] < 0 ? -1 :
+				search.frets[i][search.best[i]];
+	}
+
+	return search.bestAssigned;
+}
+
+static double salience(const PolyEstimator *estimator, double f0)
+{
+	/// The last bin of the spectrum
+	int lastBin = (int) (estimator->fftSize / 2) - 1;
+	/// The return value
+	double ret = 0;
+
+	for(unsigned int m = 1; m <= estimator->config.harmonics; m++) {
+		/// The bin of the harmonic
+		double center = m * f0 / estimator->binHz;
+		int first = (int) floor(center) - SALIENCE_BINS;
+		int last = (int) ceil(center) + SALIENCE_BINS;
+		/// The peak around the harmonic
+		float peak = 0;
+
+		if(last > lastBin) {
+			break;
+		}
+
+		for(int k = first; k <= last; k++) {
+			if(estimator->residual[k] > peak) {
+				peak = estimator->residual[k];
+			}
+		}
+
+		ret += (f0 + WEIGHT_ALPHA) / (m * f0 + WEIGHT_BETA) * peak;
+	}
+
+	return ret;
+}
+
+static double removeNote(PolyEstimator *estimator, double f0)
+{
+	/// The last bin of the spectrum
+	int lastBin = (int) (estimator->fftSize / 2) - 1;
+	/// The ratio of the range of the peaks
+	double range = pow(2, PARTIAL_RANGE / 12);
+	/// The residual
+	float *residual = estimator->residual;
+	/// The bins of the peaks of the partials
+	int peaks[POLY_MAX_HARMONICS];
+	/// The amplitudes of the peaks of the partials
+	float amplitudes[POLY_MAX_HARMONICS];
+	/// The number of partials below the Nyquist frequency
+	int partials = 0;
+	/// The sum of the frequencies of the refining partials, weighted
+	double refined = 0;
+	/// The sum of the weights of the refining partials
+	double weights = 0;
+
+	for(unsigned int m = 1; m <= estimator->config.harmonics; m++) {
+		double center = m * f0 / estimator->binHz;
+		int first = (int) floor(center / range);
+		int last = (int) ceil(center * range);
+		int peak = first;
+
+		if(last >= lastBin) {
+			break;
+		}
+
+		for(int k = first; k <= last; k++) {
+			if(residual[k] > residual[peak]) {
+				peak = k;
+			}
+		}
+
+		peaks[partials] = peak;
+		amplitudes[partials] = residual[peak];
+		partials++;
+
+		if(m <= REFINE_HARMONICS && peak > 0) {
+			// Parabolic interpolation of the peak
+			double left = residual[peak - 1];
+			double mid = residual[peak];
+			double right = residual[peak + 1];
+			double den = left - 2 * mid + right;
+			double bin = peak;
+
+			if(den < 0) {
+				bin += 0.5 * (left - right) / den;
+			}
+
+			refined += mid * bin * estimator->binHz / m;
+			weights += mid;
+		}
+	}
+
+	for(int i = 0; i < partials; i++) {
+		/// The mean of the partial and its neighbours
+		float smooth = (amplitudes[i] +
+				amplitudes[i > 0 ? i - 1 : i] +
+				amplitudes[i + 1 < partials ? i + 1 : i]) / 3;
+		/// The part of the partial that belongs to this note
+		float own = amplitudes[i] < smooth ? amplitudes[i] : smooth;
+		/// The gain of the bins of the partial
+		float gain = amplitudes[i] > 0 ? 1 - own / amplitudes[i] : 0;
+
+		for(int k = peaks[i] - PARTIAL_BINS; k <= peaks[i] + PARTIAL_BINS;
+				k++) {
+			if(k >= 0 && k <= lastBin) {
+				residual[k] *= gain;
+			}
+		}
+	}
+
+	return weights > 0 ? refined / weights : f0;
+}
+
+static void assignNote(AssignSearch *search, unsigned int index,
+		unsigned int used, unsigned int assigned, int minFret, int maxFret,
+		int sum)
+{
+	/// The span of the fretted notes so far
+	int span = maxFret >= minFret ? maxFret - minFret : 0;
+
+	// The remaining notes cannot make this assignment better than the best
+	if(assigned + search->count - index < search->bestAssigned ||
+			(assigned + search->count - index == search->bestAssigned &&
+			span > search->bestSpan)) {
+		return;
+	}
+
+	if(index == search->count) {
+		if(assigned > search->bestAssigned || span < search->bestSpan ||
+				(span == search->bestSpan && sum < search->bestSum)) {
+			search->bestAssigned = assigned;
+			search->bestSpan = span;
+			search->bestSum = sum;
+			for(unsigned int i = 0; i < search->count; i++) {
+				search->best[i] = search->current[i];
+			}
+		}
+		return;
+	}
+
+	if(search->frets[index]) {
+		for(unsigned int s = 0; s < search->strings; s++) {
+			/// The fret of the note on this string
+			int fret = search->frets[index][s];
+
+			if(fret < 0 || (used & (1u << s))) {
+				continue;
+			}
+
+			search->current[index] = (int) s;
+
+			// The open strings don't need a finger, so they have no span
+			if(fret) {
+				assignNote(search, index + 1, used | (1u << s), assigned + 1,
+						fret < minFret ? fret : minFret,
+						fret > maxFret ? fret : maxFret, sum + fret);
+			} else {
+				assignNote(search, index + 1, used | (1u << s), assigned + 1,
+						minFret, maxFret, sum);
+			}
+		}
+	}
+
+	// Leave the note out, in case the others cannot be played with it
+	search->current[index] = -1;
+	assignNote(search, index + 1, used, assigned, minFret, maxFret, sum);
+}
@@ -0,0 +1,236 @@
+/**
+ * @file preprocess.c
+ * @brief Prepare the input signal for the detection.
+ */
+
+#include "preprocess.h"
+
+// dspGainMeasure, dspCascadeProcess, dspCascadeReset
+#include "dsp.h"
+
+// sqrtf, expf, isfinite
+#include <math.h>
+// memset
+#include <string.h>
+
+// FLT_MAX
+#include <float.h>
+
+// assert
+#include <assert.h>
+
+/**
+ * @brief The floor assumed before the minimum statistics have a full window.
+ *
+ * It is low, so that a note at the beginning of the stream opens the gate,
+ * and the floor rises to the actual noise after a window.
+ */
+static const float INITIAL_FLOOR = 0.003f;
+
+/**
+ * @brief The lowest floor.
+ *
+ * Digital silence would have a null floor, and any dither would open the gate.
+ */
+static const float MINIMUM_FLOOR = 0.0001f;
+
+/**
+ * @brief The time constant of the level when it is rising, in seconds.
+ *
+ * A faster attack would change the gain along the attack of a note, and the
+ * modulation confuses the period estimator.
+ */
+static const double LEVEL_ATTACK = 0.5;
+
+/**
+ * @brief The time constant of the level when it is falling, in seconds.
+ *
+ * The release is slower than the attack, so that the decay of a note isn't
+ * amplified back, or the detection would not see the quick raise of the next
+ * note.
+ */
+static const double LEVEL_RELEASE = 2;
+
+/**
+ * @brief The minimum gain of the automatic gain control.
+ */
+static const float MINIMUM_GAIN = 0.25f;
+
+/**
+ * @brief The maximum gain of the automatic gain control.
+ *
+ * It limits the amplification of the noise when the level estimate is wrong.
+ */
+static const float MAXIMUM_GAIN = 16.0f;
+
+/**
+ * @brief Add the RMS of a block to the minimum statistics.
+ *
+ * @param pre The preprocessor
+ * @param rms The RMS of the block
+ * @param n The number of samples of the block
+ */
+static void updateFloor(Preprocessor *pre, float rms, size_t n);
+
+void preprocessInit(Preprocessor *pre, unsigned int rate, float gateRatio,
+		int agc)
+{
+	assert(pre);
+	assert(rate > 0);
+	assert(gateRatio >= 1);
+
+	pre->floor = INITIAL_FLOOR;
+	pre->gateRatio = gateRatio;
+	pre->open = 0;
+	pre->rms = 0;
+	pre->peak = 0;
+	pre->envelope = 0;
+	pre->rate = rate;
+
+	for(int i = 0; i < PREPROCESS_SUBWINDOWS; i++) {
+		pre->minima[i] = INITIAL_FLOOR;
+	}
+	pre->subwindow = 0;
+	pre->minimum = FLT_MAX;
+	pre->subwindowSamples = 0;
+	pre->subwindowLength = (size_t) (PREPROCESS_SUBWINDOW_DURATION * rate);
+
+	pre->agc = agc;
+	pre->level = PREPROCESS_TARGET_LEVEL;
+	pre->gain = 1;
+	pre->targetGain = 1;
+
+	pre->filtering = 0;
+	pre->invalid = 0;
+	dspCascadeInit(&pre->filters);
+}
+
+int preprocessSetFilters(Preprocessor *pre, unsigned int rate,
+		double dcBlocker, double highPass, float preEmphasis)
+{
+	assert(pre);
+
+	/// The next stage of the cascade
+	unsigned int stage = 0;
+	/// The coefficients of the stage
+	DspBiquad biquad;
+
+	if(dcBlocker < 0 || dcBlocker >= rate / 2.0 || highPass < 0 ||
+			highPass >= rate / 2.0 || preEmphasis < 0 || preEmphasis >= 1) {
+		return -1;
+	}
+
+	dspCascadeInit(&pre->filters);
+
+	if(dcBlocker > 0) {
+		dspBiquadDcBlocker(&biquad, dcBlocker, rate);
+		dspCascadeSet(&pre->filters, stage++, &biquad);
+	}
+
+	if(highPass > 0) {
+		dspBiquadHighPass(&biquad, highPass, rate);
+		dspCascadeSet(&pre->filters, stage++, &biquad);
+	}
+
+	if(preEmphasis > 0) {
+		dspBiquadPreEmphasis(&biquad, preEmphasis);
+		dspCascadeSet(&pre->filters, stage++, &biquad);
+	}
+
+	pre->filtering = stage > 0;
+
+	return 0;
+}
+
+int preprocessBlock(Preprocessor *pre, float *x, size_t n)
+{
+	assert(pre);
+
+	pre->invalid = 0;
+	if(!n) {
+		return pre->open;
+	}
+
+	if(pre->filtering) {
+		dspCascadeProcess(&pre->filters, x, n);
+	}
+
+	// The gain reaches its target at the end of the block
+	float step = (pre->targetGain - pre->gain) / n;
+	float sum = dspGainMeasure(x, n, pre->gain + step, step, &pre->peak);
+	pre->gain = pre->targetGain;
+
+	/* A single invalid sample would stay in the feedback of the filters and
+	in the level, and make all the following blocks NaN. */
+	pre->invalid = !isfinite(sum) || !isfinite(pre->peak);
+	if(pre->invalid) {
+		dspCascadeReset(&pre->filters);
+		memset(x, 0, n * sizeof(float));
+		pre->level = PREPROCESS_TARGET_LEVEL;
+		pre->gain = 1;
+		pre->targetGain = 1;
+		pre->rms = 0;
+		pre->peak = 0;
+		pre->open = 0;
+		return 0;
+	}
+
+	float rawPeak = pre->peak / pre->gain;
+	pre->envelope *= expf(-(float) n /
+			(float) (PREPROCESS_ENVELOPE_RELEASE * pre->rate));
+	if(rawPeak > pre->envelope) {
+		pre->envelope = rawPeak;
+	}
+
+	pre->rms = sqrtf(sum / n);
+	updateFloor(pre, pre->rms, n);
+	pre->open = pre->rms > pre->floor * pre->gateRatio;
+
+	// The noise must not change the gain, or it would be amplified in pauses
+	if(pre->agc && pre->open) {
+		double time = pre->rms > pre->level ? LEVEL_ATTACK : LEVEL_RELEASE;
+		// The weight depends on the duration of the block
+		float weight = 1 - expf(-(float) (n / (time * pre->rate)));
+		pre->level += weight * (pre->rms - pre->level);
+
+		pre->targetGain = PREPROCESS_TARGET_LEVEL / pre->level;
+		if(pre->targetGain < MINIMUM_GAIN) {
+			pre->targetGain = MINIMUM_GAIN;
+		} else if(pre->targetGain > MAXIMUM_GAIN) {
+			pre->targetGain = MAXIMUM_GAIN;
+		}
+	}
+
+	return pre->open;
+}
+
+float preprocessGate(const Preprocessor *pre)
+{
+	assert(pre);
+	return pre->floor * pre->gateRatio * pre->gain;
+}
+
+void updateFloor(Preprocessor *pre, float rms, size_t n)
+{
+	if(rms < pre->minimum) {
+		pre->minimum = rms;
+	}
+
+	pre->subwindowSamples += n;
+	if(pre->subwindowSamples >= pre->subwindowLength) {
+		pre->minima[pre->subwindow] = pre->minimum;
+		pre->subwindow = (pre->subwindow + 1) % PREPROCESS_SUBWINDOWS;
+		pre->minimum = FLT_MAX;
+		pre->subwindowSamples = 0;
+	}
+
+	// The minimum of the current sub-window lets the floor fall immediately
+	float floor = pre->minimum;
+	for(int i = 0; i < PREPROCESS_SUBWINDOWS; i++) {
+		if(pre->minima[i] < floor) {
+			floor = pre->minima[i];
+		}
+	}
+
+	pre->floor = floor > MINIMUM_FLOOR ? floor : MINIMUM_FLOOR;
+}
@@ -0,0 +1,279 @@
+/**
+ * @file profile.c
+ * @brief Save and load the capture and analysis settings of a machine.
+ *
+ * The values are integers, e.g. the latency is in microseconds, because the
+ * GUI sets the locale, which changes the decimal separator of the floats.
+ */
+
+#include "profile.h"
+
+// fopen, fgets, feof, fprintf, fclose, rename, remove, snprintf
+#include <stdio.h>
+// strtoul
+#include <stdlib.h>
+// strcmp, strchr, strspn, strcspn
+#include <string.h>
+// assert
+#include <assert.h>
+
+/**
+ * @brief The maximum length of a line of a profile.
+ */
+#define PROFILE_LINE_SIZE 256
+
+/**
+ * @brief The keys of the settings, which are also their order in the file.
+ */
+typedef enum {
+	/**
+	 * @brief Profile.rate, in Hz.
+	 */
+	PROFILE_KEY_RATE = 0,
+
+	/**
+	 * @brief Profile.latency, in microseconds.
+	 */
+	PROFILE_KEY_LATENCY,
+
+	/**
+	 * @brief Profile.hop, in samples.
+	 */
+	PROFILE_KEY_HOP,
+
+	/**
+	 * @brief Profile.ring, in milliseconds.
+	 */
+	PROFILE_KEY_RING,
+
+	/**
+	 * @brief Profile.floatSums, 0 or 1.
+	 */
+	PROFILE_KEY_FLOAT_SUMS,
+
+	/**
+	 * @brief The number of keys.
+	 */
+	PROFILE_KEYS
+} ProfileKey;
+
+/**
+ * @brief The names of the keys in the file.
+ */
+static const char *KEY_NAMES[PROFILE_KEYS] = {
+	"rate", "latency-us", "hop", "ring-ms", "float-sums"
+};
+
+/**
+ * @brief Get the value of a setting, in the unit of the file.
+ *
+ * @param profile The profile
+ * @param key The key of the setting
+ * @return The value
+ */
+static unsigned long getValue(const Profile *profile, ProfileKey key);
+
+/**
+ * @brief Set a setting from a value in the unit of the file.
+ *
+ * @param profile The profile
+ * @param key The key of the setting
+ * @param value The value
+ * @return 0 on success, -1 if the value is not valid for the setting
+ */
+static int setValue(Profile *profile, ProfileKey key, unsigned long value);
+
+/**
+ * @brief Parse a line of a profile.
+ *
+ * @param profile The profile to change
+ * @param line The line, with its terminator
+ * @return 0 on success, also for empty lines, comments and unknown keys, -1
+ *  if the line is not valid
+ */
+static int parseLine(Profile *profile, char *line);
+
+void profileInit(Profile *profile)
+{
+	assert(profile);
+
+	profile->rate = 0;
+	profile->latency = 0;
+	profile->hop = 0;
+	profile->ring = 0;
+	profile->floatSums = 0;
+}
+
+int profileLoad(Profile *profile, const char *path)
+{
+	assert(profile);
+	assert(path);
+
+	/// The file of the profile
+	FILE *fp = fopen(path, "r");
+	/// The settings being loaded, which replace the profile only if valid
+	Profile loaded = *profile;
+	/// The line being parsed
+	char line[PROFILE_LINE_SIZE];
+	/// The return value
+	int err = 0;
+
+	if(!fp) {
+		return -1;
+	}
+
+	while(!err && fgets(line, sizeof(line), fp)) {
+		// The lines are short, a longer one is not a profile
+		if(!strchr(line, '\n') && !feof(fp)) {
+			err = -2;
+		} else if(parseLine(&loaded, line)) {
+			err = -2;
+		}
+	}
+
+	fclose(fp);
+
+	if(!err) {
+		*profile = loaded;
+	}
+
+	return err;
+}
+
+int profileSave(const Profile *profile, const char *path)
+{
+	assert(profile);
+	assert(path);
+
+	/// The path of the temporary file
+	char tmp[PROFILE_PATH_SIZE];
+	/// The temporary file
+	FILE *fp;
+	/// The result of the writes
+	int err = 0;
+
+	if(snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int) sizeof(tmp)) {
+		return -1;
+	}
+
+	fp = fopen(tmp, "w");
+	if(!fp) {
+		return -1;
+	}
+
+	if(fprintf(fp, "# GuitarBiro calibration profile\n") < 0) {
+		err = -1;
+	}
+	for(int key = 0; !err && key < PROFILE_KEYS; key++) {
+		if(fprintf(fp, "%s %lu\n", KEY_NAMES[key],
+				getValue(profile, (ProfileKey) key)) < 0) {
+			err = -1;
+		}
+	}
+
+	if(fclose(fp)) {
+		err = -1;
+	}
+
+	if(err || rename(tmp, path)) {
+		remove(tmp);
+		return -1;
+	}
+
+	return 0;
+}
+
+unsigned long getValue(const Profile *profile, ProfileKey key)
+{
+	switch(key) {
+		case PROFILE_KEY_RATE:
+			return profile->rate;
+
+		case PROFILE_KEY_LATENCY:
+			return (unsigned long) (profile->latency * 1e6 + 0.5);
+
+		case PROFILE_KEY_HOP:
+			return profile->hop;
+
+		case PROFILE_KEY_RING:
+			return (unsigned long) (profile->ring * 1e3 + 0.5);
+
+		case PROFILE_KEY_FLOAT_SUMS:
+			return profile->floatSums != 0;
+
+		default:
+			return 0;
+	}
+}
+
+int setValue(Profile *profile, ProfileKey key, unsigned long value)
+{
+	switch(key) {
+		case PROFILE_KEY_RATE:
+			profile->rate = (unsigned int) value;
+			return value == profile->rate ? 0 : -1;
+
+		case PROFILE_KEY_LATENCY:
+			profile->latency = value / 1e6;
+			return 0;
+
+		case PROFILE_KEY_HOP:
+			profile->hop = (unsigned int) value;
+			return value == profile->hop ? 0 : -1;
+
+		case PROFILE_KEY_RING:
+			profile->ring = value / 1e3;
+			return 0;
+
+		case PROFILE_KEY_FLOAT_SUMS:
+			profile->floatSums = value != 0;
+			return value > 1 ? -1 : 0;
+
+		default:
+			return -1;
+	}
+}
+
+int parseLine(Profile *profile, char *line)
+{
+	/// The separators of the tokens
+	const char *spaces = " \t\r\n";
+	/// The key of the line
+	char *key = line + strspn(line, spaces);
+	/// The end of the key
+	char *keyEnd = key + strcspn(key, spaces);
+	/// The value of the line
+	char *value = keyEnd + strspn(keyEnd, spaces);
+	/// The end of the value
+	char *end;
+	/// The number in the value
+	unsigned long number;
+
+	/// The index of the key
+	int i = 0;
+
+	if(!*key || *key == '#') {
+		return 0;
+	}
+	*keyEnd = 0;
+
+	while(i < PROFILE_KEYS && strcmp(key, KEY_NAMES[i])) {
+		i++;
+	}
+
+	// The keys of newer versions are ignored
+	if(i == PROFILE_KEYS) {
+		return 0;
+	}
+
+	// strtoul would accept the negative numbers
+	if(*value < '0' || *value > '9') {
+		return -1;
+	}
+	number = strtoul(value, &end, 10);
+	if(end[strspn(end, spaces)]) {
+		return -1;
+	}
+
+	return setValue(profile, (ProfileKey) i, number);
+}
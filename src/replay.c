@@ -0,0 +1,162 @@
+/**
+ * @file replay.c
+ * @brief Replays a dump of the flight recorder through the detection.
+ *
+ * The program prints the records of the dump, i.e. what the detection did
+ * while it was running, and then feeds the samples of the dump to a new
+ * detection and prints its events in the format of the captures, so that the
+ * two can be compared.
+ * The replay uses the options of the detection saved in the dump, with the
+ * governor disabled, so that it always runs the same tier and its output
+ * depends only on the samples: the same dump always gives the same events.
+ * @note The detection of the replay starts from a clean state, whereas the
+ *  one of the dump had already seen the samples before it, so the first
+ *  windows can differ.
+ */
+
+// DetectContext, detectConfigFromFlight, detectInitWithConfig, detectAnalyze
+#include "detect.h"
+
+// FlightDump, flightLoad, flightDumpFree, flightTriggerName
+#include "flight.h"
+
+// captureLogEvent
+#include "capture.h"
+
+// SampleRing, sampleRingCreate, sampleRingWrite, sampleRingFree
+#include "sample_ring.h"
+
+// printf, fprintf
+#include <stdio.h>
+
+/**
+ * @brief The number of samples that are given to the detection each time.
+ *
+ * It is fixed, so that the replay is deterministic.
+ */
+static const size_t REPLAY_BLOCK = 512;
+
+/**
+ * @brief Print the header and the records of a dump.
+ *
+ * @param dump The dump
+ */
+static void printRecords(const FlightDump *dump);
+
+/**
+ * @brief Run a new detection on the samples of a dump, and print its events.
+ *
+ * @param dump The dump
+ * @return 0 on success, a negative number in case of error
+ */
+static int replay(const FlightDump *dump);
+
+/**
+ * @brief The entry point of the program
+ *
+ * @param argc The number of arguments received
+ * @param argv The arguments: the path of the dump
+ * @return The status code to pass to the OS at the exit.
+ */
+int main(int argc, char *argv[])
+{
+	FlightDump *dump;
+	int err;
+
+	if(argc != 2) {
+		fprintf(stderr, "Usage: %s dump.flight\n", argv[0]);
+		return 1;
+	}
+
+	dump = flightLoad(argv[1]);
+	if(!dump) {
+		fprintf(stderr, "Could not load the dump %s.\n", argv[1]);
+		return 2;
+	}
+
+	printRecords(dump);
+	err = replay(dump);
+	flightDumpFree(dump);
+
+	if(err) {
+		fprintf(stderr, "The detection could not replay the dump.\n");
+		return 3;
+	}
+
+	return 0;
+}
+
+void printRecords(const FlightDump *dump)
+{
+	const FlightHeader *header = &dump->header;
+
+	printf("# trigger %s, rate %u, hop %u\n",
+			flightTriggerName(header->trigger), header->rate, header->hop);
+	printf("# samples %zu-%zu, %zu records\n", header->start,
+			header->start + header->samples, header->records);
+	printf("# agc %d, dc blocker %g Hz, high-pass %g Hz, reference %g Hz, "
+			"%u strings, fixed point %d, polyphony %u, chords %d\n",
+			header->options.agc, header->options.dcBlocker,
+			header->options.highPass, header->options.reference,
+			header->options.strings, header->options.fixedPoint,
+			header->options.polyphony, header->options.chords);
+
+	printf("# position tier period quality elapsed decision note\n");
+	for(size_t i = 0; i < header->records; i++) {
+		const FlightRecord *record = &dump->records[i];
+
+		printf("%zu %u %.3f %.3f %.6f %s %d\n", record->position,
+				record->tier, record->period, record->quality,
+				record->elapsed,
+				flightDecisionName((FlightDecision) record->decision),
+				record->note);
+	}
+}
+
+int replay(const FlightDump *dump)
+{
+	/// The configuration of the detection
+	DetectConfig config;
+	/// The tuning of the dump
+	Tuning tuning;
+	/// The detection
+	DetectContext *detection;
+	/// The ring that plays the audio callback
+	SampleRing *ring;
+	/// The event being printed
+	DetectEvent event;
+	/// The return value
+	int err = 0;
+
+	if(detectConfigFromFlight(&config, &tuning, &dump->header)) {
+		return -1;
+	}
+
+	detection = detectInitWithConfig(&config);
+	ring = sampleRingCreate(dump->header.rate);
+	if(!detection || !ring) {
+		sampleRingFree(ring);
+		detectFree(detection);
+		return -1;
+	}
+
+	printf("# replay\n");
+	for(size_t i = 0; i < dump->header.samples && !err; i += REPLAY_BLOCK) {
+		size_t n = dump->header.samples - i < REPLAY_BLOCK ?
+				dump->header.samples - i : REPLAY_BLOCK;
+
+		sampleRingWrite(ring, dump->samples + i, n);
+		err = detectAnalyze(detection, ring);
+
+		while(detectPollEvent(detection, &event)) {
+			// Use the positions of the stream, like the records
+			event.position += dump->header.start;
+			captureLogEvent(stdout, &event);
+		}
+	}
+
+	sampleRingFree(ring);
+	detectFree(detection);
+
+	return err;
+}
@@ -0,0 +1,401 @@
+/**
+ * @file sample_ring.c
+ * @brief A single-producer/single-consumer ring buffer of float samples.
+ *
+ * @link https://en.wikipedia.org/wiki/Circular_buffer#Optimization
+ */
+
+// memfd_create
+#define _GNU_SOURCE
+
+#include "sample_ring.h"
+
+// malloc, free
+#include <stdlib.h>
+// memcpy
+#include <string.h>
+// uintptr_t
+#include <stdint.h>
+// fprintf
+#include <stdio.h>
+// assert
+#include <assert.h>
+// atomic_size_t, atomic_load_explicit, atomic_store_explicit
+#include <stdatomic.h>
+
+#ifdef WIN32
+	// CreateFileMapping, MapViewOfFileEx, VirtualAlloc
+#	include <windows.h>
+#else
+	// mmap, munmap, shm_open, shm_unlink
+#	include <sys/mman.h>
+	// ftruncate, close, sysconf, getpid
+#	include <unistd.h>
+	// O_RDWR, O_CREAT, O_EXCL
+#	include <fcntl.h>
+#endif
+
+/**
+ * @brief The size of a cache line.
+ *
+ * The indices of the producer and of the consumer are kept in different cache
+ * lines, so that updating one doesn't invalidate the other one in the cache of
+ * the other core (false sharing).
+ */
+#define CACHE_LINE 64
+
+struct _SampleRing {
+	/**
+	 * @brief The samples.
+	 *
+	 * The memory is mapped twice, so buffer[i] and buffer[i + capacity] are
+	 * the same sample, for any i in [0, capacity).
+	 */
+	float *buffer;
+
+	/**
+	 * @brief The number of samples of the ring.
+	 *
+	 * It is a power of two, so that indices can be wrapped with a mask.
+	 */
+	size_t capacity;
+
+	/**
+	 * @brief The mask to get the position of an index in the buffer.
+	 */
+	size_t mask;
+
+	/**
+	 * @brief The address returned by malloc for this struct.
+	 *
+	 * The struct is aligned manually to a cache line, which malloc doesn't
+	 * guarantee.
+	 */
+	void *raw;
+
+	char padding0[CACHE_LINE];
+
+	/**
+	 * @brief The number of samples written since the creation of the ring.
+	 *
+	 * It is written only by the producer.
+	 * Indices are never wrapped, so the difference between the write and the
+	 * read index is always the fill count, even after an overflow of size_t.
+	 */
+	atomic_size_t writeIndex;
+
+	char padding1[CACHE_LINE];
+
+	/**
+	 * @brief The number of samples consumed since the creation of the ring.
+	 *
+	 * It is written only by the consumer.
+	 */
+	atomic_size_t readIndex;
+
+	char padding2[CACHE_LINE];
+};
+
+/**
+ * @brief Map a memory area twice, in two contiguous ranges of addresses.
+ *
+ * @param size The size of the area, in bytes. It must be a multiple of the
+ *  size of pages (of the allocation granularity on Windows)
+ * @return The address of the first mapping, or 0 in case of error
+ */
+static void *mapTwice(size_t size);
+
+/**
+ * @brief Release the memory obtained with mapTwice.
+ *
+ * @param address The address of the first mapping
+ * @param size The size passed to mapTwice
+ */
+static void unmapTwice(void *address, size_t size);
+
+/**
+ * @brief Get the granularity of the memory mappings.
+ *
+ * @return The size in bytes
+ */
+static size_t mappingGranularity();
+
+SampleRing *sampleRingCreate(size_t capacity)
+{
+	/// The instance that will be returned
+	SampleRing *ring;
+	/// The address returned by malloc
+	void *raw;
+	/// The minimum capacity, imposed by the memory pages
+	size_t minCapacity = mappingGranularity() / sizeof(float);
+
+	if(capacity < minCapacity) {
+		capacity = minCapacity;
+	}
+
+	// The page size is a power of two, so this is a multiple of it, too
+	size_t pow2 = 1;
+	while(pow2 < capacity) {
+		pow2 <<= 1;
+	}
+	capacity = pow2;
+
+	raw = malloc(sizeof(SampleRing) + CACHE_LINE);
+	if(!raw) {
+		return 0;
+	}
+
+	ring = (SampleRing *) (((uintptr_t) raw + CACHE_LINE - 1) &
+			~(uintptr_t) (CACHE_LINE - 1));
+	ring->raw = raw;
+
+	ring->buffer = (float *) mapTwice(capacity * sizeof(float));
+	if(!ring->buffer) {
+		fprintf(stderr, "Could not map the memory of the ring buffer.\n");
+		free(raw);
+		return 0;
+	}
+
+	ring->capacity = capacity;
+	ring->mask = capacity - 1;
+
+	atomic_init(&ring->writeIndex, 0);
+	atomic_init(&ring->readIndex, 0);
+
+	return ring;
+}
+
+void sampleRingFree(SampleRing *ring)
+{
+	if(!ring) {
+		return;
+	}
+
+	unmapTwice(ring->buffer, ring->capacity * sizeof(float));
+	free(ring->raw);
+}
+
+size_t sampleRingCapacity(const SampleRing *ring)
+{
+	assert(ring);
+	return ring->capacity;
+}
+
+size_t sampleRingFreeCount(SampleRing *ring)
+{
+	assert(ring);
+
+	size_t write = atomic_load_explicit(&ring->writeIndex,
+			memory_order_relaxed);
+	// Acquire: the consumer must have finished with the freed samples
+	size_t read = atomic_load_explicit(&ring->readIndex, memory_order_acquire);
+
+	return ring->capacity - (write - read);
+}
+
+float *sampleRingWritePtr(SampleRing *ring)
+{
+	assert(ring);
+
+	size_t write = atomic_load_explicit(&ring->writeIndex,
+			memory_order_relaxed);
+	return ring->buffer + (write & ring->mask);
+}
+
+void sampleRingAdvanceWrite(SampleRing *ring, size_t count)
+{
+	assert(ring);
+
+	size_t write = atomic_load_explicit(&ring->writeIndex,
+			memory_order_relaxed);
+
+	// The free space can only have grown since the producer checked it
+	assert(count <= ring->capacity - (write - atomic_load_explicit(
+			&ring->readIndex, memory_order_relaxed)));
+
+	// Release: the samples must be visible before the index
+	atomic_store_explicit(&ring->writeIndex, write + count,
+			memory_order_release);
+}
+
+size_t sampleRingWrite(SampleRing *ring, const float *samples, size_t count)
+{
+	size_t freeCount = sampleRingFreeCount(ring);
+	if(count > freeCount) {
+		count = freeCount;
+	}
+
+	memcpy(sampleRingWritePtr(ring), samples, count * sizeof(float));
+	sampleRingAdvanceWrite(ring, count);
+
+	return count;
+}
+
+size_t sampleRingFillCount(SampleRing *ring)
+{
+	assert(ring);
+
+	size_t read = atomic_load_explicit(&ring->readIndex, memory_order_relaxed);
+	// Acquire: the samples must be visible with the index
+	size_t write = atomic_load_explicit(&ring->writeIndex,
+			memory_order_acquire);
+
+	return write - read;
+}
+
+float *sampleRingPeek(SampleRing *ring, size_t *count)
+{
+	assert(ring);
+
+	size_t read = atomic_load_explicit(&ring->readIndex, memory_order_relaxed);
+	// Acquire: the samples must be visible with the index
+	size_t write = atomic_load_explicit(&ring->writeIndex,
+			memory_order_acquire);
+
+	if(count) {
+		*count = write - read;
+	}
+
+	return ring->buffer + (read & ring->mask);
+}
+
+void sampleRingConsume(SampleRing *ring, size_t count)
+{
+	assert(ring);
+
+	size_t read = atomic_load_explicit(&ring->readIndex, memory_order_relaxed);
+
+	// The available samples can only have grown since the consumer peeked
+	assert(count <= atomic_load_explicit(&ring->writeIndex,
+			memory_order_relaxed) - read);
+
+	/* Release: the consumer must have finished reading (and writing) the
+	samples before the producer can overwrite them. */
+	atomic_store_explicit(&ring->readIndex, read + count, memory_order_release);
+}
+
+#ifdef WIN32
+
+static void *mapTwice(size_t size)
+{
+	HANDLE mapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL,
+			PAGE_READWRITE, (DWORD) ((unsigned long long) size >> 32),
+			(DWORD) (size & 0xFFFFFFFF), NULL);
+	if(!mapping) {
+		return 0;
+	}
+
+	/* Windows cannot map a view over a reserved range, so find a free range,
+	release it and map both the views there.
+	Another thread could take the range in the meantime, so retry a few
+	times. */
+	for(int attempt = 0; attempt < 10; attempt++) {
+		char *address = VirtualAlloc(NULL, 2 * size, MEM_RESERVE,
+				PAGE_NOACCESS);
+		if(!address) {
+			break;
+		}
+		VirtualFree(address, 0, MEM_RELEASE);
+
+		char *first = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size,
+				address);
+		char *second = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size,
+				address + size);
+
+		if(first == address && second == address + size) {
+			// The views keep a reference to the mapping
+			CloseHandle(mapping);
+			return address;
+		}
+
+		if(first) {
+			UnmapViewOfFile(first);
+		}
+		if(second) {
+			UnmapViewOfFile(second);
+		}
+	}
+
+	CloseHandle(mapping);
+	return 0;
+}
+
+static void unmapTwice(void *address, size_t size)
+{
+	UnmapViewOfFile((char *) address + size);
+	UnmapViewOfFile(address);
+}
+
+static size_t mappingGranularity()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+}
+
+#else
+
+static void *mapTwice(size_t size)
+{
+	/// The file descriptor of the shared memory
+	int fd;
+	/// The address of the first mapping
+	char *address;
+
+#if defined(__linux__)
+	fd = memfd_create("guitarbiro-ring", MFD_CLOEXEC);
+#else
+	/* Other POSIX systems don't have memfd_create, so use a named shared
+	memory object and remove the name immediately. */
+	char name[64];
+	snprintf(name, sizeof(name), "/guitarbiro-ring-%ld-%p", (long) getpid(),
+			(void *) &fd);
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if(fd != -1) {
+		shm_unlink(name);
+	}
+#endif
+
+	if(fd == -1) {
+		return 0;
+	}
+
+	if(ftruncate(fd, size)) {
+		close(fd);
+		return 0;
+	}
+
+	// Reserve the range for both the mappings, then replace its halves
+	address = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+			0);
+	if(address == MAP_FAILED) {
+		close(fd);
+		return 0;
+	}
+
+	if(mmap(address, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+			0) == MAP_FAILED || mmap(address + size, size,
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) ==
+			MAP_FAILED) {
+		munmap(address, 2 * size);
+		close(fd);
+		return 0;
+	}
+
+	// The mappings keep the memory alive
+	close(fd);
+
+	return address;
+}
+
+static void unmapTwice(void *address, size_t size)
+{
+	munmap(address, 2 * size);
+}
+
+static size_t mappingGranularity()
+{
+	return (size_t) sysconf(_SC_PAGESIZE);
+}
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * @file thread_utils.c
+ * @brief Portable helpers for the threads of the program.
+ */
+
+// SCHED_IDLE
+#define _GNU_SOURCE
+
+#include "thread_utils.h"
+
+#ifdef WIN32
+	// Sleep
+#	include <windows.h>
+#else
+	// nanosleep
+#	include <time.h>
+	// pthread_self, pthread_setschedparam
+#	include <pthread.h>
+	// sched_param, SCHED_IDLE
+#	include <sched.h>
+#endif
+
+/**
+ * @author Bernardo Ramos (http://stackoverflow.com/users/4626775/bernardo-ramos)
+ * @link http://stackoverflow.com/a/28827188
+ * @copyright Creative Commons Attribution-ShareAlike 3.0 Unported
+ *
+ * This function has been taken from Stack Overflow.
+ */
+void threadSleepMs(unsigned int ms)
+{
+#ifdef WIN32
+	Sleep(ms);
+#else
+	struct timespec ts;
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	nanosleep(&ts, NULL);
+#endif
+}
+
+int threadSetIdlePriority(void)
+{
+#ifdef __linux__
+	struct sched_param param;
+	param.sched_priority = 0;
+
+	return pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) ? -1 : 0;
+#else
+	return -1;
+#endif
+}
@@ -0,0 +1,36 @@
+/**
+ * @file timing.c
+ * @brief A portable monotonic clock to measure the pipeline.
+ */
+
+// clock_gettime
+#define _POSIX_C_SOURCE 199309L
+
+#include "timing.h"
+
+#ifdef WIN32
+	// QueryPerformanceCounter, QueryPerformanceFrequency
+#	include <windows.h>
+#else
+	// clock_gettime
+#	include <time.h>
+#endif
+
+double timeNow()
+{
+#ifdef WIN32
+	LARGE_INTEGER counter;
+	LARGE_INTEGER frequency;
+
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+
+	return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
@@ -0,0 +1,277 @@
+/**
+ * @file check_capture.c
+ * @brief Performs unit testing on the capture of the sessions.
+ */
+
+/// The library to test
+#include "capture.h"
+
+/// The check unit framework
+#include <check.h>
+
+/// EXIT_SUCCESS, EXIT_FAILURE, malloc, free
+#include <stdlib.h>
+
+/// fopen, fread, remove
+#include <stdio.h>
+
+/// memcmp, strstr
+#include <string.h>
+
+/// uint32_t
+#include <stdint.h>
+
+/// noteToSemitones
+#include "guitar.h"
+
+/**
+ * @brief The sample rate of the tests.
+ */
+static const unsigned int RATE = 44100;
+
+/**
+ * @brief The number of samples of each block.
+ */
+#define BLOCK_SIZE 512
+
+/**
+ * @brief The path of the files of the tests, without the extension.
+ */
+static const char *PATH = "check_capture_session";
+
+/**
+ * @brief Read a whole file.
+ *
+ * @param extension The extension of the file of the tests
+ * @param size Output parameter for the size of the file
+ * @return The content, with a terminator. The caller will have to free it
+ */
+static unsigned char *readFile(const char *extension, size_t *size);
+
+/**
+ * @brief Read a 32 bits little endian integer.
+ *
+ * @param src The first byte
+ * @return The value
+ */
+static uint32_t loadLe32(const unsigned char *src);
+
+/**
+ * @brief Get a sample of the WAV file.
+ *
+ * @param wav The content of the file
+ * @param i The index of the sample
+ * @return The sample
+ */
+static float wavSample(const unsigned char *wav, size_t i);
+
+/**
+ * @brief Get the value of a sample of the blocks that the tests write.
+ *
+ * @param position The position of the sample in the stream
+ * @return The sample, which is never 0
+ */
+static float rampSample(size_t position);
+
+/**
+ * @brief Test that the samples and the events are written to the files.
+ */
+START_TEST(testCaptureFiles)
+{
+	const unsigned int blocks = 20;
+	CaptureConfig config;
+	CaptureStats stats;
+	Capture *capture;
+	float block[BLOCK_SIZE];
+	DetectEvent event;
+	unsigned char *wav;
+	char *log;
+	size_t size;
+
+	captureConfigInit(&config, RATE);
+	config.writerSleep = 1;
+	capture = captureStart(&config, PATH);
+	ck_assert(capture != NULL);
+
+	for(unsigned int b = 0; b < blocks; b++) {
+		for(size_t i = 0; i < BLOCK_SIZE; i++) {
+			block[i] = rampSample(b * BLOCK_SIZE + i);
+		}
+		// The ring has room for two seconds, so no block is dropped
+		ck_assert_int_eq(captureWrite(capture, block, BLOCK_SIZE), 1);
+	}
+
+	event.type = DETECT_EVENT_NOTE;
+	event.position = 1024;
+	event.note = noteToSemitones("A", 2);
+	event.frequency = 110;
+	ck_assert_int_eq(captureEvent(capture, &event), 1);
+	event.type = DETECT_EVENT_SILENCE;
+	event.position = 4096;
+	ck_assert_int_eq(captureEvent(capture, &event), 1);
+
+	captureStop(capture, &stats);
+	ck_assert_uint_eq(stats.blocks, blocks);
+	ck_assert_uint_eq(stats.droppedBlocks, 0);
+	ck_assert_uint_eq(stats.events, 2);
+	ck_assert_uint_eq(stats.writtenSamples, blocks * BLOCK_SIZE);
+	ck_assert_uint_eq(stats.writeErrors, 0);
+
+	wav = readFile(".wav", &size);
+	ck_assert_uint_eq(size, 44 + blocks * BLOCK_SIZE * sizeof(float));
+	ck_assert(!memcmp(wav, "RIFF", 4));
+	ck_assert_uint_eq(loadLe32(wav + 4), size - 8);
+	ck_assert(!memcmp(wav + 8, "WAVEfmt ", 8));
+	// IEEE float, mono
+	ck_assert_uint_eq(loadLe32(wav + 20), 3 | 1 << 16);
+	ck_assert_uint_eq(loadLe32(wav + 24), RATE);
+	ck_assert_uint_eq(loadLe32(wav + 40), size - 44);
+	for(size_t i = 0; i < blocks * BLOCK_SIZE; i++) {
+		ck_assert(wavSample(wav, i) == rampSample(i));
+	}
+	free(wav);
+
+	log = (char *) readFile(".log", &size);
+	ck_assert_msg(strstr(log, "\n1024 note 24 110.00\n4096 silence\n"),
+			"Unexpected log:\n%s", log);
+	free(log);
+
+	remove("check_capture_session.wav");
+	remove("check_capture_session.log");
+}
+END_TEST
+
+/**
+ * @brief Test that the blocks are dropped when the writer is behind, and that
+ *  they are replaced by silence.
+ */
+START_TEST(testCaptureDrops)
+{
+	const unsigned int blocks = 20;
+	CaptureConfig config;
+	CaptureStats stats;
+	Capture *capture;
+	float block[BLOCK_SIZE];
+	unsigned char *wav;
+	char *log;
+	size_t size;
+	unsigned long dropped = 0;
+
+	captureConfigInit(&config, RATE);
+	// The smallest ring, and a writer that sleeps through the whole test
+	config.capacity = 1;
+	config.writerSleep = 500;
+	capture = captureStart(&config, PATH);
+	ck_assert(capture != NULL);
+
+	for(unsigned int b = 0; b < blocks; b++) {
+		for(size_t i = 0; i < BLOCK_SIZE; i++) {
+			block[i] = rampSample(b * BLOCK_SIZE + i);
+		}
+		dropped += !captureWrite(capture, block, BLOCK_SIZE);
+	}
+
+	captureStop(capture, &stats);
+	ck_assert_uint_gt(dropped, 0);
+	ck_assert_uint_eq(stats.droppedBlocks, dropped);
+	ck_assert_uint_eq(stats.droppedSamples, dropped * BLOCK_SIZE);
+	ck_assert_uint_eq(stats.blocks + stats.droppedBlocks, blocks);
+	// The silence keeps the file aligned with the stream
+	ck_assert_uint_eq(stats.writtenSamples, blocks * BLOCK_SIZE);
+
+	wav = readFile(".wav", &size);
+	ck_assert_uint_eq(size, 44 + blocks * BLOCK_SIZE * sizeof(float));
+	for(size_t i = 0; i < blocks * BLOCK_SIZE; i++) {
+		float sample = wavSample(wav, i);
+		ck_assert(sample == rampSample(i) || sample == 0);
+		// Blocks are either written or dropped as a whole
+		ck_assert((sample == 0) == (wavSample(wav, i / BLOCK_SIZE *
+				BLOCK_SIZE) == 0));
+	}
+	free(wav);
+
+	log = (char *) readFile(".log", &size);
+	ck_assert_msg(strstr(log, " dropped "), "Unexpected log:\n%s", log);
+	free(log);
+
+	remove("check_capture_session.wav");
+	remove("check_capture_session.log");
+}
+END_TEST
+
+/**
+ * @brief Create the suite to check the capture
+ * @return The test suite
+ */
+Suite *captureSuite()
+{
+	Suite *s;
+	TCase *tcCore;
+
+	s = suite_create("Capture");
+
+	tcCore = tcase_create("Core");
+	tcase_add_test(tcCore, testCaptureFiles);
+	tcase_add_test(tcCore, testCaptureDrops);
+	suite_add_tcase(s, tcCore);
+
+	return s;
+}
+
+int main()
+{
+	int numberFailed;
+	Suite *s;
+	SRunner *sr;
+
+	s = captureSuite();
+	sr = srunner_create(s);
+
+	srunner_run_all(sr, CK_NORMAL);
+	numberFailed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (numberFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static unsigned char *readFile(const char *extension, size_t *size)
+{
+	char name[64];
+	FILE *fp;
+	unsigned char *buf;
+
+	snprintf(name, sizeof(name), "%s%s", PATH, extension);
+	fp = fopen(name, "rb");
+	ck_assert_msg(fp, "Could not open %s.", name);
+
+	fseek(fp, 0L, SEEK_END);
+	*size = ftell(fp);
+	rewind(fp);
+
+	buf = malloc(*size + 1);
+	ck_assert_uint_eq(fread(buf, 1, *size, fp), *size);
+	buf[*size] = 0;
+	fclose(fp);
+
+	return buf;
+}
+
+static uint32_t loadLe32(const unsigned char *src)
+{
+	return src[0] | src[1] << 8 | src[2] << 16 | (uint32_t) src[3] << 24;
+}
+
+static float wavSample(const unsigned char *wav, size_t i)
+{
+	uint32_t bits = loadLe32(wav + 44 + i * sizeof(float));
+	float sample;
+
+	memcpy(&sample, &bits, sizeof(sample));
+
+	return sample;
+}
+
+static float rampSample(size_t position)
+{
+	return (float) (position % 1000 + 1) / 1000;
+}
@@ -0,0 +1,1099 @@
+/**
+ * @file check_detect.c
+ * @brief Performs unit testing on the detection loop, on the preprocessor
+ *  and on the governor
+ */
+
+/// The check unit framework
+#include <check.h>
+
+/// The library to test
+#include "detect.h"
+
+/// Governor, governorInit, governorUpdate
+#include "governor.h"
+
+/// Preprocessor, preprocessInit, preprocessBlock
+#include "preprocess.h"
+
+/// DspCascade, dspCascadeProcess
+#include "dsp.h"
+
+/// Arena, allocTrackingBegin, allocTrackingEnd
+#include "arena.h"
+
+/// noteToSemitones
+#include "guitar.h"
+
+/// ESTIMATOR_GRID_STEP
+#include "period_estimator.h"
+
+/// EXIT_SUCCESS, EXIT_FAILURE, malloc, free
+#include <stdlib.h>
+
+/// fprintf, fopen, fread, remove
+#include <stdio.h>
+
+/// strlen, strcat
+#include <string.h>
+
+/// sin, fabs, isnan, isinf, NAN
+#include <math.h>
+
+/**
+ * @brief The sample rate of the samples.
+ */
+static const unsigned int RATE = 44100;
+
+/**
+ * @brief The number of samples that the fake audio callback writes each time.
+ */
+static const size_t BLOCK_SIZE = 441;
+
+/**
+ * @brief The path to the audio samples that will be used for testing.
+ * @sa check_period_estimator.c
+ */
+static char *gPath;
+
+/**
+ * @brief Open a sample file.
+ *
+ * @param filename The name of the file of the sample
+ * @param size Output param that will contain the size of the sample
+ * @return The buffer. The caller will have to free it
+ */
+static float *openSample(const char *filename, size_t *size);
+
+/**
+ * @brief Run the detection on a whole sample, as the recording loop would do.
+ *
+ * @param context The detection context
+ * @param ring The ring to use
+ * @param samples The samples
+ * @param size The number of samples
+ * @param firstNote Output parameter for the first note that has been detected
+ * @return The number of note events
+ */
+static unsigned int runSample(DetectContext *context, SampleRing *ring,
+		const float *samples, size_t size, semitone_t *firstNote);
+
+/**
+ * @brief The maximum number of events that recordSample keeps.
+ */
+#define RECORDED_EVENTS 64
+
+/**
+ * @brief Run the detection on a whole sample with a configuration, and keep
+ *  its events.
+ *
+ * @param config The configuration of the detection
+ * @param samples The samples
+ * @param size The number of samples
+ * @param events Output array for the events, with RECORDED_EVENTS elements
+ * @param stats Output parameter for the counters at the end of the sample
+ * @return The number of events, which must not exceed RECORDED_EVENTS
+ */
+static size_t recordSample(const DetectConfig *config, const float *samples,
+		size_t size, DetectEvent *events, DetectStats *stats);
+
+/**
+ * @brief Mix real world samples, followed by two seconds of silence.
+ *
+ * @param samples The names of the files of the samples
+ * @param count The number of samples
+ * @param size Output parameter for the size of the mix
+ * @return The mix. The caller will have to free it
+ */
+static float *mixSamples(const char **samples, size_t count, size_t *size);
+
+/**
+ * @brief Test the detection on real world samples, without heap allocations.
+ */
+START_TEST(testDetectSamples)
+{
+	const char *samples[] = {
+		"A2_string5.pcm",
+		"A4_string1.pcm",
+		"B3_string2.pcm",
+		"D3_string4.pcm",
+		"E2_string6.pcm",
+		"E4_string1.pcm",
+		"G3_string3.pcm",
+	};
+
+	semitone_t expected[] = {
+		noteToSemitones("A", 2),
+		noteToSemitones("A", 4),
+		noteToSemitones("B", 3),
+		noteToSemitones("D", 3),
+		noteToSemitones("E", 2),
+		noteToSemitones("E", 4),
+		noteToSemitones("G", 3),
+	};
+
+	for(size_t i = 0; i < sizeof(samples) / sizeof(*samples); i++) {
+		size_t size;
+		float *buf = openSample(samples[i], &size);
+		DetectContext *context = detectInit(RATE);
+		SampleRing *ring = sampleRingCreate(RATE);
+		semitone_t note;
+
+		ck_assert(context != NULL);
+		ck_assert(ring != NULL);
+
+		allocTrackingBegin();
+		unsigned int notes = runSample(context, ring, buf, size, &note);
+		ck_assert_int_eq(allocTrackingEnd(), 0);
+
+		ck_assert_int_ge(notes, 1);
+		ck_assert_int_eq(note, expected[i]);
+
+		DetectStats stats;
+		detectGetStats(context, &stats);
+		ck_assert_int_eq(stats.notes, notes);
+		ck_assert_int_gt(stats.frames, 0);
+		ck_assert_int_eq(stats.eventsLost, 0);
+
+		sampleRingFree(ring);
+		detectFree(context);
+		free(buf);
+	}
+}
+END_TEST
+
+/**
+ * @brief Test that the fixed-point estimation detects the notes of the real
+ *  world samples.
+ */
+START_TEST(testDetectFixedPoint)
+{
+	const char *samples[] = {
+		"A2_string5.pcm",
+		"A4_string1.pcm",
+		"B3_string2.pcm",
+		"D3_string4.pcm",
+		"E2_string6.pcm",
+		"E4_string1.pcm",
+		"G3_string3.pcm",
+	};
+
+	semitone_t expected[] = {
+		noteToSemitones("A", 2),
+		noteToSemitones("A", 4),
+		noteToSemitones("B", 3),
+		noteToSemitones("D", 3),
+		noteToSemitones("E", 2),
+		noteToSemitones("E", 4),
+		noteToSemitones("G", 3),
+	};
+
+	static DetectEvent events[RECORDED_EVENTS];
+	DetectConfig config;
+
+	// The bands have their own estimator
+	detectConfigInit(&config, RATE);
+	config.bands = 1;
+	config.fixedPoint = 1;
+	ck_assert(detectInitWithConfig(&config) == NULL);
+
+	for(size_t i = 0; i < sizeof(samples) / sizeof(*samples); i++) {
+		size_t size;
+		float *buf = openSample(samples[i], &size);
+		DetectStats stats;
+		size_t count;
+		size_t notes = 0;
+
+		detectConfigInit(&config, RATE);
+		// Only the full tiers use the fixed-point estimator
+		config.governor = 0;
+		config.fixedPoint = 1;
+		count = recordSample(&config, buf, size, events, &stats);
+
+		for(size_t j = 0; j < count; j++) {
+			if(events[j].type == DETECT_EVENT_NOTE) {
+				ck_assert_int_eq(events[j].note, expected[i]);
+				notes++;
+			}
+		}
+		ck_assert_uint_ge(notes, 1);
+		ck_assert_uint_eq(stats.tierFrames[DETECT_TIER_FULL], stats.frames);
+
+		free(buf);
+	}
+}
+END_TEST
+
+/**
+ * @brief Test that the float sums of the period estimation do not change the
+ *  notes and the quality gating on real world samples.
+ */
+START_TEST(testDetectFloatSums)
+{
+	const char *samples[] = {
+		"A2_string5.pcm",
+		"A4_string1.pcm",
+		"B3_string2.pcm",
+		"D3_string4.pcm",
+		"E2_string6.pcm",
+		"E4_string1.pcm",
+		"G3_string3.pcm",
+	};
+
+	/// The lag grids to check, the default one and every lag
+	const double gridSteps[] = {ESTIMATOR_GRID_STEP, 0};
+
+	static DetectEvent refEvents[RECORDED_EVENTS];
+	static DetectEvent events[RECORDED_EVENTS];
+
+	for(size_t i = 0; i < sizeof(samples) / sizeof(*samples); i++) {
+		size_t size;
+		float *buf = openSample(samples[i], &size);
+
+		for(size_t g = 0; g < sizeof(gridSteps) / sizeof(*gridSteps); g++) {
+			DetectConfig config;
+			DetectStats refStats, stats;
+
+			detectConfigInit(&config, RATE);
+			config.gridStep = gridSteps[g];
+			size_t refCount = recordSample(&config, buf, size, refEvents,
+					&refStats);
+
+			config.floatSums = 1;
+			size_t count = recordSample(&config, buf, size, events, &stats);
+
+			ck_assert_int_eq(count, refCount);
+			for(size_t j = 0; j < count; j++) {
+				ck_assert_int_eq(events[j].type, refEvents[j].type);
+				if(events[j].type == DETECT_EVENT_NOTE) {
+					ck_assert_int_eq(events[j].note, refEvents[j].note);
+				} else if(events[j].type == DETECT_EVENT_TIER) {
+					ck_assert_int_eq(events[j].tier, refEvents[j].tier);
+				}
+			}
+
+			ck_assert_int_eq(stats.frames, refStats.frames);
+			ck_assert_int_eq(stats.droppedQuality, refStats.droppedQuality);
+			ck_assert_int_eq(stats.droppedUnplayable,
+					refStats.droppedUnplayable);
+		}
+
+		free(buf);
+	}
+}
+END_TEST
+
+/**
+ * @brief Test the chords on a mix of real world samples of open strings.
+ */
+START_TEST(testDetectChords)
+{
+	const char *samples[] = {
+		"A2_string5.pcm",
+		"D3_string4.pcm",
+		"G3_string3.pcm",
+		"B3_string2.pcm",
+	};
+	const size_t count = sizeof(samples) / sizeof(*samples);
+	size_t size;
+	// The silence after the samples ends the chord
+	float *mix = mixSamples(samples, count, &size);
+	static DetectEvent events[RECORDED_EVENTS];
+	DetectConfig config;
+	DetectStats stats;
+	int complete = 0;
+
+	detectConfigInit(&config, RATE);
+	config.polyphony = POLY_MAX_NOTES;
+	size_t recorded = recordSample(&config, mix, size, events, &stats);
+
+	int last = -1;
+	for(size_t i = 0; i < recorded; i++) {
+		if(events[i].type != DETECT_EVENT_NOTES) {
+			continue;
+		}
+		last = (int) i;
+
+		if(events[i].count != count) {
+			continue;
+		}
+
+		// All the notes are on the open strings, from the fifth one
+		complete = 1;
+		for(unsigned int s = 0; s < events[i].strings; s++) {
+			int expected = s >= 1 && s <= count ? 0 : -1;
+			complete = complete && events[i].frets[s] == expected;
+		}
+		if(complete) {
+			break;
+		}
+	}
+
+	ck_assert(complete);
+	ck_assert_int_gt(stats.chords, 0);
+
+	// The silence ends the chord
+	for(size_t i = last + 1; i < recorded; i++) {
+		if(events[i].type == DETECT_EVENT_NOTES) {
+			last = (int) i;
+		}
+	}
+	ck_assert_int_ge(last, 0);
+	ck_assert_int_eq(events[last].count, 0);
+
+	// Without polyphony there are no chords
+	config.polyphony = 0;
+	recorded = recordSample(&config, mix, size, events, &stats);
+	for(size_t i = 0; i < recorded; i++) {
+		ck_assert_int_ne(events[i].type, DETECT_EVENT_NOTES);
+	}
+
+	free(mix);
+}
+END_TEST
+
+/**
+ * @brief Test the names of the chords on a mix of real world samples of open
+ *  strings.
+ */
+START_TEST(testDetectChordNames)
+{
+	// The open strings of an E minor chord, without the fifth and fourth
+	const char *samples[] = {
+		"E2_string6.pcm",
+		"G3_string3.pcm",
+		"B3_string2.pcm",
+		"E4_string1.pcm",
+	};
+	size_t size;
+	float *mix = mixSamples(samples, sizeof(samples) / sizeof(*samples),
+			&size);
+	static DetectEvent events[RECORDED_EVENTS];
+	DetectConfig config;
+	DetectStats stats;
+	const ChromaChord *first = 0;
+	const ChromaChord *last = 0;
+
+	detectConfigInit(&config, RATE);
+	config.chords = 1;
+	size_t recorded = recordSample(&config, mix, size, events, &stats);
+
+	for(size_t i = 0; i < recorded; i++) {
+		if(events[i].type != DETECT_EVENT_CHORD) {
+			continue;
+		}
+
+		if(!first) {
+			first = &events[i].chord;
+
+			// The shape of a recognized chord starts from its root
+			ck_assert_int_eq(events[i].frets[events[i].strings - 1], 0);
+		}
+		last = &events[i].chord;
+	}
+
+	ck_assert(first != NULL);
+	ck_assert_int_eq(first->root, noteToSemitones("E", 1) % 12);
+	ck_assert_int_eq(first->kind, CHROMA_MINOR);
+	ck_assert_int_gt(stats.chordNames, 1);
+
+	// The silence ends the chord
+	ck_assert_int_eq(last->root, INVALID_SEMITONE);
+
+	// The notes of the chords are a different stream
+	for(size_t i = 0; i < recorded; i++) {
+		ck_assert_int_ne(events[i].type, DETECT_EVENT_NOTES);
+	}
+
+	free(mix);
+}
+END_TEST
+
+/**
+ * @brief Test that a NaN in the input is reported, and that its dump is
+ *  replayed deterministically.
+ */
+START_TEST(testDetectFlight)
+{
+	const char *path = "check_detect.flight";
+	// A NaN in the middle of the note
+	const size_t corrupted = RATE / 2;
+	size_t size;
+	float *buf = openSample("E2_string6.pcm", &size);
+	static DetectEvent events[RECORDED_EVENTS];
+	static DetectEvent replayed[RECORDED_EVENTS];
+	DetectConfig config;
+	DetectConfig replayConfig;
+	Tuning replayTuning;
+	DetectContext *context;
+	SampleRing *ring;
+	DetectStats stats;
+	FlightDump *dump;
+	size_t count = 0;
+	size_t anomalies = 0;
+	int nanRecords = 0;
+
+	buf[corrupted] = NAN;
+
+	detectConfigInit(&config, RATE);
+	// Same tier in the live run and in the replays
+	config.governor = 0;
+	// The replays must take the options from the dump
+	config.chords = 1;
+	config.reference = 442;
+	config.flightSeconds = (double) size / RATE + 1;
+
+	context = detectInitWithConfig(&config);
+	ring = sampleRingCreate(RATE);
+	ck_assert(context != NULL);
+	for(size_t i = 0; i < size; i += BLOCK_SIZE) {
+		size_t n = size - i < BLOCK_SIZE ? size - i : BLOCK_SIZE;
+		ck_assert_int_eq(sampleRingWrite(ring, buf + i, n), n);
+		ck_assert_int_eq(detectAnalyze(context, ring), 0);
+
+		while(count < RECORDED_EVENTS &&
+				detectPollEvent(context, &events[count])) {
+			anomalies += events[count].type == DETECT_EVENT_ANOMALY;
+			count++;
+		}
+	}
+
+	// The anomalies are reported at most once per length of the recorder
+	ck_assert_int_eq(anomalies, 1);
+	detectGetStats(context, &stats);
+	// The block with the NaN has been replaced by silence
+	ck_assert_uint_eq(stats.invalidBlocks, 1);
+	for(size_t i = 0; i < count; i++) {
+		if(events[i].type == DETECT_EVENT_ANOMALY) {
+			ck_assert_int_eq(events[i].trigger, FLIGHT_TRIGGER_NAN);
+		}
+	}
+
+	ck_assert_int_eq(detectDumpFlight(context, path, FLIGHT_TRIGGER_NAN), 0);
+	sampleRingFree(ring);
+	detectFree(context);
+
+	dump = flightLoad(path);
+	ck_assert(dump != NULL);
+	ck_assert_int_eq(dump->header.trigger, FLIGHT_TRIGGER_NAN);
+	ck_assert_uint_eq(dump->header.start, 0);
+	// Only the samples that have been preprocessed are recorded
+	ck_assert_uint_le(dump->header.samples, size);
+	ck_assert_uint_gt(dump->header.samples, size - config.hop);
+	// They are recorded before the preprocessor
+	ck_assert(isnan(dump->samples[corrupted]));
+	for(size_t i = 0; i < dump->header.records; i++) {
+		nanRecords += isnan(dump->records[i].period);
+	}
+	ck_assert_int_eq(nanRecords, stats.nanPeriods);
+
+	ck_assert_int_eq(detectConfigFromFlight(&replayConfig, &replayTuning,
+			&dump->header), 0);
+	ck_assert_int_eq(replayConfig.chords, 1);
+	ck_assert(replayConfig.reference == 442);
+	ck_assert(replayConfig.highPass == config.highPass);
+	ck_assert_uint_eq(replayTuning.strings, GUITAR_STRINGS);
+	// The anomalies are reported only with the recorder
+	replayConfig.flightSeconds = config.flightSeconds;
+
+	// The replays are identical to the live run, and to each other
+	for(int round = 0; round < 2; round++) {
+		DetectStats replayStats;
+		size_t replayCount = recordSample(&replayConfig, dump->samples,
+				dump->header.samples, replayed, &replayStats);
+
+		ck_assert_int_eq(replayCount, count);
+		for(size_t i = 0; i < count; i++) {
+			ck_assert_int_eq(replayed[i].type, events[i].type);
+			ck_assert_uint_eq(replayed[i].position, events[i].position);
+			if(events[i].type == DETECT_EVENT_NOTE) {
+				ck_assert_int_eq(replayed[i].note, events[i].note);
+			}
+		}
+		ck_assert_int_eq(replayStats.nanPeriods, stats.nanPeriods);
+		ck_assert_uint_eq(replayStats.invalidBlocks, stats.invalidBlocks);
+	}
+
+	flightDumpFree(dump);
+	remove(path);
+	free(buf);
+}
+END_TEST
+
+/**
+ * @brief Test that the detection recovers from a NaN in the input, with the
+ *  filters and the gain control of the default configuration.
+ */
+START_TEST(testDetectNanRecovery)
+{
+	size_t firstSize;
+	size_t secondSize;
+	float *first = openSample("E2_string6.pcm", &firstSize);
+	float *second = openSample("A2_string5.pcm", &secondSize);
+	size_t size = firstSize + secondSize;
+	float *mix = malloc(size * sizeof(float));
+	static DetectEvent events[RECORDED_EVENTS];
+	DetectConfig config;
+	DetectStats stats;
+	int e2 = 0;
+	int a2 = 0;
+
+	// A NaN in the middle of the first note, and then the second note
+	memcpy(mix, first, firstSize * sizeof(float));
+	memcpy(mix + firstSize, second, secondSize * sizeof(float));
+	mix[RATE / 2] = NAN;
+
+	detectConfigInit(&config, RATE);
+	config.governor = 0;
+	size_t count = recordSample(&config, mix, size, events, &stats);
+
+	ck_assert_uint_eq(stats.invalidBlocks, 1);
+	for(size_t i = 0; i < count; i++) {
+		if(events[i].type == DETECT_EVENT_NOTE) {
+			e2 |= events[i].note == noteToSemitones("E", 2);
+			a2 |= events[i].note == noteToSemitones("A", 2);
+		}
+	}
+	ck_assert(e2);
+	ck_assert(a2);
+
+	free(first);
+	free(second);
+	free(mix);
+}
+END_TEST
+
+/**
+ * @brief Test that the latency of the input is added to the effective one,
+ *  and the histogram of the analysis times.
+ */
+START_TEST(testDetectLatency)
+{
+	size_t size;
+	float *buf = openSample("A2_string5.pcm", &size);
+	static DetectEvent events[RECORDED_EVENTS];
+	DetectConfig config;
+	DetectStats stats;
+
+	detectConfigInit(&config, RATE);
+	config.inputLatency = -0.005;
+	ck_assert(detectInitWithConfig(&config) == NULL);
+
+	config.inputLatency = 0.005;
+	config.governor = 0;
+	recordSample(&config, buf, size, events, &stats);
+
+	ck_assert(stats.inputLatency == config.inputLatency);
+	ck_assert(stats.lastAnalysisTime > 0);
+	ck_assert(fabs(stats.latency - config.inputLatency -
+			(double) config.hop / RATE - stats.lastAnalysisTime) < 1e-9);
+
+	// Each window is in the bucket of its analysis time
+	unsigned long histogram = 0;
+	for(unsigned int i = 0; i < DETECT_TIME_BUCKETS; i++) {
+		histogram += stats.analysisTimes[i];
+	}
+	ck_assert_uint_eq(histogram, stats.frames);
+	ck_assert(stats.analysisTimeSum >= stats.maxAnalysisTime);
+	ck_assert(detectTimeBucketBound(0) == DETECT_TIME_BUCKET_BASE);
+	ck_assert(detectTimeBucketBound(3) == 8 * DETECT_TIME_BUCKET_BASE);
+	ck_assert(isinf(detectTimeBucketBound(DETECT_TIME_BUCKETS - 1)));
+
+	free(buf);
+}
+END_TEST
+
+/**
+ * @brief Test that the stages are sampled when the hardware counters are
+ *  available, and that the detection works as usual when they are not.
+ */
+START_TEST(testDetectHwCounters)
+{
+	size_t size;
+	float *buf = openSample("A2_string5.pcm", &size);
+	static DetectEvent events[RECORDED_EVENTS];
+	DetectConfig config;
+	DetectStats stats;
+
+	detectConfigInit(&config, RATE);
+	config.governor = 0;
+	config.hwCounters = 1;
+	recordSample(&config, buf, size, events, &stats);
+	ck_assert_int_eq(events[0].type, DETECT_EVENT_NOTE);
+
+	if(stats.hwCounters) {
+		// All the windows are sampled
+		ck_assert_uint_eq(stats.stages[DETECT_STAGE_ESTIMATOR].samples +
+				stats.stages[DETECT_STAGE_ESTIMATOR].discarded, stats.frames);
+		ck_assert_uint_gt(stats.stages[DETECT_STAGE_ENVELOPE].samples +
+				stats.stages[DETECT_STAGE_ENVELOPE].discarded, 0);
+		if(stats.stages[DETECT_STAGE_ESTIMATOR].samples) {
+			ck_assert(stats.stages[DETECT_STAGE_ESTIMATOR].totals[HW_CYCLES] >
+					0);
+		}
+	} else {
+		for(int i = 0; i < DETECT_STAGES; i++) {
+			ck_assert_uint_eq(stats.stages[i].samples, 0);
+			ck_assert_uint_eq(stats.stages[i].discarded, 0);
+		}
+	}
+
+	// Without the option, the stages are never sampled
+	config.hwCounters = 0;
+	recordSample(&config, buf, size, events, &stats);
+	ck_assert_int_eq(stats.hwCounters, 0);
+	ck_assert_uint_eq(stats.stages[DETECT_STAGE_ESTIMATOR].samples, 0);
+
+	free(buf);
+}
+END_TEST
+
+/**
+ * @brief Test that the detection becomes idle during silence and wakes up.
+ */
+START_TEST(testDetectIdle)
+{
+	size_t size;
+	float *note = openSample("E2_string6.pcm", &size);
+	// Three seconds of silence, more than the default timeout
+	size_t silenceSize = 3 * RATE;
+	float *silence = calloc(silenceSize, sizeof(float));
+	DetectContext *context = detectInit(RATE);
+	SampleRing *ring = sampleRingCreate(RATE);
+	DetectEvent event;
+	int idleEvents = 0;
+	int activeEvents = 0;
+	int notesAfterIdle = 0;
+
+	for(int round = 0; round < 2; round++) {
+		const float *samples = round ? silence : note;
+		size_t n = round ? silenceSize : size;
+
+		for(size_t i = 0; i < n; i += BLOCK_SIZE) {
+			size_t block = n - i < BLOCK_SIZE ? n - i : BLOCK_SIZE;
+			sampleRingWrite(ring, samples + i, block);
+			detectAnalyze(context, ring);
+
+			while(detectPollEvent(context, &event)) {
+				idleEvents += event.type == DETECT_EVENT_IDLE;
+			}
+		}
+	}
+
+	ck_assert_int_eq(idleEvents, 1);
+	ck_assert(detectIsIdle(context));
+
+	DetectStats stats;
+	detectGetStats(context, &stats);
+	unsigned long frames = stats.frames;
+	ck_assert_int_gt(stats.idleBlocks, 0);
+
+	// More silence doesn't run the estimator
+	for(size_t i = 0; i < silenceSize; i += BLOCK_SIZE) {
+		sampleRingWrite(ring, silence + i, BLOCK_SIZE);
+		detectAnalyze(context, ring);
+	}
+	detectGetStats(context, &stats);
+	ck_assert_int_eq(stats.frames, frames);
+
+	// The note wakes the detection up and it is detected again
+	for(size_t i = 0; i < size; i += BLOCK_SIZE) {
+		size_t block = size - i < BLOCK_SIZE ? size - i : BLOCK_SIZE;
+		sampleRingWrite(ring, note + i, block);
+		detectAnalyze(context, ring);
+
+		while(detectPollEvent(context, &event)) {
+			activeEvents += event.type == DETECT_EVENT_ACTIVE;
+			if(event.type == DETECT_EVENT_NOTE) {
+				ck_assert_int_eq(event.note, noteToSemitones("E", 2));
+				notesAfterIdle++;
+			}
+		}
+	}
+
+	ck_assert_int_eq(activeEvents, 1);
+	ck_assert_int_ge(notesAfterIdle, 1);
+
+	sampleRingFree(ring);
+	detectFree(context);
+	free(silence);
+	free(note);
+}
+END_TEST
+
+/**
+ * @brief Test that the gate follows the noise floor and that the gain control
+ *  normalizes the level, whatever the level of the input.
+ */
+START_TEST(testDetectPreprocess)
+{
+	const float levels[] = {0.005f, 0.05f};
+	float block[441];
+
+	for(size_t l = 0; l < sizeof(levels) / sizeof(*levels); l++) {
+		Preprocessor pre;
+		float noise = levels[l];
+		unsigned int seed = 1;
+
+		preprocessInit(&pre, RATE, 6, 1);
+
+		/* Ten seconds of noise: a loud noise opens the gate until the window
+		of the floor is full, then it must be closed. */
+		for(int b = 0; b < 1000; b++) {
+			for(int i = 0; i < 441; i++) {
+				seed = seed * 1103515245 + 12345;
+				block[i] = noise * ((seed >> 16) / 32768.0f - 1);
+			}
+			int open = preprocessBlock(&pre, block, 441);
+			if(b >= 900) {
+				ck_assert_int_eq(open, 0);
+			}
+		}
+
+		// Uniform noise has RMS amplitude / sqrt(3)
+		ck_assert(pre.floor < noise / sqrtf(3));
+		ck_assert(pre.floor > noise / sqrtf(3) / 4);
+
+		// A note 20dB above the noise opens the gate and gets normalized
+		for(int b = 0; b < 500; b++) {
+			for(int i = 0; i < 441; i++) {
+				block[i] = 10 * noise * sinf(2 * M_PI * 110 * i / RATE);
+			}
+			ck_assert_int_eq(preprocessBlock(&pre, block, 441), 1);
+		}
+
+		ck_assert(fabsf(pre.level * pre.gain - PREPROCESS_TARGET_LEVEL) <
+				0.05f * PREPROCESS_TARGET_LEVEL);
+
+		// The envelope follows the input, not the normalized signal
+		ck_assert(fabsf(pre.envelope - 10 * noise) < 0.05f * 10 * noise);
+	}
+}
+END_TEST
+
+/**
+ * @brief Test that the filters remove the offset and keep their state between
+ *  blocks.
+ */
+START_TEST(testDetectFilters)
+{
+	const size_t size = RATE;
+	float *whole = malloc(size * sizeof(float));
+	float *blocks = malloc(size * sizeof(float));
+	Preprocessor pre;
+
+	for(size_t i = 0; i < size; i++) {
+		// An offset, hum and the A string
+		whole[i] = 0.3f + 0.05f * sinf(2 * M_PI * 10 * i / RATE) +
+				0.2f * sinf(2 * M_PI * 110 * i / RATE);
+		blocks[i] = whole[i];
+	}
+
+	preprocessInit(&pre, RATE, 6, 0);
+	ck_assert_int_eq(preprocessSetFilters(&pre, RATE, 5, 20, 0), 0);
+	dspCascadeProcess(&pre.filters, whole, size);
+
+	// Blocks of any size must give the same result
+	preprocessInit(&pre, RATE, 6, 0);
+	ck_assert_int_eq(preprocessSetFilters(&pre, RATE, 5, 20, 0), 0);
+	for(size_t i = 0, n = 1; i < size; i += n, n = n * 7 % 1000 + 1) {
+		preprocessBlock(&pre, blocks + i, n < size - i ? n : size - i);
+	}
+
+	double mean = 0;
+	for(size_t i = 0; i < size; i++) {
+		ck_assert(whole[i] == blocks[i]);
+		// Skip the transient of the filters
+		if(i >= size / 2) {
+			mean += whole[i];
+		}
+	}
+	mean /= size / 2;
+	ck_assert(fabs(mean) < 0.001);
+
+	// Out of range parameters
+	ck_assert_int_ne(preprocessSetFilters(&pre, RATE, RATE, 0, 0), 0);
+	ck_assert_int_ne(preprocessSetFilters(&pre, RATE, 0, 0, 1), 0);
+
+	free(whole);
+	free(blocks);
+}
+END_TEST
+
+/**
+ * @brief Test the transitions of the governor.
+ */
+START_TEST(testDetectGovernor)
+{
+	Governor governor;
+	const double hop = 0.02;
+
+	governorInit(&governor, DETECT_TIERS - 1);
+	ck_assert_int_eq(governor.tier, 0);
+
+	// A low load never changes the tier
+	for(int i = 0; i < 100; i++) {
+		ck_assert_int_eq(governorUpdate(&governor, 0.1 * hop, hop, 0), 0);
+	}
+
+	// A single slow frame isn't enough to step down
+	ck_assert_int_eq(governorUpdate(&governor, 5 * hop, hop, 0), 0);
+	ck_assert_int_eq(governorUpdate(&governor, 0.1 * hop, hop, 0), 0);
+
+	// A sustained high load steps down one tier at a time until the cheapest
+	int tier = 0;
+	for(int i = 0; i < 100; i++) {
+		int newTier = governorUpdate(&governor, 2 * hop, hop, 0);
+		ck_assert_int_le(newTier, tier + 1);
+		tier = newTier;
+	}
+	ck_assert_int_eq(tier, DETECT_TIERS - 1);
+
+	// Backlog steps down immediately
+	governorInit(&governor, DETECT_TIERS - 1);
+	ck_assert_int_eq(governorUpdate(&governor, 0, hop, 1), 1);
+
+	// When headroom returns, it goes back to the full tier, but slowly
+	tier = governor.tier;
+	ck_assert_int_eq(governorUpdate(&governor, 0.05 * hop, hop, 0), tier);
+	for(int i = 0; i < 10 * GOVERNOR_STEP_UP_FRAMES; i++) {
+		tier = governorUpdate(&governor, 0.05 * hop, hop, 0);
+	}
+	ck_assert_int_eq(tier, 0);
+
+	// A governor with only a tier never changes it
+	governorInit(&governor, 0);
+	ck_assert_int_eq(governorUpdate(&governor, 10 * hop, hop, 1), 0);
+}
+END_TEST
+
+/**
+ * @brief Create the suite to check the detection
+ * @return The test suite
+ */
+Suite *detectSuite()
+{
+	Suite *s;
+	TCase *tcSamples;
+	TCase *tcFloatSums;
+	TCase *tcFixedPoint;
+	TCase *tcChords;
+	TCase *tcChordNames;
+	TCase *tcFlight;
+	TCase *tcLatency;
+	TCase *tcHwCounters;
+	TCase *tcIdle;
+	TCase *tcPreprocess;
+	TCase *tcGovernor;
+
+	s = suite_create("Detection");
+
+	tcSamples = tcase_create("Real world samples");
+	tcase_add_test(tcSamples, testDetectSamples);
+	tcase_set_timeout(tcSamples, 60.0);
+	suite_add_tcase(s, tcSamples);
+
+	tcFloatSums = tcase_create("Float sums");
+	tcase_add_test(tcFloatSums, testDetectFloatSums);
+	tcase_set_timeout(tcFloatSums, 60.0);
+	suite_add_tcase(s, tcFloatSums);
+
+	tcFixedPoint = tcase_create("Fixed point");
+	tcase_add_test(tcFixedPoint, testDetectFixedPoint);
+	tcase_set_timeout(tcFixedPoint, 60.0);
+	suite_add_tcase(s, tcFixedPoint);
+
+	tcChords = tcase_create("Chords");
+	tcase_add_test(tcChords, testDetectChords);
+	tcase_set_timeout(tcChords, 60.0);
+	suite_add_tcase(s, tcChords);
+
+	tcChordNames = tcase_create("Chord names");
+	tcase_add_test(tcChordNames, testDetectChordNames);
+	tcase_set_timeout(tcChordNames, 60.0);
+	suite_add_tcase(s, tcChordNames);
+
+	tcFlight = tcase_create("Flight recorder");
+	tcase_add_test(tcFlight, testDetectFlight);
+	tcase_add_test(tcFlight, testDetectNanRecovery);
+	tcase_set_timeout(tcFlight, 60.0);
+	suite_add_tcase(s, tcFlight);
+
+	tcLatency = tcase_create("Latency");
+	tcase_add_test(tcLatency, testDetectLatency);
+	suite_add_tcase(s, tcLatency);
+
+	tcHwCounters = tcase_create("Hardware counters");
+	tcase_add_test(tcHwCounters, testDetectHwCounters);
+	suite_add_tcase(s, tcHwCounters);
+
+	tcIdle = tcase_create("Idle");
+	tcase_add_test(tcIdle, testDetectIdle);
+	tcase_set_timeout(tcIdle, 60.0);
+	suite_add_tcase(s, tcIdle);
+
+	tcPreprocess = tcase_create("Preprocessor");
+	tcase_add_test(tcPreprocess, testDetectPreprocess);
+	tcase_add_test(tcPreprocess, testDetectFilters);
+	suite_add_tcase(s, tcPreprocess);
+
+	tcGovernor = tcase_create("Governor");
+	tcase_add_test(tcGovernor, testDetectGovernor);
+	suite_add_tcase(s, tcGovernor);
+
+	return s;
+}
+
+/**
+ * @brief The entry point for these tests.
+ *
+ * This program requires, as command line argument, the path to the directory
+ * containing the samples that will be used for some tests.
+ *
+ * @param argc The number of command line arguments
+ * @param argv The command line arguments
+ * @return The exit status code
+ */
+int main(int argc, char *argv[])
+{
+	int number_failed;
+	Suite *s;
+	SRunner *sr;
+
+	if(argc < 2) {
+		fprintf(stderr, "The program requires one argument.\n");
+		return EXIT_FAILURE;
+	}
+	gPath = argv[1];
+
+	s = detectSuite();
+	sr = srunner_create(s);
+
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static unsigned int runSample(DetectContext *context, SampleRing *ring,
+		const float *samples, size_t size, semitone_t *firstNote)
+{
+	unsigned int notes = 0;
+	DetectEvent event;
+
+	*firstNote = INVALID_SEMITONE;
+
+	for(size_t i = 0; i < size; i += BLOCK_SIZE) {
+		size_t n = size - i < BLOCK_SIZE ? size - i : BLOCK_SIZE;
+		ck_assert_int_eq(sampleRingWrite(ring, samples + i, n), n);
+
+		ck_assert_int_eq(detectAnalyze(context, ring), 0);
+
+		while(detectPollEvent(context, &event)) {
+			if(event.type == DETECT_EVENT_NOTE) {
+				if(!notes) {
+					*firstNote = event.note;
+				}
+				notes++;
+			}
+		}
+	}
+
+	return notes;
+}
+
+static size_t recordSample(const DetectConfig *config, const float *samples,
+		size_t size, DetectEvent *events, DetectStats *stats)
+{
+	DetectContext *context = detectInitWithConfig(config);
+	SampleRing *ring = sampleRingCreate(config->rate);
+	size_t count = 0;
+
+	ck_assert(context != NULL);
+	ck_assert(ring != NULL);
+
+	for(size_t i = 0; i < size; i += BLOCK_SIZE) {
+		size_t n = size - i < BLOCK_SIZE ? size - i : BLOCK_SIZE;
+		ck_assert_int_eq(sampleRingWrite(ring, samples + i, n), n);
+
+		ck_assert_int_eq(detectAnalyze(context, ring), 0);
+
+		while(count < RECORDED_EVENTS &&
+				detectPollEvent(context, &events[count])) {
+			count++;
+		}
+		ck_assert(count < RECORDED_EVENTS);
+	}
+
+	detectGetStats(context, stats);
+
+	sampleRingFree(ring);
+	detectFree(context);
+
+	return count;
+}
+
+static float *mixSamples(const char **samples, size_t count, size_t *size)
+{
+	float *mix;
+
+	*size = 2 * RATE;
+	for(size_t i = 0; i < count; i++) {
+		size_t n;
+		free(openSample(samples[i], &n));
+		*size = n + 2 * RATE > *size ? n + 2 * RATE : *size;
+	}
+
+	mix = calloc(*size, sizeof(float));
+	for(size_t i = 0; i < count; i++) {
+		size_t n;
+		float *buf = openSample(samples[i], &n);
+		for(size_t j = 0; j < n; j++) {
+			mix[j] += buf[j] / count;
+		}
+		free(buf);
+	}
+
+	return mix;
+}
+
+static float *openSample(const char *filename, size_t *size)
+{
+	#ifdef WIN32
+		const char *slash = "\\";
+	#else
+		const char *slash = "/";
+	#endif
+
+	FILE *fp;
+	char *realName;
+	size_t fileSize;
+	float *buf;
+
+	// + 2 = slash + null char
+	realName = calloc(strlen(filename) + strlen(gPath) + 2, sizeof(char));
+	strcat(realName, gPath);
+	strcat(realName, slash);
+	strcat(realName, filename);
+
+	fp = fopen(realName, "rb");
+	free(realName);
+
+	ck_assert_msg(fp, "Could not open sample file %s.", filename);
+
+	fseek(fp, 0L, SEEK_END);
+	fileSize = ftell(fp);
+	rewind(fp);
+
+	ck_assert_int_eq(fileSize % sizeof(float), 0);
+	*size = fileSize / sizeof(float);
+
+	buf = (float *) malloc(fileSize);
+	if(fread(buf, 1, fileSize, fp) != fileSize) {
+		ck_abort_msg("An error occurred while reading %s.", filename);
+	}
+
+	fclose(fp);
+
+	return buf;
+}
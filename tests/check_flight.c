@@ -0,0 +1,229 @@
+/**
+ * @file check_flight.c
+ * @brief Performs unit testing on the flight recorder.
+ */
+
+/// The library to test
+#include "flight.h"
+
+/// The check unit framework
+#include <check.h>
+
+/// EXIT_SUCCESS, EXIT_FAILURE
+#include <stdlib.h>
+
+/// fopen, fclose, remove
+#include <stdio.h>
+
+/// isnan, NAN
+#include <math.h>
+
+/**
+ * @brief The sample rate of the tests.
+ */
+static const unsigned int RATE = 1000;
+
+/**
+ * @brief The hop of the tests.
+ */
+static const unsigned int HOP = 100;
+
+/**
+ * @brief The path of the dump of the tests.
+ */
+static const char *PATH = "check_flight.flight";
+
+/**
+ * @brief Create a recorder with its arena.
+ *
+ * @param seconds The seconds that the recorder keeps
+ * @param arena Output parameter for the arena, which the caller will have to
+ *  free
+ * @return The recorder
+ */
+static FlightRecorder *createRecorder(double seconds, Arena **arena);
+
+/**
+ * @brief Test that the recorder keeps only the last samples and records.
+ */
+START_TEST(testFlightWrap)
+{
+	Arena *arena;
+	FlightRecorder *recorder = createRecorder(1, &arena);
+	FlightRecord record = {0};
+	FlightDump *dump;
+	float samples[350];
+
+	// Three seconds and a half, in blocks that don't divide the capacity
+	for(size_t i = 0; i < 10; i++) {
+		for(size_t j = 0; j < 350; j++) {
+			samples[j] = (float) (i * 350 + j);
+		}
+		flightAudio(recorder, samples, 350);
+	}
+
+	for(size_t i = 0; i < 35; i++) {
+		record.position = i * HOP;
+		record.decision = FLIGHT_DECISION_QUALITY;
+		flightRecord(recorder, &record);
+	}
+
+	ck_assert_int_eq(flightDump(recorder, PATH, FLIGHT_TRIGGER_REQUEST), 0);
+	dump = flightLoad(PATH);
+	ck_assert(dump != NULL);
+
+	ck_assert_uint_eq(dump->header.samples, RATE);
+	ck_assert_uint_eq(dump->header.start, 3500 - RATE);
+	for(size_t i = 0; i < dump->header.samples; i++) {
+		ck_assert(dump->samples[i] == (float) (dump->header.start + i));
+	}
+
+	// A record per hop, plus one
+	ck_assert_uint_eq(dump->header.records, RATE / HOP + 1);
+	ck_assert_uint_eq(dump->records[0].position, (35 - RATE / HOP - 1) * HOP);
+	ck_assert_uint_eq(dump->records[dump->header.records - 1].position,
+			34 * HOP);
+
+	flightDumpFree(dump);
+	arenaFree(arena);
+	remove(PATH);
+}
+END_TEST
+
+/**
+ * @brief Test that a dump is loaded as it was recorded.
+ */
+START_TEST(testFlightRoundTrip)
+{
+	Arena *arena;
+	FlightRecorder *recorder = createRecorder(2, &arena);
+	FlightRecord record;
+	FlightDump *dump;
+	float samples[] = {0.5f, -0.25f, NAN, 1e-3f};
+	FILE *fp;
+
+	// An empty recorder can be dumped
+	ck_assert_int_eq(flightDump(recorder, PATH, FLIGHT_TRIGGER_OVERFLOW), 0);
+	dump = flightLoad(PATH);
+	ck_assert(dump != NULL);
+	ck_assert_int_eq(dump->header.trigger, FLIGHT_TRIGGER_OVERFLOW);
+	ck_assert_uint_eq(dump->header.samples, 0);
+	ck_assert_uint_eq(dump->header.records, 0);
+	flightDumpFree(dump);
+
+	flightAudio(recorder, samples, 4);
+	record.position = 12345;
+	record.period = 100.25f;
+	record.quality = 0.875f;
+	record.elapsed = 0.001f;
+	record.note = -1;
+	record.tier = 2;
+	record.decision = FLIGHT_DECISION_NOTE;
+	flightRecord(recorder, &record);
+
+	ck_assert_int_eq(flightDump(recorder, PATH, FLIGHT_TRIGGER_NAN), 0);
+
+	// Only the complete file is left
+	fp = fopen("check_flight.flight.tmp", "rb");
+	ck_assert(fp == NULL);
+
+	dump = flightLoad(PATH);
+	ck_assert(dump != NULL);
+	ck_assert_uint_eq(dump->header.rate, RATE);
+	ck_assert_uint_eq(dump->header.hop, HOP);
+	ck_assert_int_eq(dump->header.trigger, FLIGHT_TRIGGER_NAN);
+	ck_assert_uint_eq(dump->header.start, 0);
+	ck_assert_uint_eq(dump->header.samples, 4);
+	ck_assert(dump->header.options.gateRatio == 1.5f);
+	ck_assert_int_eq(dump->header.options.agc, 1);
+	ck_assert(dump->header.options.dcBlocker == 0);
+	ck_assert(dump->header.options.highPass == 41.2);
+	ck_assert_uint_eq(dump->header.options.strings, 7);
+	ck_assert_int_eq(dump->header.options.open[6], -31);
+	ck_assert(dump->header.options.reference == 442.5);
+	ck_assert_int_eq(dump->header.options.windowPeriods, 4);
+	ck_assert_uint_eq(dump->header.options.polyphony, 3);
+	ck_assert_int_eq(dump->header.options.chords, 0);
+	ck_assert(dump->samples[0] == 0.5f);
+	ck_assert(dump->samples[1] == -0.25f);
+	ck_assert(isnan(dump->samples[2]));
+	ck_assert(dump->samples[3] == 1e-3f);
+
+	ck_assert_uint_eq(dump->header.records, 1);
+	ck_assert_uint_eq(dump->records[0].position, record.position);
+	ck_assert(dump->records[0].period == record.period);
+	ck_assert(dump->records[0].quality == record.quality);
+	ck_assert(dump->records[0].elapsed == record.elapsed);
+	ck_assert_int_eq(dump->records[0].note, -1);
+	ck_assert_uint_eq(dump->records[0].tier, 2);
+	ck_assert_uint_eq(dump->records[0].decision, FLIGHT_DECISION_NOTE);
+	flightDumpFree(dump);
+
+	// A file that isn't a dump is refused
+	fp = fopen(PATH, "wb");
+	fputs("RIFF", fp);
+	fclose(fp);
+	ck_assert(flightLoad(PATH) == NULL);
+
+	arenaFree(arena);
+	remove(PATH);
+}
+END_TEST
+
+/**
+ * @brief Create the suite to check the flight recorder
+ * @return The test suite
+ */
+Suite *flightSuite()
+{
+	Suite *s;
+	TCase *tcCore;
+
+	s = suite_create("Flight recorder");
+
+	tcCore = tcase_create("Core");
+	tcase_add_test(tcCore, testFlightWrap);
+	tcase_add_test(tcCore, testFlightRoundTrip);
+	suite_add_tcase(s, tcCore);
+
+	return s;
+}
+
+int main()
+{
+	int numberFailed;
+	Suite *s;
+	SRunner *sr;
+
+	s = flightSuite();
+	sr = srunner_create(s);
+
+	srunner_run_all(sr, CK_NORMAL);
+	numberFailed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (numberFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static FlightRecorder *createRecorder(double seconds, Arena **arena)
+{
+	FlightConfig config;
+	FlightRecorder *recorder;
+
+	flightConfigInit(&config, RATE, HOP, seconds);
+	config.options.gateRatio = 1.5f;
+	config.options.agc = 1;
+	config.options.highPass = 41.2;
+	config.options.strings = 7;
+	config.options.open[6] = -31;
+	config.options.reference = 442.5;
+	config.options.windowPeriods = 4;
+	config.options.polyphony = 3;
+	*arena = arenaCreate(flightMemorySize(&config));
+	ck_assert(*arena != NULL);
+
+	recorder = flightCreate(*arena, &config);
+	ck_assert(recorder != NULL);
+
+	return recorder;
+}
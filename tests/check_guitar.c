@@ -16,6 +16,9 @@
 /// EXIT_SUCCESS, EXIT_FAILURE
 #include <stdlib.h>
 
+/// log2, pow
+#include <math.h>
+
 /**
  * @brief Tests the noteToSemitones and frequencyToSemitones functions
  */
@@ -153,11 +156,149 @@ START_TEST(testGuitarFrets)
 }
 END_TEST
 
+/**
+ * @brief Tests the tables of the tunings and their descriptions
+ */
+START_TEST(testGuitarTuning)
+{
+	Tuning tuning;
+
+	// The table must give the same results as noteToFrets for all the notes
+	ck_assert_int_eq(tuningInit(&tuning, STANDARD_TUNING, GUITAR_STRINGS,
+			GUITAR_FRETS), 0);
+	for(semitone_t note = -20; note < 120; note++) {
+		semitone_t frets[GUITAR_STRINGS];
+		unsigned int positions;
+		unsigned int expected = noteToFrets(note, STANDARD_TUNING, frets,
+				GUITAR_STRINGS, GUITAR_FRETS);
+		const semitone_t *table = tuningLookup(&tuning, note, &positions);
+
+		ck_assert_int_eq(positions, expected);
+		ck_assert(expected ? table != NULL : table == NULL);
+
+		for(unsigned int j = 0; expected && j < GUITAR_MAX_STRINGS; j++) {
+			if(j < GUITAR_STRINGS && frets[j] >= 0) {
+				ck_assert_int_eq(table[j], frets[j]);
+			} else {
+				ck_assert_int_lt(table[j], 0);
+			}
+		}
+	}
+	ck_assert(tuningLookup(&tuning, INVALID_SEMITONE, NULL) == NULL);
+
+	// Descriptions are from the lowest string
+	Tuning parsed;
+	ck_assert_int_eq(tuningParse(&parsed, "standard", GUITAR_FRETS), 0);
+	ck_assert_int_eq(parsed.strings, GUITAR_STRINGS);
+	for(unsigned int i = 0; i < GUITAR_STRINGS; i++) {
+		ck_assert_int_eq(parsed.open[i], STANDARD_TUNING[i]);
+	}
+
+	ck_assert_int_eq(tuningParse(&parsed, "D2 A2 D3 G3 B3 E4", GUITAR_FRETS),
+			0);
+	ck_assert_int_eq(parsed.open[5], noteToSemitones("D", 2));
+	ck_assert_int_eq(tuningLookup(&parsed, noteToSemitones("D", 2),
+			NULL)[5], 0);
+	ck_assert(tuningLookup(&parsed, noteToSemitones("C#", 2), NULL) == NULL);
+
+	ck_assert_int_eq(tuningParse(&parsed, "7-string", 24), 0);
+	ck_assert_int_eq(parsed.strings, 7);
+	ck_assert_int_eq(tuningLookup(&parsed, noteToSemitones("C", 2),
+			NULL)[6], 1);
+
+	ck_assert_int_eq(tuningParse(&parsed, "bass", 20), 0);
+	ck_assert_int_eq(parsed.strings, 4);
+	ck_assert_int_eq(parsed.open[0], noteToSemitones("G", 2));
+	ck_assert(tuningLookup(&parsed, noteToSemitones("D#", 1), NULL) == NULL);
+
+	// Invalid descriptions
+	ck_assert_int_ne(tuningParse(&parsed, "", GUITAR_FRETS), 0);
+	ck_assert_int_ne(tuningParse(&parsed, "E A D G B E", GUITAR_FRETS), 0);
+	ck_assert_int_ne(tuningParse(&parsed, "E2 H2", GUITAR_FRETS), 0);
+	ck_assert_int_ne(tuningParse(&parsed, "E2x A2", GUITAR_FRETS), 0);
+	ck_assert_int_ne(tuningParse(&parsed, "E1 E1 E1 E1 E1 E1 E1 E1 E1",
+			GUITAR_FRETS), 0);
+	ck_assert_int_ne(tuningParse(&parsed, "A0 E8", GUITAR_FRETS), 0);
+}
+END_TEST
+
+/**
+ * @brief Tests the quantizer against frequencyToSemitones
+ */
+START_TEST(testGuitarQuantizer)
+{
+	Quantizer quantizer;
+	/// The ratio between two tested frequencies, a tenth of cent
+	const double step = pow(2, 1 / 12000.0);
+	double highest = noteToFrequency("E", 7) * pow(2, 1 / 24.0);
+
+	ck_assert_int_eq(quantizerInit(&quantizer, QUANTIZER_STANDARD_REFERENCE),
+			0);
+
+	/* All the playable frequencies, and the quarter tones around them.
+	frequencyToSemitones works with floats, so the two may disagree only on the
+	boundaries between semitones. */
+	for(double f = noteToFrequency("E", 1) / pow(2, 1 / 24.0); f < highest;
+			f *= step) {
+		double error;
+		float cents;
+		semitone_t expected = frequencyToSemitones(f, &error);
+		semitone_t note = quantize(&quantizer, f, &cents);
+
+		ck_assert(cents >= -50.001f && cents <= 50.001f);
+		if(note != expected) {
+			ck_assert(fabs(cents) > 49.99);
+			ck_assert_int_eq(abs(note - expected), 1);
+		} else {
+			ck_assert_double_eq_tol(cents, -1200 * log2(error), 1e-3);
+		}
+	}
+
+	// The table gives the same frequencies as noteToFrequency
+	for(semitone_t note = QUANTIZER_FIRST;
+			note < QUANTIZER_FIRST + QUANTIZER_SIZE; note++) {
+		double f = quantizerFrequency(&quantizer, note);
+		ck_assert_double_eq_tol(f / noteToFrequency("A", 0),
+				pow(2, note / 12.0), 1e-9);
+		ck_assert_int_eq(quantize(&quantizer, f, NULL), note);
+	}
+	ck_assert_double_eq(quantizerFrequency(&quantizer, INVALID_SEMITONE), -1);
+	ck_assert_double_eq(quantizerFrequency(&quantizer, QUANTIZER_FIRST - 1),
+			-1);
+
+	// Out of the table
+	ck_assert_int_eq(quantize(&quantizer, 0, NULL), INVALID_SEMITONE);
+	ck_assert_int_eq(quantize(&quantizer, -440, NULL), INVALID_SEMITONE);
+	ck_assert_int_eq(quantize(&quantizer, 1e6, NULL), INVALID_SEMITONE);
+	ck_assert_int_eq(quantize(&quantizer, NAN, NULL), INVALID_SEMITONE);
+
+	// Another pitch standard
+	ck_assert_int_eq(quantizerInit(&quantizer, 432), 0);
+	ck_assert_int_eq(quantize(&quantizer, 432, NULL), noteToSemitones("A", 4));
+	ck_assert_int_ne(quantizerInit(&quantizer, 0), 0);
+
+	// The batch must give the same results as the single conversions
+	double frequencies[] = {82.41, 110, 100, 440, 10, 1318.5, 1e6};
+	size_t count = sizeof(frequencies) / sizeof(frequencies[0]);
+	semitone_t notes[sizeof(frequencies) / sizeof(frequencies[0])];
+	float errors[sizeof(frequencies) / sizeof(frequencies[0])];
+	quantizeBatch(&quantizer, frequencies, notes, errors, count);
+	for(size_t i = 0; i < count; i++) {
+		float cents;
+		ck_assert_int_eq(notes[i], quantize(&quantizer, frequencies[i],
+				&cents));
+		ck_assert_float_eq_tol(errors[i], cents, 1e-6);
+	}
+}
+END_TEST
+
 Suite *guitarSuite(void)
 {
 	Suite *s;
 	TCase *tcSemitones;
 	TCase *tcFrets;
+	TCase *tcTuning;
+	TCase *tcQuantizer;
 
 	s = suite_create("Guitar");
 
@@ -170,6 +311,14 @@ Suite *guitarSuite(void)
 	tcase_add_test(tcFrets, testGuitarFrets);
 	suite_add_tcase(s, tcFrets);
 
+	tcTuning = tcase_create("Tuning tables");
+	tcase_add_test(tcTuning, testGuitarTuning);
+	suite_add_tcase(s, tcTuning);
+
+	tcQuantizer = tcase_create("Quantizer");
+	tcase_add_test(tcQuantizer, testGuitarQuantizer);
+	suite_add_tcase(s, tcQuantizer);
+
 	return s;
 }
 
@@ -0,0 +1,173 @@
+/**
+ * @file check_metrics.c
+ * @brief Performs unit testing on the export of the metrics.
+ */
+
+/// The library to test
+#include "metrics.h"
+
+/// The check unit framework
+#include <check.h>
+
+/// EXIT_SUCCESS, EXIT_FAILURE
+#include <stdlib.h>
+
+/// fopen, fread, fclose, remove, tmpfile, rewind
+#include <stdio.h>
+
+/// memset, strstr
+#include <string.h>
+
+/**
+ * @brief The path of the metrics of the tests.
+ */
+static const char *PATH = "check_metrics.prom";
+
+/**
+ * @brief The maximum size of the metrics read by the tests.
+ */
+#define TEXT_SIZE 8192
+
+/**
+ * @brief Read a whole file into a string.
+ *
+ * @param fp The file, which is closed
+ * @param text Output parameter for the content, of TEXT_SIZE characters
+ */
+static void readText(FILE *fp, char *text);
+
+/**
+ * @brief Test the format of the metrics.
+ */
+START_TEST(testMetricsFormat)
+{
+	static char text[TEXT_SIZE];
+	MetricsSnapshot snapshot;
+	FILE *fp = tmpfile();
+
+	ck_assert(fp != NULL);
+
+	memset(&snapshot, 0, sizeof(snapshot));
+	snapshot.detect.notes = 12;
+	snapshot.detect.droppedSilence = 34;
+	snapshot.detect.tier = DETECT_TIER_DECIMATED;
+	snapshot.detect.tierFrames[DETECT_TIER_FULL] = 5;
+	snapshot.detect.frames = 5;
+	snapshot.detect.analysisTimes[0] = 2;
+	snapshot.detect.analysisTimes[2] = 3;
+	snapshot.detect.analysisTimeSum = 0.25;
+	snapshot.overflows = 7;
+	snapshot.ringFill = 256;
+	snapshot.ringCapacity = 1024;
+
+	ck_assert_int_eq(metricsFormat(fp, &snapshot), 0);
+	rewind(fp);
+	readText(fp, text);
+
+	ck_assert(strstr(text, "# TYPE guitarbiro_detections_total counter\n"));
+	ck_assert(strstr(text, "\nguitarbiro_detections_total{kind=\"note\"} 12\n"));
+	ck_assert(strstr(text, "\nguitarbiro_drops_total{reason=\"silence\"} 34\n"));
+	ck_assert(strstr(text, "\nguitarbiro_windows_total{tier=\"full\"} 5\n"));
+	ck_assert(strstr(text, "\nguitarbiro_overflows_total 7\n"));
+	ck_assert(strstr(text, "\nguitarbiro_ring_fill_samples 256\n"));
+	ck_assert(strstr(text, "\nguitarbiro_engine_tier 2\n"));
+
+	// The buckets of a histogram are cumulative
+	ck_assert(strstr(text, "# TYPE guitarbiro_analysis_seconds histogram\n"));
+	ck_assert(strstr(text,
+			"\nguitarbiro_analysis_seconds_bucket{le=\"1.6e-05\"} 2\n"));
+	ck_assert(strstr(text,
+			"\nguitarbiro_analysis_seconds_bucket{le=\"3.2e-05\"} 2\n"));
+	ck_assert(strstr(text,
+			"\nguitarbiro_analysis_seconds_bucket{le=\"6.4e-05\"} 5\n"));
+	ck_assert(strstr(text,
+			"\nguitarbiro_analysis_seconds_bucket{le=\"+Inf\"} 5\n"));
+	ck_assert(strstr(text, "\nguitarbiro_analysis_seconds_sum 0.25\n"));
+	ck_assert(strstr(text, "\nguitarbiro_analysis_seconds_count 5\n"));
+}
+END_TEST
+
+/**
+ * @brief Test that the exporter writes the last published snapshot, and only
+ *  complete files.
+ */
+START_TEST(testMetricsExporter)
+{
+	static char text[TEXT_SIZE];
+	MetricsConfig config;
+	MetricsExporter *exporter;
+	MetricsSnapshot snapshot;
+	FILE *fp;
+
+	remove(PATH);
+
+	metricsConfigInit(&config);
+	config.interval = 10;
+	ck_assert(metricsStart(&config, "") == NULL);
+
+	exporter = metricsStart(&config, PATH);
+	ck_assert(exporter != NULL);
+
+	// The snapshots that the writer doesn't take are replaced
+	memset(&snapshot, 0, sizeof(snapshot));
+	for(unsigned long i = 1; i <= 1000; i++) {
+		snapshot.detect.notes = i;
+		metricsPublish(exporter, &snapshot);
+	}
+	metricsStop(exporter);
+
+	fp = fopen(PATH, "r");
+	ck_assert(fp != NULL);
+	readText(fp, text);
+	ck_assert(strstr(text, "\nguitarbiro_detections_total{kind=\"note\"} 1000\n"));
+
+	fp = fopen("check_metrics.prom.tmp", "r");
+	ck_assert(fp == NULL);
+
+	remove(PATH);
+}
+END_TEST
+
+/**
+ * @brief Create the suite to check the metrics
+ * @return The test suite
+ */
+Suite *metricsSuite()
+{
+	Suite *s;
+	TCase *tcCore;
+
+	s = suite_create("Metrics");
+
+	tcCore = tcase_create("Core");
+	tcase_add_test(tcCore, testMetricsFormat);
+	tcase_add_test(tcCore, testMetricsExporter);
+	suite_add_tcase(s, tcCore);
+
+	return s;
+}
+
+int main()
+{
+	int numberFailed;
+	Suite *s;
+	SRunner *sr;
+
+	s = metricsSuite();
+	sr = srunner_create(s);
+
+	srunner_run_all(sr, CK_NORMAL);
+	numberFailed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (numberFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void readText(FILE *fp, char *text)
+{
+	size_t size = fread(text, 1, TEXT_SIZE - 1, fp);
+
+	ck_assert_uint_lt(size, TEXT_SIZE - 1);
+	text[size] = 0;
+	fclose(fp);
+}
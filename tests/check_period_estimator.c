@@ -27,6 +27,18 @@
 /// noteToSemitones, noteToFrequency
 #include "guitar.h"
 
+/// Arena, allocTrackingBegin, allocTrackingEnd
+#include "arena.h"
+
+/// BandEstimator, bandRun, bandRunLow, bandRunHigh, bandCombine
+#include "band_estimator.h"
+
+/// pthread_create, pthread_join
+#include <pthread.h>
+
+/// FixedEstimator, fixedRun, fixedFromFloat
+#include "fixed_estimator.h"
+
 /**
  * @brief The timeout to run the "real world samples" test.
  *
@@ -58,6 +70,39 @@ static char *gPath;
  */
 static float *openSample(const char *filename, size_t *size);
 
+/**
+ * @brief The arguments of the thread that runs the low band.
+ */
+typedef struct {
+	/**
+	 * @brief The estimator.
+	 */
+	BandEstimator *estimator;
+
+	/**
+	 * @brief The signal.
+	 */
+	const float *x;
+
+	/**
+	 * @brief The estimated period.
+	 */
+	double period;
+
+	/**
+	 * @brief The quality of the period.
+	 */
+	double quality;
+} LowBandJob;
+
+/**
+ * @brief Run the low band of a band-split estimator in a thread.
+ *
+ * @param arg A LowBandJob
+ * @return Always null
+ */
+static void *runLowBand(void *arg);
+
 /**
  * @brief Simulate a test with a pure sine signal and with a sine plus octaves.
  *
@@ -188,6 +233,613 @@ START_TEST(testPeriodEstimatorSamples)
 }
 END_TEST
 
+/**
+ * @brief Test that a PeriodEstimator matches estimatePeriod without allocating.
+ */
+START_TEST(testPeriodEstimatorArena)
+{
+	/// The sample rate of the samples
+	const int rate = 44100;
+
+	/// The samples to check
+	const char *samples[] = {
+		"A2_string5.pcm",
+		"E4_string1.pcm",
+		"G3_string3.pcm",
+	};
+	const size_t numSamples = sizeof(samples) / sizeof(*samples);
+
+	float *bufs[sizeof(samples) / sizeof(*samples)];
+	size_t sizes[sizeof(samples) / sizeof(*samples)];
+
+	EstimatorConfig config;
+	estimatorConfigInit(&config,
+			(int) floor(rate / noteToFrequency("E", 7)),
+			(int) ceil(rate / noteToFrequency("A", 0)));
+
+	size_t memorySize = estimatorMemorySize(&config);
+	Arena *arena = arenaCreate(memorySize);
+	ck_assert(arena != NULL);
+
+	PeriodEstimator *estimator = estimatorCreate(arena, &config);
+	ck_assert(estimator != NULL);
+	ck_assert(arenaUsed(arena) <= memorySize);
+
+	// The arena is full, another estimator cannot fit
+	ck_assert(estimatorCreate(arena, &config) == NULL);
+
+	/* Use only a part of the samples, as an analysis window would, to keep
+	the test fast. */
+	const int n = 8 * config.maxP;
+	double refPeriods[sizeof(samples) / sizeof(*samples)];
+	double refQualities[sizeof(samples) / sizeof(*samples)];
+	int refInts[sizeof(samples) / sizeof(*samples)];
+
+	for(size_t i = 0; i < numSamples; i++) {
+		bufs[i] = openSample(samples[i], &sizes[i]);
+		ck_assert(sizes[i] >= (size_t) n);
+
+		refPeriods[i] = estimatePeriod(bufs[i], n, config.minP, config.maxP,
+				&refQualities[i], &refInts[i]);
+	}
+
+	allocTrackingBegin();
+
+	for(size_t i = 0; i < numSamples; i++) {
+		double q;
+		int p;
+		double period = estimatorRun(estimator, bufs[i], n, &q, &p);
+
+		ck_assert_double_eq(period, refPeriods[i]);
+		ck_assert_double_eq(q, refQualities[i]);
+		ck_assert_int_eq(p, refInts[i]);
+	}
+
+	ck_assert_int_eq(allocTrackingEnd(), 0);
+
+	for(size_t i = 0; i < numSamples; i++) {
+		free(bufs[i]);
+	}
+	arenaFree(arena);
+}
+END_TEST
+
+/**
+ * @brief Test that the estimators of the detection give the same results with
+ *  and without the specialized kernels.
+ *
+ * The configuration is the one of detectInit at 44.1kHz, which is among the
+ * default kernels of the SPECIALIZED_KERNELS option.
+ * The references come from estimators whose configuration has no kernel.
+ */
+START_TEST(testPeriodEstimatorSpecialized)
+{
+	/// The sample rate of the samples
+	const int rate = 44100;
+
+	/// The samples to check
+	const char *samples[] = {
+		"E2_string6.pcm",
+		"D3_string4.pcm",
+		"E4_string1.pcm",
+	};
+	const size_t numSamples = sizeof(samples) / sizeof(*samples);
+
+	EstimatorConfig config;
+	estimatorConfigInit(&config,
+			(int) floor(rate / noteToFrequency("E", 7)),
+			(int) ceil(rate / noteToFrequency("E", 1)));
+	EstimatorConfig gridConfig = config;
+	gridConfig.gridStep = ESTIMATOR_GRID_STEP;
+	// A wider range has no kernel, but it can run on the same range
+	EstimatorConfig refConfig = gridConfig;
+	refConfig.maxP++;
+
+	Arena *arena = arenaCreate(estimatorMemorySize(&config) +
+			estimatorMemorySize(&gridConfig) + estimatorMemorySize(&refConfig));
+	ck_assert(arena != NULL);
+	PeriodEstimator *estimator = estimatorCreate(arena, &config);
+	PeriodEstimator *gridEstimator = estimatorCreate(arena, &gridConfig);
+	PeriodEstimator *refEstimator = estimatorCreate(arena, &refConfig);
+	ck_assert(estimator != NULL && gridEstimator != NULL &&
+			refEstimator != NULL);
+	ck_assert(!estimatorSpecialized(refEstimator, 2 * refConfig.maxP));
+
+	/// The window of the detection
+	const int n = 2 * config.maxP;
+
+	// The kernels are only for the windows they have been built for
+	ck_assert(!estimatorSpecialized(estimator, n + 1));
+#ifdef ESTIMATOR_KERNELS
+	ck_assert(estimatorSpecialized(estimator, n));
+	ck_assert(estimatorSpecialized(gridEstimator, n));
+#endif
+
+	for(size_t i = 0; i < numSamples; i++) {
+		size_t size;
+		float *buf = openSample(samples[i], &size);
+		ck_assert(size >= (size_t) n);
+
+		for(size_t offset = 0; offset + n <= size; offset += 5 * n) {
+			double q, refQ;
+			int p, refP;
+			double period = estimatorRun(estimator, buf + offset, n, &q, &p);
+			double ref = estimatePeriod(buf + offset, n, config.minP,
+					config.maxP, &refQ, &refP);
+
+			ck_assert_double_eq(period, ref);
+			ck_assert_double_eq(q, refQ);
+			ck_assert_int_eq(p, refP);
+
+			period = estimatorRun(gridEstimator, buf + offset, n, &q, &p);
+			ref = estimatorRunRange(refEstimator, buf + offset, n, config.minP,
+					config.maxP, &refQ, &refP);
+
+			ck_assert_double_eq(period, ref);
+			ck_assert_double_eq(q, refQ);
+			ck_assert_int_eq(p, refP);
+		}
+
+		free(buf);
+	}
+
+	arenaFree(arena);
+}
+END_TEST
+
+/**
+ * @brief Test that the fixed-point estimator agrees with the float one.
+ *
+ * All the windows of the samples are compared, with the range and the window
+ * of the detection.
+ */
+START_TEST(testPeriodEstimatorFixed)
+{
+	/// The sample rate of the samples
+	const int rate = 44100;
+
+	/// The samples to check
+	const char *samples[] = {
+		"E2_string6.pcm",
+		"A2_string5.pcm",
+		"D3_string4.pcm",
+		"G3_string3.pcm",
+		"B3_string2.pcm",
+		"E4_string1.pcm",
+		"A4_string1.pcm",
+	};
+	const size_t numSamples = sizeof(samples) / sizeof(*samples);
+
+	EstimatorConfig config;
+	estimatorConfigInit(&config,
+			(int) floor(rate / noteToFrequency("E", 7)),
+			(int) ceil(rate / noteToFrequency("E", 1)));
+
+	Arena *arena = arenaCreate(fixedMemorySize(&config));
+	ck_assert(arena != NULL);
+	FixedEstimator *estimator = fixedCreate(arena, &config);
+	ck_assert(estimator != NULL);
+
+	/// The window of the detection
+	const int n = 2 * config.maxP;
+	/// The number of windows that have been compared
+	int windows = 0;
+	/// The number of windows with the same result
+	int agreements = 0;
+
+	for(size_t i = 0; i < numSamples; i++) {
+		size_t size;
+		float *buf = openSample(samples[i], &size);
+		int16_t *fixed = malloc(size * sizeof(int16_t));
+		ck_assert(fixed != NULL);
+		fixedFromFloat(buf, fixed, (int) size);
+
+		for(size_t offset = 0; offset + n <= size; offset += n / 2) {
+			double q;
+			int p;
+			double ref = estimatePeriod(buf + offset, n, config.minP,
+					config.maxP, &q, &p);
+			int32_t fixedQ;
+			double period = fixedRun(estimator, fixed + offset, n, &fixedQ,
+					0) / (double) (1 << FIXED_PERIOD_SHIFT);
+
+			windows++;
+			if((ref == 0 && period == 0) ||
+					(ref > 0 && fabs(period / ref - 1) < 0.001)) {
+				agreements++;
+			}
+
+			// On clear notes, within a cent, and with the same quality
+			if(ref > 0 && q > 0.9) {
+				ck_assert(period > 0);
+				ck_assert(fabs(1200 * log2(period / ref)) < 1);
+				ck_assert_double_eq_tol(
+						fixedQ / (double) (1 << FIXED_NAC_SHIFT), q, 1e-3);
+			}
+		}
+
+		free(fixed);
+		free(buf);
+	}
+
+	ck_assert(agreements >= 0.99 * windows);
+
+	arenaFree(arena);
+}
+END_TEST
+
+/**
+ * @brief Test that the batch estimation gives the same results as the
+ *  estimation of each frame, with any number of threads.
+ */
+START_TEST(testPeriodEstimatorBatch)
+{
+	/// The sample rate of the samples
+	const int rate = 44100;
+
+	/// The numbers of threads to check, 0 is all the processors
+	const int threads[] = {1, 3, 0};
+
+	size_t size;
+	float *buf = openSample("E2_string6.pcm", &size);
+
+	EstimatorConfig config;
+	estimatorConfigInit(&config,
+			(int) floor(rate / noteToFrequency("E", 7)),
+			(int) ceil(rate / noteToFrequency("E", 1)));
+	config.gridStep = ESTIMATOR_GRID_STEP;
+
+	/// The window of the detection
+	const int n = 2 * config.maxP;
+	const int hop = n / 4;
+	const int frames = (int) ((size - n) / hop) + 1;
+
+	double *refPeriods = malloc(frames * sizeof(double));
+	double *refQualities = malloc(frames * sizeof(double));
+	double *periods = malloc(frames * sizeof(double));
+	double *qualities = malloc(frames * sizeof(double));
+	ck_assert(refPeriods && refQualities && periods && qualities);
+
+	Arena *arena = arenaCreate(estimatorMemorySize(&config));
+	ck_assert(arena != NULL);
+	PeriodEstimator *estimator = estimatorCreate(arena, &config);
+	ck_assert(estimator != NULL);
+
+	for(int i = 0; i < frames; i++) {
+		refPeriods[i] = estimatorRun(estimator, buf + (size_t) i * hop, n,
+				&refQualities[i], 0);
+	}
+
+	for(size_t t = 0; t < sizeof(threads) / sizeof(*threads); t++) {
+		memset(periods, 0, frames * sizeof(double));
+		memset(qualities, 0, frames * sizeof(double));
+
+		ck_assert_int_eq(estimatePeriodBatch(buf, n, hop, frames, &config,
+				threads[t], periods, qualities), 0);
+
+		for(int i = 0; i < frames; i++) {
+			ck_assert_double_eq(periods[i], refPeriods[i]);
+			ck_assert_double_eq(qualities[i], refQualities[i]);
+		}
+	}
+
+	// Nothing to do
+	ck_assert_int_eq(estimatePeriodBatch(buf, n, hop, 0, &config, 0, 0, 0), 0);
+
+	arenaFree(arena);
+	free(refPeriods);
+	free(refQualities);
+	free(periods);
+	free(qualities);
+	free(buf);
+}
+END_TEST
+
+/**
+ * @brief Test that the coarse search on the lag grid finds the same notes.
+ */
+START_TEST(testPeriodEstimatorGrid)
+{
+	/// The sample rate of the samples
+	const int rate = 44100;
+
+	/// The samples to check, with the lowest and the highest notes
+	const char *samples[] = {
+		"E2_string6.pcm",
+		"A2_string5.pcm",
+		"D3_string4.pcm",
+		"A4_string1.pcm",
+	};
+	const size_t numSamples = sizeof(samples) / sizeof(*samples);
+
+	/// The expected semitones from A0 of samples
+	semitone_t expected[] = {
+		noteToSemitones("E", 2),
+		noteToSemitones("A", 2),
+		noteToSemitones("D", 3),
+		noteToSemitones("A", 4),
+	};
+
+	EstimatorConfig config;
+	estimatorConfigInit(&config,
+			(int) floor(rate / noteToFrequency("E", 7)),
+			(int) ceil(rate / noteToFrequency("E", 1)));
+	config.gridStep = ESTIMATOR_GRID_STEP;
+
+	Arena *arena = arenaCreate(estimatorMemorySize(&config));
+	ck_assert(arena != NULL);
+	PeriodEstimator *estimator = estimatorCreate(arena, &config);
+	ck_assert(estimator != NULL);
+
+	const int n = 2 * config.maxP;
+
+	// A sine with harmonics, between two points of the grid
+	const double pi = 4 * atan(1);
+	double p = rate / noteToFrequency("C#", 2) * 1.004;
+	float *x = malloc(n * sizeof(float));
+	for(int i = 0; i < n; i++) {
+		x[i] = sin(2 * pi * i / p) + 0.6 * sin(2 * pi * i * 2 / p) +
+				0.3 * sin(2 * pi * i * 3 / p);
+	}
+
+	double q;
+	double estimated = estimatorRun(estimator, x, n, &q, NULL);
+	ck_assert_double_eq_tol(estimated, p, 0.001 * p);
+	ck_assert_double_eq_tol(q, 1, 0.05);
+	free(x);
+
+	/* The windows of the samples are analyzed as the detection does, and the
+	notes must be right where the full search is right.
+	In the decay the octave correction becomes ambiguous, and the two searches
+	may choose different wrong multiples. */
+	for(size_t i = 0; i < numSamples; i++) {
+		size_t size;
+		float *buf = openSample(samples[i], &size);
+
+		for(size_t start = 0; start + n <= size; start += 4 * n) {
+			double dense, denseQ;
+			double coarse = estimatorRun(estimator, buf + start, n, &q, NULL);
+
+			dense = estimatePeriod(buf + start, n, config.minP, config.maxP,
+					&denseQ, NULL);
+			if(denseQ < 0.9 || dense <= 0 ||
+					frequencyToSemitones(rate / dense, 0) != expected[i]) {
+				continue;
+			}
+
+			ck_assert(coarse > 0);
+			ck_assert_int_eq(frequencyToSemitones(rate / coarse, 0),
+					expected[i]);
+		}
+
+		free(buf);
+	}
+
+	arenaFree(arena);
+}
+END_TEST
+
+/**
+ * @brief Test the estimation with a window proportional to each lag.
+ */
+START_TEST(testPeriodEstimatorPeriods)
+{
+	/// The sample rate of the samples
+	const int rate = 44100;
+
+	EstimatorConfig config;
+	estimatorConfigInit(&config,
+			(int) floor(rate / noteToFrequency("E", 7)),
+			(int) ceil(rate / noteToFrequency("E", 1)));
+	config.periods = ESTIMATOR_WINDOW_PERIODS;
+
+	Arena *arena = arenaCreate(estimatorMemorySize(&config));
+	ck_assert(arena != NULL);
+	PeriodEstimator *estimator = estimatorCreate(arena, &config);
+	ck_assert(estimator != NULL);
+
+	const int n = 2 * config.maxP;
+	const double pi = 4 * atan(1);
+	float *x = malloc(n * sizeof(float));
+	double q;
+
+	/* A high note that begins near the end of the window: the short lags see
+	only the note, and the normalization makes their peak as high as the one
+	of a whole window. */
+	double p = rate / noteToFrequency("E", 5);
+	for(int i = 0; i < n; i++) {
+		x[i] = i < n - 8 * p ? 0 : sin(2 * pi * i / p) +
+				0.5 * sin(2 * pi * i * 2 / p);
+	}
+	double estimated = estimatorRun(estimator, x, n, &q, NULL);
+	ck_assert_double_eq_tol(estimated, p, 0.001 * p);
+	ck_assert_double_eq_tol(q, 1, 0.05);
+
+	// The low notes still use the whole window
+	p = rate / noteToFrequency("F", 1);
+	for(int i = 0; i < n; i++) {
+		x[i] = sin(2 * pi * i / p) + 0.6 * sin(2 * pi * i * 2 / p) +
+				0.3 * sin(2 * pi * i * 3 / p);
+	}
+	estimated = estimatorRun(estimator, x, n, &q, NULL);
+	ck_assert_double_eq_tol(estimated, p, 0.001 * p);
+	ck_assert_double_eq_tol(q, 1, 0.05);
+
+	// The sustain of a real note
+	size_t size;
+	float *buf = openSample("G3_string3.pcm", &size);
+	ck_assert(size >= (size_t) (rate + n));
+	estimated = estimatorRun(estimator, buf + rate, n, &q, NULL);
+	ck_assert_int_eq(frequencyToSemitones(rate / estimated, 0),
+			noteToSemitones("G", 3));
+
+	free(buf);
+	free(x);
+	arenaFree(arena);
+}
+END_TEST
+
+/**
+ * @brief Test the candidates of the estimation, with and without lag grid.
+ */
+START_TEST(testPeriodEstimatorCandidates)
+{
+	/// The sample rate of the samples
+	const int rate = 44100;
+	const double pi = 4 * atan(1);
+
+	EstimatorConfig config;
+	estimatorConfigInit(&config,
+			(int) floor(rate / noteToFrequency("E", 7)),
+			(int) ceil(rate / noteToFrequency("E", 1)));
+
+	const int n = 2 * config.maxP;
+	float *x = malloc(n * sizeof(float));
+	double p = rate / noteToFrequency("A", 2);
+	for(int i = 0; i < n; i++) {
+		x[i] = sin(2 * pi * i / p) + 0.6 * sin(2 * pi * i * 2 / p) +
+				0.3 * sin(2 * pi * i * 3 / p);
+	}
+
+	for(int grid = 0; grid < 2; grid++) {
+		config.gridStep = grid ? ESTIMATOR_GRID_STEP : 0;
+		Arena *arena = arenaCreate(estimatorMemorySize(&config));
+		ck_assert(arena != NULL);
+		PeriodEstimator *estimator = estimatorCreate(arena, &config);
+		ck_assert(estimator != NULL);
+
+		PeriodCandidate candidates[4];
+		int count;
+		double q, refQ;
+		int periodInt, refInt;
+		double ref = estimatorRun(estimator, x, n, &refQ, &refInt);
+		double period = estimatorRunCandidates(estimator, x, n, &q, &periodInt,
+				candidates, 4, &count);
+
+		// The candidates don't change the estimation
+		ck_assert_double_eq(period, ref);
+		ck_assert_double_eq(q, refQ);
+		ck_assert_int_eq(periodInt, refInt);
+		ck_assert_double_eq_tol(period, p, 0.001 * p);
+
+		// The period and its multiple in the range are the strongest peaks
+		ck_assert_int_ge(count, 2);
+		int chosen = 0, octave = 0;
+		for(int i = 0; i < count; i++) {
+			if(i > 0) {
+				ck_assert(candidates[i].quality <= candidates[i - 1].quality);
+			}
+			if(candidates[i].flags & ESTIMATOR_CANDIDATE_CHOSEN) {
+				chosen++;
+				ck_assert_int_eq(candidates[i].ratio, 1);
+				ck_assert_double_eq_tol(candidates[i].period, period, 0.01 * p);
+			}
+			if(candidates[i].flags == (ESTIMATOR_CANDIDATE_MULTIPLE |
+					ESTIMATOR_CANDIDATE_OCTAVE)) {
+				octave++;
+				ck_assert_int_eq(candidates[i].ratio, 2);
+				ck_assert_double_eq_tol(candidates[i].period, 2 * p, 0.02 * p);
+			}
+			// The second harmonic makes a weaker peak at half the period
+			if(candidates[i].flags & ESTIMATOR_CANDIDATE_SUBMULTIPLE) {
+				ck_assert(candidates[i].quality < q);
+			}
+		}
+		ck_assert_int_eq(chosen, 1);
+		ck_assert_int_eq(octave, 1);
+
+		// Only the strongest one fits
+		ck_assert_double_eq(estimatorRunCandidates(estimator, x, n, &q, NULL,
+				candidates, 1, &count), ref);
+		ck_assert_int_eq(count, 1);
+		ck_assert(candidates[0].quality >= 0.99);
+
+		arenaFree(arena);
+	}
+
+	free(x);
+}
+END_TEST
+
+/**
+ * @brief Test the band-split estimator, also with the bands in two threads.
+ */
+START_TEST(testPeriodEstimatorBands)
+{
+	/// The sample rate of the samples
+	const int rate = 44100;
+
+	/// The samples to check
+	const char *samples[] = {
+		"A2_string5.pcm",
+		"A4_string1.pcm",
+		"B3_string2.pcm",
+		"D3_string4.pcm",
+		"E2_string6.pcm",
+		"E4_string1.pcm",
+		"G3_string3.pcm",
+	};
+	const size_t numSamples = sizeof(samples) / sizeof(*samples);
+
+	/// The expected semitones from A0 of samples
+	semitone_t expected[] = {
+		noteToSemitones("A", 2),
+		noteToSemitones("A", 4),
+		noteToSemitones("B", 3),
+		noteToSemitones("D", 3),
+		noteToSemitones("E", 2),
+		noteToSemitones("E", 4),
+		noteToSemitones("G", 3),
+	};
+
+	BandConfig config;
+	bandConfigInit(&config, rate,
+			(int) floor(rate / noteToFrequency("E", 7)),
+			(int) ceil(rate / noteToFrequency("E", 1)));
+
+	size_t memorySize = bandMemorySize(&config);
+	ck_assert(memorySize > 0);
+	Arena *arena = arenaCreate(memorySize);
+	ck_assert(arena != NULL);
+	BandEstimator *estimator = bandCreate(arena, &config);
+	ck_assert(estimator != NULL);
+
+	// The low band must have room for a decimated window
+	BandConfig invalid = config;
+	invalid.crossover = rate / 4.0;
+	ck_assert_int_eq(bandMemorySize(&invalid), 0);
+
+	for(size_t i = 0; i < numSamples; i++) {
+		size_t size;
+		float *buf = openSample(samples[i], &size);
+		// In the sustain, after the attack
+		const float *x = buf + rate / 2;
+		ck_assert(size >= (size_t) (rate / 2 + config.window));
+
+		double q;
+		double period = bandRun(estimator, x, &q);
+		ck_assert(period > 0);
+		ck_assert(q > 0.9);
+		ck_assert_int_eq(frequencyToSemitones(rate / period, 0), expected[i]);
+
+		// The bands have separate buffers, so they can run at the same time
+		LowBandJob job = {estimator, x, 0, 0};
+		pthread_t thread;
+		double highQ;
+		ck_assert_int_eq(pthread_create(&thread, NULL, runLowBand, &job), 0);
+		double high = bandRunHigh(estimator, x, &highQ);
+		ck_assert_int_eq(pthread_join(thread, NULL), 0);
+
+		ck_assert_double_eq(bandCombine(x, config.window, job.period,
+				job.quality, high, highQ, &q), period);
+
+		free(buf);
+	}
+
+	arenaFree(arena);
+}
+END_TEST
+
 /**
  * @brief Create the suite to check estimatePeriod
  * @return The test suite
@@ -197,6 +849,14 @@ Suite *periodEstimatorSuite()
 	Suite *s;
 	TCase *tcSine;
 	TCase *tcSamples;
+	TCase *tcArena;
+	TCase *tcGrid;
+	TCase *tcPeriods;
+	TCase *tcBands;
+	TCase *tcCandidates;
+	TCase *tcSpecialized;
+	TCase *tcFixed;
+	TCase *tcBatch;
 
 	s = suite_create("Period estimator");
 
@@ -209,6 +869,41 @@ Suite *periodEstimatorSuite()
 	tcase_set_timeout(tcSamples, SAMPLES_TIMEOUT);
 	suite_add_tcase(s, tcSamples);
 
+	tcArena = tcase_create("Estimator in arena");
+	tcase_add_test(tcArena, testPeriodEstimatorArena);
+	suite_add_tcase(s, tcArena);
+
+	tcGrid = tcase_create("Lag grid");
+	tcase_add_test(tcGrid, testPeriodEstimatorGrid);
+	tcase_set_timeout(tcGrid, SAMPLES_TIMEOUT);
+	suite_add_tcase(s, tcGrid);
+
+	tcPeriods = tcase_create("Window proportional to the lag");
+	tcase_add_test(tcPeriods, testPeriodEstimatorPeriods);
+	suite_add_tcase(s, tcPeriods);
+
+	tcBands = tcase_create("Band-split estimator");
+	tcase_add_test(tcBands, testPeriodEstimatorBands);
+	suite_add_tcase(s, tcBands);
+
+	tcCandidates = tcase_create("Candidates");
+	tcase_add_test(tcCandidates, testPeriodEstimatorCandidates);
+	suite_add_tcase(s, tcCandidates);
+
+	tcSpecialized = tcase_create("Specialized kernels");
+	tcase_add_test(tcSpecialized, testPeriodEstimatorSpecialized);
+	suite_add_tcase(s, tcSpecialized);
+
+	tcFixed = tcase_create("Fixed point");
+	tcase_add_test(tcFixed, testPeriodEstimatorFixed);
+	tcase_set_timeout(tcFixed, SAMPLES_TIMEOUT);
+	suite_add_tcase(s, tcFixed);
+
+	tcBatch = tcase_create("Batch");
+	tcase_add_test(tcBatch, testPeriodEstimatorBatch);
+	tcase_set_timeout(tcBatch, SAMPLES_TIMEOUT);
+	suite_add_tcase(s, tcBatch);
+
 	return s;
 }
 
@@ -295,3 +990,12 @@ static float *openSample(const char *filename, size_t *size)
 
 	return buf;
 }
+
+void *runLowBand(void *arg)
+{
+	LowBandJob *job = (LowBandJob *) arg;
+
+	job->period = bandRunLow(job->estimator, job->x, &job->quality);
+
+	return 0;
+}
@@ -0,0 +1,544 @@
+/**
+ * @file check_poly.c
+ * @brief Performs unit testing and benchmarking on the chord estimator and
+ *  on the chord recognizer
+ */
+
+/// The check unit framework
+#include <check.h>
+
+/// The library to test
+#include "poly.h"
+
+/// ChromaEstimator, chromaRun, chromaShape, chromaChordName
+#include "chroma.h"
+
+/// Arena, arenaCreate, arenaFree
+#include "arena.h"
+
+/// noteToSemitones, noteToFrequency, Tuning, tuningInit
+#include "guitar.h"
+
+/// timeNow
+#include "timing.h"
+
+/// EXIT_SUCCESS, EXIT_FAILURE, malloc, free
+#include <stdlib.h>
+
+/// strcmp
+#include <string.h>
+
+/// printf
+#include <stdio.h>
+
+/// sin, exp, pow, sqrt, fabs, ceil
+#include <math.h>
+
+/// Macros to use check 0.10 with floating point numbers
+#include "check_float.h"
+
+/**
+ * @brief The sample rate of the synthetic chords.
+ */
+static const unsigned int RATE = 44100;
+
+/**
+ * @brief The number of chords of the benchmark.
+ */
+static const int BENCHMARK_CHORDS = 300;
+
+/**
+ * @brief The number of chords of the benchmark of the recognizer.
+ */
+static const int RECOGNIZER_CHORDS = 240;
+
+/**
+ * @brief The windows of each chord of the benchmark of the recognizer.
+ *
+ * The chroma vector is smoothed, so it needs a few windows to settle.
+ */
+static const int RECOGNIZER_WINDOWS = 3;
+
+/**
+ * @brief The barre chords of each kind, with the root on the sixth string and
+ *  on the fifth one, from the first string.
+ *
+ * The frets are relative to the barre, and -1 means a string not played.
+ */
+static const semitone_t SHAPES[CHROMA_KINDS][2][GUITAR_STRINGS] = {
+	{{0, 0, 1, 2, 2, 0}, {0, 2, 2, 2, 0, -1}},
+	{{0, 0, 0, 2, 2, 0}, {0, 1, 2, 2, 0, -1}},
+	{{0, 0, 1, 0, 2, 0}, {0, 2, 0, 2, 0, -1}},
+	{{0, 0, 0, 0, 2, 0}, {0, 1, 0, 2, 0, -1}},
+};
+
+/**
+ * @brief The number of harmonics of the synthetic notes.
+ */
+#define SYNTH_HARMONICS 20
+
+/**
+ * @brief The state of the generator of the synthetic chords.
+ *
+ * The generator is deterministic, so the results are the same on every run.
+ */
+static unsigned int gSeed;
+
+/**
+ * @brief Get a pseudo-random number.
+ *
+ * @return A number in [0, 1)
+ */
+static double randomUnit(void);
+
+/**
+ * @brief Synthesize a chord of plucked strings.
+ *
+ * The harmonics have random phases, they decay faster as they get higher, and
+ * they are slightly sharp, like the ones of a real string.
+ *
+ * @param x The output buffer
+ * @param n The number of samples
+ * @param notes The notes
+ * @param count The number of notes
+ * @param offset The time of the first sample from the pluck, in samples
+ */
+static void synthesizeChord(float *x, int n, const semitone_t *notes,
+		int count, int offset);
+
+/**
+ * @brief Create an estimator with the default configuration at RATE.
+ *
+ * @param arena Output parameter for the arena of the estimator
+ * @param config Output parameter for the configuration
+ * @return The estimator
+ */
+static PolyEstimator *createDefault(Arena **arena, PolyConfig *config);
+
+/**
+ * @brief Tests single notes all over the neck
+ */
+START_TEST(testPolySingleNotes)
+{
+	Arena *arena;
+	PolyConfig config;
+	PolyEstimator *estimator = createDefault(&arena, &config);
+	float *x = malloc(config.window * sizeof(float));
+	PolyNote notes[POLY_MAX_NOTES];
+
+	gSeed = 1;
+	for(semitone_t note = config.lowest; note <= noteToSemitones("E", 5);
+			note += 5) {
+		synthesizeChord(x, config.window, &note, 1, RATE / 20);
+		ck_assert_uint_eq(polyRun(estimator, x, notes), 1);
+		ck_assert_int_eq(notes[0].note, note);
+
+		// The frequency is refined on the harmonics, which are sharp
+		double expected = noteToFrequency("A", 0) * pow(2, note / 12.0);
+		ck_assert_double_eq_tol(notes[0].frequency / expected, 1, 0.005);
+	}
+
+	free(x);
+	arenaFree(arena);
+}
+END_TEST
+
+/**
+ * @brief Tests the assignment of the notes of a chord to the strings
+ */
+START_TEST(testPolyStrings)
+{
+	Tuning tuning;
+	PolyNote notes[POLY_MAX_NOTES];
+	/// Open E major, from the lowest string
+	const char *names[] = {"E", "B", "E", "G#", "B", "E"};
+	const semitone_t octaves[] = {2, 2, 3, 3, 3, 4};
+	const semitone_t frets[] = {0, 2, 2, 1, 0, 0};
+
+	tuningInit(&tuning, STANDARD_TUNING, GUITAR_STRINGS, GUITAR_FRETS);
+
+	for(int i = 0; i < 6; i++) {
+		notes[i].note = noteToSemitones(names[i], octaves[i]);
+	}
+
+	ck_assert_uint_eq(polyAssignStrings(&tuning, notes, 6), 6);
+	for(int i = 0; i < 6; i++) {
+		// The strings are numbered from the highest one
+		ck_assert_int_eq(notes[i].string, 5 - i);
+		ck_assert_int_eq(notes[i].fret, frets[i]);
+	}
+
+	// E2 and F2 can only be played on the lowest string
+	notes[0].note = noteToSemitones("E", 2);
+	notes[1].note = noteToSemitones("F", 2);
+	notes[2].note = noteToSemitones("A", 3);
+	ck_assert_uint_eq(polyAssignStrings(&tuning, notes, 3), 2);
+	ck_assert((notes[0].string < 0) != (notes[1].string < 0));
+	ck_assert_int_ge(notes[2].string, 0);
+
+	// Notes out of the neck
+	notes[0].note = noteToSemitones("C", 1);
+	ck_assert_uint_eq(polyAssignStrings(&tuning, notes, 1), 0);
+	ck_assert_int_eq(notes[0].string, -1);
+	ck_assert_int_eq(notes[0].fret, -1);
+}
+END_TEST
+
+/**
+ * @brief Benchmark the estimator on random chords, and check its accuracy and
+ *  its cost against the hop of the detection
+ */
+START_TEST(testPolyChords)
+{
+	Arena *arena;
+	PolyConfig config;
+	PolyEstimator *estimator = createDefault(&arena, &config);
+	float *x = malloc(config.window * sizeof(float));
+	PolyNote found[POLY_MAX_NOTES];
+	/// The open strings, from the lowest one
+	semitone_t open[GUITAR_STRINGS];
+	/// The duration of the default hop of the detection, in seconds
+	double hop = 2 * ceil(RATE / noteToFrequency("E", 1)) / RATE;
+	/// The time spent in the estimator
+	double elapsed = 0;
+	/// The notes that have been found correctly
+	int hits = 0;
+	/// The notes that have been found but were not played
+	int falsePositives = 0;
+	/// The notes that were played but have not been found
+	int misses = 0;
+
+	for(int s = 0; s < GUITAR_STRINGS; s++) {
+		open[s] = STANDARD_TUNING[GUITAR_STRINGS - 1 - s];
+	}
+
+	gSeed = 1;
+	for(int chord = 0; chord < BENCHMARK_CHORDS; chord++) {
+		semitone_t notes[POLY_MAX_NOTES];
+		int count = 0;
+		int used = 0;
+
+		/* From one to six notes on different strings, in the first frets.
+		The octaves of another note are skipped, because they are hidden by
+		its harmonics. */
+		for(int i = 0; i <= chord % POLY_MAX_NOTES; i++) {
+			int s;
+			do {
+				s = (int) (randomUnit() * GUITAR_STRINGS);
+			} while(used & (1 << s));
+			used |= 1 << s;
+
+			semitone_t note = open[s] + (semitone_t) (randomUnit() * 5);
+			int octave = 0;
+			for(int j = 0; j < count; j++) {
+				octave = octave || (notes[j] - note) % 12 == 0;
+			}
+			if(!octave) {
+				notes[count++] = note;
+			}
+		}
+
+		synthesizeChord(x, config.window, notes, count, 1500);
+
+		double start = timeNow();
+		unsigned int n = polyRun(estimator, x, found);
+		elapsed += timeNow() - start;
+
+		int correct = 0;
+		for(unsigned int i = 0; i < n; i++) {
+			int played = 0;
+			for(int j = 0; j < count; j++) {
+				played = played || found[i].note == notes[j];
+			}
+			correct += played;
+		}
+		hits += correct;
+		falsePositives += n - correct;
+		misses += count - correct;
+	}
+
+	double precision = hits / (double) (hits + falsePositives);
+	double recall = hits / (double) (hits + misses);
+	double frame = elapsed / BENCHMARK_CHORDS;
+
+	printf("Chords: precision %.3f, recall %.3f, %.0f us per window, "
+			"%.1f%% of the hop.\n", precision, recall, frame * 1e6,
+			100 * frame / hop);
+
+	ck_assert_msg(precision >= 0.9, "Precision %f is too low.", precision);
+	ck_assert_msg(recall >= 0.85, "Recall %f is too low.", recall);
+	ck_assert_msg(frame < hop, "A window takes %f s, more than a hop.", frame);
+
+	free(x);
+	arenaFree(arena);
+}
+END_TEST
+
+/**
+ * @brief Tests the names and the shapes of the chords
+ */
+START_TEST(testChromaShapes)
+{
+	Tuning tuning;
+	ChromaChord chord;
+	semitone_t frets[GUITAR_MAX_STRINGS];
+	char name[CHROMA_NAME_SIZE];
+	/// E, C and Am, in the open position, from the first string
+	const semitone_t e[] = {0, 0, 1, 2, 2, 0};
+	const semitone_t c[] = {0, 1, 0, 2, 3, -1};
+	const semitone_t am[] = {0, 1, 2, 2, 0, -1};
+
+	tuningInit(&tuning, STANDARD_TUNING, GUITAR_STRINGS, GUITAR_FRETS);
+
+	chord.root = noteToSemitones("E", 1) % CHROMA_CLASSES;
+	chord.kind = CHROMA_MAJOR;
+	chromaChordName(&chord, name);
+	ck_assert_str_eq(name, "E");
+	ck_assert_uint_eq(chromaShape(&tuning, &chord, frets), 6);
+	for(int s = 0; s < GUITAR_STRINGS; s++) {
+		ck_assert_int_eq(frets[s], e[s]);
+	}
+
+	chord.root = noteToSemitones("C", 1) % CHROMA_CLASSES;
+	ck_assert_uint_eq(chromaShape(&tuning, &chord, frets), 5);
+	for(int s = 0; s < GUITAR_STRINGS; s++) {
+		ck_assert_int_eq(frets[s], c[s]);
+	}
+
+	chord.root = noteToSemitones("A", 0) % CHROMA_CLASSES;
+	chord.kind = CHROMA_MINOR;
+	chromaChordName(&chord, name);
+	ck_assert_str_eq(name, "Am");
+	ck_assert_uint_eq(chromaShape(&tuning, &chord, frets), 5);
+	for(int s = 0; s < GUITAR_STRINGS; s++) {
+		ck_assert_int_eq(frets[s], am[s]);
+	}
+
+	chord.root = noteToSemitones("C#", 1) % CHROMA_CLASSES;
+	chord.kind = CHROMA_MINOR_SEVENTH;
+	chromaChordName(&chord, name);
+	ck_assert_str_eq(name, "C#m7");
+	ck_assert_uint_gt(chromaShape(&tuning, &chord, frets), 0);
+	ck_assert_int_lt(frets[GUITAR_STRINGS - 1], 0);
+}
+END_TEST
+
+/**
+ * @brief Benchmark the recognizer on barre chords, and check its accuracy and
+ *  its cost against the one of the chord estimator
+ */
+START_TEST(testChromaChords)
+{
+	Arena *arena;
+	ChromaConfig config;
+	ChromaEstimator *estimator;
+	Arena *polyArena;
+	PolyConfig polyConfig;
+	PolyEstimator *poly = createDefault(&polyArena, &polyConfig);
+	PolyNote found[POLY_MAX_NOTES];
+	/// The default hop of the detection
+	int hop = 2 * (int) ceil(RATE / noteToFrequency("E", 1));
+	/// The signal of a chord, for all its windows
+	float *x;
+	/// The time spent in the recognizer
+	double elapsed = 0;
+	/// The time spent in the chord estimator
+	double polyElapsed = 0;
+	/// The chords that have been recognized correctly
+	int correct = 0;
+
+	chromaConfigInit(&config, RATE);
+	arena = arenaCreate(chromaMemorySize(&config));
+	ck_assert(arena != NULL);
+	estimator = chromaCreate(arena, &config);
+	ck_assert(estimator != NULL);
+
+	int size = config.window + (RECOGNIZER_WINDOWS - 1) * hop;
+	x = malloc((size > polyConfig.window ? size : polyConfig.window) *
+			sizeof(float));
+
+	gSeed = 1;
+	for(int i = 0; i < RECOGNIZER_CHORDS; i++) {
+		ChromaChord expected;
+		ChromaChord chord = {0, CHROMA_MAJOR, 0};
+		semitone_t notes[GUITAR_STRINGS];
+		int count = 0;
+
+		expected.kind = (ChromaKind) (i % CHROMA_KINDS);
+		expected.root = (semitone_t) (randomUnit() * CHROMA_CLASSES);
+
+		// The shape with the lowest barre
+		int barre = (expected.root - STANDARD_TUNING[GUITAR_STRINGS - 1] +
+				2 * CHROMA_CLASSES) % CHROMA_CLASSES;
+		int shape = 0;
+		int fifth = (expected.root - STANDARD_TUNING[GUITAR_STRINGS - 2] +
+				2 * CHROMA_CLASSES) % CHROMA_CLASSES;
+		if(fifth < barre) {
+			barre = fifth;
+			shape = 1;
+		}
+
+		for(int s = 0; s < GUITAR_STRINGS; s++) {
+			if(SHAPES[expected.kind][shape][s] >= 0) {
+				notes[count++] = STANDARD_TUNING[s] + barre +
+						SHAPES[expected.kind][shape][s];
+			}
+		}
+
+		synthesizeChord(x, size, notes, count, 1500);
+
+		chromaReset(estimator);
+		double start = timeNow();
+		for(int w = 0; w < RECOGNIZER_WINDOWS; w++) {
+			chromaRun(estimator, x + w * hop, &chord);
+		}
+		elapsed += timeNow() - start;
+
+		correct += chord.root == expected.root && chord.kind == expected.kind;
+
+		start = timeNow();
+		polyRun(poly, x, found);
+		polyElapsed += timeNow() - start;
+	}
+
+	double accuracy = correct / (double) RECOGNIZER_CHORDS;
+	double window = elapsed / (RECOGNIZER_CHORDS * RECOGNIZER_WINDOWS);
+	double polyWindow = polyElapsed / RECOGNIZER_CHORDS;
+
+	printf("Chord names: accuracy %.3f, %.0f us per window, %.1f%% of the "
+			"chord estimator.\n", accuracy, window * 1e6,
+			100 * window / polyWindow);
+
+	ck_assert_msg(accuracy >= 0.9, "Accuracy %f is too low.", accuracy);
+	ck_assert_msg(window < polyWindow / 2, "A window takes %f s, the chord "
+			"estimator %f s.", window, polyWindow);
+
+	// The bins below A0 are folded in their classes too
+	/// F major, with the root on F0
+	semitone_t low[] = {-4, 8, 12, 15};
+	ChromaChord chord = {0, CHROMA_MINOR, 0};
+	config.lowest = config.reference / 32;
+	Arena *lowArena = arenaCreate(chromaMemorySize(&config));
+	ck_assert(lowArena != NULL);
+	estimator = chromaCreate(lowArena, &config);
+	ck_assert(estimator != NULL);
+	synthesizeChord(x, size, low, 4, 1500);
+	for(int w = 0; w < RECOGNIZER_WINDOWS; w++) {
+		chromaRun(estimator, x + w * hop, &chord);
+	}
+	ck_assert_int_eq(chord.root, 8);
+	ck_assert_int_eq(chord.kind, CHROMA_MAJOR);
+	arenaFree(lowArena);
+
+	free(x);
+	arenaFree(arena);
+	arenaFree(polyArena);
+}
+END_TEST
+
+Suite *polySuite(void)
+{
+	Suite *s;
+	TCase *tcSingle;
+	TCase *tcStrings;
+	TCase *tcChords;
+	TCase *tcChromaShapes;
+	TCase *tcChromaChords;
+
+	s = suite_create("Chords");
+
+	tcSingle = tcase_create("Single notes");
+	tcase_add_test(tcSingle, testPolySingleNotes);
+	suite_add_tcase(s, tcSingle);
+
+	tcStrings = tcase_create("Strings");
+	tcase_add_test(tcStrings, testPolyStrings);
+	suite_add_tcase(s, tcStrings);
+
+	tcChords = tcase_create("Mixed chords");
+	tcase_add_test(tcChords, testPolyChords);
+	tcase_set_timeout(tcChords, 60.0);
+	suite_add_tcase(s, tcChords);
+
+	tcChromaShapes = tcase_create("Chord names and shapes");
+	tcase_add_test(tcChromaShapes, testChromaShapes);
+	suite_add_tcase(s, tcChromaShapes);
+
+	tcChromaChords = tcase_create("Chord recognition");
+	tcase_add_test(tcChromaChords, testChromaChords);
+	tcase_set_timeout(tcChromaChords, 60.0);
+	suite_add_tcase(s, tcChromaChords);
+
+	return s;
+}
+
+int main()
+{
+	int number_failed;
+	Suite *s;
+	SRunner *sr;
+
+	s = polySuite();
+	sr = srunner_create(s);
+
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static double randomUnit(void)
+{
+	gSeed = gSeed * 1103515245 + 12345;
+	return ((gSeed >> 8) & 0xffff) / 65536.0;
+}
+
+static void synthesizeChord(float *x, int n, const semitone_t *notes,
+		int count, int offset)
+{
+	for(int i = 0; i < n; i++) {
+		x[i] = 0;
+	}
+
+	for(int j = 0; j < count; j++) {
+		double f0 = noteToFrequency("A", 0) * pow(2, notes[j] / 12.0);
+		double amplitude = (0.6 + 0.8 * randomUnit()) / count;
+		double inharmonicity = 0.0001 * randomUnit();
+		double phases[SYNTH_HARMONICS];
+
+		for(int h = 0; h < SYNTH_HARMONICS; h++) {
+			phases[h] = 2 * M_PI * randomUnit();
+		}
+
+		for(int h = 1; h <= SYNTH_HARMONICS; h++) {
+			double f = h * f0 * sqrt(1 + inharmonicity * h * h);
+			if(f >= RATE / 2) {
+				break;
+			}
+
+			for(int i = 0; i < n; i++) {
+				double t = (i + offset) / (double) RATE;
+				x[i] += amplitude * sin(2 * M_PI * f * t + phases[h - 1]) / h *
+						exp(-t * (1 + 0.3 * h));
+			}
+		}
+	}
+
+	// Some noise, like the one of the pickups
+	for(int i = 0; i < n; i++) {
+		x[i] += 0.001 * (randomUnit() - 0.5);
+	}
+}
+
+static PolyEstimator *createDefault(Arena **arena, PolyConfig *config)
+{
+	polyConfigInit(config, RATE);
+
+	*arena = arenaCreate(polyMemorySize(config));
+	ck_assert(*arena != NULL);
+
+	PolyEstimator *ret = polyCreate(*arena, config);
+	ck_assert(ret != NULL);
+
+	return ret;
+}
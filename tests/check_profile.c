@@ -0,0 +1,142 @@
+/**
+ * @file check_profile.c
+ * @brief Performs unit testing on the profiles of the calibration.
+ */
+
+/// The library to test
+#include "profile.h"
+
+/// The check unit framework
+#include <check.h>
+
+/// EXIT_SUCCESS, EXIT_FAILURE
+#include <stdlib.h>
+
+/// fopen, fputs, fclose, remove
+#include <stdio.h>
+
+/**
+ * @brief The path of the profile of the tests.
+ */
+static const char *PATH = "check_profile.profile";
+
+/**
+ * @brief Write a file with the path of the tests.
+ *
+ * @param content The content of the file
+ */
+static void writeProfile(const char *content);
+
+/**
+ * @brief Test that a saved profile is loaded as it was.
+ */
+START_TEST(testProfileRoundTrip)
+{
+	Profile profile;
+	Profile loaded;
+	FILE *fp;
+
+	profileInit(&profile);
+	profile.rate = 48000;
+	profile.latency = 0.0025;
+	profile.hop = 1165;
+	profile.ring = 1.5;
+	profile.floatSums = 1;
+	ck_assert_int_eq(profileSave(&profile, PATH), 0);
+
+	// Only the complete file is left
+	fp = fopen("check_profile.profile.tmp", "r");
+	ck_assert(fp == NULL);
+
+	profileInit(&loaded);
+	ck_assert_int_eq(profileLoad(&loaded, PATH), 0);
+	ck_assert_uint_eq(loaded.rate, profile.rate);
+	ck_assert(loaded.latency == profile.latency);
+	ck_assert_uint_eq(loaded.hop, profile.hop);
+	ck_assert(loaded.ring == profile.ring);
+	ck_assert_int_eq(loaded.floatSums, 1);
+
+	remove(PATH);
+	ck_assert_int_eq(profileLoad(&loaded, PATH), -1);
+}
+END_TEST
+
+/**
+ * @brief Test that a profile edited by hand is parsed, and that an invalid
+ *  one is refused as a whole.
+ */
+START_TEST(testProfileParse)
+{
+	Profile profile;
+
+	profileInit(&profile);
+	profile.hop = 100;
+
+	// Comments, blank lines, unknown keys and missing keys are accepted
+	writeProfile("# A comment\n\n  latency-us\t5000 \ncolor blue\nrate 44100");
+	ck_assert_int_eq(profileLoad(&profile, PATH), 0);
+	ck_assert_uint_eq(profile.rate, 44100);
+	ck_assert(profile.latency == 0.005);
+	ck_assert_uint_eq(profile.hop, 100);
+
+	writeProfile("hop 1071\nlatency-us -5000\n");
+	ck_assert_int_eq(profileLoad(&profile, PATH), -2);
+	ck_assert_uint_eq(profile.hop, 100);
+
+	writeProfile("hop 1071 samples\n");
+	ck_assert_int_eq(profileLoad(&profile, PATH), -2);
+
+	writeProfile("float-sums 2\n");
+	ck_assert_int_eq(profileLoad(&profile, PATH), -2);
+
+	writeProfile("ring-ms\n");
+	ck_assert_int_eq(profileLoad(&profile, PATH), -2);
+	ck_assert(profile.ring == 0);
+
+	remove(PATH);
+}
+END_TEST
+
+/**
+ * @brief Create the suite to check the profiles
+ * @return The test suite
+ */
+Suite *profileSuite()
+{
+	Suite *s;
+	TCase *tcCore;
+
+	s = suite_create("Profile");
+
+	tcCore = tcase_create("Core");
+	tcase_add_test(tcCore, testProfileRoundTrip);
+	tcase_add_test(tcCore, testProfileParse);
+	suite_add_tcase(s, tcCore);
+
+	return s;
+}
+
+int main()
+{
+	int numberFailed;
+	Suite *s;
+	SRunner *sr;
+
+	s = profileSuite();
+	sr = srunner_create(s);
+
+	srunner_run_all(sr, CK_NORMAL);
+	numberFailed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (numberFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void writeProfile(const char *content)
+{
+	FILE *fp = fopen(PATH, "w");
+
+	ck_assert(fp != NULL);
+	fputs(content, fp);
+	fclose(fp);
+}
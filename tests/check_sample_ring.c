@@ -0,0 +1,195 @@
+/**
+ * @file check_sample_ring.c
+ * @brief Performs unit testing on the single-producer/single-consumer ring.
+ */
+
+/// The library to test
+#include "sample_ring.h"
+
+/// The check unit framework
+#include <check.h>
+
+/// EXIT_SUCCESS, EXIT_FAILURE
+#include <stdlib.h>
+
+/// pthread_create, pthread_join
+#include <pthread.h>
+
+/**
+ * @brief The number of samples that the threaded test exchanges.
+ */
+static const size_t THREADED_SAMPLES = 1 << 22;
+
+/**
+ * @brief Tests the counters and that windows crossing the end are contiguous.
+ */
+START_TEST(testSampleRingWrap)
+{
+	SampleRing *ring = sampleRingCreate(1000);
+	ck_assert(ring != NULL);
+
+	size_t capacity = sampleRingCapacity(ring);
+	ck_assert_uint_ge(capacity, 1000);
+	// Capacity must be a power of two
+	ck_assert_uint_eq(capacity & (capacity - 1), 0);
+
+	ck_assert_uint_eq(sampleRingFillCount(ring), 0);
+	ck_assert_uint_eq(sampleRingFreeCount(ring), capacity);
+
+	/* Move the indices near the end of the buffer, so that next window will
+	cross it. */
+	size_t offset = capacity - 10;
+	float *w = sampleRingWritePtr(ring);
+	for(size_t i = 0; i < offset; i++) {
+		w[i] = -1;
+	}
+	sampleRingAdvanceWrite(ring, offset);
+	ck_assert_uint_eq(sampleRingFillCount(ring), offset);
+	sampleRingConsume(ring, offset);
+	ck_assert_uint_eq(sampleRingFreeCount(ring), capacity);
+
+	// Write a ramp of half the capacity with the copy function
+	size_t len = capacity / 2;
+	float *ramp = malloc(len * sizeof(float));
+	for(size_t i = 0; i < len; i++) {
+		ramp[i] = (float) i;
+	}
+	ck_assert_uint_eq(sampleRingWrite(ring, ramp, len), len);
+	ck_assert_uint_eq(sampleRingFreeCount(ring), capacity - len);
+
+	// Peek doesn't consume, and the window is contiguous
+	size_t count;
+	float *r = sampleRingPeek(ring, &count);
+	ck_assert_uint_eq(count, len);
+	for(size_t i = 0; i < len; i++) {
+		ck_assert(r[i] == (float) i);
+	}
+	ck_assert(sampleRingPeek(ring, &count) == r);
+	ck_assert_uint_eq(count, len);
+
+	// Partial consumption, as an overlapping analysis would do
+	sampleRingConsume(ring, 100);
+	r = sampleRingPeek(ring, &count);
+	ck_assert_uint_eq(count, len - 100);
+	ck_assert(r[0] == 100.0f);
+
+	// The copy function doesn't write more than the free space
+	ck_assert_uint_eq(sampleRingWrite(ring, ramp, len), len);
+	ck_assert_uint_eq(sampleRingWrite(ring, ramp, len), 100);
+	ck_assert_uint_eq(sampleRingFreeCount(ring), 0);
+	ck_assert_uint_eq(sampleRingFillCount(ring), capacity);
+
+	free(ramp);
+	sampleRingFree(ring);
+}
+END_TEST
+
+/**
+ * @brief The producer of the threaded test.
+ *
+ * It writes an increasing sequence, in blocks of variable size.
+ *
+ * @param ringPtr The ring
+ * @return Always NULL
+ */
+static void *producer(void *ringPtr)
+{
+	SampleRing *ring = (SampleRing *) ringPtr;
+	size_t written = 0;
+	size_t block = 1;
+
+	while(written < THREADED_SAMPLES) {
+		size_t freeCount = sampleRingFreeCount(ring);
+		size_t n = block < freeCount ? block : freeCount;
+		if(n > THREADED_SAMPLES - written) {
+			n = THREADED_SAMPLES - written;
+		}
+
+		float *w = sampleRingWritePtr(ring);
+		for(size_t i = 0; i < n; i++) {
+			// Floats are exact up to 2^24
+			w[i] = (float) (written + i);
+		}
+		sampleRingAdvanceWrite(ring, n);
+		written += n;
+
+		block = block * 3 % 1021 + 1;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Tests a producer and a consumer in different threads.
+ */
+START_TEST(testSampleRingThreads)
+{
+	SampleRing *ring = sampleRingCreate(4096);
+	ck_assert(ring != NULL);
+
+	pthread_t thread;
+	ck_assert_int_eq(pthread_create(&thread, NULL, producer, ring), 0);
+
+	size_t read = 0;
+	while(read < THREADED_SAMPLES) {
+		size_t count;
+		float *r = sampleRingPeek(ring, &count);
+
+		for(size_t i = 0; i < count; i++) {
+			ck_assert(r[i] == (float) (read + i));
+		}
+
+		// Leave some samples, to check overlapping reads, too
+		if(count > 7) {
+			count -= 7;
+		} else if(read + count < THREADED_SAMPLES) {
+			count = 0;
+		}
+		sampleRingConsume(ring, count);
+		read += count;
+	}
+
+	pthread_join(thread, NULL);
+	ck_assert_uint_eq(sampleRingFillCount(ring), 0);
+
+	sampleRingFree(ring);
+}
+END_TEST
+
+/**
+ * @brief Create the suite to check the ring buffer
+ * @return The test suite
+ */
+Suite *sampleRingSuite()
+{
+	Suite *s;
+	TCase *tcWrap;
+	TCase *tcThreads;
+
+	s = suite_create("Sample ring");
+
+	tcWrap = tcase_create("Wrap around");
+	tcase_add_test(tcWrap, testSampleRingWrap);
+	suite_add_tcase(s, tcWrap);
+
+	tcThreads = tcase_create("Producer and consumer");
+	tcase_add_test(tcThreads, testSampleRingThreads);
+	suite_add_tcase(s, tcThreads);
+
+	return s;
+}
+
+int main()
+{
+	int number_failed;
+	Suite *s;
+	SRunner *sr;
+
+	s = sampleRingSuite();
+	sr = srunner_create(s);
+
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}